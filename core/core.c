@@ -233,13 +233,20 @@ static int __core_worker_init(core_t *core)
                 nodeid = core->main_core->node_id;
         }
 
+        ret = mem_stat_private_init(core->hash);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
         if (ltgconf_global.daemon) {
                 void *hugepage = hugepage_private_init(core->hash, nodeid);
                 core_tls_set(VARIABLE_HUGEPAGE, hugepage);
         }
 
         core->interrupt_eventfd = -1;
-        int *interrupt = !(core->flag & CORE_FLAG_POLLING) ? &core->interrupt_eventfd : NULL;
+        /* rdma_event cores sleep on it between cq events */
+        int *interrupt = (!(core->flag & CORE_FLAG_POLLING)
+                          || (ltgconf_global.rdma && ltgconf_global.rdma_event))
+                ? &core->interrupt_eventfd : NULL;
 
         snprintf(name, sizeof(name), core->name);
         ret = sche_create(interrupt, name, &core->sche_idx, &core->sche, NULL);
@@ -248,6 +255,7 @@ static int __core_worker_init(core_t *core)
         }
 
         core_tls_set(VARIABLE_SCHEDULE, core->sche);
+        core->sche->sleepy = (core->flag & CORE_FLAG_POLLING) && interrupt;
 
         DINFO("%s[%u] sche[%d] inited\n", core->name, core->hash, core->sche_idx);
 
@@ -259,6 +267,10 @@ static int __core_worker_init(core_t *core)
         if (ret)
                 GOTO(err_ret, ret);
 
+        ret = mem_chunk_private_init(core->hash);
+        if (ret)
+                GOTO(err_ret, ret);
+
         if (ltgconf_global.daemon) {
                 ret = mem_ring_private_init(core->hash);
                 if (unlikely(ret))
@@ -58,7 +58,8 @@ static void S_LTG __core_ring_queue__(int rcoreid, struct ringbuf *ring,
         }
 
         if (found == 0) {
-                ring_bulk = slab_stream_alloc(sizeof(*ring_bulk));
+                ring_bulk = obj_pool_alloc(OBJ_POOL_RING_BULK,
+                                           sizeof(*ring_bulk));
                 LTG_ASSERT(ring_bulk);
                 ring_bulk->ring = ring;
                 ring_bulk->rcoreid = rcoreid;
@@ -110,7 +111,7 @@ inline static void INLINE __core_ring_commit(void *_core, void *var, void *arg)
                         sche_post(rcore->sche);
                 }
                 
-                slab_stream_free(ring_bulk);
+                obj_pool_free(ring_bulk);
         }
 }
 
@@ -147,7 +148,13 @@ int core_ring_init(core_t *core)
         DBUG("core ring bulk\n");
         
         INIT_LIST_HEAD(&__queue__);
-        
+
+        /* at most one bulk per remote ring is queued between commits */
+        ret = obj_pool_private_init(core->hash, OBJ_POOL_RING_BULK, "ring_bulk",
+                                    sizeof(ring_bulk_t), CORE_MAX);
+        if (ret)
+                GOTO(err_ret, ret);
+
         ret = core_register_poller("__core_ring_commit", __core_ring_commit,
                                    &__queue__);
         if (ret)
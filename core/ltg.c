@@ -78,6 +78,13 @@ int ltg_conf_init(ltgconf_t *ltgconf, const char *system_name)
         ltgconf->coredump = 1;
         ltgconf->wmem_max = XMITBUF;
         ltgconf->rmem_max = XMITBUF;
+        ltgconf->slab_reclaim_idle = 60;
+        ltgconf->obj_pool_count = 1024;
+        ltgconf->tcp_conn = 1;
+        ltgconf->rpc_local = 1;
+        ltgconf->rdma_mr_min = 64 * 1024;
+        ltgconf->rdma_stripe = 256 * 1024;
+        ltgconf->rpc_table_max = 64 * 1024;
 
         memset(&ltg_netconf_global, 0x0, sizeof(ltg_netconf_global));
         memset(&ltg_netconf_manage, 0x0, sizeof(ltg_netconf_manage));
@@ -577,7 +577,7 @@ static int __sche_create__(sche_t **_sche, const char *name, int idx,
         strcpy(sche->name, name);
 
 #if 1
-        ret = ltg_malloc((void **)&taskctx, sizeof(*taskctx) * TASK_MAX);
+        ret = ltg_malloc_tag((void **)&taskctx, sizeof(*taskctx) * TASK_MAX, MEM_TAG_TASK);
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 #endif
@@ -830,6 +830,13 @@ void sche_post(sche_t *sche)
 
         DBUG("eventfd %d\n", sche->eventfd);
         if (unlikely(sche->eventfd != -1)) {
+                /* pairs with the check before the core sleeps */
+                if (sche->sleepy) {
+                        __atomic_add_fetch(&sche->posted, 1, __ATOMIC_SEQ_CST);
+                        if (!__atomic_load_n(&sche->sleeping, __ATOMIC_SEQ_CST))
+                                return;
+                }
+
                 ret = write(sche->eventfd, &e, sizeof(e));
                 if (ret < 0) {
                         ret = errno;
@@ -454,7 +454,7 @@ static void *__sche_task_new(sche_t *sche)
             && ENABLE_TASK_HUGEPAGE) {
                 if (sche->task_hpage == NULL) {
                         uint32_t size = HUGEPAGE_SIZE;
-                        int ret = hugepage_getfree((void **)&vaddr, &size, __FUNCTION__);
+                        int ret = hugepage_getfree((void **)&vaddr, &size, MEM_TAG_TASK, __FUNCTION__);
                         LTG_ASSERT(ret == 0);
                         LTG_ASSERT(size == HUGEPAGE_SIZE);
 
@@ -478,7 +478,7 @@ static void *__sche_task_new(sche_t *sche)
                               sche->task_hpage, sche->task_hpage_offset);
                 }
         } else {
-                ret = ltg_malloc((void **)&stack, DEFAULT_STACK_SIZE);
+                ret = ltg_malloc_tag((void **)&stack, DEFAULT_STACK_SIZE, MEM_TAG_TASK);
                 LTG_ASSERT(ret == 0);
         }
 
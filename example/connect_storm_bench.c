@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * connection setup between two cores of this node. core 0 opens a new
+ * connection to the listener of the other core with corenet_tcp_connect,
+ * makes one empty corerpc call on it with corerpc_postwait_sock and closes
+ * it. the reply comes back only after the listener side took the handshake
+ * and added the socket to its core, so each one goes through the accept
+ * path of corenet_tcp_passive: a thread per connection by default, the
+ * core's poller with -a (tcp_accept_core). needs the same environment as
+ * init, etcd included. reports connections per second and setup latency.
+ */
+
+#define BENCH_MSG (LTG_MSG_MAX - 1)
+
+typedef struct {
+        coreid_t coreid;
+        int count;
+        uint32_t addr;
+        uint32_t port;
+} bench_arg_t;
+
+static int __bench_null(ltgbuf_t *in, ltgbuf_t *out, int *outlen)
+{
+        (void) in;
+        (void) out;
+
+        *outlen = 0;
+
+        return 0;
+}
+
+static void __bench_get_handler(const ltgbuf_t *buf, request_handler_func *func,
+                                const char **name)
+{
+        (void) buf;
+
+        *func = __bench_null;
+        *name = "bench_null";
+}
+
+static int __bench_cmp(const void *a, const void *b)
+{
+        uint64_t x = *(uint64_t *)a, y = *(uint64_t *)b;
+
+        return x < y ? -1 : (x > y);
+}
+
+static int __bench_conn(const bench_arg_t *arg)
+{
+        int ret, req = 0;
+        sockid_t sockid;
+
+        ret = corenet_tcp_connect(&arg->coreid, arg->addr, arg->port, &sockid);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        ret = corerpc_postwait_sock("bench_conn", &arg->coreid, &sockid, &req,
+                                    sizeof(req), BENCH_MSG, -1,
+                                    ltgconf_global.rpc_timeout);
+        if (ret)
+                GOTO(err_close, ret);
+
+        corenet_tcp_close(&sockid);
+
+        return 0;
+err_close:
+        corenet_tcp_close(&sockid);
+err_ret:
+        return ret;
+}
+
+static int __bench_run(va_list ap)
+{
+        int ret, i;
+        bench_arg_t *arg = va_arg(ap, bench_arg_t *);
+        struct timeval t1, t2, t3;
+        uint64_t *lat;
+        int64_t used;
+
+        va_end(ap);
+
+        lat = malloc(sizeof(*lat) * arg->count);
+
+        gettimeofday(&t1, NULL);
+        for (i = 0; i < arg->count; i++) {
+                gettimeofday(&t2, NULL);
+                ret = __bench_conn(arg);
+                if (ret)
+                        GOTO(err_free, ret);
+                gettimeofday(&t3, NULL);
+
+                lat[i] = _time_used(&t2, &t3);
+        }
+        gettimeofday(&t2, NULL);
+
+        used = _time_used(&t1, &t2);
+        qsort(lat, arg->count, sizeof(*lat), __bench_cmp);
+
+        printf("%s conn %d %.0f conn/s p50 %ju us p99 %ju us max %ju us\n",
+               ltgconf_global.tcp_accept_core ? "core" : "thread", arg->count,
+               (double)arg->count * 1000000 / used, lat[arg->count / 2],
+               lat[arg->count * 99 / 100], lat[arg->count - 1]);
+
+        free(lat);
+
+        return 0;
+err_free:
+        free(lat);
+        return ret;
+}
+
+int main(int argc, char *argv[])
+{
+        int ret, accept = 0;
+        char c_opt, buf[MAX_BUF_LEN];
+        bench_arg_t arg;
+        ltgconf_t ltgconf;
+        ltg_netconf_t ltgnet_conf;
+        corenet_addr_t *addr = (void *)buf;
+
+        arg.count = 1000;
+        arg.coreid.idx = 1;
+
+        while (1) {
+                c_opt = getopt(argc, argv, "n:c:a");
+                if (c_opt == -1)
+                        break;
+
+                switch (c_opt) {
+                case 'n':
+                        arg.count = _max(atoi(optarg), 1);
+                        break;
+                case 'c':
+                        arg.coreid.idx = atoi(optarg);
+                        break;
+                case 'a':
+                        accept = 1;
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-n count] [-c core] [-a]\n",
+                                argv[0]);
+                        exit(1);
+                }
+        }
+
+        ltg_conf_init(&ltgconf, "connect_storm_bench");
+
+        strcpy(ltgconf.service_name, "connect_storm_bench");
+        strcpy(ltgconf.workdir, "/tmp/connect_storm_bench");
+
+        ltgconf.coremask = 0x1 | (1UL << arg.coreid.idx);
+        ltgconf.rpc_timeout = 10;
+        ltgconf.rpc_local = 0;
+        ltgconf.tcp_shm = 0;
+        ltgconf.tcp_accept_core = accept;
+        ltgconf.backtrace = 0;
+        ltgconf.daemon = 1;
+        ltgconf.coreflag = CORE_FLAG_POLLING;
+
+        memset(&ltgnet_conf, 0x0, sizeof(ltgnet_conf));
+
+        ret = ltg_init(&ltgconf, &ltgnet_conf, &ltgnet_conf);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        corerpc_register(BENCH_MSG, __bench_get_handler, NULL);
+
+        ret = corerpc_init(ltgconf.coremask);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        arg.coreid.nid = *net_getnid();
+
+        ret = corenet_getaddr(&arg.coreid, addr);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        LTG_ASSERT(addr->info_count);
+        arg.addr = addr->info[0].addr;
+        arg.port = addr->info[0].port;
+
+        ret = core_request(0, -1, "connect_storm_bench", __bench_run, &arg);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * small corerpc calls from core 0 to another core of this node, over the
+ * network unless -l lets them take the local path. the same number of
+ * calls is issued three ways: serially with corerpc_postwait1, as one
+ * corerpc_postwait_batch, and in parallel with corerpc_post_async and
+ * one corerpc_wait. the handler does nothing and replies empty. needs the
+ * same environment as init, etcd included. reports calls per second and
+ * the average time of a call.
+ */
+
+#define BENCH_MSG (LTG_MSG_MAX - 1)
+
+typedef struct {
+        coreid_t coreid;
+        int count;
+        int size;
+} bench_arg_t;
+
+static int __bench_null(ltgbuf_t *in, ltgbuf_t *out, int *outlen)
+{
+        (void) in;
+        (void) out;
+
+        *outlen = 0;
+
+        return 0;
+}
+
+static void __bench_get_handler(const ltgbuf_t *buf, request_handler_func *func,
+                                const char **name)
+{
+        (void) buf;
+
+        *func = __bench_null;
+        *name = "bench_null";
+}
+
+static void __bench_report(const char *name, const bench_arg_t *arg,
+                           const struct timeval *t1, const struct timeval *t2)
+{
+        int64_t used = _time_used(t1, t2);
+
+        printf("%s count %d size %d %.0f call/s avg %.2f us\n", name,
+               arg->count, arg->size, (double)arg->count * 1000000 / used,
+               (double)used / arg->count);
+}
+
+static int __bench_serial(const bench_arg_t *arg, const char *req)
+{
+        int ret;
+
+        for (int i = 0; i < arg->count; i++) {
+                ret = corerpc_postwait1("bench_serial", &arg->coreid, req,
+                                        arg->size, NULL, NULL, BENCH_MSG, -1,
+                                        ltgconf_global.rpc_timeout);
+                if (ret)
+                        GOTO(err_ret, ret);
+        }
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static int __bench_batch(const bench_arg_t *arg, const char *req)
+{
+        int ret;
+        corerpc_batch_t *batch;
+
+        ret = ltg_malloc((void **)&batch, sizeof(*batch) * arg->count);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        for (int i = 0; i < arg->count; i++) {
+                batch[i].coreid = arg->coreid;
+                batch[i].request = req;
+                batch[i].reqlen = arg->size;
+                batch[i].wbuf = NULL;
+                batch[i].rbuf = NULL;
+                batch[i].msg_type = BENCH_MSG;
+        }
+
+        ret = corerpc_postwait_batch("bench_batch", batch, arg->count, -1,
+                                     ltgconf_global.rpc_timeout);
+        if (ret)
+                GOTO(err_free, ret);
+
+        ltg_free((void **)&batch);
+
+        return 0;
+err_free:
+        ltg_free((void **)&batch);
+err_ret:
+        return ret;
+}
+
+static int __bench_parallel(const bench_arg_t *arg, const char *req)
+{
+        int ret;
+        corerpc_wait_t wait;
+
+        corerpc_wait_init(&wait);
+
+        for (int i = 0; i < arg->count; i++) {
+                ret = corerpc_post_async("bench_async", &arg->coreid, req,
+                                         arg->size, NULL, NULL, BENCH_MSG, -1,
+                                         ltgconf_global.rpc_timeout,
+                                         corerpc_wait_done, &wait);
+                if (ret)
+                        break;
+
+                wait.count++;
+        }
+
+        return corerpc_wait("bench_parallel", &wait) ? : ret;
+}
+
+static int __bench_run(va_list ap)
+{
+        int ret;
+        bench_arg_t *arg = va_arg(ap, bench_arg_t *);
+        struct timeval t1, t2;
+        char *req;
+
+        va_end(ap);
+
+        req = malloc(arg->size);
+        memset(req, 0x1, arg->size);
+
+        /* warm up, connects the core */
+        ret = __bench_serial(arg, req);
+        if (ret)
+                GOTO(err_free, ret);
+
+        gettimeofday(&t1, NULL);
+        ret = __bench_serial(arg, req);
+        if (ret)
+                GOTO(err_free, ret);
+        gettimeofday(&t2, NULL);
+        __bench_report("serial", arg, &t1, &t2);
+
+        gettimeofday(&t1, NULL);
+        ret = __bench_batch(arg, req);
+        if (ret)
+                GOTO(err_free, ret);
+        gettimeofday(&t2, NULL);
+        __bench_report("batch", arg, &t1, &t2);
+
+        gettimeofday(&t1, NULL);
+        ret = __bench_parallel(arg, req);
+        if (ret)
+                GOTO(err_free, ret);
+        gettimeofday(&t2, NULL);
+        __bench_report("parallel", arg, &t1, &t2);
+
+        free(req);
+
+        return 0;
+err_free:
+        free(req);
+        return ret;
+}
+
+int main(int argc, char *argv[])
+{
+        int ret, local = 0;
+        char c_opt;
+        bench_arg_t arg;
+        ltgconf_t ltgconf;
+        ltg_netconf_t ltgnet_conf;
+
+        arg.count = 1000;
+        arg.size = 64;
+        arg.coreid.idx = 1;
+
+        while (1) {
+                c_opt = getopt(argc, argv, "n:s:c:l");
+                if (c_opt == -1)
+                        break;
+
+                switch (c_opt) {
+                case 'n':
+                        arg.count = atoi(optarg);
+                        break;
+                case 's':
+                        arg.size = _min(atoi(optarg), PAGE_SIZE);
+                        break;
+                case 'c':
+                        arg.coreid.idx = atoi(optarg);
+                        break;
+                case 'l':
+                        local = 1;
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-n count] [-s size] [-c core] [-l]\n",
+                                argv[0]);
+                        exit(1);
+                }
+        }
+
+        ltg_conf_init(&ltgconf, "corerpc_batch_bench");
+
+        strcpy(ltgconf.service_name, "corerpc_batch_bench");
+        strcpy(ltgconf.workdir, "/tmp/corerpc_batch_bench");
+
+        ltgconf.coremask = 0x1 | (1UL << arg.coreid.idx);
+        ltgconf.rpc_timeout = 10;
+        ltgconf.rpc_local = local;
+        ltgconf.backtrace = 0;
+        ltgconf.daemon = 1;
+        ltgconf.coreflag = CORE_FLAG_POLLING;
+
+        memset(&ltgnet_conf, 0x0, sizeof(ltgnet_conf));
+
+        ret = ltg_init(&ltgconf, &ltgnet_conf, &ltgnet_conf);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        corerpc_register(BENCH_MSG, __bench_get_handler, NULL);
+
+        ret = corerpc_init(ltgconf.coremask);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        arg.coreid.nid = *net_getnid();
+
+        ret = core_request(0, -1, "corerpc_batch_bench", __bench_run, &arg);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
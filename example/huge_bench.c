@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * public hugepage pool contention, bitmap vs buddy behind a spinlock.
+ * only the allocator metadata is touched, the pool itself is reserved
+ * address space, so no hugepages are needed to run it.
+ */
+
+#define BENCH_PAGES 4096
+#define BENCH_HOLD 8
+
+typedef struct {
+        void *meta;
+        int loop;
+        int use_bitmap;
+        uint64_t used;
+} bench_arg_t;
+
+static pthread_spinlock_t __buddy_lock__;
+
+static void *__bench_worker(void *_arg)
+{
+        bench_arg_t *arg = _arg;
+        void *addr[BENCH_HOLD];
+        uint32_t size[BENCH_HOLD];
+        int offset[BENCH_HOLD];
+        struct timeval t1, t2;
+
+        gettimeofday(&t1, NULL);
+
+        for (int i = 0; i < arg->loop; i++) {
+                for (int j = 0; j < BENCH_HOLD; j++) {
+                        size[j] = (j % 2) ? HUGEPAGE_SIZE * 2 : HUGEPAGE_SIZE;
+                        if (arg->use_bitmap) {
+                                if (mem_bitmap.alloc(arg->meta, &addr[j], &size[j]))
+                                        size[j] = 0;
+                        } else {
+                                pthread_spin_lock(&__buddy_lock__);
+                                offset[j] = __buddy_alloc(arg->meta, size[j] >> 21);
+                                pthread_spin_unlock(&__buddy_lock__);
+                                if (offset[j] < 0)
+                                        size[j] = 0;
+                        }
+                }
+
+                for (int j = 0; j < BENCH_HOLD; j++) {
+                        if (size[j] == 0)
+                                continue;
+
+                        if (arg->use_bitmap) {
+                                mem_bitmap.free(arg->meta, addr[j], size[j]);
+                        } else {
+                                pthread_spin_lock(&__buddy_lock__);
+                                __buddy_free(arg->meta, offset[j]);
+                                pthread_spin_unlock(&__buddy_lock__);
+                        }
+                }
+        }
+
+        gettimeofday(&t2, NULL);
+        arg->used = _time_used(&t1, &t2);
+
+        return NULL;
+}
+
+static void __bench_run(void *meta, int use_bitmap, int thread, int loop)
+{
+        pthread_t th[64];
+        bench_arg_t arg[64];
+        uint64_t used = 0;
+
+        if (use_bitmap)
+                mem_bitmap.init(meta, BENCH_PAGES);
+        else
+                mem_buddy.init(meta, BENCH_PAGES);
+
+        for (int i = 0; i < thread; i++) {
+                arg[i].meta = meta;
+                arg[i].loop = loop;
+                arg[i].use_bitmap = use_bitmap;
+                pthread_create(&th[i], NULL, __bench_worker, &arg[i]);
+        }
+
+        for (int i = 0; i < thread; i++) {
+                pthread_join(th[i], NULL);
+                used = _max(used, arg[i].used);
+        }
+
+        printf("%s thread %d ops %ju used %ju us, %.2f Mops/s\n",
+               use_bitmap ? "bitmap" : "buddy ", thread,
+               (uint64_t)thread * loop * BENCH_HOLD * 2, used,
+               (double)thread * loop * BENCH_HOLD * 2 / used);
+}
+
+int main(int argc, char *argv[])
+{
+        int loop = 100000, max_thread = 64;
+        char c_opt;
+        void *mem, *meta;
+
+        while (1) {
+                c_opt = getopt(argc, argv, "l:t:");
+                if (c_opt == -1)
+                        break;
+
+                switch (c_opt) {
+                case 'l':
+                        loop = atoi(optarg);
+                        break;
+                case 't':
+                        max_thread = _min(atoi(optarg), 64);
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-l loop] [-t max_thread]\n", argv[0]);
+                        exit(1);
+                }
+        }
+
+        mem = mmap(NULL, (BENCH_PAGES + 2) * HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mem == MAP_FAILED) {
+                fprintf(stderr, "mmap %s\n", strerror(errno));
+                exit(1);
+        }
+
+        /* buddy logs every alloc at info level */
+        dbg_info(0);
+
+        meta = (void *)_align_up((uintptr_t)mem, HUGEPAGE_SIZE);
+        pthread_spin_init(&__buddy_lock__, PTHREAD_PROCESS_PRIVATE);
+
+        for (int thread = 1; thread <= max_thread; thread *= 2) {
+                __bench_run(meta, 0, thread, loop);
+                __bench_run(meta, 1, thread, loop);
+        }
+
+        return 0;
+}
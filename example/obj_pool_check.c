@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * steady state rpcs must not reach the general allocators. core 0 calls
+ * core 2 with corerpc_postwait1, core 1 is the netctl core, so every call
+ * takes the ring hop and is sent by core 1 with a context from its pool.
+ * after a warm up that connects and grows the tables, the malloc and slab
+ * allocation counters of mem_stat must not move over the calls, and the
+ * rpc_ctx pool must serve them all. needs the same environment as init,
+ * etcd included.
+ */
+
+#define CHECK_MSG (LTG_MSG_MAX - 1)
+#define CHECK_NETCTL 1
+#define CHECK_TARGET 2
+#define CHECK_WARMUP 1000
+
+static int __check_tag__[] = {
+        MEM_TAG_MALLOC,
+        MEM_TAG_SLAB_STREAM,
+        MEM_TAG_SLAB_STATIC,
+};
+
+#define CHECK_TAG_COUNT (int)(sizeof(__check_tag__) / sizeof(__check_tag__[0]))
+
+static int __check_null(ltgbuf_t *in, ltgbuf_t *out, int *outlen)
+{
+        (void) in;
+        (void) out;
+
+        *outlen = 0;
+
+        return 0;
+}
+
+static void __check_get_handler(const ltgbuf_t *buf, request_handler_func *func,
+                                const char **name)
+{
+        (void) buf;
+
+        *func = __check_null;
+        *name = "check_null";
+}
+
+static int __check(const char *name, int ok)
+{
+        printf("%-40s %s\n", name, ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+static int __check_call(const coreid_t *coreid, int count)
+{
+        int ret, req = 0;
+
+        for (int i = 0; i < count; i++) {
+                ret = corerpc_postwait1("check_call", coreid, &req, sizeof(req),
+                                        NULL, NULL, CHECK_MSG, -1,
+                                        ltgconf_global.rpc_timeout);
+                if (ret)
+                        GOTO(err_ret, ret);
+        }
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static int __check_run(va_list ap)
+{
+        int ret, fail = 0;
+        int loop = va_arg(ap, int);
+        int *_fail = va_arg(ap, int *);
+        coreid_t coreid;
+        mem_stat_t s1, s2;
+        obj_pool_stat_t p1, p2;
+        char name[MAX_NAME_LEN];
+
+        va_end(ap);
+
+        coreid.nid = *net_getnid();
+        coreid.idx = CHECK_TARGET;
+
+        ret = __check_call(&coreid, CHECK_WARMUP);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        mem_stat_merge(&s1);
+        obj_pool_stat(CHECK_NETCTL, OBJ_POOL_RPC_CTX, &p1);
+
+        ret = __check_call(&coreid, loop);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        mem_stat_merge(&s2);
+        obj_pool_stat(CHECK_NETCTL, OBJ_POOL_RPC_CTX, &p2);
+
+        for (int i = 0; i < CHECK_TAG_COUNT; i++) {
+                int tag = __check_tag__[i];
+
+                snprintf(name, MAX_NAME_LEN, "steady state %s allocs (%jd)",
+                         mem_stat_tag(tag), s2.alloc[tag] - s1.alloc[tag]);
+                fail += __check(name, s2.alloc[tag] == s1.alloc[tag]);
+        }
+
+        fail += __check("rpc_ctx from the pool",
+                        p2.hit - p1.hit == (uint64_t)loop);
+        fail += __check("rpc_ctx fallback", p2.fallback == p1.fallback);
+
+        *_fail = fail;
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+int main(int argc, char *argv[])
+{
+        int ret, loop = 100000, fail = 0;
+        char c_opt;
+        ltgconf_t ltgconf;
+        ltg_netconf_t ltgnet_conf;
+
+        while (1) {
+                c_opt = getopt(argc, argv, "l:");
+                if (c_opt == -1)
+                        break;
+
+                switch (c_opt) {
+                case 'l':
+                        loop = atoi(optarg);
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-l loop]\n", argv[0]);
+                        exit(1);
+                }
+        }
+
+        ltg_conf_init(&ltgconf, "obj_pool_check");
+
+        strcpy(ltgconf.service_name, "obj_pool_check");
+        strcpy(ltgconf.workdir, "/tmp/obj_pool_check");
+
+        ltgconf.coremask = 0x1 | (1UL << CHECK_NETCTL) | (1UL << CHECK_TARGET);
+        ltgconf.rpc_timeout = 10;
+        ltgconf.rpc_local = 0;
+        ltgconf.tcp_shm = 0;
+        ltgconf.backtrace = 0;
+        ltgconf.daemon = 1;
+        ltgconf.coreflag = CORE_FLAG_POLLING;
+
+        memset(&ltgnet_conf, 0x0, sizeof(ltgnet_conf));
+
+        ret = ltg_init(&ltgconf, &ltgnet_conf, &ltgnet_conf);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        ret = netctl_init(1UL << CHECK_NETCTL);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        corerpc_register(CHECK_MSG, __check_get_handler, NULL);
+
+        ret = corerpc_init(ltgconf.coremask);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        ret = core_request(0, -1, "obj_pool_check", __check_run, loop, &fail);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        return fail;
+err_ret:
+        return ret;
+}
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * a buffer outside the hugepage mr must not reach a cached registration
+ * after it was unmapped and mapped again at the same address. the first
+ * part needs no device: it maps a range, allows it, invalidates and
+ * unmaps it, maps it again and checks the new mapping is not allowed,
+ * and that malloc memory never is. with an rdma device the same is done
+ * through rdma_mr_get of a real cache, the remapped range must be
+ * refused instead of hit until it is allowed again.
+ */
+
+#define CHECK_SIZE (1024 * 1024)
+
+static int __check(const char *name, int ok)
+{
+        printf("%-40s %s\n", name, ok ? "ok" : "FAIL");
+
+        return ok ? 0 : 1;
+}
+
+static void *__check_map(void *hint)
+{
+        void *addr;
+
+        addr = mmap(hint, CHECK_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED)
+                return NULL;
+
+        memset(addr, 0x1, CHECK_SIZE);
+
+        return addr;
+}
+
+static int __check_allow(void)
+{
+        int fail = 0;
+        void *addr, *remap, *mem;
+
+        addr = __check_map(NULL);
+        LTG_ASSERT(addr);
+
+        fail += __check("mapped range refused", !rdma_mr_allowed(addr, CHECK_SIZE));
+
+        LTG_ASSERT(rdma_mr_allow(addr, CHECK_SIZE) == 0);
+        fail += __check("allowed range", rdma_mr_allowed(addr, CHECK_SIZE));
+        fail += __check("allowed sub range",
+                        rdma_mr_allowed(addr + PAGE_SIZE, PAGE_SIZE));
+        fail += __check("range across the end refused",
+                        !rdma_mr_allowed(addr + PAGE_SIZE, CHECK_SIZE));
+
+        rdma_mr_invalidate(addr, CHECK_SIZE);
+        munmap(addr, CHECK_SIZE);
+
+        remap = __check_map(addr);
+        LTG_ASSERT(remap);
+        if (remap != addr) {
+                printf("remapped at %p, not %p\n", remap, addr);
+        }
+
+        fail += __check("remapped range refused",
+                        !rdma_mr_allowed(remap, CHECK_SIZE));
+        munmap(remap, CHECK_SIZE);
+
+        mem = malloc(CHECK_SIZE);
+        LTG_ASSERT(mem);
+        fail += __check("malloc refused", !rdma_mr_allowed(mem, CHECK_SIZE));
+        free(mem);
+
+        return fail;
+}
+
+static int __check_cache(struct ibv_pd *pd, int *_fail)
+{
+        int ret, fail = 0;
+        void *addr, *remap, *mem;
+        rdma_info_t dev;
+        rdma_mr_ent_t *ent;
+        struct ibv_mr *mr;
+
+        memset(&dev, 0x0, sizeof(dev));
+        dev.pd = pd;
+
+        ret = rdma_mr_cache_init(&dev);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        addr = __check_map(NULL);
+        LTG_ASSERT(addr);
+
+        ent = rdma_mr_get(&dev, addr, CHECK_SIZE, &mr);
+        fail += __check("get of a mapped range refused", ent == NULL);
+
+        LTG_ASSERT(rdma_mr_allow(addr, CHECK_SIZE) == 0);
+        ent = rdma_mr_get(&dev, addr, CHECK_SIZE, &mr);
+        fail += __check("get of an allowed range", ent != NULL);
+        if (ent) {
+                fail += __check("mr covers the range",
+                                (uintptr_t)mr->addr <= (uintptr_t)addr
+                                && (uintptr_t)mr->addr + mr->length
+                                >= (uintptr_t)addr + CHECK_SIZE);
+                rdma_mr_put(ent);
+        }
+
+        ent = rdma_mr_get(&dev, addr + PAGE_SIZE, PAGE_SIZE, &mr);
+        fail += __check("get of a cached sub range", ent != NULL);
+        if (ent)
+                rdma_mr_put(ent);
+
+        rdma_mr_invalidate(addr, CHECK_SIZE);
+        munmap(addr, CHECK_SIZE);
+
+        remap = __check_map(addr);
+        LTG_ASSERT(remap);
+
+        ent = rdma_mr_get(&dev, remap, CHECK_SIZE, &mr);
+        fail += __check("get of the remapped range refused", ent == NULL);
+        if (ent)
+                rdma_mr_put(ent);
+
+        LTG_ASSERT(rdma_mr_allow(remap, CHECK_SIZE) == 0);
+        ent = rdma_mr_get(&dev, remap, CHECK_SIZE, &mr);
+        fail += __check("get of the remapped range allowed", ent != NULL);
+        if (ent)
+                rdma_mr_put(ent);
+
+        rdma_mr_invalidate(remap, CHECK_SIZE);
+        munmap(remap, CHECK_SIZE);
+
+        mem = malloc(CHECK_SIZE);
+        LTG_ASSERT(mem);
+        ent = rdma_mr_get(&dev, mem, CHECK_SIZE, &mr);
+        fail += __check("get of malloc memory refused", ent == NULL);
+        if (ent)
+                rdma_mr_put(ent);
+        free(mem);
+
+        *_fail += fail;
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+int main(int argc, char *argv[])
+{
+        int ret, count, fail = 0;
+        ltgconf_t ltgconf;
+        struct ibv_device **list;
+        struct ibv_context *ctx;
+        struct ibv_pd *pd;
+
+        (void) argc;
+        (void) argv;
+
+        ltg_conf_init(&ltgconf, "rdma_mr_check");
+        ltgconf_global.rdma_mr_cache = 16;
+
+        fail += __check_allow();
+
+        list = ibv_get_device_list(&count);
+        if (list == NULL || count == 0) {
+                printf("no rdma device, cache part skipped\n");
+                goto out;
+        }
+
+        ctx = ibv_open_device(list[0]);
+        if (ctx == NULL) {
+                ret = errno;
+                GOTO(err_list, ret);
+        }
+
+        pd = ibv_alloc_pd(ctx);
+        if (pd == NULL) {
+                ret = errno;
+                GOTO(err_ctx, ret);
+        }
+
+        ret = __check_cache(pd, &fail);
+        if (ret)
+                GOTO(err_pd, ret);
+
+        ibv_dealloc_pd(pd);
+        ibv_close_device(ctx);
+out:
+        if (list)
+                ibv_free_device_list(list);
+
+        return fail;
+err_pd:
+        ibv_dealloc_pd(pd);
+err_ctx:
+        ibv_close_device(ctx);
+err_list:
+        ibv_free_device_list(list);
+        return ret;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * small corerpc calls from core 0 to another core of this node over
+ * rdma, -d of them in flight. -g sets rdma_signal, one send wr in that
+ * many asks for a completion, 0 signals every wr. -i sets rdma_inline.
+ * needs an rdma device and the same environment as init, etcd included.
+ * reports calls per second and, from corenet_rdma_stat of the connection,
+ * the wrs posted and the completions polled per call.
+ */
+
+#define BENCH_MSG (LTG_MSG_MAX - 1)
+
+typedef struct {
+        coreid_t coreid;
+        int count;
+        int depth;
+} bench_arg_t;
+
+static int __bench_null(ltgbuf_t *in, ltgbuf_t *out, int *outlen)
+{
+        (void) in;
+        (void) out;
+
+        *outlen = 0;
+
+        return 0;
+}
+
+static void __bench_get_handler(const ltgbuf_t *buf, request_handler_func *func,
+                                const char **name)
+{
+        (void) buf;
+
+        *func = __bench_null;
+        *name = "bench_null";
+}
+
+static int __bench_round(const bench_arg_t *arg, int count)
+{
+        int ret = 0, req = 0;
+        corerpc_wait_t wait;
+
+        corerpc_wait_init(&wait);
+
+        for (int i = 0; i < count; i++) {
+                ret = corerpc_post_async("bench_signal", &arg->coreid, &req,
+                                         sizeof(req), NULL, NULL, BENCH_MSG, -1,
+                                         ltgconf_global.rpc_timeout,
+                                         corerpc_wait_done, &wait);
+                if (ret)
+                        break;
+
+                wait.count++;
+        }
+
+        return corerpc_wait("bench_round", &wait) ? : ret;
+}
+
+static int __bench_stat(const bench_arg_t *arg, corenet_rdma_stat_t *stat)
+{
+        int ret;
+        sockid_t sockid;
+
+        ret = corenet_maping(core_self(), &arg->coreid, &sockid);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        if (sockid.rdma_handler == NULL) {
+                ret = ENOTSUP;
+                DERROR("not connected over rdma\n");
+                GOTO(err_ret, ret);
+        }
+
+        ret = corenet_rdma_stat(&sockid, stat);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static int __bench_run(va_list ap)
+{
+        int ret;
+        bench_arg_t *arg = va_arg(ap, bench_arg_t *);
+        struct timeval t1, t2;
+        corenet_rdma_stat_t s1, s2;
+        int64_t used;
+
+        va_end(ap);
+
+        /* warm up, connects the core */
+        ret = __bench_round(arg, 1);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        ret = __bench_stat(arg, &s1);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        gettimeofday(&t1, NULL);
+        for (int i = 0; i < arg->count; i += arg->depth) {
+                ret = __bench_round(arg, _min(arg->depth, arg->count - i));
+                if (ret)
+                        GOTO(err_ret, ret);
+        }
+        gettimeofday(&t2, NULL);
+
+        ret = __bench_stat(arg, &s2);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        used = _time_used(&t1, &t2);
+        printf("signal %d inline %d count %d depth %d %.0f call/s\n",
+               ltgconf_global.rdma_signal, ltgconf_global.rdma_inline,
+               arg->count, arg->depth, (double)arg->count * 1000000 / used);
+        printf("per call post %.2f send wr %.2f inline %.2f send cqe %.2f"
+               " recv wr %.2f cqe %.2f\n",
+               (double)(s2.post - s1.post) / arg->count,
+               (double)(s2.send_wr - s1.send_wr) / arg->count,
+               (double)(s2.inline_wr - s1.inline_wr) / arg->count,
+               (double)(s2.send_cqe - s1.send_cqe) / arg->count,
+               (double)(s2.recv_wr - s1.recv_wr) / arg->count,
+               (double)(s2.cqe - s1.cqe) / arg->count);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+int main(int argc, char *argv[])
+{
+        int ret, signal = 0, inline_size = 0;
+        char c_opt;
+        bench_arg_t arg;
+        ltgconf_t ltgconf;
+        ltg_netconf_t ltgnet_conf;
+
+        arg.count = 100000;
+        arg.depth = 8;
+        arg.coreid.idx = 1;
+
+        while (1) {
+                c_opt = getopt(argc, argv, "n:d:c:g:i:");
+                if (c_opt == -1)
+                        break;
+
+                switch (c_opt) {
+                case 'n':
+                        arg.count = _max(atoi(optarg), 1);
+                        break;
+                case 'd':
+                        arg.depth = _max(atoi(optarg), 1);
+                        break;
+                case 'c':
+                        arg.coreid.idx = atoi(optarg);
+                        break;
+                case 'g':
+                        signal = atoi(optarg);
+                        break;
+                case 'i':
+                        inline_size = atoi(optarg);
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-n count] [-d depth] [-c core]"
+                                " [-g signal] [-i inline]\n", argv[0]);
+                        exit(1);
+                }
+        }
+
+        ltg_conf_init(&ltgconf, "rdma_signal_bench");
+
+        strcpy(ltgconf.service_name, "rdma_signal_bench");
+        strcpy(ltgconf.workdir, "/tmp/rdma_signal_bench");
+
+        ltgconf.coremask = 0x1 | (1UL << arg.coreid.idx);
+        ltgconf.rpc_timeout = 10;
+        ltgconf.rpc_local = 0;
+        ltgconf.tcp_shm = 0;
+        ltgconf.rdma = 1;
+        ltgconf.rdma_signal = signal;
+        ltgconf.rdma_inline = inline_size;
+        ltgconf.backtrace = 0;
+        ltgconf.daemon = 1;
+        ltgconf.coreflag = CORE_FLAG_POLLING;
+
+        memset(&ltgnet_conf, 0x0, sizeof(ltgnet_conf));
+
+        ret = ltg_init(&ltgconf, &ltgnet_conf, &ltgnet_conf);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        corerpc_register(BENCH_MSG, __bench_get_handler, NULL);
+
+        ret = corerpc_init(ltgconf.coremask);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        arg.coreid.nid = *net_getnid();
+
+        ret = core_request(0, -1, "rdma_signal_bench", __bench_run, &arg);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
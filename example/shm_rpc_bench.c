@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * corerpc calls from core 0 to another core of this node carrying a write
+ * buffer. with -m tcp_shm is on and corenet_maping connects the cores with
+ * corenet_shm, otherwise they talk over loopback tcp. calls go out with
+ * corerpc_post_async, -d of them in flight, 1 is a plain round trip. with
+ * -w the cores sleep instead of polling and the kicks wake them. needs the
+ * same environment as init, etcd included. reports calls per second and
+ * the average time of a round.
+ */
+
+#define BENCH_MSG (LTG_MSG_MAX - 1)
+
+typedef struct {
+        coreid_t coreid;
+        int count;
+        int size;
+        int depth;
+} bench_arg_t;
+
+static int __bench_null(ltgbuf_t *in, ltgbuf_t *out, int *outlen)
+{
+        (void) in;
+        (void) out;
+
+        *outlen = 0;
+
+        return 0;
+}
+
+static void __bench_get_handler(const ltgbuf_t *buf, request_handler_func *func,
+                                const char **name)
+{
+        (void) buf;
+
+        *func = __bench_null;
+        *name = "bench_null";
+}
+
+static int __bench_round(const bench_arg_t *arg, const ltgbuf_t *wbuf, int count)
+{
+        int ret = 0, req = 0;
+        corerpc_wait_t wait;
+
+        corerpc_wait_init(&wait);
+
+        for (int i = 0; i < count; i++) {
+                ret = corerpc_post_async("bench_shm", &arg->coreid, &req,
+                                         sizeof(req), wbuf, NULL, BENCH_MSG, -1,
+                                         ltgconf_global.rpc_timeout,
+                                         corerpc_wait_done, &wait);
+                if (ret)
+                        break;
+
+                wait.count++;
+        }
+
+        return corerpc_wait("bench_round", &wait) ? : ret;
+}
+
+static int __bench_loop(const bench_arg_t *arg, const ltgbuf_t *wbuf)
+{
+        int ret;
+
+        for (int i = 0; i < arg->count; i += arg->depth) {
+                ret = __bench_round(arg, wbuf, _min(arg->depth, arg->count - i));
+                if (ret)
+                        GOTO(err_ret, ret);
+        }
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static int __bench_run(va_list ap)
+{
+        int ret;
+        bench_arg_t *arg = va_arg(ap, bench_arg_t *);
+        struct timeval t1, t2;
+        ltgbuf_t wbuf;
+        int64_t used;
+
+        va_end(ap);
+
+        ret = ltgbuf_init(&wbuf, arg->size);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        /* warm up, connects the core */
+        ret = __bench_round(arg, &wbuf, 1);
+        if (ret)
+                GOTO(err_free, ret);
+
+        gettimeofday(&t1, NULL);
+        ret = __bench_loop(arg, &wbuf);
+        if (ret)
+                GOTO(err_free, ret);
+        gettimeofday(&t2, NULL);
+
+        used = _time_used(&t1, &t2);
+        printf("%s count %d size %d depth %d %.0f call/s avg %.2f us\n",
+               ltgconf_global.tcp_shm ? "shm" : "tcp", arg->count, arg->size,
+               arg->depth, (double)arg->count * 1000000 / used,
+               (double)used * arg->depth / arg->count);
+
+        ltgbuf_free(&wbuf);
+
+        return 0;
+err_free:
+        ltgbuf_free(&wbuf);
+err_ret:
+        return ret;
+}
+
+int main(int argc, char *argv[])
+{
+        int ret, shm = 0, wait = 0;
+        char c_opt;
+        bench_arg_t arg;
+        ltgconf_t ltgconf;
+        ltg_netconf_t ltgnet_conf;
+
+        arg.count = 100000;
+        arg.size = 4096;
+        arg.depth = 1;
+        arg.coreid.idx = 1;
+
+        while (1) {
+                c_opt = getopt(argc, argv, "n:s:d:c:mw");
+                if (c_opt == -1)
+                        break;
+
+                switch (c_opt) {
+                case 'n':
+                        arg.count = atoi(optarg);
+                        break;
+                case 's':
+                        arg.size = _min(atoi(optarg), IO_MAX);
+                        break;
+                case 'd':
+                        arg.depth = _max(atoi(optarg), 1);
+                        break;
+                case 'c':
+                        arg.coreid.idx = atoi(optarg);
+                        break;
+                case 'm':
+                        shm = 1;
+                        break;
+                case 'w':
+                        wait = 1;
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-n count] [-s size] [-d depth]"
+                                " [-c core] [-m] [-w]\n", argv[0]);
+                        exit(1);
+                }
+        }
+
+        ltg_conf_init(&ltgconf, "shm_rpc_bench");
+
+        strcpy(ltgconf.service_name, "shm_rpc_bench");
+        strcpy(ltgconf.workdir, "/tmp/shm_rpc_bench");
+
+        ltgconf.coremask = 0x1 | (1UL << arg.coreid.idx);
+        ltgconf.rpc_timeout = 10;
+        ltgconf.rpc_local = 0;
+        ltgconf.tcp_shm = shm;
+        ltgconf.backtrace = 0;
+        ltgconf.daemon = 1;
+        ltgconf.coreflag = wait ? 0 : CORE_FLAG_POLLING;
+
+        memset(&ltgnet_conf, 0x0, sizeof(ltgnet_conf));
+
+        ret = ltg_init(&ltgconf, &ltgnet_conf, &ltgnet_conf);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        corerpc_register(BENCH_MSG, __bench_get_handler, NULL);
+
+        ret = corerpc_init(ltgconf.coremask);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        arg.coreid.nid = *net_getnid();
+
+        ret = core_request(0, -1, "shm_rpc_bench", __bench_run, &arg);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
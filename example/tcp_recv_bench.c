@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * request/ack over loopback, a polling server and blocking clients. the
+ * fionread server receives the way corenet_tcp used to: FIONREAD, an
+ * exactly sized ltgbuf, recvmsg, merge. the chunk server reads into the
+ * per socket chunk ring. both pop whole messages off the receive buffer
+ * and free them, as corerpc does. reports receive syscalls per message
+ * and bytes per receive buffer allocation.
+ */
+
+#define BENCH_CONN_MAX 64
+
+typedef struct {
+        int sd;
+        ltgbuf_t recv_buf;
+        mem_chunk_rx_t rx;
+} bench_conn_t;
+
+typedef struct {
+        int sd;
+        int loop;
+        int size;
+} bench_client_t;
+
+static bench_conn_t __conn__[BENCH_CONN_MAX];
+static int __conn_count__;
+static int __size__;
+static int __done__;
+static uint64_t __syscall__;
+static uint64_t __alloc__;
+static uint64_t __bytes__;
+
+static void *__bench_client(void *_arg)
+{
+        bench_client_t *arg = _arg;
+        char *buf = malloc(arg->size), ack;
+        int ret;
+
+        memset(buf, 0x1, arg->size);
+
+        for (int i = 0; i < arg->loop; i++) {
+                ret = send(arg->sd, buf, arg->size, 0);
+                LTG_ASSERT(ret == arg->size);
+
+                ret = recv(arg->sd, &ack, 1, 0);
+                LTG_ASSERT(ret == 1);
+        }
+
+        free(buf);
+        __atomic_add_fetch(&__done__, 1, __ATOMIC_RELEASE);
+        return NULL;
+}
+
+static int __bench_fionread(bench_conn_t *conn)
+{
+        int ret, toread, iov_count;
+        ltgbuf_t buf;
+        struct iovec iov[CORE_IOV_MAX];
+        struct msghdr msg;
+
+        ret = ioctl(conn->sd, FIONREAD, &toread);
+        __syscall__++;
+        if (ret < 0 || toread == 0)
+                return 0;
+
+        ret = ltgbuf_init(&buf, toread);
+        LTG_ASSERT(ret == 0);
+        __alloc__ += ltgbuf_segcount(&buf);
+
+        iov_count = CORE_IOV_MAX;
+        ltgbuf_trans(iov, &iov_count, &buf);
+        memset(&msg, 0x0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_count;
+
+        ret = _recvmsg(conn->sd, &msg, MSG_DONTWAIT);
+        __syscall__++;
+        LTG_ASSERT(ret == toread);
+
+        ltgbuf_merge(&conn->recv_buf, &buf);
+
+        return toread;
+}
+
+static int __bench_chunk(bench_conn_t *conn)
+{
+        int ret;
+        uint32_t len;
+
+        ret = mem_chunk_recv(&conn->rx, conn->sd, &conn->recv_buf, &len);
+        LTG_ASSERT(ret == 0);
+
+        return len;
+}
+
+static void __bench_server(int (*recv_func)(bench_conn_t *))
+{
+        int ep, nfds, ret;
+        struct epoll_event ev, events[512];
+        bench_conn_t *conn;
+        ltgbuf_t msg;
+        char ack = 0;
+
+        ep = epoll_create(BENCH_CONN_MAX);
+        for (int i = 0; i < __conn_count__; i++) {
+                ev.events = EPOLLIN;
+                ev.data.u32 = i;
+                epoll_ctl(ep, EPOLL_CTL_ADD, __conn__[i].sd, &ev);
+        }
+
+        while (__atomic_load_n(&__done__, __ATOMIC_ACQUIRE) < __conn_count__) {
+                nfds = epoll_wait(ep, events, 512, 0);
+                for (int i = 0; i < nfds; i++) {
+                        conn = &__conn__[events[i].data.u32];
+                        __bytes__ += recv_func(conn);
+
+                        while (conn->recv_buf.len >= (uint32_t)__size__) {
+                                ltgbuf_init(&msg, 0);
+                                ltgbuf_pop1(&conn->recv_buf, &msg, __size__, 1);
+                                ltgbuf_free(&msg);
+
+                                ret = send(conn->sd, &ack, 1, MSG_NOSIGNAL);
+                                LTG_ASSERT(ret == 1);
+                        }
+                }
+        }
+
+        close(ep);
+}
+
+static void __bench_run(const char *name, int (*recv_func)(bench_conn_t *),
+                        int conn, int loop, int size)
+{
+        int ld, one = 1;
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        pthread_t cth[BENCH_CONN_MAX];
+        bench_client_t client[BENCH_CONN_MAX];
+        uint64_t total = (uint64_t)conn * loop;
+        struct timeval t1, t2;
+
+        ld = socket(AF_INET, SOCK_STREAM, 0);
+        memset(&addr, 0x0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        LTG_ASSERT(bind(ld, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        LTG_ASSERT(listen(ld, BENCH_CONN_MAX) == 0);
+        getsockname(ld, (struct sockaddr *)&addr, &len);
+
+        for (int i = 0; i < conn; i++) {
+                client[i].sd = socket(AF_INET, SOCK_STREAM, 0);
+                LTG_ASSERT(connect(client[i].sd, (struct sockaddr *)&addr,
+                                   sizeof(addr)) == 0);
+                setsockopt(client[i].sd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                __conn__[i].sd = accept(ld, NULL, NULL);
+                setsockopt(__conn__[i].sd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                ltgbuf_init(&__conn__[i].recv_buf, 0);
+                memset(&__conn__[i].rx, 0x0, sizeof(__conn__[i].rx));
+
+                client[i].loop = loop;
+                client[i].size = size;
+        }
+
+        __conn_count__ = conn;
+        __size__ = size;
+        __done__ = 0;
+        __syscall__ = 0;
+        __alloc__ = 0;
+        __bytes__ = 0;
+
+        gettimeofday(&t1, NULL);
+        for (int i = 0; i < conn; i++) {
+                pthread_create(&cth[i], NULL, __bench_client, &client[i]);
+        }
+
+        __bench_server(recv_func);
+
+        for (int i = 0; i < conn; i++) {
+                pthread_join(cth[i], NULL);
+        }
+        gettimeofday(&t2, NULL);
+
+        if (recv_func == __bench_chunk) {
+                for (int i = 0; i < conn; i++) {
+                        __syscall__ += __conn__[i].rx.nr_recv;
+                        __alloc__ += __conn__[i].rx.nr_chunk;
+                }
+        }
+
+        printf("%s conn %d size %d msg %ju %.0f msg/s syscall/msg %.2f"
+               " bytes/alloc %.0f\n",
+               name, conn, size, total,
+               (double)total * 1000000 / _time_used(&t1, &t2),
+               (double)__syscall__ / total,
+               (double)__bytes__ / (__alloc__ ? __alloc__ : 1));
+
+        for (int i = 0; i < conn; i++) {
+                LTG_ASSERT(__conn__[i].recv_buf.len == 0);
+                mem_chunk_rx_free(&__conn__[i].rx);
+                close(client[i].sd);
+                close(__conn__[i].sd);
+        }
+
+        close(ld);
+}
+
+int main(int argc, char *argv[])
+{
+        int ret, conn = 4, loop = 100000, size = 128;
+        char c_opt;
+
+        while (1) {
+                c_opt = getopt(argc, argv, "c:l:s:");
+                if (c_opt == -1)
+                        break;
+
+                switch (c_opt) {
+                case 'c':
+                        conn = _min(atoi(optarg), BENCH_CONN_MAX);
+                        break;
+                case 'l':
+                        loop = atoi(optarg);
+                        break;
+                case 's':
+                        size = atoi(optarg);
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-c conn] [-l loop] [-s size]\n",
+                                argv[0]);
+                        exit(1);
+                }
+        }
+
+        dbg_info(0);
+        seg_init();
+
+        ret = hugepage_init(0, 0, 0);
+        if (ret)
+                exit(ret);
+
+        ret = mem_ring_init();
+        if (ret)
+                exit(ret);
+
+        ret = slab_stream_init();
+        if (ret)
+                exit(ret);
+
+        /* the server runs here and plays core 0 */
+        ret = mem_chunk_private_init(0);
+        if (ret)
+                exit(ret);
+
+        __bench_run("fionread", __bench_fionread, conn, loop, size);
+        __bench_run("chunk", __bench_chunk, conn, loop, size);
+
+        return 0;
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ltg_core.h"
+#include "ltg_lib.h"
+
+/*
+ * corerpc round trips from core 0 to another core of this node over
+ * loopback corenet_tcp, one call in flight. with -u both cores drive
+ * their sockets with io_uring (tcp_uring), epoll otherwise. -s adds a
+ * write buffer to each call. needs the same environment as init, etcd
+ * included. reports calls per second, latency percentiles and the
+ * syscalls per call of both cores, io_uring_enter counted apart.
+ */
+
+#define BENCH_MSG (LTG_MSG_MAX - 1)
+
+typedef struct {
+        coreid_t coreid;
+        int count;
+        int size;
+} bench_arg_t;
+
+static int __bench_null(ltgbuf_t *in, ltgbuf_t *out, int *outlen)
+{
+        (void) in;
+        (void) out;
+
+        *outlen = 0;
+
+        return 0;
+}
+
+static void __bench_get_handler(const ltgbuf_t *buf, request_handler_func *func,
+                                const char **name)
+{
+        (void) buf;
+
+        *func = __bench_null;
+        *name = "bench_null";
+}
+
+static int __bench_cmp(const void *a, const void *b)
+{
+        uint64_t x = *(uint64_t *)a, y = *(uint64_t *)b;
+
+        return x < y ? -1 : (x > y);
+}
+
+static int __bench_call(const bench_arg_t *arg, const ltgbuf_t *wbuf)
+{
+        int ret, req = 0;
+        corerpc_wait_t wait;
+
+        corerpc_wait_init(&wait);
+
+        ret = corerpc_post_async("bench_uring", &arg->coreid, &req, sizeof(req),
+                                 wbuf, NULL, BENCH_MSG, -1,
+                                 ltgconf_global.rpc_timeout,
+                                 corerpc_wait_done, &wait);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        wait.count++;
+
+        return corerpc_wait("bench_call", &wait);
+err_ret:
+        return ret;
+}
+
+static void __bench_sys(int hash, corenet_sys_stat_t *stat)
+{
+        memset(stat, 0x0, sizeof(*stat));
+        corenet_tcp_sys_stat(hash, stat);
+}
+
+static void __bench_sys_print(const char *name, const corenet_sys_stat_t *s1,
+                              const corenet_sys_stat_t *s2, int count)
+{
+        printf("%s syscall/call %.2f enter/call %.2f sqe/call %.2f\n", name,
+               (double)(s2->syscall - s1->syscall) / count,
+               (double)(s2->enter - s1->enter) / count,
+               (double)(s2->sqe - s1->sqe) / count);
+}
+
+static int __bench_run(va_list ap)
+{
+        int ret, i;
+        bench_arg_t *arg = va_arg(ap, bench_arg_t *);
+        struct timeval t1, t2, t3;
+        corenet_sys_stat_t s1, s2, r1, r2;
+        ltgbuf_t wbuf, *_wbuf = NULL;
+        uint64_t *lat;
+        int64_t used;
+
+        va_end(ap);
+
+        if (arg->size) {
+                ret = ltgbuf_init(&wbuf, arg->size);
+                if (ret)
+                        GOTO(err_ret, ret);
+
+                _wbuf = &wbuf;
+        }
+
+        lat = malloc(sizeof(*lat) * arg->count);
+
+        /* warm up, connects the core */
+        ret = __bench_call(arg, _wbuf);
+        if (ret)
+                GOTO(err_free, ret);
+
+        __bench_sys(core_self()->hash, &s1);
+        __bench_sys(arg->coreid.idx, &r1);
+
+        gettimeofday(&t1, NULL);
+        for (i = 0; i < arg->count; i++) {
+                gettimeofday(&t2, NULL);
+                ret = __bench_call(arg, _wbuf);
+                if (ret)
+                        GOTO(err_free, ret);
+                gettimeofday(&t3, NULL);
+
+                lat[i] = _time_used(&t2, &t3);
+        }
+        gettimeofday(&t2, NULL);
+
+        __bench_sys(core_self()->hash, &s2);
+        __bench_sys(arg->coreid.idx, &r2);
+
+        used = _time_used(&t1, &t2);
+        qsort(lat, arg->count, sizeof(*lat), __bench_cmp);
+
+        printf("%s count %d size %d %.0f call/s p50 %ju us p99 %ju us max %ju us\n",
+               ltgconf_global.tcp_uring ? "uring" : "epoll", arg->count,
+               arg->size, (double)arg->count * 1000000 / used,
+               lat[arg->count / 2], lat[arg->count * 99 / 100],
+               lat[arg->count - 1]);
+        __bench_sys_print("client", &s1, &s2, arg->count);
+        __bench_sys_print("server", &r1, &r2, arg->count);
+
+        free(lat);
+        if (_wbuf)
+                ltgbuf_free(_wbuf);
+
+        return 0;
+err_free:
+        free(lat);
+        if (_wbuf)
+                ltgbuf_free(_wbuf);
+err_ret:
+        return ret;
+}
+
+int main(int argc, char *argv[])
+{
+        int ret, uring = 0;
+        char c_opt;
+        bench_arg_t arg;
+        ltgconf_t ltgconf;
+        ltg_netconf_t ltgnet_conf;
+
+        arg.count = 100000;
+        arg.size = 0;
+        arg.coreid.idx = 1;
+
+        while (1) {
+                c_opt = getopt(argc, argv, "n:s:c:u");
+                if (c_opt == -1)
+                        break;
+
+                switch (c_opt) {
+                case 'n':
+                        arg.count = _max(atoi(optarg), 1);
+                        break;
+                case 's':
+                        arg.size = _min(atoi(optarg), IO_MAX);
+                        break;
+                case 'c':
+                        arg.coreid.idx = atoi(optarg);
+                        break;
+                case 'u':
+                        uring = 1;
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-n count] [-s size] [-c core] [-u]\n",
+                                argv[0]);
+                        exit(1);
+                }
+        }
+
+        ltg_conf_init(&ltgconf, "tcp_uring_bench");
+
+        strcpy(ltgconf.service_name, "tcp_uring_bench");
+        strcpy(ltgconf.workdir, "/tmp/tcp_uring_bench");
+
+        ltgconf.coremask = 0x1 | (1UL << arg.coreid.idx);
+        ltgconf.rpc_timeout = 10;
+        ltgconf.rpc_local = 0;
+        ltgconf.tcp_shm = 0;
+        ltgconf.tcp_uring = uring;
+        ltgconf.backtrace = 0;
+        ltgconf.daemon = 1;
+        ltgconf.coreflag = CORE_FLAG_POLLING;
+
+        memset(&ltgnet_conf, 0x0, sizeof(ltgnet_conf));
+
+        ret = ltg_init(&ltgconf, &ltgnet_conf, &ltgnet_conf);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        corerpc_register(BENCH_MSG, __bench_get_handler, NULL);
+
+        ret = corerpc_init(ltgconf.coremask);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        arg.coreid.nid = *net_getnid();
+
+        ret = core_request(0, -1, "tcp_uring_bench", __bench_run, &arg);
+        if (ret)
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
@@ -87,11 +87,29 @@
 
 #define IBV_CQ_DUMP(cq) IBV_CQ_DUMP_L(DBUG, cq)
 
+/* shared receive queue of one core and device, see corenet_rdma.c */
+typedef struct {
+        struct ibv_srq *srq;
+        struct ibv_mr *mr;
+        void *addr;
+        htab_t qp_tab;                  /* qp_num to rdma_conn_t */
+        struct ibv_recv_wr *free_list;  /* slots given back, not posted yet */
+        uint32_t count;
+        uint32_t nr_free;
+        uint32_t nr_posted;
+        uint64_t nr_refill;
+} rdma_srq_t;
+
 typedef struct {
         struct ibv_context *ibv_verbs;
         struct ibv_cq *cq;
         struct ibv_pd *pd;
         struct ibv_mr *mr;
+        rdma_srq_t *srq;                /* NULL unless rdma_srq */
+        struct ibv_comp_channel *channel; /* NULL unless rdma_event */
+        int armed;                      /* cq notification requested */
+        void *mr_cache;                 /* NULL unless rdma_mr_cache */
+        int max_sge;                    /* send sges per wr, at most MAX_SGE */
         // int ref;
 
         uint32_t nr_conn;
@@ -142,6 +160,8 @@ typedef struct {
         int type;
         struct rdma_event_channel *channel;
         rdma_info_t *dev;
+        uint32_t max_inline;            /* granted by the device at qp creation */
+        uint32_t max_sge;               /* same */
 
         uint64_t nr_get;
         uint64_t nr_ack;
@@ -149,11 +169,16 @@ typedef struct {
         uint64_t nr_success;
         uint64_t nr_flush;
         uint64_t nr_other;
+        uint64_t nr_post;               /* ibv_post_send calls */
+        uint64_t nr_send_wr;            /* send wrs posted */
+        uint64_t nr_inline;             /* of them unsignaled inline */
+        uint64_t nr_recv_wr;            /* recv wrs posted on the qp */
+        uint64_t nr_send_cqe;           /* completions of send wrs */
 } rdma_conn_t;
 
 #define RDMA_CONN_DUMP_L3(LEVEL, env, conn) do { \
         struct ibv_cq *cq = (conn)->dev ? (conn)->dev->cq : NULL; \
-        LEVEL("%s: rdma_conn[%d] %p conn %d/%d ref %d/%d ack %ju/%ju nr %ju/%ju/%ju rinfo %p cq %p pd %p cmid %p type %d chan %p qp %p mr %p/%p addr %p core %p\n", \
+        LEVEL("%s: rdma_conn[%d] %p conn %d/%d ref %d/%d ack %ju/%ju nr %ju/%ju/%ju wr %ju/%ju/%ju/%ju/%ju rinfo %p cq %p pd %p cmid %p type %d chan %p qp %p mr %p/%p addr %p core %p\n", \
                (env), \
                (conn)->node_loc, \
                (conn), \
@@ -166,6 +191,11 @@ typedef struct {
                (conn)->nr_success, \
                (conn)->nr_flush, \
                (conn)->nr_other, \
+               (conn)->nr_post, \
+               (conn)->nr_send_wr, \
+               (conn)->nr_inline, \
+               (conn)->nr_recv_wr, \
+               (conn)->nr_send_cqe, \
                (conn)->dev, \
                cq, \
                (conn)->pd, \
@@ -184,12 +214,22 @@ typedef struct {
 
 #define RDMA_CONN_DUMP(conn) RDMA_CONN_DUMP_L(DBUG, conn);
 
-typedef struct {
+typedef struct rdma_mr_ent rdma_mr_ent_t;
+
+typedef struct rdma_req {
         uint32_t ref;
         uint32_t mode;
         uint32_t err;
         uint32_t n;
         rdma_conn_t    *rdma_handler;
+        rdma_srq_t *srq;                /* owner of a shared receive slot */
+        uint32_t seq;                   /* send queue position of its last wr */
+        uint32_t nr_sge;                /* sges in use, ref counts the wrs */
+        struct list_head hook;          /* on unsignaled_list */
+        rdma_mr_ent_t *mr[MAX_SGE];     /* cached mrs of a write's segments */
+        struct rdma_req *parent;        /* read or write a stripe chunk belongs to */
+        uint32_t stripe;                /* chunks of a striped req in flight */
+        uint32_t stripe_err;
         ltgbuf_t msg_buf;
         union {
                 struct ibv_recv_wr rr;
@@ -218,6 +258,7 @@ enum corenet_rdma_op_code {
         RDMA_SEND_MSG,
         RDMA_WRITE,
         RDMA_READ,
+        RDMA_STRIPE,
         RDMA_OP_END,
 };
 
@@ -229,9 +270,21 @@ enum corenet_rdma_op_code {
 #define CORE_IOV_MAX (1024 * 1)
 #endif
 #define DEFAULT_MH_NUM 1024
+#define MAX_RDMA_DEV 4
 #define MAX_REQ_NUM ((DEFAULT_MH_NUM) / 2)
 #define EXTRA_SIZE (4)
 
+/* corerpc credit window of one connection, see corerpc_credit.c */
+typedef struct corenet_credit {
+        uint32_t max_bytes;             /* granted by the peer, 0 no limit */
+        uint32_t max_msgs;
+        uint32_t bytes;                 /* sent and not answered yet */
+        uint32_t msgs;
+        uint32_t nr_wait;               /* callers sleeping for credit */
+        uint64_t nr_block;
+        struct list_head wait_list;
+} corenet_credit_t;
+
 typedef struct {
         struct list_head hook;
         int ev;
@@ -248,6 +301,20 @@ typedef struct {
 
 #if ENABLE_TCP_THREAD
         plock_t rwlock;
+#else
+        mem_chunk_rx_t rx;              /* recv_buf segments point into it */
+        int zc;                         /* SO_ZEROCOPY is on */
+        int zc_partial;                 /* send_buf head is split by a zerocopy send */
+        uint32_t zc_seq;                /* id of the next zerocopy send */
+        struct list_head zc_list;       /* sent data waiting for completion */
+        struct list_head send_list;     /* on forward_list until the next commit */
+        ltg_time_t send_time;           /* when it was queued, for tcp_cork */
+#endif
+        corenet_credit_t credit;
+#if ENABLE_TCP_URING
+        int uring;                      /* driven by the core's io_uring */
+        void *uring_send;
+        struct list_head uring_hook;    /* on uring_ready */
 #endif
         char *name;
 } corenet_tcp_node_t;
@@ -278,9 +345,51 @@ typedef struct {
         struct ibv_send_wr *last_sr;
 
         int send_count;
+        int send_ref;                   /* conn refs taken once send_count wrs are posted */
+        int send_inline;                /* unsignaled inline wrs, freed once posted */
+        uint32_t send_seq;              /* send wrs queued on the qp so far */
+        uint32_t unsignaled;            /* send wrs since the last signaled one */
+        struct list_head unsignaled_list;
         struct list_head send_list;
+
+        uint64_t rail_group;            /* sent by the peer at connect, 0 single rail */
+        int rail_idx;
+        uint32_t rail_rkey;             /* peer's hugepage rkey over this qp */
+        int rail_primary;               /* node_loc of rail 0, -1 if this is it */
+        int rail_count;
+        int rail[MAX_RDMA_DEV];         /* node_loc of the other rails */
+        uint64_t rail_bytes;            /* rdma read and write bytes posted */
+        uint64_t rail_errors;           /* stripe chunks failed over */
 } corenet_rdma_node_t;
 
+/* private data of a connect, see corenet_rdma_rail_link */
+typedef struct {
+        uint32_t magic;
+        uint32_t idx;
+        uint64_t group;
+        uint32_t rkey;
+} rdma_rail_msg_t;
+
+#define RDMA_RAIL_MAGIC 0x7261696c
+
+typedef struct {
+        uint32_t addr;                  /* peer address of the rail */
+        int dev;                        /* index in the core's dev_list */
+        int closing;
+        uint64_t bytes;
+        uint64_t errors;
+} corenet_rail_stat_t;
+
+/* per connection, the completions left by rdma_signal show as cqe < wr */
+typedef struct {
+        uint64_t post;                  /* ibv_post_send calls */
+        uint64_t send_wr;
+        uint64_t inline_wr;             /* unsignaled inline sends */
+        uint64_t recv_wr;
+        uint64_t send_cqe;
+        uint64_t cqe;                   /* send and recv, errors included */
+} corenet_rdma_stat_t;
+
 #define CORENET_RDMA_NODE_DUMP_L(LEVEL, node) do { \
         LEVEL("rdma_node %p sock %d conn %p ref %d in_use %d send %d ctx %p\n",  \
                (node), \
@@ -316,10 +425,9 @@ typedef struct {
         uint32_t figerprint;
 } corenet_t;
 
-#define MAX_RDMA_DEV 4
-
 typedef struct {
         void *ring_net;
+        void *shm_net;                  /* NULL unless tcp_shm */
 #if ENABLE_RDMA
         int   dev_count;
         void *rdma_net;
@@ -343,14 +451,82 @@ typedef struct {
         corenet_rdma_node_t array[0];
 } corenet_rdma_t;
 
+/*
+ * tcp_shm peer, one per connection. the unix socket lives on corenet_tcp:
+ * it carries the handshake and the kicks, its hangup closes the node.
+ */
+typedef struct {
+        struct list_head hook;          /* on poll_list */
+        struct list_head send_hook;     /* on send_list until the next commit */
+        sockid_t sockid;                /* SOCKID_SHM, sd indexes the core's array */
+        sockid_t uds;
+        void *ctx;
+        core_exec exec;
+        func_t reset;
+
+        void *map;                      /* counted by the receive buffers out */
+        void *tx;                       /* queue we produce */
+        void *rx;
+        char *tx_data;
+        char *rx_data;
+        uint32_t tx_head;               /* published at commit */
+        uint32_t tx_done;               /* oldest slot the peer holds */
+        uint32_t rx_tail;
+        uint32_t data_head;             /* tx_data in use from data_tail */
+        uint32_t data_tail;
+        uint32_t data_used;
+        struct list_head pending;       /* messages waiting for room */
+        corenet_credit_t credit;
+
+        uint64_t nr_send;
+        uint64_t nr_recv;
+        uint64_t nr_full;
+} corenet_shm_node_t;
+
+typedef struct {
+        coreid_t coreid;
+        int sd;                         /* abstract unix listener */
+        struct list_head poll_list;
+        struct list_head send_list;
+        int size;
+        corenet_shm_node_t array[0];
+} corenet_shm_t;
+
 typedef struct {
         corenet_t corenet;
+        uint64_t nr_syscall;            /* epoll_wait, recv and send of the core */
 #if !ENABLE_TCP_THREAD
         struct iovec iov[CORE_IOV_MAX]; //iov for send/recv
+        uint64_t nr_zc_send;
+        uint64_t nr_zc_bytes;
+        uint64_t nr_zc_complete;
+        uint64_t nr_zc_copied;          /* completed, but the kernel copied */
+        uint64_t nr_zc_fallback;        /* sent by copy over the threshold */
+        struct list_head zc_orphan;     /* closed, with zerocopy still in flight */
+        time_t zc_scan;
+#endif
+#if ENABLE_TCP_URING
+        void *uring;                    /* NULL when epoll is used */
+        int uring_epoll;                /* epoll_fd became readable */
+        struct list_head uring_ready;   /* nodes with new data */
 #endif
         corenet_tcp_node_t array[0];
 } corenet_tcp_t;
 
+typedef struct {
+        uint64_t send;
+        uint64_t bytes;
+        uint64_t complete;
+        uint64_t copied;
+        uint64_t fallback;
+} corenet_zc_stat_t;
+
+typedef struct {
+        uint64_t syscall;               /* made directly, see nr_syscall */
+        uint64_t enter;                 /* io_uring_enter, 0 on epoll */
+        uint64_t sqe;                   /* ops handed to the ring */
+} corenet_sys_stat_t;
+
 int corenet_tcp_init(int max, corenet_tcp_t **corenet);
 void corenet_tcp_destroy();
 
@@ -368,6 +544,17 @@ int corenet_tcp_connected(const sockid_t *sockid);
 int corenet_tcp_poll(void *ctx, int tmo);
 int corenet_tcp_send(void *ctx, const sockid_t *sockid, ltgbuf_t *buf);
 void corenet_tcp_commit(void *ctx);
+int corenet_tcp_zc_stat(int hash, corenet_zc_stat_t *stat);
+int corenet_tcp_sys_stat(int hash, corenet_sys_stat_t *stat);
+corenet_credit_t *corenet_tcp_credit(const sockid_t *sockid);
+
+int corenet_shm_init(const coreid_t *coreid, corenet_shm_t **shm);
+int corenet_shm_poll(void *shm, int polling);
+int corenet_shm_send(void *ctx, const sockid_t *sockid, ltgbuf_t *buf);
+void corenet_shm_commit(void *shm);
+int corenet_shm_connected(const sockid_t *sockid);
+void corenet_shm_close(const sockid_t *sockid);
+corenet_credit_t *corenet_shm_credit(const sockid_t *sockid);
 
 #if ENABLE_RDMA
 // below is RDMA transfer
@@ -382,6 +569,25 @@ int rdma_create_cq(rdma_info_t *res, int ib_port);
 void *rdma_get_mr_addr();
 void *rdma_register_mr(void* pd, void* buf, size_t size);
 
+/*
+ * memory outside the hugepage mr is copied unless its owner allowed the
+ * range with rdma_mr_allow. an allowed range is registered on first use
+ * and the registration stays cached, pinning the pages, after the op is
+ * done. the owner calls rdma_mr_invalidate before it unmaps the range or
+ * frees it back to the system, that drops the registration and the
+ * permission, a reused address would otherwise reach the old pages.
+ * ltgbuf_initwith memory is copied the same way, its cb does not
+ * invalidate. the library allows and invalidates its own shm maps.
+ */
+int rdma_mr_cache_init(rdma_info_t *dev);
+int rdma_mr_registered(const void *addr, size_t len);
+int rdma_mr_allow(const void *addr, size_t len);
+int rdma_mr_allowed(const void *addr, size_t len);
+rdma_mr_ent_t *rdma_mr_get(rdma_info_t *dev, const void *addr, size_t len,
+                           struct ibv_mr **mr);
+void rdma_mr_put(rdma_mr_ent_t *ent);
+void rdma_mr_invalidate(const void *addr, size_t len);
+
 int corenet_rdma_add(core_t *core, sockid_t *sockid, void *ctx,
                      core_exec exec, core_exec1 exec1, func_t reset,
                      func_t check, func_t recv, rdma_conn_t **_handler);
@@ -393,8 +599,13 @@ void corenet_rdma_get(rdma_conn_t *rdma_handler, int n, const char *caller, int
 
 void corenet_rdma_check();
 
-int corenet_rdma_connect(uint32_t addr, uint32_t port, sockid_t *sockid);
+int corenet_rdma_connect(uint32_t addr, uint32_t port, uint64_t group, int idx,
+                         sockid_t *sockid);
 int corenet_rdma_connected(const sockid_t *sockid);
+int corenet_rdma_rail_link(const sockid_t *sockid, const sockid_t *rail);
+int corenet_rdma_rail_stat(const sockid_t *sockid, corenet_rail_stat_t *stat,
+                           int *count);
+int corenet_rdma_stat(const sockid_t *sockid, corenet_rdma_stat_t *stat);
 
 void corenet_rdma_connect_request(struct rdma_cm_event *ev, void *core);
 void corenet_rdma_established(struct rdma_cm_event *ev, void *core);
@@ -403,15 +614,14 @@ void corenet_rdma_timewait_exit(struct rdma_cm_event *ev, void *core);
 
 int corenet_rdma_post_recv(void *ptr);
 typedef rdma_req_t *(*req_build_func)(rdma_conn_t *rdma_handler, ltgbuf_t *buf,
-                                 void **addr, uint32_t rkey, uint32_t size);
-int corenet_rdma_send(const sockid_t *sockid, ltgbuf_t *buf, void **addr,
-                      uint32_t rkey, uint32_t size,
-                      req_build_func);
+                                 const data_prop_t *prop);
+int corenet_rdma_send(const sockid_t *sockid, ltgbuf_t *buf,
+                      const data_prop_t *prop, req_build_func);
 void corenet_rdma_commit(void *rdma_net);
 
-rdma_req_t *build_post_send_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf, void **addr, uint32_t rkey, uint32_t size);
-rdma_req_t *build_rdma_read_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf, void **addr, uint32_t rkey, uint32_t size);
-rdma_req_t *build_rdma_write_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf, void **addr, uint32_t rkey, uint32_t size);
+rdma_req_t *build_post_send_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf, const data_prop_t *prop);
+rdma_req_t *build_rdma_read_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf, const data_prop_t *prop);
+rdma_req_t *build_rdma_write_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf, const data_prop_t *prop);
 
 int corenet_rdma_poll(__corenet_t *corenet);
 
@@ -422,7 +632,9 @@ int corenet_rdma_passive(uint32_t *port, int cpu_index);
 int corenet_rdma_listen_by_channel(int cpu_idx, uint32_t port);
 
 // client-side
-int corenet_rdma_connect_by_channel(const uint32_t addr, const uint32_t port, core_t *core, sockid_t *sockid);
+int corenet_rdma_connect_by_channel(const uint32_t addr, const uint32_t port,
+                                    const rdma_rail_msg_t *rail, core_t *core,
+                                    sockid_t *sockid);
 
 // int corenet_rdma_on_passive_event(int cpu_idx);
 int rdma_event_init();
@@ -439,5 +651,6 @@ int corenet_register(uint64_t coremask);
 void corenet_close(const sockid_t *sockid);
 
 int corenet_send(void *ctx, const sockid_t *sockid, ltgbuf_t *buf);
+corenet_credit_t *corenet_credit(const sockid_t *sockid);
 
 #endif
@@ -5,5 +5,6 @@
 
 int corenet_tcp_connect(const coreid_t *coreid, uint32_t addr, uint32_t port, sockid_t *sockid);
 int corenet_tcp_passive(const coreid_t *coreid, uint32_t *_port, int *_sd);
+int corenet_shm_connect(const coreid_t *coreid, sockid_t *sockid);
 
 #endif
@@ -7,15 +7,30 @@
 
 #define CORENET_DEV_MAX 10
 
+/* tcp_conn is capped here, repair keeps one bit per connection */
+#define CORENET_CONN_MAX 8
+/* rpcs moving more than this go to the bulk connections */
+#define CORENET_CONN_SMALL (64 * 1024)
+/* seconds, cap of the warm up retry backoff */
+#define CORENET_WARMUP_BACKOFF_MAX 32
+
 typedef int (*corerpc_request)(void *ctx, void *);
 
 typedef struct {
         nid_t nid;
         int coreid;
         uint64_t coremask;
-        sockid_t sockid[CORE_MAX];
+        sockid_t sockid[CORE_MAX];      /* small rpcs, the only one if stripe is 0 */
+
+        int stripe;                     /* bulk connections per core */
+        uint32_t gen;                   /* bumped by every full connect */
+        sockid_t *bulk;                 /* stripe per core */
+        uint8_t cursor[CORE_MAX];       /* next bulk connection */
+        uint8_t repair[CORE_MAX];       /* connections being reconnected */
 
         int connecting;
+        time_t warm_next;               /* no warm up connect before this */
+        int warm_backoff;
         struct list_head wait_list;
         corerpc_request request;
         int (*connected)(const sockid_t *);
@@ -27,9 +42,15 @@ int corenet_maping_connected(const nid_t *nid, const sockid_t *sockid);
 void corenet_maping_closeall(const nid_t *nid, const sockid_t *sockid);
 void corenet_maping_close(const nid_t *nid, const sockid_t *sockid);
 int corenet_maping(void *core, const coreid_t *coreid, sockid_t *sockid);
+int corenet_maping_ready(void *core, const coreid_t *coreid);
+int corenet_maping1(void *core, const coreid_t *coreid, uint32_t size,
+                    sockid_t *sockid);
 
 int corenet_maping_register(uint64_t coremask);
 void corenet_maping_check(const ltg_net_info_t *info);
+void corenet_maping_uncheck(const nid_t *nid);
+void corenet_maping_prune(const nid_t *nids, int count);
+int corenet_maping_meshed();
 int corenet_maping_offline(uint64_t coremask);
 
 #endif
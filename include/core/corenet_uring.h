@@ -0,0 +1,88 @@
+#ifndef __CORENET_URING_H__
+#define __CORENET_URING_H__
+
+#include "ltg_def.h"
+
+#if ENABLE_TCP_URING
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+/*
+ * a per core io_uring driven without liburing. the owner core prepares
+ * sqes during the iteration and submits them with one io_uring_enter,
+ * completions are reaped from the mapped cq ring. recv is multishot and
+ * picks its buffers from a provided buffer ring.
+ */
+
+#define CORENET_URING_ENTRIES 1024
+#define CORENET_URING_BUF_COUNT 256             /* power of 2 */
+#define CORENET_URING_BUF_SIZE (32 * 1024)
+#define CORENET_URING_IOV_MAX 64
+
+typedef void (*corenet_uring_func)(void *ctx, uint64_t user_data, int res,
+                                   uint32_t flags, void *buf);
+
+typedef struct {
+        int fd;
+        uint32_t sq_entries;
+        uint32_t sq_mask;
+        uint32_t sq_tail;               /* local, published on submit */
+        uint32_t to_submit;
+        uint32_t *sq_khead;
+        uint32_t *sq_ktail;
+        uint32_t *sq_kflags;
+        struct io_uring_sqe *sqes;
+
+        uint32_t cq_mask;
+        uint32_t *cq_khead;
+        uint32_t *cq_ktail;
+        struct io_uring_cqe *cqes;
+
+        void *sq_ring;
+        void *cq_ring;
+        size_t sq_ring_size;
+        size_t cq_ring_size;
+        size_t sqes_size;
+
+        struct io_uring_buf_ring *buf_ring;
+        void *buf;
+        uint16_t buf_tail;
+        uint16_t bgid;
+
+        uint64_t nr_enter;
+        uint64_t nr_sqe;
+        uint64_t nr_cqe;
+        uint64_t nr_nobufs;
+} corenet_uring_t;
+
+#define CORENET_URING_DUMP_L(LEVEL, uring, format, a...) do { \
+    LEVEL("uring %p fd %d enter %ju sqe %ju cqe %ju nobufs %ju "format, \
+          (uring),  \
+          (uring)->fd,  \
+          (uring)->nr_enter,  \
+          (uring)->nr_sqe,  \
+          (uring)->nr_cqe,  \
+          (uring)->nr_nobufs,  \
+          ##a \
+          ); \
+} while(0)
+
+#define CORENET_URING_DUMP(uring, format, a...) CORENET_URING_DUMP_L(DBUG, uring, format, ##a)
+
+int corenet_uring_create(corenet_uring_t **_uring);
+void corenet_uring_destroy(corenet_uring_t *uring);
+
+int corenet_uring_recv(corenet_uring_t *uring, int fd, uint64_t user_data);
+int corenet_uring_sendmsg(corenet_uring_t *uring, int fd, const struct msghdr *msg,
+                          uint64_t user_data);
+int corenet_uring_poll(corenet_uring_t *uring, int fd, uint64_t user_data);
+int corenet_uring_cancel(corenet_uring_t *uring, int fd, uint64_t user_data);
+
+int corenet_uring_submit(corenet_uring_t *uring, int wait, int tmo);
+int corenet_uring_reap(corenet_uring_t *uring, corenet_uring_func func, void *ctx);
+
+#endif
+
+#endif
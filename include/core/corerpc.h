@@ -41,6 +41,8 @@ typedef struct {
 } corerpc_ctx_t;
 
 void corerpc_register(int type, request_get_handler handler, void *context);
+int corerpc_proto_private_init(int hash);
+int corerpc_request_private_init(int hash);
 
 int corerpc_postwait(const char *name,
                      const coreid_t *coreid, const void *request,
@@ -52,6 +54,48 @@ int corerpc_postwait1(const char *name,
                       int reqlen,  void *reply, int *replen,
                       int msg_type, int group, int timeout);
 
+typedef void (*corerpc_post_func)(void *arg, int retval);
+
+int corerpc_post_async(const char *name, const coreid_t *coreid,
+                       const void *request, int reqlen,
+                       const ltgbuf_t *wbuf, ltgbuf_t *rbuf,
+                       int msg_type, int group, int timeout,
+                       corerpc_post_func func, void *arg);
+
+/*
+ * fan-out of async posts from one task: count++ for every post that
+ * returned 0, with corerpc_wait_done as its func, then corerpc_wait.
+ */
+typedef struct {
+        int count;
+        int retval;
+        task_t task;
+} corerpc_wait_t;
+
+void corerpc_wait_init(corerpc_wait_t *wait);
+void corerpc_wait_done(void *wait, int retval);
+int corerpc_wait(const char *name, corerpc_wait_t *wait);
+
+typedef struct {
+        coreid_t coreid;
+        const void *request;
+        int reqlen;
+        const ltgbuf_t *wbuf;
+        ltgbuf_t *rbuf;
+        int msg_type;
+        int retval;                     /* out */
+} corerpc_batch_t;
+
+int corerpc_postwait_batch(const char *name, corerpc_batch_t *batch,
+                           int count, int group, int timeout);
+
+int corerpc_islocal(const coreid_t *coreid, const ltgbuf_t *wbuf,
+                    const ltgbuf_t *rbuf, int msg_type);
+int corerpc_local(const char *name, const coreid_t *coreid,
+                  const void *request, int reqlen, const ltgbuf_t *wbuf,
+                  ltgbuf_t *rbuf, int msg_type);
+int corerpc_local_stat(int hash, uint64_t *count);
+
 int corerpc_postwait_sock(const char *name, const coreid_t *coreid,
                           const sockid_t *sockid, const void *request,
                           int reqlen, int msg_type,
@@ -62,8 +106,29 @@ void corerpc_reply_error(const sockid_t *sockid, const msgid_t *msgid, int _erro
 
 void corerpc_reply_rdma(void *ctx, void *arg);
 void corerpc_reply_tcp(void *ctx, void *arg);
+void corerpc_reply_shm(void *ctx, void *arg);
+
+typedef struct {
+        uint32_t bytes;
+        uint32_t msgs;
+        uint32_t max_bytes;
+        uint32_t max_msgs;
+        uint32_t wait;
+        uint64_t block;
+} corerpc_credit_stat_t;
+
+struct corenet_credit;
+
+void corerpc_credit_init(struct corenet_credit *credit);
+void corerpc_credit_reset(struct corenet_credit *credit);
+int corerpc_credit_get(const sockid_t *sockid, uint32_t bytes, int wait);
+void corerpc_credit_put(const sockid_t *sockid, uint32_t bytes);
+void corerpc_credit_update(const sockid_t *sockid, const ltg_net_head_t *head);
+void corerpc_credit_advertise(ltgbuf_t *buf);
+int corerpc_credit_stat(const sockid_t *sockid, corerpc_credit_stat_t *stat);
 
 int corerpc_tcp_recv(void *ctx, void *buf, int *count);
+int corerpc_shm_recv(void *ctx, void *buf, int *count);
 
 void corerpc_scan(void *ctx);
 
@@ -87,5 +152,6 @@ int corerpc_rdma_recv_data(void *_ctx, void *_msg_buf);
 
 int corerpc_rdma_request(void *ctx, void *_op);
 int corerpc_tcp_request(void *ctx, void *_op);
+int corerpc_shm_request(void *ctx, void *_op);
 
 #endif
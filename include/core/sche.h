@@ -188,6 +188,9 @@ typedef struct sche_t {
         // uint64_t hz;
         // scher status
         int eventfd;
+        int sleepy;                     /* eventfd only written while sleeping */
+        int sleeping;
+        uint32_t posted;
         int running;
         int suspendable;
 
@@ -0,0 +1,2 @@
+#define LTG_CMAKE_DEBUG 0
+#define LTG_CMAKE_URING 1
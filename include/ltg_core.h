@@ -9,6 +9,7 @@
 #include "core/rdma_event.h"
 #include "core/cpuset.h"
 #include "core/corenet.h"
+#include "core/corenet_uring.h"
 #include "core/corerpc.h"
 #include "core/corenet_maping.h"
 #include "core/corenet_connect.h"
@@ -36,7 +36,10 @@ typedef long long LLD;
 #define IO_MAX (1024 * 1024 * 4)
 #define BUFFER_SEG_SIZE IO_MAX
 
-#define MAX_SGE  (IO_MAX / BUFFER_SEG_SIZE + 1)
+/* wrs and sges of one rdma req, bounded by RDMA_INFO_SIZE */
+#define MAX_SGE 4
+/* remote segments of an rdma payload, a write keeps one wr for its reply */
+#define MAX_DATA_SGE (MAX_SGE - 1)
 #define RDMA_INFO_SIZE 1024
 
 #define LNET_SERVICE_BASE 49152
@@ -54,6 +57,7 @@ typedef long long LLD;
 
 #define SOCKID_NORMAL 10
 #define SOCKID_CORENET 20
+#define SOCKID_SHM 30
 
 #define ENABLE_HUGEPAGE 1
 
@@ -69,6 +73,12 @@ typedef long long LLD;
 
 #define ENABLE_TCP_THREAD 0
 
+#if !ENABLE_TCP_THREAD && LTG_CMAKE_URING
+#define ENABLE_TCP_URING 1
+#else
+#define ENABLE_TCP_URING 0
+#endif
+
 #define SCHEDULE_TASKCTX_RUNTIME 1
 
 #define ENABLE_RING_MP 1
@@ -1,10 +1,14 @@
 #ifndef __LTG_MEM_H__
 #define __LTG_MEM_H__
 
+#include "mem/mem_stat.h"
 #include "mem/hugepage.h"
 #include "mem/slab.h"
 #include "mem/mem_ring.h"
 #include "mem/ltg_malloc.h"
 #include "mem/ltgbuf.h"
 #include "mem/buddy.h"
+#include "mem/huge_bitmap.h"
+#include "mem/obj_pool.h"
+#include "mem/mem_chunk.h"
 #endif
@@ -9,6 +9,12 @@ typedef struct buddy {
 
 #define BUDDY_SIZE(count) (sizeof(size_t) + count * sizeof(size_t))
 
+extern struct mem_alloc mem_buddy;
+
+uint32_t buddy_total(uint32_t page_num);
+int __buddy_alloc(void *buddy_addr, uint32_t size);
+int __buddy_free(void *buddy_addr, uint32_t offset);
+
 #define BUDDY_DUMP_L(LEVEL, buddy, format, a...) do { \
     LEVEL("buddy %p hugepage %u/%u "format, \
           (buddy),  \
@@ -0,0 +1,39 @@
+#ifndef __HUGE_BITMAP_H__
+#define __HUGE_BITMAP_H__
+
+#include <stdint.h>
+
+/*
+ * one bit per HUGEPAGE_SIZE page, set when used. 2M takes any free bit,
+ * 4M takes an aligned pair of bits in the same word, so both size classes
+ * are a single cas and never need a lock.
+ */
+
+#define HUGE_BITMAP_CLASS 2     /* 2M, 4M */
+
+typedef struct {
+        uint32_t nr_total;
+        uint32_t nr_word;
+        uint32_t nr_alloc;
+        uint32_t hint[HUGE_BITMAP_CLASS];       /* last word used by each class */
+        uint64_t bitmap[0];
+} huge_bitmap_t;
+
+#define HUGE_BITMAP_SIZE(count) (sizeof(huge_bitmap_t) + ((count) + 63) / 64 * sizeof(uint64_t))
+
+#define HUGE_BITMAP_DUMP_L(LEVEL, bitmap, format, a...) do { \
+    LEVEL("bitmap %p hugepage %u/%u "format, \
+          (bitmap),  \
+          (bitmap)->nr_total,  \
+          (bitmap)->nr_alloc,  \
+          ##a \
+          ); \
+} while(0)
+
+#define HUGE_BITMAP_DUMP(bitmap, format, a...) HUGE_BITMAP_DUMP_L(DBUG, bitmap, format, ##a)
+
+extern struct mem_alloc mem_bitmap;
+
+void bitmap_memalloc_reg();
+
+#endif
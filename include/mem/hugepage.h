@@ -4,6 +4,7 @@
 //#include "ltgbuf.h"
 struct mem_alloc {
 	uint8_t type;
+	uint8_t lockless;       /* alloc/free safe without head->lock */
 	uint32_t  max_alloc_size;
 
 	int (*init)(void *addr, uint32_t);
@@ -23,14 +24,19 @@ struct mem_alloc {
 int hugepage_init(int daemon, uint64_t coremask, int nr_huge);
 void *hugepage_private_init(int hash, int sockid);
 
-int hugepage_getfree(void **addr, uint32_t *size, const char *caller);
+int hugepage_getfree(void **addr, uint32_t *size, int tag, const char *caller);
+int hugepage_putfree(void *addr, uint32_t size, int tag, const char *caller);
 int hugepage_get();
+int hugepage_pressure();
 void hugepage_show(const char *caller);
+int hugepage_residency(int hash, uint32_t *node_count, int node_max);
+void hugepage_residency_dump(const char *caller);
 
 void get_global_private_mem(void **private_mem, uint64_t *private_mem_size);
 int suzaku_mem_alloc_register(struct mem_alloc *alloc_ops);
 
 void buddy_memalloc_reg();
+void bitmap_memalloc_reg();
 void posix_memalloc_reg();
 
 #define SUZAKU_MEM_ALLOC_REGISTER(name, mem_alloc_ops) \
@@ -4,9 +4,12 @@
 void *ltg_malloc1(size_t size);
 void ltg_free1(void *ptr);
 int ltg_malloc(void **ptr, size_t size);
+int ltg_malloc_tag(void **ptr, size_t size, int tag);
 int ltg_malign(void **_ptr, size_t align, size_t size);
 int ltg_realloc(void **_ptr, size_t size, size_t newsize);
+int ltg_realloc_tag(void **_ptr, size_t size, size_t newsize, int tag);
 int ltg_free(void **ptr);
+int ltg_free_tag(void **ptr, int tag);
 
 int huge_mem_alloc1(void **_ptr, size_t size);
 void huge_mem_free1(void **ptr);
@@ -42,6 +42,20 @@ typedef struct {
         int (*cb)(void *arg);
 } mem_ext_t;
 
+typedef struct {
+        void *chunk;
+} mem_chunk_ref_t;
+
+/* memory owned elsewhere, put runs when the last segment lets go */
+typedef struct mem_ref {
+        int ref;
+        void (*put)(struct mem_ref *ref);
+} mem_ref_t;
+
+typedef struct {
+        mem_ref_t *ref;
+} mem_ref_seg_t;
+
 struct seg_t {
         struct list_head hook;
         uint32_t len;
@@ -60,6 +74,8 @@ struct seg_t {
                 mem_ext_t ext;
                 mem_sys_t sys;
                 mem_solid_t solid;
+                mem_chunk_ref_t chunk;
+                mem_ref_seg_t ref;
         };
 } ;
 
@@ -104,6 +120,8 @@ void ltgbuf_copy2(ltgbuf_t *buf, const char *srcmem, int size);
 void ltgbuf_copy3(ltgbuf_t *buf, const char *srcmem, int size);
 int ltgbuf_droptail(ltgbuf_t *buf, uint32_t len);
 int ltgbuf_segcount(const ltgbuf_t *buf);
+uint32_t ltgbuf_owned(const ltgbuf_t *buf);
+uint32_t ltgbuf_segfloor(const ltgbuf_t *buf, uint32_t len);
 
 int ltgbuf_aligned(const ltgbuf_t *buf, int align);
 int ltgbuf_popmsg(ltgbuf_t *pack, void *buf, uint32_t len);
@@ -150,8 +168,10 @@ int ltgbuf_solid_init(ltgbuf_t *buf, int size);
 
 int ltgbuf_trans_sge(struct ibv_sge *sge, ltgbuf_t *src_buf, ltgbuf_t *dst_buf, uint32_t lkey);
 void ltgbuf_trans_addr(void **addr, const ltgbuf_t *buf);
+/* copied for rdma unless the owner allowed the range, see rdma_mr_allow */
 int ltgbuf_initwith(ltgbuf_t *buf, void *data, int size, void *arg, int (*cb)(void *arg));
 int ltgbuf_initwith2(ltgbuf_t *buf, struct iovec *iov, int count, void *arg, int (*cb)(void *arg));
+int ltgbuf_initref(ltgbuf_t *buf, void *data, uint32_t size, mem_ref_t *ref);
 int ltgbuf_rdma_popmsg(ltgbuf_t *buf, void *dist, uint32_t len);
 int ltgbuf_nvme_init2(nvmeio_t *io, uint32_t size, uint64_t offset, ltgbuf_t *buf);
 
@@ -161,6 +181,10 @@ seg_t *seg_huge_create(ltgbuf_t *buf, uint32_t *size);
 seg_t *seg_sys_create(ltgbuf_t *buf, uint32_t size);
 seg_t *seg_ext_create(ltgbuf_t *buf, void *data, uint32_t size,
                       void *arg, int (*cb)(void *arg));
+seg_t *seg_chunk_create(ltgbuf_t *buf, void *chunk, void *data, uint32_t size);
+seg_t *seg_ref_create(ltgbuf_t *buf, mem_ref_t *ref, void *data, uint32_t size);
+int seg_counted(const seg_t *seg);
+int seg_owned(const seg_t *seg);
 seg_t *seg_trans(ltgbuf_t *buf, seg_t *seg);
 void seg_check(seg_t *seg);
 
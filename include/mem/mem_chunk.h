@@ -0,0 +1,61 @@
+#ifndef __MEM_CHUNK_H__
+#define __MEM_CHUNK_H__
+
+#include <stdint.h>
+
+/*
+ * fixed size receive chunks carved from hugepages, one pool per core.
+ * a chunk is counted: the reader holds a reference while it fills the
+ * chunk and every ltgbuf segment pointing into it holds one more. the
+ * last put gives it back to the owner, through the remote list when
+ * that runs on another thread.
+ */
+
+#define MEM_CHUNK_SIZE (64 * 1024)
+
+typedef struct __mem_chunk {
+        void *ptr;
+        struct __mem_chunk_pool *pool;
+        struct __mem_chunk *next;
+        int ref;
+} mem_chunk_t;
+
+typedef struct {
+        uint32_t page;          /* hugepages held */
+        uint32_t count;         /* chunks carved */
+        uint64_t used;          /* chunks out of the pool */
+        uint64_t get;
+        uint64_t remote;        /* returns from other threads */
+} mem_chunk_stat_t;
+
+/*
+ * per socket receive ring, chunk[0] is being filled from offset, the
+ * rest are fresh. only chunk[0] is kept once the socket is drained.
+ */
+#define MEM_CHUNK_RX_MAX 16
+
+typedef struct {
+        mem_chunk_t *chunk[MEM_CHUNK_RX_MAX];
+        int count;
+        uint32_t offset;
+
+        uint64_t nr_recv;       /* recvmsg calls */
+        uint64_t nr_chunk;      /* chunks that took data */
+        uint64_t nr_bytes;
+} mem_chunk_rx_t;
+
+struct ltgbuf_t;
+
+int mem_chunk_private_init(int hash);
+
+mem_chunk_t *mem_chunk_get();
+void mem_chunk_ref(mem_chunk_t *chunk);
+void mem_chunk_put(mem_chunk_t *chunk);
+
+int mem_chunk_recv(mem_chunk_rx_t *rx, int fd, struct ltgbuf_t *buf, uint32_t *len);
+void mem_chunk_rx_free(mem_chunk_rx_t *rx);
+
+int mem_chunk_stat(int hash, mem_chunk_stat_t *stat);
+int mem_chunk_dump(char *buf, int buflen);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef __MEM_STAT_H__
+#define __MEM_STAT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * allocation accounting by tag and size class. every polling core owns
+ * its counters and updates them without atomics, other threads share one
+ * set updated atomically. a free is charged to the core that runs it, so
+ * a single core may go negative after cross core frees, the merged value
+ * is exact. malloc tags use malloc_usable_size.
+ */
+
+typedef enum {
+        MEM_TAG_MALLOC = 0,     /* ltg_malloc without a tag */
+        MEM_TAG_SLAB_STREAM,    /* slab_stream objects */
+        MEM_TAG_SLAB_STATIC,    /* slab_static objects */
+        MEM_TAG_SLAB_SEG,       /* segments held by slabs */
+        MEM_TAG_RING_PAGE,      /* pages held by mem_ring */
+        MEM_TAG_MEM_RING,       /* mem_ring pages with live buffers */
+        MEM_TAG_TASK,           /* task stacks and contexts */
+        MEM_TAG_RPC,            /* rpc tables */
+        MEM_TAG_ANALYSIS,       /* analysis tables */
+        MEM_TAG_CORENET,        /* corenet nodes and iovecs */
+        MEM_TAG_CHUNK,          /* pages held by receive chunk pools */
+        MEM_TAG_MAX,
+} mem_tag_t;
+
+/* 64, 256, 1K, 4K, 16K, 64K, 256K, 1M, 4M, more */
+#define MEM_CLASS_MAX 10
+
+typedef struct {
+        int64_t count[MEM_TAG_MAX][MEM_CLASS_MAX];
+        int64_t bytes[MEM_TAG_MAX][MEM_CLASS_MAX];
+        int64_t alloc[MEM_TAG_MAX];     /* allocations ever made, never drops */
+} mem_stat_t;
+
+void mem_stat_add(int tag, size_t size);
+void mem_stat_sub(int tag, size_t size);
+
+int mem_stat_private_init(int hash);
+int mem_stat_get(int hash, mem_stat_t *stat);
+void mem_stat_merge(mem_stat_t *stat);
+int mem_stat_dump(char *buf, int buflen);
+void mem_stat_show(const char *caller);
+const char *mem_stat_tag(int tag);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __OBJ_POOL_H__
+#define __OBJ_POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * typed per core object pools for the small structures of the rpc path.
+ * slots are cache line sized and preallocated when the core starts, the
+ * owner allocs and frees without atomics, a free from another thread is
+ * pushed to the owner's remote list. slab_stream is only used when the
+ * pool is empty or the thread has no pool.
+ */
+
+typedef enum {
+        OBJ_POOL_RPC_REQUEST = 0,
+        OBJ_POOL_CORERPC_RING,
+        OBJ_POOL_CORENET_FWD,
+        OBJ_POOL_RING_BULK,
+        OBJ_POOL_RPC_CTX,
+        OBJ_POOL_MAX,
+} obj_pool_type_t;
+
+typedef struct {
+        uint32_t size;          /* slot size */
+        uint32_t count;
+        uint64_t used;          /* slots out of the pool */
+        uint64_t hit;
+        uint64_t fallback;      /* allocs served by slab */
+        uint64_t remote;        /* frees from other threads */
+} obj_pool_stat_t;
+
+int obj_pool_private_init(int hash, int type, const char *name, size_t size,
+                          int count);
+void *obj_pool_alloc(int type, size_t size);
+void obj_pool_free(void *ptr);
+
+int obj_pool_stat(int hash, int type, obj_pool_stat_t *stat);
+int obj_pool_dump(char *buf, int buflen);
+void obj_pool_show(const char *caller);
+
+#endif
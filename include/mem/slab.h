@@ -8,20 +8,31 @@ typedef struct {
         char name[MAX_NAME_LEN];
         size_t split;
         int private;
+        int tag;
         int count;
+        int nr_idle;            /* segments with nothing allocated */
         pid_t tid;
         struct list_head list;
         struct list_head used;
         void *array[SLAB_SEG_MAX];
 } slab_bucket_t;
 
+/* head of every segment, the objects follow it */
+typedef struct {
+        int idx;                /* slot in slab_bucket->array */
+        int used;
+        int total;
+        time_t idle;            /* when used dropped to 0 */
+        char pad[40];
+} slab_seg_t;
+
 typedef struct {
         struct list_head hook;
         time_t time;
         uint32_t magic;
         uint32_t coreid;
         slab_bucket_t *slab_bucket;
-        void *seghead;
+        slab_seg_t *seghead;
         char ptr[0];
 } slab_md_t;
 
@@ -31,9 +42,19 @@ typedef struct {
         int count;
         pid_t tid;
         uint32_t coreid;
+        int tag;                /* mem_stat tag of the objects */
+        uint64_t nr_seg;
+        uint64_t max_seg;       /* high water */
+        uint64_t reclaimed;     /* segments given back */
         slab_bucket_t slab_bucket[0];
 } slab_array_t;
 
+typedef struct {
+        uint64_t bytes;
+        uint64_t high_water;
+        uint64_t reclaimed;
+} slab_stat_t;
+
 typedef struct {
         size_t max;
         slab_array_t *public;
@@ -42,12 +63,14 @@ typedef struct {
 
 
 int slab_init(const char *name, slab_t **_slab, slab_array_t **_public, int min,
-              int shift, uint32_t magic);
+              int shift, uint32_t magic, int tag);
 int slab_private_init(const char *name, slab_t **_slab, slab_array_t *public, int min,
-                      int shift, uint32_t magic);
+                      int shift, uint32_t magic, int tag);
 void *slab_alloc(slab_t *slab, size_t size);
 void slab_free(slab_t *slab, void *ptr);
 void slab_scan(void *core, slab_array_t *array);
+void slab_reclaim(void *core, slab_array_t *array);
+void slab_stat(const slab_t *slab, slab_stat_t *stat);
 
 int slab_static_init();
 int slab_static_private_init();
@@ -56,6 +79,7 @@ void slab_static_free(void *ptr);
 void *slab_static_alloc_glob(size_t size);
 int slab_static_alloc1(void **_ptr, size_t size);
 void slab_static_free1(void **ptr);
+int slab_static_stat(slab_stat_t *stat);
 
 int slab_stream_init();
 int slab_stream_private_init();
@@ -64,5 +88,6 @@ void slab_stream_free(void *ptr);
 void *slab_stream_alloc_glob(size_t size);
 int slab_stream_alloc1(void **_ptr, size_t size);
 void slab_stream_free1(void **ptr);
+int slab_stream_stat(slab_stat_t *stat);
 
 #endif
@@ -21,6 +21,9 @@ typedef enum {
         LTG_MSG_REP = 0x04,
 } net_msgtype_t;
 
+/* set in prog of a reply whose replen/group carry the credit window */
+#define LTG_REPLY_CREDIT 0x1
+
 #pragma pack(8)
 
 typedef struct  {
@@ -45,7 +45,7 @@ inline static void S_LTG request_trans(void *arg, coreid_t *dist,
         if (ctx)
                 *ctx = rpc_request->ctx;
 
-        slab_stream_free(rpc_request);
+        obj_pool_free(rpc_request);
 }
 
 typedef struct {
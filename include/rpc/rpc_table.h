@@ -19,22 +19,36 @@ typedef struct {
         func3_t post;
         func2_t close;
         void *post_arg;
+        uint32_t free_next;             /* next idx on the free list */
+        struct list_head wheel_hook;
+        uint64_t deadline;              /* ms */
 } slot_t;
 
+#define RPC_TABLE_MAX 8192              /* slots a table starts with */
+#define RPC_TABLE_CHUNK 1024            /* slots a table grows by */
+#define RPC_TABLE_CHUNK_MAX 1024
+
+#define RPC_WHEEL_TICK 10               /* ms */
+#define RPC_WHEEL_SIZE 1024
+
 typedef struct {
         char name[MAX_NAME_LEN];
         int private;
         uint32_t count;
-        uint32_t cur;
+        uint32_t max;
         int cycle;
         int tabid;
         time_t last_scan;
         uint32_t sequence;
-        slot_t *slot[0];
+        ltg_spinlock_t free_lock;       /* shared table only */
+        uint32_t free_head;
+        ltg_spinlock_t wheel_lock;      /* shared table only */
+        uint32_t wheel_count;
+        uint64_t wheel_now;             /* ms of the next tick to expire */
+        struct list_head wheel[RPC_WHEEL_SIZE];
+        slot_t **chunk[RPC_TABLE_CHUNK_MAX];
 } rpc_table_t;
 
-#define RPC_TABLE_MAX 8192
-
 extern rpc_table_t *__rpc_table__;
 
 #define RPC_TABLE_POST_FREE 0
@@ -43,6 +57,7 @@ int rpc_table_init(const char *name, rpc_table_t **rpc_table, int private);
 void rpc_table_destroy(rpc_table_t **_rpc_table);
 
 void rpc_table_scan(rpc_table_t *rpc_table, int interval, int newtask);
+void rpc_table_expire(rpc_table_t *rpc_table);
 
 int rpc_table_getslot(rpc_table_t *rpc_table, msgid_t *msgid, const char *name);
 int rpc_table_setslot(rpc_table_t *rpc_table, const msgid_t *msgid, func3_t func, void *arg,
@@ -32,6 +32,30 @@ typedef struct {
         uint64_t coremask;
         uint64_t netmask;
         int nr_hugepage;
+        int hugepage_memfd;     /* per core pool from memfd, bound to the core's node */
+        int hugepage_1g;        /* back memfd pools with 1GB pages */
+        int hugepage_bitmap;    /* lock free bitmap allocator instead of buddy */
+        int slab_reclaim_idle;  /* seconds a free slab segment is kept, 0 never */
+        int rdma_mr_cache;      /* cached registrations of outside buffers per device, 0 copy */
+        int rdma_mr_min;        /* outside buffers smaller than this are copied anyway */
+        int rdma_rail;          /* qps over distinct devices per connection, 0 or 1 single */
+        int rdma_stripe;        /* rdma reads and writes from this many bytes use all rails */
+        int obj_pool_count;     /* preallocated rpc objects per core and type */
+        int tcp_uring;          /* corenet_tcp over io_uring instead of epoll */
+        int tcp_zerocopy;       /* MSG_ZEROCOPY sends from this many bytes, 0 off */
+        int tcp_cork;           /* usec a small send may wait for more, 0 off */
+        int tcp_conn;           /* connections per core pair, small rpcs use the first */
+        int tcp_accept_core;    /* accept on the core's poller instead of a thread */
+        int tcp_shm;            /* shared memory rings to peers on the same host */
+        int rpc_local;          /* call handlers of local cores without the network */
+        int maping_warmup;      /* connects in flight per core to warm up new nodes, 0 lazy */
+        int rpc_credit_bytes;   /* request bytes in flight per connection, 0 no limit */
+        int rpc_credit_msgs;    /* requests in flight per connection, 0 no limit */
+        int rpc_table_max;      /* slots a rpc table may grow to, RPC_TABLE_MAX at least */
+        int rdma_srq;           /* receive slots shared by a core's qps per device, 0 per qp */
+        int rdma_inline;        /* max_inline_data asked for a qp, smaller sends go inline */
+        int rdma_signal;        /* signal one send wr in this many, 0 every wr */
+        int rdma_event;         /* empty cq polls before the core sleeps on cq events, 0 never */
         int daemon;
         
         int wmem_max;
@@ -36,7 +36,8 @@ typedef struct __task_t {
 #pragma pack(8)
 
 typedef struct {
-        uintptr_t remote_addr[MAX_SGE];
+        uintptr_t remote_addr[MAX_DATA_SGE];
+        uint32_t  remote_len[MAX_DATA_SGE];     /* 0 past the last segment */
         uint32_t  rkey;
         uint32_t  size;
 } data_prop_t;
@@ -10,5 +10,6 @@ typedef int (*timer_exec_t)(void *);
 int timer_init();
 void timer_destroy();
 int timer_insert(const char *name, void *ctx, func_t func, suseconds_t usec);
+suseconds_t timer_next();
 
 #endif
@@ -15,6 +15,8 @@ static seg_ops_t __sop_huge__;
 static seg_ops_t __sop_sys__;
 static seg_ops_t __sop_ext__;
 static seg_ops_t __sop_solid__;
+static seg_ops_t __sop_chunk__;
+static seg_ops_t __sop_ref__;
 
 /*shared*/
 static void S_LTG __seg_free_head(seg_t *seg, int sys)
@@ -198,6 +200,130 @@ seg_t S_LTG *seg_ext_create(ltgbuf_t *buf, void *data, uint32_t size,
         return seg;
 }
 
+/*seg receive chunk, every segment holds a reference*/
+
+static void S_LTG __seg_chunk_free(seg_t *seg)
+{
+        mem_chunk_put(seg->chunk.chunk);
+
+        __seg_free_head(seg, 0);
+}
+
+static seg_t S_LTG *__seg_chunk_share(ltgbuf_t *buf, seg_t *src)
+{
+        seg_t *seg;
+
+        seg = __seg_alloc_head(buf, src->len, 0);
+        seg->sop = src->sop;
+        seg->chunk = src->chunk;
+        seg->handler = src->handler;
+
+        mem_chunk_ref(seg->chunk.chunk);
+
+        return seg;
+}
+
+static seg_t S_LTG *__seg_chunk_trans(ltgbuf_t *buf, seg_t *seg)
+{
+        seg_t *newseg = __seg_alloc_head(buf, seg->len, 0);
+
+        newseg->handler = seg->handler;
+        newseg->sop = seg->sop;
+        newseg->chunk = seg->chunk;
+
+        __seg_free_head(seg, 0);
+
+        return newseg;
+}
+
+/*seg counted foreign memory, every segment holds a reference*/
+
+static void S_LTG __seg_ref_free(seg_t *seg)
+{
+        mem_ref_t *ref = seg->ref.ref;
+
+        if (__atomic_sub_fetch(&ref->ref, 1, __ATOMIC_ACQ_REL) == 0)
+                ref->put(ref);
+
+        __seg_free_head(seg, 0);
+}
+
+static seg_t S_LTG *__seg_ref_share(ltgbuf_t *buf, seg_t *src)
+{
+        seg_t *seg;
+
+        seg = __seg_alloc_head(buf, src->len, 0);
+        seg->sop = src->sop;
+        seg->ref = src->ref;
+        seg->handler = src->handler;
+
+        __atomic_add_fetch(&seg->ref.ref->ref, 1, __ATOMIC_RELAXED);
+
+        return seg;
+}
+
+static seg_t S_LTG *__seg_ref_trans(ltgbuf_t *buf, seg_t *seg)
+{
+        seg_t *newseg = __seg_alloc_head(buf, seg->len, 0);
+
+        newseg->handler = seg->handler;
+        newseg->sop = seg->sop;
+        newseg->ref = seg->ref;
+
+        __seg_free_head(seg, 0);
+
+        return newseg;
+}
+
+seg_t S_LTG *seg_ref_create(ltgbuf_t *buf, mem_ref_t *ref, void *data, uint32_t size)
+{
+        seg_t *seg;
+
+        seg = __seg_alloc_head(buf, size, 0);
+
+        seg->sop = &__sop_ref__;
+
+        seg->handler.ptr = data;
+        seg->handler.phyaddr = 0;
+
+        seg->ref.ref = ref;
+        __atomic_add_fetch(&ref->ref, 1, __ATOMIC_RELAXED);
+
+        return seg;
+}
+
+/* a share holds its own reference, no need for a deep copy */
+inline int INLINE seg_counted(const seg_t *seg)
+{
+        return seg->sop == &__sop_chunk__ || seg->sop == &__sop_ref__;
+}
+
+/* the memory stays valid for as long as the segment lives */
+int seg_owned(const seg_t *seg)
+{
+        if (seg_counted(seg))
+                return 1;
+
+        return seg->sop != &__sop_ext__ && !seg->shared;
+}
+
+seg_t S_LTG *seg_chunk_create(ltgbuf_t *buf, void *chunk, void *data, uint32_t size)
+{
+        seg_t *seg;
+
+        seg = __seg_alloc_head(buf, size, 0);
+
+        seg->sop = &__sop_chunk__;
+
+        seg->handler.ptr = data;
+        seg->handler.phyaddr = 0;
+
+        seg->chunk.chunk = chunk;
+        mem_chunk_ref(chunk);
+
+        return seg;
+}
+
 /*seg hugepage object*/
 
 #if ENABLE_HUGEPAGE
@@ -417,6 +543,20 @@ static void __seg_ext_init(seg_ops_t *sop)
         sop->seg_trans = __seg_ext_trans;
 }
 
+static void __seg_chunk_init(seg_ops_t *sop)
+{
+        sop->seg_free = __seg_chunk_free;
+        sop->seg_share = __seg_chunk_share;
+        sop->seg_trans = __seg_chunk_trans;
+}
+
+static void __seg_ref_init(seg_ops_t *sop)
+{
+        sop->seg_free = __seg_ref_free;
+        sop->seg_share = __seg_ref_share;
+        sop->seg_trans = __seg_ref_trans;
+}
+
 static void __seg_solid_init(seg_ops_t *sop)
 {
         sop->seg_free = __seg_solid_free;
@@ -430,4 +570,6 @@ void seg_init()
         __seg_sys_init(&__sop_sys__);
         __seg_ext_init(&__sop_ext__);
         __seg_solid_init(&__sop_solid__);
+        __seg_chunk_init(&__sop_chunk__);
+        __seg_ref_init(&__sop_ref__);
 }
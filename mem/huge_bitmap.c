@@ -0,0 +1,152 @@
+#include "ltg_utils.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "mem/huge_bitmap.h"
+
+#define PAIR_MASK 0x5555555555555555ULL
+
+struct mem_alloc mem_bitmap;
+
+static inline void *__bitmap_start(void *bitmap_addr)
+{
+        return (void *)((uint64_t)bitmap_addr & (~(((uint64_t)1 << 21) - 1))) + HUGEPAGE_SIZE;
+}
+
+int bitmap_init(void *bitmap_addr, uint32_t page_num)
+{
+        huge_bitmap_t *bitmap = bitmap_addr;
+        uint32_t i, tail;
+
+        bitmap->nr_total = page_num;
+        bitmap->nr_word = (page_num + 63) / 64;
+        bitmap->nr_alloc = 0;
+
+        for (i = 0; i < HUGE_BITMAP_CLASS; i++) {
+                bitmap->hint[i] = 0;
+        }
+
+        memset(bitmap->bitmap, 0x0, sizeof(uint64_t) * bitmap->nr_word);
+
+        /* pages past the end are never handed out */
+        tail = page_num % 64;
+        if (tail) {
+                bitmap->bitmap[bitmap->nr_word - 1] = ~((1ULL << tail) - 1);
+        }
+
+        mem_bitmap.max_alloc_size = MAX_ALLOC_SIZE;
+
+        HUGE_BITMAP_DUMP_L(DINFO, bitmap, "\n");
+
+        return 0;
+}
+
+/* free bits of word w that can hold count pages */
+static inline uint64_t __bitmap_candidate(uint64_t w, int count)
+{
+        uint64_t free = ~w;
+
+        if (count == 1)
+                return free;
+        else
+                return free & (free >> 1) & PAIR_MASK;
+}
+
+static int __bitmap_alloc(huge_bitmap_t *bitmap, int count)
+{
+        uint32_t i, idx, start;
+        uint64_t old, new, candidate, mask;
+        int bit, cls = count - 1;
+
+        start = bitmap->hint[cls];
+        for (i = 0; i < bitmap->nr_word; i++) {
+                idx = (start + i) % bitmap->nr_word;
+
+                old = __atomic_load_n(&bitmap->bitmap[idx], __ATOMIC_ACQUIRE);
+                while (1) {
+                        candidate = __bitmap_candidate(old, count);
+                        if (candidate == 0)
+                                break;
+
+                        bit = __builtin_ctzll(candidate);
+                        mask = ((1ULL << count) - 1) << bit;
+                        new = old | mask;
+
+                        if (__atomic_compare_exchange_n(&bitmap->bitmap[idx], &old, new,
+                                                        0, __ATOMIC_ACQ_REL,
+                                                        __ATOMIC_ACQUIRE)) {
+                                if (idx != start)
+                                        __atomic_store_n(&bitmap->hint[cls], idx,
+                                                         __ATOMIC_RELAXED);
+
+                                __atomic_add_fetch(&bitmap->nr_alloc, count,
+                                                   __ATOMIC_RELAXED);
+
+                                return idx * 64 + bit;
+                        }
+
+                        /* old was reloaded by the failed cas */
+                }
+        }
+
+        return -1;
+}
+
+int bitmap_alloc(void *bitmap_addr, void **_addr, uint32_t *size)
+{
+        huge_bitmap_t *bitmap = bitmap_addr;
+        uint32_t req_size = _min(*size, mem_bitmap.max_alloc_size);
+        int offset;
+
+        offset = __bitmap_alloc(bitmap, req_size >> 21);
+        if (unlikely(offset < 0)) {
+                HUGE_BITMAP_DUMP_L(DWARN, bitmap, "alloc %u\n", *size);
+                return ENOMEM;
+        }
+
+        *size = req_size;
+        *_addr = __bitmap_start(bitmap_addr) + (uint64_t)offset * HUGEPAGE_SIZE;
+
+        DBUG("bitmap alloc addr %p size %u\n", *_addr, *size);
+
+        return 0;
+}
+
+int bitmap_free(void *bitmap_addr, void *free_addr, uint32_t size)
+{
+        huge_bitmap_t *bitmap = bitmap_addr;
+        uint64_t offset, mask, old;
+        int count = size >> 21;
+
+        offset = (free_addr - __bitmap_start(bitmap_addr)) / HUGEPAGE_SIZE;
+        LTG_ASSERT(offset + count <= bitmap->nr_total);
+
+        mask = ((1ULL << count) - 1) << (offset % 64);
+        old = __atomic_fetch_and(&bitmap->bitmap[offset / 64], ~mask,
+                                 __ATOMIC_RELEASE);
+        LTG_ASSERT((old & mask) == mask);
+        (void) old;
+
+        __atomic_sub_fetch(&bitmap->nr_alloc, count, __ATOMIC_RELAXED);
+
+        DBUG("bitmap free addr %p size %u\n", free_addr, size);
+
+        return 0;
+}
+
+void bitmap_memalloc_reg()
+{
+        suzaku_mem_alloc_register(&mem_bitmap);
+}
+
+struct mem_alloc mem_bitmap = {
+        .type = 0,
+        .lockless = 1,
+        .init = bitmap_init,
+        .alloc = bitmap_alloc,
+        .free = bitmap_free
+};
@@ -19,24 +19,53 @@
 //this will used for future, flexiable swith between ymalloc.
 struct mem_alloc mem_buddy;
 
+uint32_t buddy_total(uint32_t page_num)
+{
+        uint32_t total = 1;
+
+        while (total < page_num)
+                total *= 2;
+
+        return total;
+}
+
+/* mark a leaf as used, for pages past the end of a non power of 2 pool */
+static void __buddy_reserve(struct buddy *buddy, uint32_t offset)
+{
+        size_t index = offset + buddy->nr_total - 1;
+
+        buddy->buddy_trees[index] = 0;
+
+        while (index) {
+                index = PARENT(index);
+                buddy->buddy_trees[index] = MAX(buddy->buddy_trees[LEFT_LEAF(index)],
+                                                buddy->buddy_trees[RIGHT_LEAF(index)]);
+        }
+}
+
 int buddy_init(void *buddy_addr, uint32_t page_num)
 {
         struct buddy *buddy = (struct buddy *)buddy_addr;
         size_t i;
         size_t node_size;
+        uint32_t total = buddy_total(page_num);
 
-        buddy->nr_total = page_num;
+        buddy->nr_total = total;
         buddy->nr_alloc = 0;
 
-        node_size = (size_t)page_num * 2;
+        node_size = (size_t)total * 2;
 
-        for (i = 0; i < page_num * 2 - 1; i++) {
+        for (i = 0; i < total * 2 - 1; i++) {
                 if (IS_POWER_OF_2(i + 1))
                         node_size /= 2;
 
                 buddy->buddy_trees[i] = node_size;
         }
 
+        for (i = page_num; i < total; i++) {
+                __buddy_reserve(buddy, i);
+        }
+
         mem_buddy.max_alloc_size = MAX_ALLOC_SIZE;
 
         BUDDY_DUMP_L(DINFO, buddy, "\n");
@@ -141,9 +170,12 @@ int __buddy_free(void *buddy_addr, uint32_t offset)
 
 int buddy_free(void *buddy_addr, void *free_addr, uint32_t size)
 {
-        (void)buddy_addr;
-        (void)free_addr;
-        (void)size;
+        struct buddy *buddy = (struct buddy *)buddy_addr;
+        void *start_addr = (void *)((uint64_t)buddy_addr & (~(((uint64_t)1 << 21) -1))) + HUGEPAGE_SIZE;
+
+        __buddy_free(buddy_addr, (free_addr - start_addr) / HUGEPAGE_SIZE);
+        buddy->nr_alloc -= size >> 21;
+
         return 0;
 }
 
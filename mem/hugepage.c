@@ -1,5 +1,6 @@
 #include <numaif.h>
 #include <sys/mman.h>
+#include <linux/memfd.h>
 
 #define DBG_SUBSYS S_LTG_MEM
 
@@ -16,16 +17,19 @@ typedef struct {
         void             *private_hp_head[CORE_MAX]; /*polling core hugepage head*/
 
         int              hash;
+        int              node_id;
         int              hugepage_count;
         int              nr_alloc;
+        int              pressure;
 } hugepage_head_t;
 
 #define HUGEPAGE_HEAD_DUMP_L(LEVEL, head, format, a...) do { \
-    LEVEL("hugepage head %p addr %p %p hash %d count %d/%d  "format, \
+    LEVEL("hugepage head %p addr %p %p hash %d node %d count %d/%d  "format, \
           (head),  \
           (head)->malloc_addr,  \
           (head)->start_addr,  \
           (head)->hash,  \
+          (head)->node_id,  \
           (head)->hugepage_count,  \
           (head)->nr_alloc,  \
           ##a \
@@ -42,6 +46,25 @@ static int __use_huge__ = 0;
 static int PRIVATE_HP_COUNT = 0;
 static int PUBLIC_HP_COUNT = 0;
 
+/* memfd backend, see __hugepage_memfd_map */
+#define HUGEPAGE_1G_SIZE (1024UL * 1024 * 1024)
+#define HUGEPAGE_NODE_MAX 64
+
+#ifndef MFD_HUGE_2MB
+#define MFD_HUGE_2MB (21U << 26)
+#endif
+
+#ifndef MFD_HUGE_1GB
+#define MFD_HUGE_1GB (30U << 26)
+#endif
+
+static int __use_memfd__ = 0;
+static size_t __memfd_page_size__ = HUGEPAGE_SIZE;
+/* private pools stay PROT_NONE until their core ran hugepage_private_init */
+static int __hugepage_private_ready__[CORE_MAX];
+
+static void __hugepage_residency_dump(int hash, const char *caller);
+
 static void __hugepage_head_init(hugepage_head_t *head, void *mem, void *addr,
                                  int hp_count, int sockid)
 {
@@ -60,6 +83,8 @@ static void __hugepage_head_init(hugepage_head_t *head, void *mem, void *addr,
 
         head->malloc_addr = mem;
         head->hash = -1;
+        head->node_id = sockid;
+        head->pressure = 0;
         
         int ret = ltg_spin_init(&head->lock);
         LTG_ASSERT(ret == 0);
@@ -96,6 +121,70 @@ err_ret:
         return ret;
 }
 
+/*
+ * map a memfd backed hugetlb file at addr, the range was reserved by
+ * hugepage_init. the policy is set before the first touch so every page
+ * is faulted on sockid, size need not be a power of 2.
+ */
+static int __hugepage_memfd_map(void *addr, size_t size, int sockid, const char *name)
+{
+        int ret, fd;
+        void *map_ret;
+        unsigned long nodemask;
+        unsigned int flag;
+
+        flag = MFD_CLOEXEC | MFD_HUGETLB;
+        flag |= (__memfd_page_size__ == HUGEPAGE_1G_SIZE) ? MFD_HUGE_1GB : MFD_HUGE_2MB;
+
+        fd = memfd_create(name, flag);
+        if (fd < 0) {
+                ret = errno;
+                DERROR("memfd %s create fail, %s\n", name, strerror(ret));
+                GOTO(err_ret, ret);
+        }
+
+        ret = ftruncate(fd, size);
+        if (ret < 0) {
+                ret = errno;
+                GOTO(err_close, ret);
+        }
+
+        map_ret = mmap(addr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED, fd, 0);
+        if (map_ret == MAP_FAILED) {
+                ret = errno;
+                DERROR("memfd %s map %p size %ju fail, %s\n", name, addr,
+                       size, strerror(ret));
+                GOTO(err_close, ret);
+        }
+
+        if (sockid >= 0) {
+                nodemask = 1UL << sockid;
+                ret = mbind(addr, size, MPOL_BIND, &nodemask,
+                            sizeof(nodemask) * 8, MPOL_MF_STRICT);
+                if (ret < 0) {
+                        ret = errno;
+                        DERROR("memfd %s bind node %d fail, %s\n", name,
+                               sockid, strerror(ret));
+                        GOTO(err_unmap, ret);
+                }
+        }
+
+        close(fd);
+
+        DINFO("memfd %s addr %p size %ju page %ju node %d\n", name, addr,
+              size, __memfd_page_size__, sockid);
+
+        return 0;
+err_unmap:
+        mmap(addr, size, PROT_NONE,
+             MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+err_close:
+        close(fd);
+err_ret:
+        return ret;
+}
+
 static void __hugepage_init(void *addr, int sockid)
 {
         unsigned long int  sock;
@@ -126,19 +215,38 @@ void *hugepage_private_init(int hash, int sockid)
         DINFO("hash %d head addr %p\n", hash, addr);
         head = (hugepage_head_t *)addr;
 
-        __hugepage_head_init(head, NULL, addr, PRIVATE_HP_COUNT, sockid);
+        if (__use_memfd__) {
+                char name[MAX_NAME_LEN];
+
+                snprintf(name, MAX_NAME_LEN, "ltg_hugepage_%d", hash);
+                int ret = __hugepage_memfd_map(addr,
+                                               ((size_t)PRIVATE_HP_COUNT + 1) * HUGEPAGE_SIZE,
+                                               sockid, name);
+                if (unlikely(ret)) {
+                        DERROR("core[%d] private hugepage fail\n", hash);
+                        EXIT(ret);
+                }
+        }
+
+        /* memfd pool already bound, MPOL_PREFERRED here would relax it */
+        int bind = __use_memfd__ ? -1 : sockid;
+
+        __hugepage_head_init(head, NULL, addr, PRIVATE_HP_COUNT, bind);
 
         for (i = 0; i < PRIVATE_HP_COUNT; i++) {
                 addr += HUGEPAGE_SIZE;
-                __hugepage_init(addr, sockid);
+                __hugepage_init(addr, bind);
         }
 
         head->hash = hash;
+        head->node_id = sockid;
+        __atomic_store_n(&__hugepage_private_ready__[hash], 1, __ATOMIC_RELEASE);
 
         __private_huge__ = head;
         hugepage_alloc_ops->init((void *)head + sizeof(*head), PRIVATE_HP_COUNT);
 
         HUGEPAGE_HEAD_DUMP_L(DINFO, head, "\n");
+        __hugepage_residency_dump(hash, __FUNCTION__);
         return head;
 }
 
@@ -175,6 +283,82 @@ static void __hugepage_init_private(hugepage_head_t *head, void *private)
         }
 }
 
+static void __hugepage_meta_check(int count)
+{
+        LTG_ASSERT(sizeof(hugepage_head_t) + BUDDY_SIZE(buddy_total(count) * 2)
+                   <= HUGEPAGE_SIZE);
+        LTG_ASSERT(sizeof(hugepage_head_t) + HUGE_BITMAP_SIZE(count)
+                   <= HUGEPAGE_SIZE);
+}
+
+/*
+ * reserve the whole range first so public and private pools stay in one
+ * region, rdma registers it as a single mr (get_global_private_mem).
+ * private pools are mapped later by the owner core in hugepage_private_init.
+ */
+static int __hugepage_init_memfd(uint64_t coremask, int nr_hugepage)
+{
+        int ret, poll_num = 0;
+        size_t page_size, public_size, private_size, mem_size;
+        void *mem, *addr;
+        hugepage_head_t *head;
+
+        page_size = ltgconf_global.hugepage_1g ? HUGEPAGE_1G_SIZE : HUGEPAGE_SIZE;
+
+        __use_memfd__ = 1;
+        __memfd_page_size__ = page_size;
+        __use_huge__ = nr_hugepage;
+
+        /* round each pool up to the backing page, the tail is used too */
+        public_size = round_up(((size_t)_max(nr_hugepage / 2, 1) + 1) * HUGEPAGE_SIZE,
+                               page_size);
+        private_size = round_up(((size_t)nr_hugepage + 1) * HUGEPAGE_SIZE,
+                                page_size);
+        PUBLIC_HP_COUNT = public_size / HUGEPAGE_SIZE - 1;
+        PRIVATE_HP_COUNT = private_size / HUGEPAGE_SIZE - 1;
+
+        __hugepage_meta_check(PUBLIC_HP_COUNT);
+        __hugepage_meta_check(PRIVATE_HP_COUNT);
+
+        for (int i = 0; i < CORE_MAX; i++) {
+                if (core_usedby(coremask, i))
+                        poll_num++;
+        }
+
+        mem_size = public_size + private_size * poll_num;
+
+        DINFO("memfd private_hp_count %d public_hp_count %d poll_num %d"
+              " size %ju page %ju\n", PRIVATE_HP_COUNT, PUBLIC_HP_COUNT,
+              poll_num, mem_size, page_size);
+
+        mem = mmap(NULL, mem_size + page_size, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mem == MAP_FAILED) {
+                ret = errno;
+                GOTO(err_ret, ret);
+        }
+
+        addr = (void *)_align_up((uintptr_t)mem, page_size);
+
+        ret = __hugepage_memfd_map(addr, public_size, -1, "ltg_hugepage_public");
+        if (unlikely(ret))
+                GOTO(err_free, ret);
+
+        head = addr;
+        __hugepage_head_init(head, mem, addr, mem_size / HUGEPAGE_SIZE - 1, -1);
+
+        __hugepage_init_public(head, addr + HUGEPAGE_SIZE);
+        hugepage_alloc_ops->init((void *)head + sizeof(*head), PUBLIC_HP_COUNT);
+
+        __hugepage_init_private(head, addr + public_size);
+
+        return 0;
+err_free:
+        munmap(mem, mem_size + page_size);
+err_ret:
+        return ret;
+}
+
 int hugepage_init(int daemon, uint64_t coremask, int nr_hugepage)
 { 
         int ret, hp_count, poll_num = 0;
@@ -187,9 +371,15 @@ int hugepage_init(int daemon, uint64_t coremask, int nr_hugepage)
                 posix_memalloc_reg();
                 hugepage_alloc_ops->init(NULL, 0);
                 return 0;
+        } else if (ltgconf_global.hugepage_bitmap) {
+                bitmap_memalloc_reg();
         } else {
                 buddy_memalloc_reg();
         }
+
+        if (ltgconf_global.hugepage_memfd) {
+                return __hugepage_init_memfd(coremask, nr_hugepage);
+        }
         
         __use_huge__ = nr_hugepage;
         PRIVATE_HP_COUNT = nr_hugepage;
@@ -264,7 +454,7 @@ void private_hugepage_free(void *addr)
         return ;
 }
 
-int hugepage_getfree(void **_addr, uint32_t *size, const char *caller)
+int hugepage_getfree(void **_addr, uint32_t *size, int tag, const char *caller)
 {
         int ret;
         hugepage_head_t *head = __private_huge__ ? __private_huge__ : __hugepage__;
@@ -277,21 +467,83 @@ int hugepage_getfree(void **_addr, uint32_t *size, const char *caller)
                 if (ret)
                         GOTO(err_ret, ret);
         } else {
-                if (unlikely(head == __hugepage__))
+                int lock = (head == __hugepage__) && !hugepage_alloc_ops->lockless;
+
+                if (unlikely(lock))
                         ltg_spin_lock(&head->lock);
 
                 ret = hugepage_alloc_ops->alloc((void *)head + sizeof(*head), _addr, size);
-                if (ret)
+                if (ret) {
+                        if (unlikely(lock))
+                                ltg_spin_unlock(&head->lock);
                         GOTO(err_ret, ret);
+                }
 
-                head->nr_alloc += *size / HUGEPAGE_SIZE;
+                __atomic_add_fetch(&head->nr_alloc, *size / HUGEPAGE_SIZE,
+                                   __ATOMIC_RELAXED);
 
                 HUGEPAGE_HEAD_DUMP_L(DINFO, head, "caller %s size %u\n", caller, *size);
 
-                if (unlikely(head == __hugepage__))
+                if (unlikely(lock))
                         ltg_spin_unlock(&head->lock);
         }
 
+        mem_stat_add(tag, *size);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static int __hugepage_public(const hugepage_head_t *head, const void *addr)
+{
+        return addr >= (void *)head
+                && addr < (void *)head + ((size_t)PUBLIC_HP_COUNT + 1) * HUGEPAGE_SIZE;
+}
+
+/* give pages back to the pool they came from */
+int hugepage_putfree(void *addr, uint32_t size, int tag, const char *caller)
+{
+        int ret;
+        hugepage_head_t *head;
+
+        if (size % HUGEPAGE_SIZE)
+                return EINVAL;
+
+        if (__hugepage__ == NULL) {
+                ret = hugepage_alloc_ops->free(NULL, addr, size);
+                if (ret)
+                        GOTO(err_ret, ret);
+
+                mem_stat_sub(tag, size);
+
+                return 0;
+        }
+
+        head = __hugepage_public(__hugepage__, addr) ? __hugepage__ : __private_huge__;
+        LTG_ASSERT(head);
+
+        int lock = (head == __hugepage__) && !hugepage_alloc_ops->lockless;
+
+        if (unlikely(lock))
+                ltg_spin_lock(&head->lock);
+
+        ret = hugepage_alloc_ops->free((void *)head + sizeof(*head), addr, size);
+        if (ret) {
+                if (unlikely(lock))
+                        ltg_spin_unlock(&head->lock);
+                GOTO(err_ret, ret);
+        }
+
+        __atomic_sub_fetch(&head->nr_alloc, size / HUGEPAGE_SIZE, __ATOMIC_RELAXED);
+
+        HUGEPAGE_HEAD_DUMP_L(DINFO, head, "caller %s size %u\n", caller, size);
+
+        if (unlikely(lock))
+                ltg_spin_unlock(&head->lock);
+
+        mem_stat_sub(tag, size);
+
         return 0;
 err_ret:
         return ret;
@@ -310,6 +562,32 @@ int hugepage_get()
         return 0;
 }
 
+/*
+ * pool pressure for reclaim, on below 1/16 free and off above 1/8 free so
+ * the callers do not flap around a single threshold.
+ */
+int hugepage_pressure()
+{
+        int total, left;
+        hugepage_head_t *head = __private_huge__ ? __private_huge__ : __hugepage__;
+
+        if (head == NULL)
+                return 0;
+
+        total = (head == __hugepage__) ? PUBLIC_HP_COUNT : head->hugepage_count;
+        left = total - head->nr_alloc;
+
+        if (head->pressure) {
+                if (left > total / 8)
+                        head->pressure = 0;
+        } else {
+                if (left < total / 16)
+                        head->pressure = 1;
+        }
+
+        return head->pressure;
+}
+
 void hugepage_show(const char *caller)
 {
         hugepage_head_t *head = __private_huge__ ? __private_huge__ : __hugepage__;
@@ -343,3 +621,110 @@ void get_global_private_mem(void **private_mem, uint64_t *private_mem_size)
         *private_mem = __hugepage__->start_addr;
         *private_mem_size = ((uint64_t)__hugepage__->hugepage_count) * HUGEPAGE_SIZE;
 }
+
+static hugepage_head_t *__hugepage_head_get(int hash)
+{
+        if (__hugepage__ == NULL)
+                return NULL;
+
+        if (hash < 0)
+                return __hugepage__;
+
+        if (hash >= CORE_MAX
+            || !__atomic_load_n(&__hugepage_private_ready__[hash], __ATOMIC_ACQUIRE))
+                return NULL;
+
+        return __hugepage__->private_hp_head[hash];
+}
+
+/*
+ * count where the pages of a pool actually live, hash -1 for the public
+ * pool. node_count[node] is in HUGEPAGE_SIZE units.
+ */
+int hugepage_residency(int hash, uint32_t *node_count, int node_max)
+{
+        int ret, i, j, count, left;
+        void *pages[64];
+        int status[64];
+        hugepage_head_t *head;
+        void *addr;
+
+        head = __hugepage_head_get(hash);
+        if (head == NULL || head->hash != hash) {
+                ret = ENOENT;
+                GOTO(err_ret, ret);
+        }
+
+        memset(node_count, 0x0, sizeof(*node_count) * node_max);
+
+        addr = head;
+        left = (hash < 0 ? PUBLIC_HP_COUNT : head->hugepage_count) + 1;
+        while (left) {
+                count = _min(left, 64);
+                for (i = 0; i < count; i++) {
+                        pages[i] = addr;
+                        addr += HUGEPAGE_SIZE;
+                }
+
+                ret = move_pages(0, count, pages, NULL, status, 0);
+                if (ret < 0) {
+                        ret = errno;
+                        GOTO(err_ret, ret);
+                }
+
+                for (j = 0; j < count; j++) {
+                        if (status[j] >= 0 && status[j] < node_max)
+                                node_count[status[j]]++;
+                }
+
+                left -= count;
+        }
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static void __hugepage_residency_dump(int hash, const char *caller)
+{
+        int ret, node, len, nr_node;
+        uint32_t node_count[HUGEPAGE_NODE_MAX];
+        char buf[MAX_BUF_LEN];
+        hugepage_head_t *head;
+
+        head = __hugepage_head_get(hash);
+        if (head == NULL)
+                return;
+
+        ret = hugepage_residency(hash, node_count, HUGEPAGE_NODE_MAX);
+        if (unlikely(ret))
+                return;
+
+        len = 0;
+        buf[0] = '\0';
+        nr_node = 0;
+        for (node = 0; node < HUGEPAGE_NODE_MAX; node++) {
+                if (node_count[node] == 0)
+                        continue;
+
+                len += snprintf(buf + len, MAX_BUF_LEN - len, " node%d:%u",
+                                node, node_count[node]);
+                nr_node++;
+        }
+
+        if (head->node_id >= 0 && head->node_id < HUGEPAGE_NODE_MAX
+            && (nr_node > 1 || node_count[head->node_id] == 0)) {
+                DWARN("caller %s core[%d] want node %d, resident%s\n",
+                      caller, hash, head->node_id, buf);
+        } else {
+                DINFO("caller %s core[%d] want node %d, resident%s\n",
+                      caller, hash, head->node_id, buf);
+        }
+}
+
+void hugepage_residency_dump(const char *caller)
+{
+        for (int i = -1; i < CORE_MAX; i++) {
+                __hugepage_residency_dump(i, caller);
+        }
+}
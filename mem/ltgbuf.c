@@ -484,6 +484,23 @@ inline int INLINE ltgbuf_initwith2(ltgbuf_t *buf, struct iovec *iov, int count,
         return 0;
 }
 
+/* the buffer points into data and holds a reference on it */
+int ltgbuf_initref(ltgbuf_t *buf, void *data, uint32_t size, mem_ref_t *ref)
+{
+        seg_t *seg;
+
+        buf->len = 0;
+        buf->used = 0;
+        INIT_LIST_HEAD(&buf->list);
+
+        seg = seg_ref_create(buf, ref, data, size);
+
+        seg_add_tail(buf, seg);
+        BUFFER_CHECK(buf);
+
+        return 0;
+}
+
 inline int INLINE ltgbuf_init(ltgbuf_t *buf, uint32_t size)
 {
         seg_t *seg;
@@ -579,7 +596,7 @@ int S_LTG ltgbuf_pop1(ltgbuf_t *buf, ltgbuf_t *newbuf, uint32_t len, int deep)
                         DBUG("pop %u from %u\n", min, seg->len);
 
                         if (newbuf) {
-                                if (deep) {
+                                if (deep && !seg_counted(seg)) {
                                         int ret = ltgbuf_appendmem(newbuf,
                                                                     seg->handler.ptr,
                                                                     min);
@@ -1429,3 +1446,41 @@ inline int INLINE ltgbuf_aligned(const ltgbuf_t *buf, int align)
 
         return 1;
 }
+
+/* length of the leading segments that own their memory */
+uint32_t ltgbuf_owned(const ltgbuf_t *buf)
+{
+        struct list_head *pos;
+        seg_t *seg;
+        uint32_t len = 0;
+
+        list_for_each(pos, &buf->list) {
+                seg = (seg_t *)pos;
+
+                if (!seg_owned(seg))
+                        break;
+
+                len += seg->len;
+        }
+
+        return len;
+}
+
+/* the largest length not above len that ends on a segment boundary */
+uint32_t ltgbuf_segfloor(const ltgbuf_t *buf, uint32_t len)
+{
+        struct list_head *pos;
+        seg_t *seg;
+        uint32_t floor = 0;
+
+        list_for_each(pos, &buf->list) {
+                seg = (seg_t *)pos;
+
+                if (floor + seg->len > len)
+                        break;
+
+                floor += seg->len;
+        }
+
+        return floor;
+}
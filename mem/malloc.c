@@ -6,6 +6,7 @@
 #include <string.h>
 #include <errno.h>
 #include <numaif.h>
+#include <malloc.h>
 
 #define DBG_SUBSYS S_LTG_MEM
 
@@ -59,6 +60,15 @@ static void __free__(void *mem)
 #endif
 }
 
+static inline size_t __malloc_size__(void *mem)
+{
+#if ENABLE_JEM
+        return je_malloc_usable_size(mem);
+#else
+        return malloc_usable_size(mem);
+#endif
+}
+
 void __ltg_malloc_bind(void *ptr, size_t size)
 {
 
@@ -87,6 +97,7 @@ int ltg_malign(void **_ptr, size_t align, size_t size)
                 ptr = __memalign__(align, size);
                 if (ptr != NULL) {
                         __ltg_malloc_bind(ptr, size);
+                        mem_stat_add(MEM_TAG_MALLOC, __malloc_size__(ptr));
 
                         *_ptr = ptr;
                         return 0;
@@ -98,6 +109,11 @@ int ltg_malign(void **_ptr, size_t align, size_t size)
 
 
 int S_LTG ltg_malloc(void **_ptr, size_t size)
+{
+        return ltg_malloc_tag(_ptr, size, MEM_TAG_MALLOC);
+}
+
+int S_LTG ltg_malloc_tag(void **_ptr, size_t size, int tag)
 {
         int ret, i;
         void *ptr = NULL;
@@ -120,6 +136,7 @@ int S_LTG ltg_malloc(void **_ptr, size_t size)
                 ptr = __calloc__(1, size);
                 if (ptr != NULL) {
                         __ltg_malloc_bind(ptr, size);
+                        mem_stat_add(tag, __malloc_size__(ptr));
                         
                         goto out;
                 }
@@ -145,6 +162,7 @@ void *ltg_malloc1(size_t size)
         
         if (ptr) {
                 __ltg_malloc_bind(ptr, size);
+                mem_stat_add(MEM_TAG_MALLOC, __malloc_size__(ptr));
         }
 
         return ptr;
@@ -152,6 +170,12 @@ void *ltg_malloc1(size_t size)
 
 
 inline int ltg_realloc(void **_ptr, size_t size, size_t newsize)
+{
+        return ltg_realloc_tag(_ptr, size, newsize, MEM_TAG_MALLOC);
+}
+
+/* the tag must be the one the buffer was allocated with */
+int ltg_realloc_tag(void **_ptr, size_t size, size_t newsize, int tag)
 {
         int ret, i;
         void *ptr;
@@ -159,7 +183,7 @@ inline int ltg_realloc(void **_ptr, size_t size, size_t newsize)
         DBUG("mem %u\n", (int)size);
         
         if (*_ptr == NULL && size == 0) /*malloc*/ {
-                ret = ltg_malloc(&ptr, newsize);
+                ret = ltg_malloc_tag(&ptr, newsize, tag);
                 if (ret)
                         GOTO(err_ret, ret);
 
@@ -170,7 +194,7 @@ inline int ltg_realloc(void **_ptr, size_t size, size_t newsize)
         }
 
         if (newsize == 0)
-                return ltg_free(_ptr);
+                return ltg_free_tag(_ptr, tag);
 
         if (newsize < size) {
                 ptr = *_ptr;
@@ -182,11 +206,16 @@ inline int ltg_realloc(void **_ptr, size_t size, size_t newsize)
                 newsize = sizeof(struct list_head);
 #endif
 
+        size_t oldsize = *_ptr ? __malloc_size__(*_ptr) : 0;
+
         ret = ENOMEM;
         for (i = 0; i < 3; i++) {
                 ptr = realloc(*_ptr, newsize);
                 if (ptr != NULL) {
                         __ltg_malloc_bind(ptr, newsize);
+                        if (oldsize)
+                                mem_stat_sub(tag, oldsize);
+                        mem_stat_add(tag, __malloc_size__(ptr));
                         goto out;
                 }
         }
@@ -204,8 +233,14 @@ err_ret:
 }
 
 int ltg_free(void **ptr)
+{
+        return ltg_free_tag(ptr, MEM_TAG_MALLOC);
+}
+
+int ltg_free_tag(void **ptr, int tag)
 {
         if (*ptr != NULL) {
+                mem_stat_sub(tag, __malloc_size__(*ptr));
                 __free__(*ptr);
         } else {
                 LTG_ASSERT(0);
@@ -218,6 +253,9 @@ int ltg_free(void **ptr)
 
 void ltg_free1(void *ptr)
 {
+        if (ptr)
+                mem_stat_sub(MEM_TAG_MALLOC, __malloc_size__(ptr));
+
         free(ptr);
 }
 
@@ -0,0 +1,326 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define DBG_SUBSYS S_LTG_MEM
+
+#include "ltg_utils.h"
+#include "ltg_mem.h"
+#include "core/core.h"
+
+#define CHUNK_PER_PAGE (HUGEPAGE_SIZE / MEM_CHUNK_SIZE)
+
+typedef struct __mem_chunk_pool {
+        int hash;
+        uint32_t page;
+        uint32_t count;
+        mem_chunk_t *free;
+        uint64_t used;
+        uint64_t get;
+
+        /* pushed by other threads, kept off the owner's line */
+        mem_chunk_t *remote __attribute__((__aligned__(CACHE_LINE_SIZE)));
+        uint64_t nr_remote;
+} mem_chunk_pool_t;
+
+static mem_chunk_pool_t *__mem_chunk_core__[CORE_MAX];
+static __thread mem_chunk_pool_t *__mem_chunk__;
+
+int mem_chunk_private_init(int hash)
+{
+        int ret;
+        mem_chunk_pool_t *pool;
+
+        LTG_ASSERT(hash >= 0 && hash < CORE_MAX);
+        LTG_ASSERT(__mem_chunk__ == NULL);
+
+        ret = ltg_malign((void **)&pool, CACHE_LINE_SIZE, sizeof(*pool));
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        memset(pool, 0x0, sizeof(*pool));
+        pool->hash = hash;
+
+        __mem_chunk__ = pool;
+        __mem_chunk_core__[hash] = pool;
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+/* pages are taken on demand and kept for the life of the core */
+static int __mem_chunk_grow(mem_chunk_pool_t *pool)
+{
+        int ret;
+        void *addr;
+        uint32_t size = HUGEPAGE_SIZE;
+        mem_chunk_t *array;
+
+        ret = hugepage_getfree(&addr, &size, MEM_TAG_CHUNK, __FUNCTION__);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        ret = ltg_malloc((void **)&array, sizeof(*array) * CHUNK_PER_PAGE);
+        if (unlikely(ret))
+                GOTO(err_free, ret);
+
+        for (int i = CHUNK_PER_PAGE - 1; i >= 0; i--) {
+                array[i].ptr = addr + (size_t)MEM_CHUNK_SIZE * i;
+                array[i].pool = pool;
+                array[i].ref = 0;
+                array[i].next = pool->free;
+                pool->free = &array[i];
+        }
+
+        pool->page++;
+        pool->count += CHUNK_PER_PAGE;
+
+        DBUG("chunk pool[%d] page %u count %u\n", pool->hash, pool->page,
+             pool->count);
+
+        return 0;
+err_free:
+        hugepage_putfree(addr, HUGEPAGE_SIZE, MEM_TAG_CHUNK, __FUNCTION__);
+err_ret:
+        return ret;
+}
+
+mem_chunk_t *mem_chunk_get()
+{
+        int ret;
+        mem_chunk_pool_t *pool = __mem_chunk__;
+        mem_chunk_t *chunk;
+
+        if (unlikely(pool == NULL))
+                return NULL;
+
+        if (unlikely(pool->free == NULL)) {
+                pool->free = __atomic_exchange_n(&pool->remote, NULL,
+                                                 __ATOMIC_ACQUIRE);
+                if (pool->free == NULL) {
+                        ret = __mem_chunk_grow(pool);
+                        if (unlikely(ret))
+                                return NULL;
+                }
+        }
+
+        chunk = pool->free;
+        pool->free = chunk->next;
+        chunk->ref = 1;
+        pool->used++;
+        pool->get++;
+
+        return chunk;
+}
+
+inline void INLINE mem_chunk_ref(mem_chunk_t *chunk)
+{
+        LTG_ASSERT(chunk->ref > 0);
+        __atomic_add_fetch(&chunk->ref, 1, __ATOMIC_RELAXED);
+}
+
+inline void INLINE mem_chunk_put(mem_chunk_t *chunk)
+{
+        mem_chunk_pool_t *pool = chunk->pool;
+
+        if (__atomic_sub_fetch(&chunk->ref, 1, __ATOMIC_ACQ_REL))
+                return;
+
+        if (likely(pool == __mem_chunk__)) {
+                chunk->next = pool->free;
+                pool->free = chunk;
+                pool->used--;
+        } else {
+                chunk->next = __atomic_load_n(&pool->remote, __ATOMIC_RELAXED);
+                while (!__atomic_compare_exchange_n(&pool->remote, &chunk->next,
+                                                    chunk, 0, __ATOMIC_RELEASE,
+                                                    __ATOMIC_RELAXED)) {
+                }
+
+                __atomic_add_fetch(&pool->nr_remote, 1, __ATOMIC_RELAXED);
+        }
+}
+
+static int __mem_chunk_rx_fill(mem_chunk_rx_t *rx, struct iovec *iov, int *_count,
+                               int want)
+{
+        mem_chunk_t *chunk;
+
+        while (rx->count < want) {
+                chunk = mem_chunk_get();
+                if (unlikely(chunk == NULL))
+                        break;
+
+                rx->chunk[rx->count++] = chunk;
+        }
+
+        if (unlikely(rx->count == 0))
+                return ENOBUFS;
+
+        iov[0].iov_base = rx->chunk[0]->ptr + rx->offset;
+        iov[0].iov_len = MEM_CHUNK_SIZE - rx->offset;
+        for (int i = 1; i < rx->count; i++) {
+                iov[i].iov_base = rx->chunk[i]->ptr;
+                iov[i].iov_len = MEM_CHUNK_SIZE;
+        }
+
+        *_count = rx->count;
+
+        return 0;
+}
+
+static void __mem_chunk_rx_consume(mem_chunk_rx_t *rx, ltgbuf_t *buf, uint32_t len)
+{
+        uint32_t cp;
+        mem_chunk_t *chunk;
+        seg_t *seg;
+
+        while (len) {
+                chunk = rx->chunk[0];
+                cp = _min(len, MEM_CHUNK_SIZE - rx->offset);
+
+                if (rx->offset == 0)
+                        rx->nr_chunk++;
+
+                seg = seg_chunk_create(buf, chunk, chunk->ptr + rx->offset, cp);
+                seg_add_tail(buf, seg);
+
+                rx->offset += cp;
+                len -= cp;
+
+                if (rx->offset == MEM_CHUNK_SIZE) {
+                        mem_chunk_put(chunk);
+                        rx->count--;
+                        memmove(&rx->chunk[0], &rx->chunk[1],
+                                sizeof(chunk) * rx->count);
+                        rx->offset = 0;
+                }
+        }
+}
+
+/* the socket is drained, fresh chunks go back to the pool */
+static void __mem_chunk_rx_trim(mem_chunk_rx_t *rx)
+{
+        while (rx->count > 1) {
+                rx->count--;
+                mem_chunk_put(rx->chunk[rx->count]);
+        }
+}
+
+/*
+ * read until the socket is drained, without asking how much is pending.
+ * the first read only fills the current chunk, the next ones take the
+ * whole ring. the data is appended to buf as segments pointing into the
+ * chunks. if something was read before an error the error is left for
+ * the next call.
+ */
+int mem_chunk_recv(mem_chunk_rx_t *rx, int fd, ltgbuf_t *buf, uint32_t *_len)
+{
+        int ret, count, want = 1;
+        uint32_t len = 0, size;
+        struct iovec iov[MEM_CHUNK_RX_MAX];
+        struct msghdr msg;
+
+        memset(&msg, 0x0, sizeof(msg));
+        msg.msg_iov = iov;
+
+        while (1) {
+                ret = __mem_chunk_rx_fill(rx, iov, &count, want);
+                if (unlikely(ret)) {
+                        if (len)
+                                break;
+
+                        GOTO(err_ret, ret);
+                }
+
+                size = MEM_CHUNK_SIZE * count - rx->offset;
+                msg.msg_iovlen = count;
+
+                ret = _recvmsg(fd, &msg, MSG_DONTWAIT);
+                rx->nr_recv++;
+                if (ret < 0) {
+                        ret = -ret;
+                        if (ret == EAGAIN || len)
+                                break;
+
+                        GOTO(err_ret, ret);
+                }
+
+                __mem_chunk_rx_consume(rx, buf, ret);
+                rx->nr_bytes += ret;
+                len += ret;
+
+                if ((uint32_t)ret < size)
+                        break;
+
+                /* more may be pending, widen the read */
+                want = MEM_CHUNK_RX_MAX;
+        }
+
+        __mem_chunk_rx_trim(rx);
+
+        *_len = len;
+
+        return 0;
+err_ret:
+        __mem_chunk_rx_trim(rx);
+        return ret;
+}
+
+void mem_chunk_rx_free(mem_chunk_rx_t *rx)
+{
+        for (int i = 0; i < rx->count; i++) {
+                mem_chunk_put(rx->chunk[i]);
+        }
+
+        rx->count = 0;
+        rx->offset = 0;
+}
+
+/* the owner keeps writing, a counter may be one update behind */
+int mem_chunk_stat(int hash, mem_chunk_stat_t *stat)
+{
+        mem_chunk_pool_t *pool;
+
+        if (hash < 0 || hash >= CORE_MAX)
+                return EINVAL;
+
+        pool = __mem_chunk_core__[hash];
+        if (pool == NULL)
+                return ENOENT;
+
+        stat->page = __atomic_load_n(&pool->page, __ATOMIC_RELAXED);
+        stat->count = __atomic_load_n(&pool->count, __ATOMIC_RELAXED);
+        stat->get = __atomic_load_n(&pool->get, __ATOMIC_RELAXED);
+        stat->remote = __atomic_load_n(&pool->nr_remote, __ATOMIC_RELAXED);
+        stat->used = __atomic_load_n(&pool->used, __ATOMIC_RELAXED) - stat->remote;
+
+        return 0;
+}
+
+int mem_chunk_dump(char *buf, int buflen)
+{
+        int len = 0;
+        mem_chunk_stat_t stat;
+
+        buf[0] = '\0';
+
+        for (int hash = 0; hash < CORE_MAX; hash++) {
+                if (mem_chunk_stat(hash, &stat))
+                        continue;
+
+                len += snprintf(buf + len, buflen - len,
+                                "core[%d] chunk page %u count %u used %ju"
+                                " get %ju remote %ju\n",
+                                hash, stat.page, stat.count, stat.used,
+                                stat.get, stat.remote);
+                if (len >= buflen)
+                        return ENOSPC;
+        }
+
+        return 0;
+}
@@ -114,7 +114,7 @@ static int __mem_ring_new__(mem_ring_head_t *head, mem_ring_t **_hpage, uint32_t
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
-        ret = hugepage_getfree((void **)&vaddr, &new_size, __FUNCTION__);
+        ret = hugepage_getfree((void **)&vaddr, &new_size, MEM_TAG_RING_PAGE, __FUNCTION__);
         if (unlikely(ret))
                 GOTO(err_free, ret);
 
@@ -228,6 +228,9 @@ retry:
         mem_handler->pool = head;
         mem_handler->ptr = hpage->vaddr + hpage->offset;
 
+        if (hpage->ref == 0)
+                mem_stat_add(MEM_TAG_MEM_RING, hpage->size);
+
         hpage->ref++;
         hpage->offset += alloc_size;
 
@@ -307,6 +310,7 @@ static void __mem_ring_local_free(mem_handler_t *mem_handler)
         if (hpage->ref == 0) {
                 // in free list
                 head->nr_bytes -= hpage->offset;
+                mem_stat_sub(MEM_TAG_MEM_RING, hpage->size);
                 // MEM_RING_HEAD_DUMP_L(DBUG, head, "free %u\n", hpage->offset);
 
                 hpage->offset = 0;
@@ -451,7 +455,7 @@ int mem_ring_init()
         mem_ring_head_t *head;
         uint32_t size = HUGEPAGE_SIZE;
 
-        ret = hugepage_getfree((void **)&head, &size, __FUNCTION__);
+        ret = hugepage_getfree((void **)&head, &size, MEM_TAG_RING_PAGE, __FUNCTION__);
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
@@ -509,7 +513,7 @@ int mem_ring_private_init(int corehash)
         mem_ring_head_t *head;
         uint32_t size = HUGEPAGE_SIZE;
 
-        ret = hugepage_getfree((void **)&head, &size, __FUNCTION__);
+        ret = hugepage_getfree((void **)&head, &size, MEM_TAG_RING_PAGE, __FUNCTION__);
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
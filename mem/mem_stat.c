@@ -0,0 +1,241 @@
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define DBG_SUBSYS S_LTG_MEM
+
+#include "ltg_utils.h"
+#include "ltg_mem.h"
+#include "core/core.h"
+
+static mem_stat_t __mem_stat_public__;
+static mem_stat_t *__mem_stat_core__[CORE_MAX];
+static __thread mem_stat_t *__mem_stat_private__ = NULL;
+
+static const char *__mem_tag__[MEM_TAG_MAX] = {
+        "malloc",
+        "stream",
+        "static",
+        "slab_seg",
+        "ring_page",
+        "mem_ring",
+        "task",
+        "rpc",
+        "analysis",
+        "corenet",
+        "chunk",
+};
+
+static const char *__mem_class__[MEM_CLASS_MAX] = {
+        "64", "256", "1K", "4K", "16K", "64K", "256K", "1M", "4M", "big",
+};
+
+static inline int INLINE __mem_stat_class(size_t size)
+{
+        int bits;
+
+        if (size <= 64)
+                return 0;
+
+        bits = 64 - __builtin_clzll(size - 1);
+
+        return _min((bits - 5) / 2, MEM_CLASS_MAX - 1);
+}
+
+inline void INLINE mem_stat_add(int tag, size_t size)
+{
+        mem_stat_t *stat = __mem_stat_private__;
+        int cls = __mem_stat_class(size);
+
+        if (likely(stat)) {
+                stat->count[tag][cls]++;
+                stat->bytes[tag][cls] += size;
+                stat->alloc[tag]++;
+        } else {
+                stat = &__mem_stat_public__;
+                __atomic_add_fetch(&stat->count[tag][cls], 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&stat->bytes[tag][cls], size, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&stat->alloc[tag], 1, __ATOMIC_RELAXED);
+        }
+}
+
+inline void INLINE mem_stat_sub(int tag, size_t size)
+{
+        mem_stat_t *stat = __mem_stat_private__;
+        int cls = __mem_stat_class(size);
+
+        if (likely(stat)) {
+                stat->count[tag][cls]--;
+                stat->bytes[tag][cls] -= size;
+        } else {
+                stat = &__mem_stat_public__;
+                __atomic_sub_fetch(&stat->count[tag][cls], 1, __ATOMIC_RELAXED);
+                __atomic_sub_fetch(&stat->bytes[tag][cls], size, __ATOMIC_RELAXED);
+        }
+}
+
+int mem_stat_private_init(int hash)
+{
+        int ret;
+        mem_stat_t *stat;
+
+        LTG_ASSERT(hash >= 0 && hash < CORE_MAX);
+
+        ret = ltg_malloc((void **)&stat, sizeof(*stat));
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        memset(stat, 0x0, sizeof(*stat));
+
+        __mem_stat_core__[hash] = stat;
+        __mem_stat_private__ = stat;
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+const char *mem_stat_tag(int tag)
+{
+        LTG_ASSERT(tag >= 0 && tag < MEM_TAG_MAX);
+
+        return __mem_tag__[tag];
+}
+
+/*
+ * snapshot of one core, hash -1 for threads outside the cores. the owner
+ * keeps writing, a counter may be one update behind.
+ */
+int mem_stat_get(int hash, mem_stat_t *stat)
+{
+        mem_stat_t *src;
+
+        if (hash == -1) {
+                src = &__mem_stat_public__;
+        } else if (hash >= 0 && hash < CORE_MAX && __mem_stat_core__[hash]) {
+                src = __mem_stat_core__[hash];
+        } else {
+                return ENOENT;
+        }
+
+        for (int i = 0; i < MEM_TAG_MAX; i++) {
+                for (int j = 0; j < MEM_CLASS_MAX; j++) {
+                        stat->count[i][j] = __atomic_load_n(&src->count[i][j],
+                                                            __ATOMIC_RELAXED);
+                        stat->bytes[i][j] = __atomic_load_n(&src->bytes[i][j],
+                                                            __ATOMIC_RELAXED);
+                }
+
+                stat->alloc[i] = __atomic_load_n(&src->alloc[i], __ATOMIC_RELAXED);
+        }
+
+        return 0;
+}
+
+void mem_stat_merge(mem_stat_t *stat)
+{
+        mem_stat_t tmp;
+
+        memset(stat, 0x0, sizeof(*stat));
+
+        for (int hash = -1; hash < CORE_MAX; hash++) {
+                if (mem_stat_get(hash, &tmp))
+                        continue;
+
+                for (int i = 0; i < MEM_TAG_MAX; i++) {
+                        for (int j = 0; j < MEM_CLASS_MAX; j++) {
+                                stat->count[i][j] += tmp.count[i][j];
+                                stat->bytes[i][j] += tmp.bytes[i][j];
+                        }
+
+                        stat->alloc[i] += tmp.alloc[i];
+                }
+        }
+}
+
+static int __mem_stat_dump(const mem_stat_t *stat, const char *name,
+                           char *buf, int buflen)
+{
+        int len = 0;
+        int64_t count, bytes;
+
+        for (int i = 0; i < MEM_TAG_MAX; i++) {
+                count = 0;
+                bytes = 0;
+                for (int j = 0; j < MEM_CLASS_MAX; j++) {
+                        count += stat->count[i][j];
+                        bytes += stat->bytes[i][j];
+                }
+
+                if (count == 0 && bytes == 0)
+                        continue;
+
+                len += snprintf(buf + len, buflen - len,
+                                "%s %s count %jd bytes %jd alloc %jd",
+                                name, __mem_tag__[i], count, bytes,
+                                stat->alloc[i]);
+                if (len >= buflen)
+                        return buflen;
+
+                for (int j = 0; j < MEM_CLASS_MAX; j++) {
+                        if (stat->count[i][j] == 0)
+                                continue;
+
+                        len += snprintf(buf + len, buflen - len, " %s:%jd",
+                                        __mem_class__[j], stat->count[i][j]);
+                        if (len >= buflen)
+                                return buflen;
+                }
+
+                len += snprintf(buf + len, buflen - len, "\n");
+                if (len >= buflen)
+                        return buflen;
+        }
+
+        return len;
+}
+
+/* one line per core and tag, then the merged total */
+int mem_stat_dump(char *buf, int buflen)
+{
+        int len = 0;
+        char name[MAX_NAME_LEN];
+        mem_stat_t stat;
+
+        buf[0] = '\0';
+
+        for (int hash = -1; hash < CORE_MAX; hash++) {
+                if (mem_stat_get(hash, &stat))
+                        continue;
+
+                snprintf(name, MAX_NAME_LEN, "core[%d]", hash);
+                len += __mem_stat_dump(&stat, name, buf + len, buflen - len);
+                if (len >= buflen)
+                        return ENOSPC;
+        }
+
+        mem_stat_merge(&stat);
+        len += __mem_stat_dump(&stat, "total", buf + len, buflen - len);
+        if (len >= buflen)
+                return ENOSPC;
+
+        return 0;
+}
+
+void mem_stat_show(const char *caller)
+{
+        int ret;
+        char *buf;
+
+        ret = ltg_malloc((void **)&buf, MAX_BUF_LEN * 4);
+        if (unlikely(ret))
+                return;
+
+        mem_stat_dump(buf, MAX_BUF_LEN * 4);
+
+        DINFO1(MAX_BUF_LEN * 5, "caller %s mem stat\n%s", caller, buf);
+
+        ltg_free((void **)&buf);
+}
@@ -0,0 +1,219 @@
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define DBG_SUBSYS S_LTG_MEM
+
+#include "ltg_utils.h"
+#include "ltg_mem.h"
+#include "core/core.h"
+
+/* in front of every object, pool is NULL for the slab fallback */
+typedef struct __obj_md {
+        struct __obj_pool *pool;
+        struct __obj_md *next;
+} obj_md_t;
+
+typedef struct __obj_pool {
+        char name[MAX_NAME_LEN];
+        int type;
+        int hash;
+        uint32_t size;
+        uint32_t count;
+        void *base;
+        obj_md_t *free;
+        uint64_t used;
+        uint64_t hit;
+        uint64_t fallback;
+
+        /* pushed by other threads, kept off the owner's line */
+        obj_md_t *remote __attribute__((__aligned__(CACHE_LINE_SIZE)));
+        uint64_t nr_remote;
+} obj_pool_t;
+
+static obj_pool_t *__obj_pool_core__[CORE_MAX][OBJ_POOL_MAX];
+static __thread obj_pool_t *__obj_pool__[OBJ_POOL_MAX];
+
+int obj_pool_private_init(int hash, int type, const char *name, size_t size,
+                          int count)
+{
+        int ret;
+        obj_pool_t *pool;
+        obj_md_t *md;
+
+        LTG_ASSERT(hash >= 0 && hash < CORE_MAX);
+        LTG_ASSERT(type >= 0 && type < OBJ_POOL_MAX);
+        LTG_ASSERT(__obj_pool__[type] == NULL);
+
+        ret = ltg_malign((void **)&pool, CACHE_LINE_SIZE, sizeof(*pool));
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        memset(pool, 0x0, sizeof(*pool));
+        snprintf(pool->name, MAX_NAME_LEN, "%s", name);
+        pool->type = type;
+        pool->hash = hash;
+        pool->size = _align_up(sizeof(obj_md_t) + size, CACHE_LINE_SIZE);
+        pool->count = count;
+
+        ret = ltg_malign(&pool->base, CACHE_LINE_SIZE,
+                         (size_t)pool->size * count);
+        if (unlikely(ret))
+                GOTO(err_free, ret);
+
+        /* link every slot now, the rpc path never faults them in */
+        for (int i = count - 1; i >= 0; i--) {
+                md = pool->base + (size_t)pool->size * i;
+                md->pool = pool;
+                md->next = pool->free;
+                pool->free = md;
+        }
+
+        __obj_pool__[type] = pool;
+        __obj_pool_core__[hash][type] = pool;
+
+        DINFO("obj pool %s[%d] size %u count %u\n", name, hash,
+              pool->size, count);
+
+        return 0;
+err_free:
+        ltg_free((void **)&pool);
+err_ret:
+        return ret;
+}
+
+static void *__obj_pool_fallback(obj_pool_t *pool, size_t size)
+{
+        obj_md_t *md;
+
+        md = slab_stream_alloc(sizeof(*md) + size);
+        if (unlikely(md == NULL))
+                return NULL;
+
+        if (pool) {
+                pool->fallback++;
+
+                if (pool->fallback % 1000 == 1) {
+                        DWARN("obj pool %s[%d] empty, used %ju fallback %ju\n",
+                              pool->name, pool->hash, pool->used,
+                              pool->fallback);
+                }
+        }
+
+        md->pool = NULL;
+
+        return md + 1;
+}
+
+inline void INLINE *obj_pool_alloc(int type, size_t size)
+{
+        obj_pool_t *pool = __obj_pool__[type];
+        obj_md_t *md;
+
+        if (unlikely(pool == NULL))
+                return __obj_pool_fallback(NULL, size);
+
+        LTG_ASSERT(sizeof(*md) + size <= pool->size);
+
+        if (unlikely(pool->free == NULL)) {
+                pool->free = __atomic_exchange_n(&pool->remote, NULL,
+                                                 __ATOMIC_ACQUIRE);
+                if (unlikely(pool->free == NULL))
+                        return __obj_pool_fallback(pool, size);
+        }
+
+        md = pool->free;
+        pool->free = md->next;
+        pool->used++;
+        pool->hit++;
+
+        return md + 1;
+}
+
+inline void INLINE obj_pool_free(void *ptr)
+{
+        obj_md_t *md = (obj_md_t *)ptr - 1;
+        obj_pool_t *pool = md->pool;
+
+        if (unlikely(pool == NULL)) {
+                slab_stream_free(md);
+        } else if (likely(pool == __obj_pool__[pool->type])) {
+                md->next = pool->free;
+                pool->free = md;
+                pool->used--;
+        } else {
+                md->next = __atomic_load_n(&pool->remote, __ATOMIC_RELAXED);
+                while (!__atomic_compare_exchange_n(&pool->remote, &md->next,
+                                                    md, 0, __ATOMIC_RELEASE,
+                                                    __ATOMIC_RELAXED)) {
+                }
+
+                __atomic_add_fetch(&pool->nr_remote, 1, __ATOMIC_RELAXED);
+        }
+}
+
+/* the owner keeps writing, a counter may be one update behind */
+int obj_pool_stat(int hash, int type, obj_pool_stat_t *stat)
+{
+        obj_pool_t *pool;
+
+        if (hash < 0 || hash >= CORE_MAX || type < 0 || type >= OBJ_POOL_MAX)
+                return EINVAL;
+
+        pool = __obj_pool_core__[hash][type];
+        if (pool == NULL)
+                return ENOENT;
+
+        stat->size = pool->size;
+        stat->count = pool->count;
+        stat->hit = __atomic_load_n(&pool->hit, __ATOMIC_RELAXED);
+        stat->fallback = __atomic_load_n(&pool->fallback, __ATOMIC_RELAXED);
+        stat->remote = __atomic_load_n(&pool->nr_remote, __ATOMIC_RELAXED);
+        stat->used = __atomic_load_n(&pool->used, __ATOMIC_RELAXED) - stat->remote;
+
+        return 0;
+}
+
+int obj_pool_dump(char *buf, int buflen)
+{
+        int len = 0;
+        obj_pool_stat_t stat;
+
+        buf[0] = '\0';
+
+        for (int hash = 0; hash < CORE_MAX; hash++) {
+                for (int type = 0; type < OBJ_POOL_MAX; type++) {
+                        if (obj_pool_stat(hash, type, &stat))
+                                continue;
+
+                        len += snprintf(buf + len, buflen - len,
+                                        "core[%d] %s size %u count %u used %ju"
+                                        " hit %ju fallback %ju remote %ju\n",
+                                        hash, __obj_pool_core__[hash][type]->name,
+                                        stat.size, stat.count, stat.used,
+                                        stat.hit, stat.fallback, stat.remote);
+                        if (len >= buflen)
+                                return ENOSPC;
+                }
+        }
+
+        return 0;
+}
+
+void obj_pool_show(const char *caller)
+{
+        int ret;
+        char *buf;
+
+        ret = ltg_malloc((void **)&buf, MAX_BUF_LEN * 4);
+        if (unlikely(ret))
+                return;
+
+        obj_pool_dump(buf, MAX_BUF_LEN * 4);
+
+        DINFO1(MAX_BUF_LEN * 5, "caller %s obj pool\n%s", caller, buf);
+
+        ltg_free((void **)&buf);
+}
@@ -14,6 +14,7 @@
 //#define SLAB_SEG (1024 * 1024 * 2)
 #define SLAB_SEG  (ltgconf_global.nr_hugepage ? MAX_ALLOC_SIZE : (1024 * 1024 * 2))
 #define SLAB_MD sizeof(slab_md_t)
+#define SLAB_RECLAIM_KEEP 1
 
 #if ENABLE_HUGEPAGE
 static void *__slab_lowlevel_calloc(int private)
@@ -24,22 +25,23 @@ static void *__slab_lowlevel_calloc(int private)
 
         (void) private;
 
-        ret = hugepage_getfree(&ptr, &size, __FUNCTION__);
+        ret = hugepage_getfree(&ptr, &size, MEM_TAG_SLAB_SEG, __FUNCTION__);
         if (ret)
                 return NULL;
         else
                 return ptr;
 }
 
-#if 0
 static void __slab_lowlevel_free(void *ptr, int private)
 {
-        (void) ptr;
+        int ret;
+
         (void) private;
 
-        UNIMPLEMENTED(__DUMP__);
+        ret = hugepage_putfree(ptr, SLAB_SEG, MEM_TAG_SLAB_SEG, __FUNCTION__);
+        if (ret)
+                UNIMPLEMENTED(__DUMP__);
 }
-#endif
 
 #else
 
@@ -50,32 +52,31 @@ static void *__slab_lowlevel_calloc(int private)
 
         (void) private;
         
-        ret = ltg_malloc(&ptr, SLAB_SEG);
+        ret = ltg_malloc_tag(&ptr, SLAB_SEG, MEM_TAG_SLAB_SEG);
         if (ret)
                 return NULL;
         else
                 return ptr;
 }
 
-#if 0
 static void __slab_lowlevel_free(void *ptr, int private)
 {
         (void) private;
 
-        ltg_free(&ptr);
+        ltg_free_tag(&ptr, MEM_TAG_SLAB_SEG);
 }
-#endif
 
 #endif
 
 static int __slab_init__(const char *name, slab_bucket_t *slab, int split,
-                         pid_t tid, int private)
+                         pid_t tid, int private, int tag)
 {
         memset(slab, 0x0, sizeof(*slab));
 
         slab->split = split;
         slab->tid = tid;
         slab->private = private;
+        slab->tag = tag;
         INIT_LIST_HEAD(&slab->list);
         INIT_LIST_HEAD(&slab->used);
         strcpy(slab->name, name);
@@ -86,7 +87,7 @@ static int __slab_init__(const char *name, slab_bucket_t *slab, int split,
 }
 
 static int __slab_init(const char *name, slab_array_t **_array, int private,
-                       int min, int shift, uint32_t magic)
+                       int min, int shift, uint32_t magic, int tag)
 {
         int ret;
         slab_array_t *array;
@@ -102,6 +103,10 @@ static int __slab_init(const char *name, slab_array_t **_array, int private,
 
         array->count = shift;
         array->magic = magic;
+        array->tag = tag;
+        array->nr_seg = 0;
+        array->max_seg = 0;
+        array->reclaimed = 0;
         if (private) {
                 core_t *core = core_self();
                 array->coreid = core->hash;
@@ -118,7 +123,7 @@ static int __slab_init(const char *name, slab_array_t **_array, int private,
         for (int i = 0; i < shift; i++) {
                 slab_bucket_t *mem = &array->slab_bucket[i];
                 ret = __slab_init__(name, mem, min * (1 << i),
-                                    array->tid, private);
+                                    array->tid, private, tag);
                 if (ret)
                         GOTO(err_ret, ret);
         }
@@ -131,7 +136,7 @@ err_ret:
 }
 
 int slab_private_init(const char *name, slab_t **_slab, slab_array_t *public, int min,
-                      int shift, uint32_t magic)
+                      int shift, uint32_t magic, int tag)
 {
         int ret;
         slab_t *slab;
@@ -142,7 +147,7 @@ int slab_private_init(const char *name, slab_t **_slab, slab_array_t *public, in
 
         memset(slab, 0x0, sizeof(*slab));
         
-        ret = __slab_init(name, &slab->private, 1, min, shift, magic);
+        ret = __slab_init(name, &slab->private, 1, min, shift, magic, tag);
         if (ret)
                 GOTO(err_ret, ret);
 
@@ -156,7 +161,7 @@ err_ret:
 }
 
 int slab_init(const char *name, slab_t **_slab, slab_array_t **_public, int min,
-              int shift, uint32_t magic)
+              int shift, uint32_t magic, int tag)
 {
         int ret;
         slab_t *slab;
@@ -167,7 +172,7 @@ int slab_init(const char *name, slab_t **_slab, slab_array_t **_public, int min,
 
         memset(slab, 0x0, sizeof(*slab));
         
-        ret = __slab_init(name, &slab->public, 0, min, shift, magic);
+        ret = __slab_init(name, &slab->public, 0, min, shift, magic, tag);
         if (ret)
                 GOTO(err_ret, ret);
 
@@ -180,8 +185,9 @@ err_ret:
         return ret;
 }
 
-static int __slab_extend(slab_bucket_t *slab, uint32_t magic, uint32_t coreid)
+static int __slab_extend(slab_array_t *array, slab_bucket_t *slab)
 {
+        uint32_t magic = array->magic, coreid = array->coreid;
         int ret;
         void *ptr;
         core_t *core = core_self();
@@ -197,17 +203,25 @@ static int __slab_extend(slab_bucket_t *slab, uint32_t magic, uint32_t coreid)
                 GOTO(err_ret, ret);
         }
 
+        slab_seg_t *seg = ptr;
+        int count = (SLAB_SEG - sizeof(*seg)) / (slab->split + SLAB_MD);
+
+        seg->idx = slab->count;
+        seg->used = 0;
+        seg->total = count;
+        seg->idle = gettime();
+
         slab->array[slab->count] = ptr;
         slab->count++;
+        slab->nr_idle++;
 
         slab_md_t *md;
-        int count = SLAB_SEG / (slab->split + SLAB_MD);
         for (int i = 0; i < count; i++ ) {
-                md = ptr + i * (slab->split + SLAB_MD);
+                md = ptr + sizeof(*seg) + i * (slab->split + SLAB_MD);
                 md->magic = magic;
                 md->slab_bucket = slab;
                 md->coreid = coreid;
-                md->seghead = ptr;
+                md->seghead = seg;
                 list_add_tail(&md->hook, &slab->list);
         }
 
@@ -221,18 +235,22 @@ static int __slab_extend(slab_bucket_t *slab, uint32_t magic, uint32_t coreid)
                       slab->count);
         }
 
+        array->nr_seg++;
+        if (array->nr_seg > array->max_seg)
+                array->max_seg = array->nr_seg;
+
         return 0;
 err_ret:
         return ret;
 }
 
-static void S_LTG *__slab_alloc__(slab_bucket_t *slab, uint32_t magic, uint32_t coreid)
+static void S_LTG *__slab_alloc__(slab_array_t *array, slab_bucket_t *slab)
 {
         int ret;
         slab_md_t *md;
 
         if (unlikely(list_empty(&slab->list))) {
-                ret = __slab_extend(slab, magic, coreid);
+                ret = __slab_extend(array, slab);
                 if (ret)
                         return NULL;
         }
@@ -244,6 +262,11 @@ static void S_LTG *__slab_alloc__(slab_bucket_t *slab, uint32_t magic, uint32_t
         list_del(&md->hook);
         list_add_tail(&md->hook, &slab->used);
 
+        if (unlikely(md->seghead->used++ == 0))
+                slab->nr_idle--;
+
+        mem_stat_add(array->tag, slab->split);
+
         return md->ptr;
 }
 
@@ -252,7 +275,7 @@ inline static void S_LTG  *__slab_alloc(slab_array_t *array, size_t size)
         for (int i = 0; i < array->count; i++) {
                 slab_bucket_t *slab = &array->slab_bucket[i];
                 if (slab->split >= size) {
-                        return __slab_alloc__(slab, array->magic, array->coreid);
+                        return __slab_alloc__(array, slab);
                 }
         }
 
@@ -303,6 +326,19 @@ err_ret:
         return NULL;
 }
 
+inline static void INLINE __slab_seg_put(slab_bucket_t *slab_bucket, slab_md_t *md)
+{
+        slab_seg_t *seg = md->seghead;
+
+        mem_stat_sub(slab_bucket->tag, slab_bucket->split);
+
+        LTG_ASSERT(seg->used > 0);
+        if (unlikely(--seg->used == 0)) {
+                seg->idle = gettime();
+                slab_bucket->nr_idle++;
+        }
+}
+
 inline static void INLINE __slab_free_local(void *ptr)
 {
         slab_md_t *md = ptr - SLAB_MD;
@@ -312,6 +348,8 @@ inline static void INLINE __slab_free_local(void *ptr)
 
         list_del(&md->hook);
         list_add_tail(&md->hook, &slab_bucket->list);
+
+        __slab_seg_put(slab_bucket, md);
 }
 
 void S_LTG __slab_free_public(slab_t *slab, void *ptr)
@@ -329,6 +367,8 @@ void S_LTG __slab_free_public(slab_t *slab, void *ptr)
         list_del(&md->hook);
         list_add_tail(&md->hook, &slab_bucket->list);
 
+        __slab_seg_put(slab_bucket, md);
+
         ltg_spin_unlock(&slab->public->spin);
 }
 
@@ -375,6 +415,92 @@ inline void INLINE slab_free(slab_t *slab, void *ptr)
         }
 }
 
+static void __slab_reclaim_seg(slab_array_t *array, slab_bucket_t *slab_bucket,
+                               slab_seg_t *seg)
+{
+        struct list_head *pos, *n;
+        slab_md_t *md;
+        slab_seg_t *last;
+        int count = 0;
+
+        LTG_ASSERT(seg->used == 0);
+
+        list_for_each_safe(pos, n, &slab_bucket->list) {
+                md = (void *)pos;
+                if (md->seghead == seg) {
+                        list_del(&md->hook);
+                        count++;
+                }
+        }
+
+        LTG_ASSERT(count == seg->total);
+
+        slab_bucket->count--;
+        if (seg->idx != slab_bucket->count) {
+                last = slab_bucket->array[slab_bucket->count];
+                last->idx = seg->idx;
+                slab_bucket->array[seg->idx] = last;
+        }
+
+        slab_bucket->array[slab_bucket->count] = NULL;
+        slab_bucket->nr_idle--;
+
+        array->nr_seg--;
+        array->reclaimed++;
+
+        __slab_lowlevel_free(seg, slab_bucket->private);
+}
+
+/*
+ * give idle segments back to the hugepage pool. one idle segment is kept
+ * per bucket so a bucket on the edge does not extend and free every scan,
+ * under pressure the idle time is not waited for.
+ */
+void slab_reclaim(void *_core, slab_array_t *array)
+{
+        core_t *core = _core;
+        int i, idle, pressure;
+        time_t now = gettime();
+        slab_bucket_t *slab_bucket;
+        slab_seg_t *seg;
+        uint64_t count = array->reclaimed;
+
+        if (ltgconf_global.slab_reclaim_idle <= 0)
+                return;
+
+        pressure = hugepage_pressure();
+        idle = pressure ? 0 : ltgconf_global.slab_reclaim_idle;
+
+        for (i = 0; i < array->count; i++) {
+                slab_bucket = &array->slab_bucket[i];
+
+                for (int j = slab_bucket->count - 1;
+                     j >= 0 && slab_bucket->nr_idle > SLAB_RECLAIM_KEEP; j--) {
+                        seg = slab_bucket->array[j];
+                        if (seg->used || now - seg->idle < idle)
+                                continue;
+
+                        __slab_reclaim_seg(array, slab_bucket, seg);
+                }
+        }
+
+        if (array->reclaimed != count) {
+                DINFO("%s[%d] %s reclaim %ju seg, pressure %d, seg %ju/%ju"
+                      " reclaimed %ju\n", core->name, core->hash,
+                      array->slab_bucket[0].name, array->reclaimed - count,
+                      pressure, array->nr_seg, array->max_seg, array->reclaimed);
+        }
+}
+
+void slab_stat(const slab_t *slab, slab_stat_t *stat)
+{
+        const slab_array_t *array = slab->private ? slab->private : slab->public;
+
+        stat->bytes = array->nr_seg * SLAB_SEG;
+        stat->high_water = array->max_seg * SLAB_SEG;
+        stat->reclaimed = array->reclaimed * SLAB_SEG;
+}
+
 void slab_scan(void *_core, slab_array_t *array)
 {
         struct list_head *pos;
@@ -382,6 +508,8 @@ void slab_scan(void *_core, slab_array_t *array)
         slab_md_t *md;
         core_t *core = _core;
 
+        slab_reclaim(core, array);
+
         uint32_t seq = 0;
         for (int i = 0; i < array->count; i++) {
                 slab_bucket_t *slab_bucket = &array->slab_bucket[i];
@@ -24,7 +24,7 @@ int slab_static_init()
         int ret;
 
         ret = slab_init("static", &__slab_public__, &__slab_array_public__,
-                        MEM_MIN, MEM_SHIFT, SLAB_MAGIC);
+                        MEM_MIN, MEM_SHIFT, SLAB_MAGIC, MEM_TAG_SLAB_STATIC);
         if (ret)
                 GOTO(err_ret, ret);
         
@@ -33,17 +33,31 @@ err_ret:
         return ret;
 }
 
+/* static objects live long, only reclaim, no used time check */
+static void __slab_scan(void *_core, void *var, void *_slab)
+{
+        (void) var;
+
+        slab_t *slab = _slab;
+
+        slab_reclaim(_core, slab->private);
+}
+
 int slab_static_private_init()
 {
         int ret;
         slab_t *slab;
 
         ret = slab_private_init("static", &slab, __slab_array_public__,
-                                MEM_MIN, MEM_SHIFT, SLAB_MAGIC);
+                                MEM_MIN, MEM_SHIFT, SLAB_MAGIC, MEM_TAG_SLAB_STATIC);
         if (ret)
                 GOTO(err_ret, ret);
 
         core_tls_set(VARIABLE_SLAB_STATIC, slab);
+
+        ret = core_register_scan("slab_static_scan", __slab_scan, slab);
+        if (ret)
+                GOTO(err_ret, ret);
         
         return 0;
 err_ret:
@@ -95,3 +109,15 @@ void slab_static_free1(void **ptr)
                 *ptr = NULL;
         }
 }
+
+int slab_static_stat(slab_stat_t *stat)
+{
+        slab_t *slab = core_tls_get(NULL, VARIABLE_SLAB_STATIC);
+
+        if (slab == NULL)
+                return ENOENT;
+
+        slab_stat(slab, stat);
+
+        return 0;
+}
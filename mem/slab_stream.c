@@ -23,7 +23,7 @@ int slab_stream_init()
         int ret;
 
         ret = slab_init("stream", &__slab_public__, &__slab_array_public__,
-                        MEM_MIN, MEM_SHIFT, SLAB_MAGIC);
+                        MEM_MIN, MEM_SHIFT, SLAB_MAGIC, MEM_TAG_SLAB_STREAM);
         if (ret)
                 GOTO(err_ret, ret);
         
@@ -50,7 +50,7 @@ int slab_stream_private_init()
         slab_t *slab;
 
         ret = slab_private_init("stream", &slab, __slab_array_public__,
-                                MEM_MIN, MEM_SHIFT, SLAB_MAGIC);
+                                MEM_MIN, MEM_SHIFT, SLAB_MAGIC, MEM_TAG_SLAB_STREAM);
         if (ret)
                 GOTO(err_ret, ret);
 
@@ -112,3 +112,15 @@ void S_LTG slab_stream_free1(void **ptr)
                 *ptr = NULL;
         }
 }
+
+int slab_stream_stat(slab_stat_t *stat)
+{
+        slab_t *slab = core_tls_get(NULL, VARIABLE_SLAB_STREAM);
+
+        if (slab == NULL)
+                return ENOENT;
+
+        slab_stat(slab, stat);
+
+        return 0;
+}
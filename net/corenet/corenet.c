@@ -20,12 +20,16 @@ extern int ltg_nofile_max;
 inline static void INLINE __corenet_routine(void *_core, void *var, void *_corenet)
 {
         (void) _core;
-        (void) _corenet;
+
+        __corenet_t *corenet = _corenet;
 
         if (likely(ltgconf_global.rdma)) {
-                corenet_rdma_commit(((__corenet_t *)_corenet)->rdma_net);
+                corenet_rdma_commit(corenet->rdma_net);
         } else {
                 corenet_tcp_commit(var);
+
+                if (corenet->shm_net)
+                        corenet_shm_commit(corenet->shm_net);
         }
 
         return;
@@ -56,6 +60,9 @@ static void S_LTG __corenet_poller(void *_core, void *var, void *_corenet)
                 int tmo = (core->flag & CORE_FLAG_POLLING) ? 0 : 1;
 
                 corenet_tcp_poll(var, tmo);
+
+                if (corenet->shm_net)
+                        corenet_shm_poll(corenet->shm_net, tmo == 0);
         }
 
         return;
@@ -110,6 +117,15 @@ static int __corenet_tcp_init(core_t *core, __corenet_t *corenet, int flag)
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
+        /* without it peers on this host just connect over tcp */
+        if (ltgconf_global.tcp_shm && ltgconf_global.daemon) {
+                ret = corenet_shm_init(&corenet->coreid,
+                                       (corenet_shm_t **)&corenet->shm_net);
+                if (unlikely(ret)) {
+                        DWARN("corenet shm disabled, %s\n", strerror(ret));
+                }
+        }
+
         return 0;
 err_ret:
         return ret;
@@ -370,15 +386,31 @@ int corenet_send(void *ctx, const sockid_t *sockid, ltgbuf_t *buf)
         if (ltgconf_global.rdma) {
                 UNIMPLEMENTED(__DUMP__);
                 return 0;
+        } else if (sockid->type == SOCKID_SHM) {
+                return corenet_shm_send(ctx, sockid, buf);
         } else {
                 return corenet_tcp_send(ctx, sockid, buf);
         }
 }
 
+/* rdma keeps its own bounded send queue */
+corenet_credit_t *corenet_credit(const sockid_t *sockid)
+{
+        if (sockid->type == SOCKID_SHM) {
+                return corenet_shm_credit(sockid);
+        } else if (sockid->type == SOCKID_CORENET && sockid->rdma_handler == NULL) {
+                return corenet_tcp_credit(sockid);
+        }
+
+        return NULL;
+}
+
 void corenet_close(const sockid_t *sockid)
 {
         if (ltgconf_global.rdma && sockid->rdma_handler != NULL) {
                 corenet_rdma_close((rdma_conn_t *)sockid->rdma_handler, __FUNCTION__);
+        } else if (sockid->type == SOCKID_SHM) {
+                corenet_shm_close(sockid);
         } else {
                 corenet_tcp_close(sockid);
         }
@@ -27,19 +27,34 @@ static int __rdma_connect_request(va_list ap)
 {
         const uint32_t addr = va_arg(ap, const uint32_t);
         const uint32_t port = va_arg(ap, const uint32_t);
+        const rdma_rail_msg_t *rail = va_arg(ap, const rdma_rail_msg_t *);
         core_t *core = va_arg(ap, core_t *);
         sockid_t *sockid = va_arg(ap, sockid_t *);
 
         va_end(ap);
 
-        return corenet_rdma_connect_by_channel(addr, port, core, sockid);
+        return corenet_rdma_connect_by_channel(addr, port, rail, core, sockid);
 }
 #endif
 
-int corenet_rdma_connect(uint32_t addr, uint32_t port, sockid_t *sockid)
+/*
+ * with a group the peer learns which connection this qp is a rail of,
+ * idx 0 is the connection itself, see corenet_rdma_rail_link.
+ */
+int corenet_rdma_connect(uint32_t addr, uint32_t port, uint64_t group, int idx,
+                         sockid_t *sockid)
 {
         int ret;
         core_t *core = core_self();
+        rdma_rail_msg_t rail, *_rail = NULL;
+
+        if (group) {
+                rail.magic = RDMA_RAIL_MAGIC;
+                rail.idx = idx;
+                rail.group = group;
+                rail.rkey = 0;
+                _rail = &rail;
+        }
 
         port = ntohs(port);
 
@@ -50,9 +65,9 @@ int corenet_rdma_connect(uint32_t addr, uint32_t port, sockid_t *sockid)
 #if 1
         ret = sche_thread_solo(SCHE_THREAD_MISC, _random(), FALSE,
                                "rdma_connect", -1, __rdma_connect_request,
-                               addr, port, core, sockid);
+                               addr, port, _rail, core, sockid);
 #else
-        ret = corenet_rdma_connect_by_channel(addr, port, core, sockid);
+        ret = corenet_rdma_connect_by_channel(addr, port, _rail, core, sockid);
 #endif
         if (unlikely(ret)) {
                 GOTO(err_ret, ret);
@@ -5,6 +5,7 @@
 #include <semaphore.h>
 #include <pthread.h>
 #include <signal.h>
+#include <netinet/tcp.h>
 #include <errno.h>
 
 #define DBG_SUBSYS S_LTG_NET
@@ -16,6 +17,11 @@
 
 #define CORENET_MAGIC 0x347a8447
 
+/* tcp_accept_core: backlog for connect storms, seconds the kernel holds a
+ * connection back until the handshake message is in */
+#define CORENET_ACCEPT_QLEN 4096
+#define CORENET_ACCEPT_DEFER 2
+
 typedef struct {
         uint32_t magic;
         coreid_t from;
@@ -167,6 +173,28 @@ err_ret:
         return NULL;
 }
 
+static corerpc_ctx_t *__corenet_tcp_newctx(const __corenet_tcp_t *corenet_tcp,
+                                           int sd, const struct sockaddr_in *sin)
+{
+        int ret;
+        corerpc_ctx_t *ctx;
+
+        ret = slab_static_alloc1((void **)&ctx, sizeof(*ctx));
+        if (unlikely(ret))
+                UNIMPLEMENTED(__DUMP__);
+
+        ctx->running = 0;
+        ctx->sockid.sd = sd;
+        ctx->sockid.type = SOCKID_CORENET;
+        ctx->sockid.seq = _random();
+        ctx->sockid.addr = sin->sin_addr.s_addr;
+        ctx->sockid.reply = corerpc_reply_tcp;
+        ctx->coreid.nid.id = 0;
+        ctx->local = corenet_tcp->coreid;
+
+        return ctx;
+}
+
 static int __corenet_tcp_accept(const __corenet_tcp_t *corenet_tcp)
 {
         int ret, sd;
@@ -183,20 +211,52 @@ static int __corenet_tcp_accept(const __corenet_tcp_t *corenet_tcp)
 		GOTO(err_ret, ret);
         }
 
-        ret = slab_static_alloc1((void **)&ctx, sizeof(*ctx));
+        ctx = __corenet_tcp_newctx(corenet_tcp, sd, &sin);
+
+        ret = ltg_thread_create(__corenet_tcp_accept__, ctx, "__corenet_tcp_accept");
         if (unlikely(ret))
                 UNIMPLEMENTED(__DUMP__);
 
-        ctx->running = 0;
-        ctx->sockid.sd = sd;
-        ctx->sockid.type = SOCKID_CORENET;
-        ctx->sockid.seq = _random();
-        ctx->sockid.addr = sin.sin_addr.s_addr;
-        ctx->sockid.reply = corerpc_reply_tcp;
-        ctx->coreid.nid.id = 0;
-        ctx->local = corenet_tcp->coreid;
+        return 0;
+err_ret:
+        return ret;
+}
 
-        ret = ltg_thread_create(__corenet_tcp_accept__, ctx, "__corenet_tcp_accept");
+/*
+ * take the handshake without waiting, EAGAIN if it is not complete yet.
+ * the listener is on this core, so is the connection.
+ */
+static int __corenet_tcp_handshake(corerpc_ctx_t *ctx)
+{
+        int ret, sd = ctx->sockid.sd;
+        corenet_msg_t msg;
+
+        ret = recv(sd, &msg, sizeof(msg), MSG_PEEK | MSG_DONTWAIT);
+        if (ret != sizeof(msg)) {
+                ret = EAGAIN;
+                goto err_ret;
+        }
+
+        ret = recv(sd, &msg, sizeof(msg), MSG_DONTWAIT);
+        LTG_ASSERT(ret == sizeof(msg));
+
+        if (msg.magic != CORENET_MAGIC) {
+                ret = EINVAL;
+                DERROR("got bad magic %x\n", msg.magic);
+                GOTO(err_ret, ret);
+        }
+
+        LTG_ASSERT(coreid_cmp(&msg.to, &ctx->local) == 0);
+
+        ret = tcp_sock_tuning(sd, 1, 1);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        ctx->coreid = msg.from;
+
+        ret = corenet_tcp_add(NULL, &ctx->sockid, ctx, corerpc_tcp_recv,
+                              corerpc_close, NULL, NULL,
+                              netable_rname(&ctx->coreid.nid));
         if (unlikely(ret))
                 UNIMPLEMENTED(__DUMP__);
 
@@ -205,6 +265,80 @@ err_ret:
         return ret;
 }
 
+/* EPOLLIN on the listener, drain the accept queue */
+static void __corenet_tcp_accept_core(void *arg)
+{
+        int ret, sd;
+        socklen_t alen;
+        struct sockaddr_in sin;
+        corerpc_ctx_t *ctx;
+        const __corenet_tcp_t *corenet_tcp = arg;
+
+        while (1) {
+                memset(&sin, 0, sizeof(sin));
+                alen = sizeof(struct sockaddr_in);
+
+                sd = accept(corenet_tcp->sd, &sin, &alen);
+                if (sd < 0) {
+                        ret = errno;
+                        if (ret != EAGAIN) {
+                                DWARN("accept fail %s\n", strerror(ret));
+                        }
+
+                        break;
+                }
+
+                LTG_ASSERT(sd < ltg_nofile_max);
+
+                ctx = __corenet_tcp_newctx(corenet_tcp, sd, &sin);
+
+                ret = __corenet_tcp_handshake(ctx);
+                if (likely(ret == 0)) {
+                        DBUG("accept from %s, sd %d\n", _inet_ntoa(sin.sin_addr.s_addr), sd);
+                        continue;
+                }
+
+                if (ret == EAGAIN) {
+                        /* the defer timed out first, wait for it off the core */
+                        ret = ltg_thread_create(__corenet_tcp_accept__, ctx,
+                                                "__corenet_tcp_accept");
+                        if (unlikely(ret))
+                                UNIMPLEMENTED(__DUMP__);
+
+                        continue;
+                }
+
+                close(sd);
+                slab_static_free1((void **)&ctx);
+        }
+}
+
+static int __corenet_tcp_passive_core(__corenet_tcp_t *corenet_tcp)
+{
+        int ret, defer = CORENET_ACCEPT_DEFER;
+        sockid_t sockid;
+
+        ret = setsockopt(corenet_tcp->sd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                         &defer, sizeof(defer));
+        if (ret < 0) {
+                ret = errno;
+                GOTO(err_ret, ret);
+        }
+
+        sockid.sd = corenet_tcp->sd;
+        sockid.seq = _random();
+        sockid.type = SOCKID_CORENET;
+        sockid.addr = 0;
+        ret = corenet_tcp_add(NULL, &sockid, corenet_tcp, NULL, NULL, NULL,
+                              __corenet_tcp_accept_core, "corenet_passive");
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
 static void *__corenet_tcp_passive(void *_arg)
 {
         int ret;
@@ -247,8 +381,13 @@ int corenet_tcp_passive(const coreid_t *coreid, uint32_t *_port, int *_sd)
                 LTG_ASSERT(port > LNET_SERVICE_RANGE && port < 65535);
                 snprintf(tmp, MAX_LINE_LEN, "%u", port);
 
-                ret = tcp_sock_hostlisten(&sd, NULL, tmp,
-                                          256, 0, 1);
+                if (ltgconf_global.tcp_accept_core) {
+                        ret = tcp_sock_hostlisten(&sd, NULL, tmp,
+                                                  CORENET_ACCEPT_QLEN, 1, 1);
+                } else {
+                        ret = tcp_sock_hostlisten(&sd, NULL, tmp,
+                                                  256, 0, 1);
+                }
                 if (unlikely(ret)) {
                         if (ret == EADDRINUSE) {
                                 DBUG("port (%u + %u) %s\n", LNET_SERVICE_BASE,
@@ -272,6 +411,14 @@ int corenet_tcp_passive(const coreid_t *coreid, uint32_t *_port, int *_sd)
         corenet_tcp->coreid = *coreid;
         corenet_tcp->sd = sd;
 
+        if (ltgconf_global.tcp_accept_core) {
+                ret = __corenet_tcp_passive_core(corenet_tcp);
+                if (unlikely(ret))
+                        GOTO(err_ret, ret);
+
+                return 0;
+        }
+
         ret = ltg_thread_create(__corenet_tcp_passive, corenet_tcp, "corenet_passive");
         if (unlikely(ret))
                 UNIMPLEMENTED(__DUMP__);
@@ -53,6 +53,20 @@ static corenet_maping_t S_LTG *__corenet_maping_get_byctx(void *core)
         return core_tls_get(core, VARIABLE_MAPING);
 }
 
+/* connection k to core idx, 0 is the one for small rpcs */
+static inline sockid_t *__corenet_maping_slot(corenet_maping_t *entry, int idx, int k)
+{
+        if (k == 0)
+                return &entry->sockid[idx];
+
+        return &entry->bulk[idx * entry->stripe + k - 1];
+}
+
+static inline int __corenet_maping_count(const corenet_maping_t *entry)
+{
+        return entry->bulk ? entry->stripe + 1 : 1;
+}
+
 static void __corenet_maping_resume(struct list_head *list, const nid_t *nid,
                                     int res)
 {
@@ -82,11 +96,60 @@ STATIC void __corenet_maping_close_finally__(const nid_t *nid, const sockid_t *s
         if (ltgconf_global.rdma && sockid->rdma_handler != NULL)
                 corenet_rdma_close((rdma_conn_t *)sockid->rdma_handler,
                                    __FUNCTION__);
+        else if (sockid->type == SOCKID_SHM)
+                corenet_shm_close(sockid);
         else
                 corenet_tcp_close(sockid);
 
 }
 
+/* with tcp_shm a core of the same node may sit on either transport */
+static int __corenet_maping_connected(const sockid_t *sockid)
+{
+        if (sockid->type == SOCKID_SHM)
+                return corenet_shm_connected(sockid);
+
+        return corenet_tcp_connected(sockid);
+}
+
+static inline void __corenet_maping_request(const corenet_maping_t *entry,
+                                            sockid_t *sockid)
+{
+        sockid->request = sockid->type == SOCKID_SHM
+                ? corerpc_shm_request : entry->request;
+}
+
+/*
+ * rdma_rail: the other addresses of the peer core are tried for more
+ * qps of this connection, each one on a device of its own.
+ */
+static void __corenet_maping_rail(const corenet_addr_t *addr, int skip,
+                                  uint64_t group, const sockid_t *sockid)
+{
+        int ret, i, rail = 1;
+        sockid_t tmp;
+        const sock_info_t *sock;
+
+        for (i = 0; i < addr->info_count && rail < ltgconf_global.rdma_rail; i++) {
+                if (i == skip)
+                        continue;
+
+                sock = &addr->info[i];
+                ret = corenet_rdma_connect(sock->addr, sock->port, group, rail, &tmp);
+                if (unlikely(ret))
+                        continue;
+
+                ret = corenet_rdma_rail_link(sockid, &tmp);
+                if (unlikely(ret)) {
+                        DBUG("rail %s unused, ret %d\n", _inet_ntoa(sock->addr), ret);
+                        corenet_rdma_close(tmp.rdma_handler, __FUNCTION__);
+                        continue;
+                }
+
+                rail++;
+        }
+}
+
 STATIC int __corenet_maping_connect_core(const coreid_t *coreid,
                                          const corenet_addr_t *addr,
                                          sockid_t *_sockid)
@@ -94,14 +157,33 @@ STATIC int __corenet_maping_connect_core(const coreid_t *coreid,
         int ret, idx, i;
         sockid_t sockid;
         const sock_info_t *sock;
+        uint64_t group = 0;
+
+        /* a peer on this host answers on its unix socket */
+        if (ltgconf_global.tcp_shm && !ltgconf_global.rdma) {
+                ret = corenet_shm_connect(coreid, &sockid);
+                if (ret == 0) {
+                        *_sockid = sockid;
+                        return 0;
+                }
+
+                DBUG("shm connect %s/%d %s\n", netable_rname(&coreid->nid),
+                     coreid->idx, strerror(ret));
+        }
 
         idx = _random() % addr->info_count;
 
+        if (ltgconf_global.rdma && ltgconf_global.daemon
+            && ltgconf_global.rdma_rail > 1 && addr->info_count > 1) {
+                group = ((uint64_t)net_getnid()->id << 32) | (uint32_t)_random();
+        }
+
         for (i = 0; i < addr->info_count; i++) {
                 sock = &addr->info[(i + idx) % addr->info_count];
 
                 if (ltgconf_global.rdma && ltgconf_global.daemon) {
-                        ret = corenet_rdma_connect(sock->addr, sock->port, &sockid);
+                        ret = corenet_rdma_connect(sock->addr, sock->port,
+                                                   group, 0, &sockid);
                         if (unlikely(ret))
                                 continue;
                 } else {
@@ -119,6 +201,11 @@ STATIC int __corenet_maping_connect_core(const coreid_t *coreid,
                 ret = ENONET;
                 GOTO(err_ret, ret);
         }
+
+        if (group) {
+                __corenet_maping_rail(addr, (i + idx) % addr->info_count, group,
+                                      &sockid);
+        }
         
         DBUG("connect to %s/%d sd %u, addr %d:%d\n", netable_rname(&coreid->nid),
              coreid->idx, sockid.sd, sock->addr, sock->port);
@@ -211,6 +298,22 @@ err_ret:
 }
 
 
+static int __corenet_maping_getaddr(const coreid_t *coreid, corenet_addr_t *addr)
+{
+        int ret, valuelen;
+        char key[MAX_NAME_LEN];
+
+        valuelen = MAX_NAME_LEN;
+        snprintf(key, MAX_NAME_LEN, "%d/%d", coreid->nid.id, coreid->idx);
+        ret = etcd_get_bin(ETCD_CORENET, key, (void *)addr, &valuelen, NULL);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
 static int __corenet_maping_connect__(const nid_t *nid, sockid_t *_sockid,
                                       uint64_t *_coremask)
 {
@@ -231,14 +334,12 @@ static int __corenet_maping_connect__(const nid_t *nid, sockid_t *_sockid,
                 if (!core_usedby(coremask, i))
                         continue;
 
-                valuelen = MAX_NAME_LEN;
-                snprintf(key, MAX_NAME_LEN, "%d/%d", nid->id, i);
-                ret = etcd_get_bin(ETCD_CORENET, key, (void *)addr, &valuelen, NULL);
+                coreid.idx = i;
+                ret = __corenet_maping_getaddr(&coreid, addr);
                 if (unlikely(ret)) {
                         GOTO(err_close, ret);
                 }
 
-                coreid.idx = i;
                 ret = __corenet_maping_connect_core(&coreid, addr, &_sockid[i]);
                 if (unlikely(ret)) {
                         GOTO(err_close, ret);
@@ -263,6 +364,135 @@ err_ret:
         return ret;
 }
 
+/*
+ * connect one more connection to a core that is already mapped. the
+ * result is dropped if a full connect ran meanwhile or someone else
+ * filled the slot.
+ */
+static int __corenet_maping_connect_slot(corenet_maping_t *entry, int idx, int k)
+{
+        int ret;
+        char buf[MAX_BUF_LEN];
+        corenet_addr_t *addr = (void *)buf;
+        coreid_t coreid = {entry->nid, idx};
+        sockid_t sockid, *slot;
+        uint32_t gen = entry->gen;
+
+        ret = __corenet_maping_getaddr(&coreid, addr);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        ret = __corenet_maping_connect_core(&coreid, addr, &sockid);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        slot = __corenet_maping_slot(entry, idx, k);
+        if (entry->gen != gen || entry->connected(slot)) {
+                ret = EEXIST;
+                GOTO(err_close, ret);
+        }
+
+        *slot = sockid;
+        __corenet_maping_request(entry, &sockid);
+        ret = corenet_hb_add(&coreid, &sockid);
+        if (unlikely(ret))
+                UNIMPLEMENTED(__DUMP__);
+
+        return 0;
+err_close:
+        __corenet_maping_close_finally__(&entry->nid, &sockid);
+err_ret:
+        return ret;
+}
+
+typedef struct {
+        corenet_maping_t *entry;
+        int idx;
+        int k;
+} repair_ctx_t;
+
+static void __corenet_maping_repair_task(void *arg)
+{
+        int ret;
+        repair_ctx_t *ctx = arg;
+        corenet_maping_t *entry = ctx->entry;
+
+        ret = __corenet_maping_connect_slot(entry, ctx->idx, ctx->k);
+        if (unlikely(ret)) {
+                DWARN("reconnect %s/%d conn %d fail %s\n",
+                      netable_rname(&entry->nid), ctx->idx, ctx->k, strerror(ret));
+        } else {
+                DINFO("reconnect %s/%d conn %d\n", netable_rname(&entry->nid),
+                      ctx->idx, ctx->k);
+        }
+
+        entry->repair[ctx->idx] &= ~(1 << ctx->k);
+        slab_stream_free(ctx);
+}
+
+/* the other connections of the core keep serving meanwhile */
+static void __corenet_maping_repair(corenet_maping_t *entry, int idx, int k)
+{
+        repair_ctx_t *ctx;
+
+        if (entry->repair[idx] & (1 << k))
+                return;
+
+        ctx = slab_stream_alloc(sizeof(*ctx));
+        if (unlikely(ctx == NULL))
+                return;
+
+        ctx->entry = entry;
+        ctx->idx = idx;
+        ctx->k = k;
+        entry->repair[idx] |= 1 << k;
+
+        sche_task_new("corenet_repair", __corenet_maping_repair_task, ctx, -1);
+}
+
+static int __corenet_maping_stripe()
+{
+        if (ltgconf_global.rdma || ltgconf_global.tcp_conn <= 1)
+                return 0;
+
+        return _min(ltgconf_global.tcp_conn, CORENET_CONN_MAX) - 1;
+}
+
+/* bulk connections are best effort, a missing one is repaired on use */
+static void __corenet_maping_update_bulk(corenet_maping_t *entry)
+{
+        int ret;
+
+        if (entry->stripe == 0)
+                return;
+
+        if (entry->bulk == NULL) {
+                ret = ltg_malloc((void **)&entry->bulk,
+                                 sizeof(sockid_t) * CORE_MAX * entry->stripe);
+                if (unlikely(ret)) {
+                        DWARN("%s no bulk connection\n", netable_rname(&entry->nid));
+                        return;
+                }
+
+                for (int i = 0; i < CORE_MAX * entry->stripe; i++) {
+                        entry->bulk[i].sd = -1;
+                }
+        }
+
+        for (int i = 0; i < CORE_MAX; i++) {
+                if (!core_usedby(entry->coremask, i))
+                        continue;
+
+                for (int k = 1; k <= entry->stripe; k++) {
+                        ret = __corenet_maping_connect_slot(entry, i, k);
+                        if (unlikely(ret)) {
+                                DWARN("connect %s/%d conn %d fail %s\n",
+                                      netable_rname(&entry->nid), i, k, strerror(ret));
+                        }
+                }
+        }
+}
+
 STATIC int __corenet_maping_update(const nid_t *nid, const sockid_t *_sockid,
                                    uint64_t coremask)
 {
@@ -279,7 +509,8 @@ STATIC int __corenet_maping_update(const nid_t *nid, const sockid_t *_sockid,
                 entry->connected = corenet_rdma_connected;
         } else {
                 entry->request = corerpc_tcp_request;
-                entry->connected = corenet_tcp_connected;
+                entry->connected = ltgconf_global.tcp_shm
+                        ? __corenet_maping_connected : corenet_tcp_connected;
         }
         
         LTG_ASSERT(entry->connected);
@@ -298,7 +529,7 @@ STATIC int __corenet_maping_update(const nid_t *nid, const sockid_t *_sockid,
 
                 coreid.idx = i;
                 sockid_t sockid = _sockid[i];
-                sockid.request = entry->request;
+                __corenet_maping_request(entry, &sockid);
                 ret = corenet_hb_add(&coreid, &sockid);
                 if (unlikely(ret))
                         UNIMPLEMENTED(__DUMP__);
@@ -306,6 +537,9 @@ STATIC int __corenet_maping_update(const nid_t *nid, const sockid_t *_sockid,
 
         memcpy(entry->sockid, _sockid, sizeof(*_sockid) * CORE_MAX);
         entry->coremask = coremask;
+        entry->gen++;
+
+        __corenet_maping_update_bulk(entry);
 
         __corenet_maping_resume(&entry->wait_list, nid, 0);
         
@@ -331,26 +565,52 @@ err_ret:
         return ret;
 }
 
+/*
+ * small rpcs keep the first connection of the core, bulk ones go round
+ * robin over the rest so a large transfer never queues in front of them.
+ * a dead connection is skipped and repaired in the background, only when
+ * none is left the whole entry is reconnected.
+ */
 static int S_LTG __corenet_maping_get(const coreid_t *coreid,
                                       corenet_maping_t *entry,
-                                      sockid_t *_sockid)
+                                      uint32_t size, sockid_t *_sockid)
 {
-        int ret;
+        int ret, idx, count, start, k;
+        uint32_t down = 0;
         sockid_t *sockid;
 
         if (unlikely(entry->connected == NULL)) {
                 ret = ENONET;
                 GOTO(err_ret, ret);
         }
-        
-        LTG_ASSERT((int)coreid->idx < (int)CORE_MAX);
-        sockid = &entry->sockid[coreid->idx];
 
-        if (likely(entry->connected(sockid))) {
-                *_sockid = *sockid;
+        idx = coreid->idx;
+        LTG_ASSERT(idx < (int)CORE_MAX);
+
+        count = __corenet_maping_count(entry);
+        if (likely(count == 1) || size <= CORENET_CONN_SMALL) {
+                start = 0;
         } else {
-                ret = ENONET;
-                GOTO(err_ret, ret);
+                start = 1 + entry->cursor[idx]++ % entry->stripe;
+        }
+
+        for (int i = 0; i < count; i++) {
+                k = (start + i) % count;
+                sockid = __corenet_maping_slot(entry, idx, k);
+                if (likely(entry->connected(sockid))) {
+                        *_sockid = *sockid;
+                        goto out;
+                }
+
+                down |= 1 << k;
+        }
+
+        ret = ENONET;
+        GOTO(err_ret, ret);
+out:
+        for (k = 0; unlikely(down); k++, down >>= 1) {
+                if (down & 1)
+                        __corenet_maping_repair(entry, idx, k);
         }
 
         return 0;
@@ -469,7 +729,256 @@ err_ret:
         return ret;
 }
 
-int S_LTG corenet_maping(void *core, const coreid_t *coreid, sockid_t *sockid)
+/*
+ * maping_warmup: every node that shows up in conn_scan is connected from
+ * each core right away instead of on the first rpc. a core runs at most
+ * maping_warmup connects at a time, a failed one is retried with backoff.
+ * a node leaves the list when it is closed or no longer listed.
+ */
+typedef struct {
+        uint32_t seq;                   /* warm list seen by the last pass */
+        time_t last;
+        int running;
+} maping_warm_t;
+
+static nid_t __corenet_maping_warm_nid__[NODEID_MAX];
+static uint8_t __corenet_maping_warm_flag__[NODEID_MAX];
+static int __corenet_maping_warm_count__;
+static uint32_t __corenet_maping_warm_seq__;
+static pthread_mutex_t __corenet_maping_warm_lock__ = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t __corenet_maping_mask__;
+static uint32_t __corenet_maping_seen__[CORE_MAX];
+static int __corenet_maping_pending__[CORE_MAX];
+
+static __thread maping_warm_t __maping_warm__;
+
+void corenet_maping_check(const ltg_net_info_t *info)
+{
+        const nid_t *nid = &info->id;
+
+        if (!ltgconf_global.maping_warmup || !ltgconf_global.daemon
+            || net_islocal(nid))
+                return;
+
+        pthread_mutex_lock(&__corenet_maping_warm_lock__);
+
+        if (__corenet_maping_warm_flag__[nid->id] == 0) {
+                __corenet_maping_warm_flag__[nid->id] = 1;
+                __corenet_maping_warm_nid__[__corenet_maping_warm_count__] = *nid;
+                __atomic_store_n(&__corenet_maping_warm_count__,
+                                 __corenet_maping_warm_count__ + 1, __ATOMIC_RELEASE);
+                __atomic_add_fetch(&__corenet_maping_warm_seq__, 1, __ATOMIC_RELEASE);
+                DINFO("warm up %s\n", info->name);
+        }
+
+        pthread_mutex_unlock(&__corenet_maping_warm_lock__);
+}
+
+static void __corenet_maping_uncheck(const nid_t *nid)
+{
+        int count = __corenet_maping_warm_count__;
+
+        if (__corenet_maping_warm_flag__[nid->id] == 0)
+                return;
+
+        for (int i = 0; i < count; i++) {
+                if (__corenet_maping_warm_nid__[i].id != nid->id)
+                        continue;
+
+                /* a pass running meanwhile sees a valid nid either way */
+                __corenet_maping_warm_nid__[i] = __corenet_maping_warm_nid__[count - 1];
+                __atomic_store_n(&__corenet_maping_warm_count__, count - 1,
+                                 __ATOMIC_RELEASE);
+                break;
+        }
+
+        __corenet_maping_warm_flag__[nid->id] = 0;
+        __atomic_add_fetch(&__corenet_maping_warm_seq__, 1, __ATOMIC_RELEASE);
+        DINFO("warm up %s dropped\n", netable_rname(nid));
+}
+
+void corenet_maping_uncheck(const nid_t *nid)
+{
+        if (!ltgconf_global.maping_warmup)
+                return;
+
+        pthread_mutex_lock(&__corenet_maping_warm_lock__);
+        __corenet_maping_uncheck(nid);
+        pthread_mutex_unlock(&__corenet_maping_warm_lock__);
+}
+
+/* drop the nodes conn_scan did not list this time */
+void corenet_maping_prune(const nid_t *nids, int count)
+{
+        int i, k;
+        nid_t nid;
+
+        if (!ltgconf_global.maping_warmup)
+                return;
+
+        pthread_mutex_lock(&__corenet_maping_warm_lock__);
+
+        for (i = __corenet_maping_warm_count__ - 1; i >= 0; i--) {
+                nid = __corenet_maping_warm_nid__[i];
+                for (k = 0; k < count; k++) {
+                        if (nids[k].id == nid.id)
+                                break;
+                }
+
+                if (k == count)
+                        __corenet_maping_uncheck(&nid);
+        }
+
+        pthread_mutex_unlock(&__corenet_maping_warm_lock__);
+}
+
+static int __corenet_maping_full(const corenet_maping_t *entry)
+{
+        if (entry->connected == NULL || entry->coremask == 0)
+                return 0;
+
+        for (int i = 0; i < CORE_MAX; i++) {
+                if (!core_usedby(entry->coremask, i))
+                        continue;
+
+                if (!entry->connected(&entry->sockid[i]))
+                        return 0;
+        }
+
+        return 1;
+}
+
+static int __corenet_maping_any(const corenet_maping_t *entry)
+{
+        if (entry->connected == NULL)
+                return 0;
+
+        for (int i = 0; i < CORE_MAX; i++) {
+                if (core_usedby(entry->coremask, i)
+                    && entry->connected(&entry->sockid[i]))
+                        return 1;
+        }
+
+        return 0;
+}
+
+/* only the cores without a connection, the live ones keep serving */
+static void __corenet_maping_warmup_slot(corenet_maping_t *entry)
+{
+        int ret;
+
+        for (int i = 0; i < CORE_MAX; i++) {
+                if (!core_usedby(entry->coremask, i)
+                    || entry->connected(&entry->sockid[i])
+                    || (entry->repair[i] & 1))
+                        continue;
+
+                entry->repair[i] |= 1;
+                ret = __corenet_maping_connect_slot(entry, i, 0);
+                entry->repair[i] &= ~1;
+                if (unlikely(ret)) {
+                        DWARN("warm up %s/%d fail %s\n",
+                              netable_rname(&entry->nid), i, strerror(ret));
+                }
+        }
+
+        entry->connecting = 0;
+        __corenet_maping_resume(&entry->wait_list, &entry->nid, 0);
+}
+
+static void __corenet_maping_warmup_task(void *arg)
+{
+        corenet_maping_t *entry = arg;
+
+        if (__corenet_maping_any(entry))
+                __corenet_maping_warmup_slot(entry);
+        else
+                __corenet_maping_connect_task(entry);
+
+        if (__corenet_maping_full(entry)) {
+                entry->warm_backoff = 0;
+        } else {
+                entry->warm_backoff = entry->warm_backoff
+                        ? _min(entry->warm_backoff * 2, CORENET_WARMUP_BACKOFF_MAX) : 1;
+                entry->warm_next = gettime() + entry->warm_backoff;
+                DBUG("warm up %s again in %d\n", netable_rname(&entry->nid),
+                     entry->warm_backoff);
+        }
+
+        __maping_warm__.running--;
+}
+
+/* once a second, or as soon as a new node is listed */
+static void __corenet_maping_warmup(void *_core, void *var, void *_maping)
+{
+        corenet_maping_t *maping = _maping, *entry;
+        maping_warm_t *warm = &__maping_warm__;
+        core_t *core = _core;
+        uint32_t seq;
+        int count, pending = 0;
+        time_t now;
+
+        (void) var;
+
+        seq = __atomic_load_n(&__corenet_maping_warm_seq__, __ATOMIC_ACQUIRE);
+        now = gettime();
+        if (likely(seq == warm->seq && now == warm->last))
+                return;
+
+        warm->last = now;
+        count = __atomic_load_n(&__corenet_maping_warm_count__, __ATOMIC_ACQUIRE);
+
+        for (int i = 0; i < count; i++) {
+                entry = &maping[__corenet_maping_warm_nid__[i].id];
+                if (likely(__corenet_maping_full(entry)))
+                        continue;
+
+                pending++;
+                if (entry->connecting || now < entry->warm_next
+                    || warm->running >= ltgconf_global.maping_warmup)
+                        continue;
+
+                entry->connecting = 1;
+                warm->running++;
+                sche_task_new("corenet_warmup", __corenet_maping_warmup_task,
+                              entry, -1);
+        }
+
+        warm->seq = seq;
+        __atomic_store_n(&__corenet_maping_pending__[core->hash], pending,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&__corenet_maping_seen__[core->hash], seq,
+                         __ATOMIC_RELEASE);
+}
+
+/*
+ * true once every core has connected to every core of every node listed
+ * and still up. always false without maping_warmup.
+ */
+int corenet_maping_meshed()
+{
+        uint32_t seq;
+
+        if (!ltgconf_global.maping_warmup || __corenet_maping_mask__ == 0)
+                return 0;
+
+        seq = __atomic_load_n(&__corenet_maping_warm_seq__, __ATOMIC_ACQUIRE);
+
+        for (int i = 0; i < CORE_MAX; i++) {
+                if (!core_usedby(__corenet_maping_mask__, i))
+                        continue;
+
+                if (__atomic_load_n(&__corenet_maping_seen__[i], __ATOMIC_ACQUIRE) != seq
+                    || __atomic_load_n(&__corenet_maping_pending__[i], __ATOMIC_RELAXED))
+                        return 0;
+        }
+
+        return 1;
+}
+
+int S_LTG corenet_maping1(void *core, const coreid_t *coreid, uint32_t size,
+                          sockid_t *sockid)
 {
         int ret;
         corenet_maping_t *entry;
@@ -479,7 +988,7 @@ retry:
         entry = &__corenet_maping_get_byctx(core)[coreid->nid.id];
         LTG_ASSERT(entry);
 
-        ret = __corenet_maping_get(coreid, entry, sockid);
+        ret = __corenet_maping_get(coreid, entry, size, sockid);
         if (unlikely(ret)) {
                 /**
                  * 保证过程唯一性，只有一个task发起连接，其它并发task等待连接完成
@@ -493,7 +1002,7 @@ retry:
                 goto retry;
         }
 
-        sockid->request = entry->request;
+        __corenet_maping_request(entry, sockid);
 
         ANALYSIS_QUEUE(0, IO_WARN, NULL);
 
@@ -502,16 +1011,43 @@ err_ret:
         return ret;
 }
 
+/* whether corenet_maping1 to coreid returns without waiting for a connect */
+int S_LTG corenet_maping_ready(void *core, const coreid_t *coreid)
+{
+        int count;
+        corenet_maping_t *entry;
+
+        entry = &__corenet_maping_get_byctx(core)[coreid->nid.id];
+        if (unlikely(entry->connected == NULL))
+                return 0;
+
+        count = __corenet_maping_count(entry);
+        for (int k = 0; k < count; k++) {
+                if (entry->connected(__corenet_maping_slot(entry, coreid->idx, k)))
+                        return 1;
+        }
+
+        return 0;
+}
+
+int S_LTG corenet_maping(void *core, const coreid_t *coreid, sockid_t *sockid)
+{
+        return corenet_maping1(core, coreid, 0, sockid);
+}
+
 static void __corenet_maping_close_entry(corenet_maping_t *entry,
                                          const sockid_t *_sockid)
 {
         sockid_t *sockid;
+        int count = __corenet_maping_count(entry);
+
+        for (int n = 0; n < CORE_MAX * count; n++) {
+                int i = n / count;
 
-        for (int i = 0; i < CORE_MAX; i++) {
                 if (!core_usedby(entry->coremask, i))
                         continue;
 
-                sockid = &entry->sockid[i];
+                sockid = __corenet_maping_slot(entry, i, n % count);
                 if (sockid->sd == -1) {
                         continue;
                 }
@@ -566,6 +1102,13 @@ static int __corenet_maping_init__(corenet_maping_t **_maping)
                 entry->connecting = 0;
                 entry->nid = nid;
                 entry->coreid = coreid.idx;
+                entry->stripe = __corenet_maping_stripe();
+                entry->gen = 0;
+                entry->bulk = NULL;
+                memset(entry->cursor, 0x0, sizeof(entry->cursor));
+                memset(entry->repair, 0x0, sizeof(entry->repair));
+                entry->warm_next = 0;
+                entry->warm_backoff = 0;
         }
 
         core_tls_set(VARIABLE_MAPING, maping);
@@ -630,6 +1173,13 @@ static int __corenet_maping_init(va_list ap)
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
+        if (ltgconf_global.maping_warmup && ltgconf_global.daemon) {
+                ret = core_register_routine("corenet_warmup",
+                                            __corenet_maping_warmup, core->maping);
+                if (unlikely(ret))
+                        GOTO(err_ret, ret);
+        }
+
         return 0;
 err_ret:
         return ret;
@@ -644,6 +1194,8 @@ int corenet_maping_init(uint64_t mask)
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
+        __corenet_maping_mask__ = mask;
+
         return 0;
 err_ret:
         return ret;
@@ -124,6 +124,63 @@ void __rdma_destroy_qp(struct rdma_cm_id *cm_id, const char *env)
         rdma_destroy_qp(cm_id);
 }
 
+/* unsignaled inline sends carry no wr_id, see __corenet_rdma_signal */
+static inline rdma_req_t *__corenet_rdma_sr_req(struct ibv_send_wr *sr)
+{
+        if (likely(sr->wr_id))
+                return (rdma_req_t *)sr->wr_id;
+
+        if (sr->send_flags & IBV_SEND_INLINE)
+                return container_of(sr, rdma_req_t, wr.sr[0]);
+
+        return NULL;
+}
+
+/* segments of a write outside the hugepage mr hold a cached registration */
+static void __corenet_rdma_req_free(rdma_req_t *req)
+{
+        int i;
+
+        if (req->mode == RDMA_WRITE) {
+                for (i = 0; i < MAX_SGE; i++) {
+                        if (req->mr[i]) {
+                                rdma_mr_put(req->mr[i]);
+                                req->mr[i] = NULL;
+                        }
+                }
+        }
+
+        ltgbuf_free(&req->msg_buf);
+}
+
+static void __corenet_rdma_rail_unlink(corenet_rdma_t *rdma_net, corenet_node_t *node)
+{
+        int i, loc = node - rdma_net->array;
+        corenet_node_t *primary;
+
+        if (node->rail_primary >= 0) {
+                primary = &rdma_net->array[node->rail_primary];
+                for (i = 0; i < primary->rail_count; i++) {
+                        if (primary->rail[i] == loc) {
+                                primary->rail[i] = primary->rail[--primary->rail_count];
+                                break;
+                        }
+                }
+        }
+
+        for (i = 0; i < node->rail_count; i++) {
+                rdma_net->array[node->rail[i]].rail_primary = -1;
+        }
+
+        node->rail_group = 0;
+        node->rail_idx = 0;
+        node->rail_rkey = 0;
+        node->rail_primary = -1;
+        node->rail_count = 0;
+        node->rail_bytes = 0;
+        node->rail_errors = 0;
+}
+
 static void __corenet_rdma_free_node(corenet_rdma_t *rdma_net, corenet_node_t *node)
 {
         if (!list_empty(&node->hook)) {
@@ -147,13 +204,22 @@ static void __corenet_rdma_free_node(corenet_rdma_t *rdma_net, corenet_node_t *n
         node->sockid.sd = -1;
         node->in_use = 0;
 
+        __corenet_rdma_rail_unlink(rdma_net, node);
+
         node->send_count = 0;
+        node->send_ref = 0;
+        node->send_inline = 0;
+        node->send_seq = 0;
+        node->unsignaled = 0;
+        INIT_LIST_HEAD(&node->unsignaled_list);
         node->head_sr.next = NULL;
         node->last_sr = &node->head_sr;
 
         memset(&node->handler, 0x00, sizeof(rdma_conn_t));
 }
 
+static void __corenet_rdma_stripe_fail(corenet_rdma_t *corenet, rdma_req_t *chunk);
+
 static void __corenet_rdma_free_node1(core_t *_core, sockid_t *sockid)
 {
         corenet_node_t *node = NULL;
@@ -167,11 +233,13 @@ static void __corenet_rdma_free_node1(core_t *_core, sockid_t *sockid)
 		rdma_req_t *req;
 		int nr = 0;
 		while (sr) {
-			req = (rdma_req_t *)sr->wr_id;
-			if (req && req->msg_buf.len){
-				ltgbuf_free(&req->msg_buf);
-			}
+			req = __corenet_rdma_sr_req(sr);
 			sr = sr->next;
+			if (req && req->mode == RDMA_STRIPE) {
+				__corenet_rdma_stripe_fail(corenet, req);
+			} else if (req && req->msg_buf.len){
+				__corenet_rdma_req_free(req);
+			}
 
                         nr++;
 		}
@@ -246,8 +314,22 @@ int corenet_rdma_add(core_t *_core, sockid_t *sockid, void *ctx, core_exec exec,
         handler->nr_get = 0;
         handler->nr_ack = 0;
 
+        handler->nr_success = 0;
         handler->nr_flush = 0;
         handler->nr_other = 0;
+        handler->nr_post = 0;
+        handler->nr_send_wr = 0;
+        handler->nr_inline = 0;
+        handler->nr_recv_wr = 0;
+        handler->nr_send_cqe = 0;
+
+        node->rail_group = 0;
+        node->rail_idx = 0;
+        node->rail_rkey = 0;
+        node->rail_primary = -1;
+        node->rail_count = 0;
+        node->rail_bytes = 0;
+        node->rail_errors = 0;
 
         sockid->sd = loc;
         sockid->rdma_handler = handler;
@@ -308,21 +390,27 @@ static void __corenet_rdma_close(rdma_conn_t *rdma_handler)
 		rdma_req_t *req;
 		int nr = 0;
 		while (sr) {
-			req = (rdma_req_t *)sr->wr_id;
-			if (req && req->msg_buf.len) {
-				ltgbuf_free(&req->msg_buf);
-			}
+			req = __corenet_rdma_sr_req(sr);
 			sr = sr->next;
+			if (req && req->mode == RDMA_STRIPE) {
+				__corenet_rdma_stripe_fail(__corenet_rdma__, req);
+			} else if (req && req->msg_buf.len) {
+				__corenet_rdma_req_free(req);
+			}
 
 			nr++;
 		}
 		LTG_ASSERT(node->send_count == nr);
 	}
 
-        IBV_MR_DUMP_L(DINFO, rdma_handler->iov_mr);
-	ibv_dereg_mr(rdma_handler->iov_mr);
+        if (rinfo->srq) {
+                htab_remove(rinfo->srq->qp_tab, &rdma_handler->qp->qp_num, NULL);
+        } else {
+                IBV_MR_DUMP_L(DINFO, rdma_handler->iov_mr);
+                ibv_dereg_mr(rdma_handler->iov_mr);
 
-        ltg_free(&rdma_handler->iov_addr);
+                ltg_free(&rdma_handler->iov_addr);
+        }
 
         __rdma_destroy_qp(cm_id, __FUNCTION__);
 
@@ -387,8 +475,9 @@ void S_LTG corenet_rdma_put(rdma_conn_t *rdma_handler, const char *caller,
 
 void corenet_rdma_close(rdma_conn_t *rdma_handler, const char *caller)
 {
-        int ret;
+        int ret, i;
         corenet_node_t *node = container_of(rdma_handler, corenet_node_t, handler);
+        corenet_rdma_t *rdma_net;
 
         DBUG("sockid %d srv_running %d rdma_running %d\n",
               node->sockid.sd, srv_running, rdma_running);
@@ -407,6 +496,13 @@ void corenet_rdma_close(rdma_conn_t *rdma_handler, const char *caller)
 
                 list_del_init(&node->send_list);
 
+                /* rails only live as long as their connection */
+                rdma_net = ((__corenet_t *)rdma_handler->core->corenet)->rdma_net;
+                for (i = 0; i < node->rail_count; i++) {
+                        corenet_rdma_close(&rdma_net->array[node->rail[i]].handler,
+                                           caller);
+                }
+
 #if 0
                 corerpc_rdma_reset(&node->sockid);
 #endif
@@ -435,6 +531,186 @@ void __iovs_post_recv_init(rdma_req_t *req, void *ptr)
         req->wr.rr.num_sge = 1;
 }
 
+/*
+ * rdma_srq: receive slots come from one shared receive queue per core and
+ * device instead of DEFAULT_MH_NUM slots for every qp. a slot belongs to no
+ * connection until it completes, the completion is mapped back by qp_num
+ * and holds a ref of that connection until the rpc layer gives the slot
+ * back. given back slots wait on free_list and corenet_rdma_poll posts
+ * them in batches.
+ */
+#define RDMA_SRQ_BATCH 32
+
+static uint32_t __corenet_rdma_srq_key(const void *_key)
+{
+        return *(uint32_t *)_key;
+}
+
+static int __corenet_rdma_srq_cmp(const void *_v1, const void *_v2)
+{
+        const rdma_conn_t *rdma_handler = _v1;
+
+        return rdma_handler->qp->qp_num != *(uint32_t *)_v2;
+}
+
+static void __corenet_rdma_srq_slot(rdma_srq_t *srq, rdma_req_t *req)
+{
+        struct ibv_sge *sge;
+
+        req->mode = RDMA_RECV_MSG;
+        req->err = 0;
+        req->srq = srq;
+        req->rdma_handler = NULL;
+
+        sge = &req->sge[0];
+        sge->addr = (uintptr_t)req - RDMA_MESSAGE_SIZE;
+        sge->length = RDMA_MESSAGE_SIZE;
+        sge->lkey = srq->mr->lkey;
+
+        memset(&req->wr.rr, 0, sizeof(struct ibv_recv_wr));
+        req->wr.rr.wr_id = (uint64_t)req;
+        req->wr.rr.sg_list = sge;
+        req->wr.rr.num_sge = 1;
+
+        req->wr.rr.next = srq->free_list;
+        srq->free_list = &req->wr.rr;
+        srq->nr_free++;
+}
+
+static int __corenet_rdma_srq_post(rdma_srq_t *srq)
+{
+        int ret;
+        uint32_t left = 0;
+        struct ibv_recv_wr *bad_wr = NULL, *wr;
+
+        ret = ibv_post_srq_recv(srq->srq, srq->free_list, &bad_wr);
+        if (unlikely(ret)) {
+                for (wr = bad_wr; wr; wr = wr->next) {
+                        left++;
+                }
+
+                DWARN("post srq %u/%u ret %d\n", srq->nr_free - left,
+                      srq->nr_free, ret);
+        }
+
+        srq->nr_posted += srq->nr_free - left;
+        srq->nr_free = left;
+        srq->free_list = left ? bad_wr : NULL;
+        srq->nr_refill++;
+
+        return ret;
+}
+
+static inline void __corenet_rdma_srq_refill(rdma_srq_t *srq)
+{
+        if (likely(srq->nr_free < RDMA_SRQ_BATCH
+                   && srq->nr_posted >= srq->count / 2))
+                return;
+
+        if (srq->nr_free)
+                (void) __corenet_rdma_srq_post(srq);
+}
+
+static rdma_conn_t *__corenet_rdma_srq_bind(rdma_req_t *req, uint32_t qp_num)
+{
+        rdma_srq_t *srq = req->srq;
+        rdma_conn_t *rdma_handler;
+
+        srq->nr_posted--;
+
+        rdma_handler = htab_find(srq->qp_tab, &qp_num);
+        if (unlikely(rdma_handler == NULL)) {
+                DBUG("qp %u closed\n", qp_num);
+                __corenet_rdma_srq_slot(srq, req);
+                return NULL;
+        }
+
+        req->rdma_handler = rdma_handler;
+        corenet_rdma_get(rdma_handler, 1, __FUNCTION__, 0);
+
+        return rdma_handler;
+}
+
+static int __corenet_rdma_srq_create(rdma_info_t *dev,
+                                     const struct ibv_device_attr *device_attr)
+{
+        int ret;
+        uint32_t i, size = RDMA_INFO_SIZE + RDMA_MESSAGE_SIZE;
+        rdma_srq_t *srq;
+        struct ibv_srq_init_attr attr;
+
+        ret = ltg_malloc((void **)&srq, sizeof(*srq));
+        if (ret)
+                GOTO(err_ret, ret);
+
+        memset(srq, 0x0, sizeof(*srq));
+
+        srq->count = min_t(uint32_t, ltgconf_global.rdma_srq,
+                           device_attr->max_srq_wr);
+        if (srq->count == 0) {
+                ret = ENOTSUP;
+                GOTO(err_free, ret);
+        }
+
+        memset(&attr, 0x0, sizeof(attr));
+        attr.attr.max_wr = srq->count;
+        attr.attr.max_sge = 1;
+        srq->srq = ibv_create_srq(dev->pd, &attr);
+        if (srq->srq == NULL) {
+                ret = errno;
+                GOTO(err_free, ret);
+        }
+
+        /* first touched here, on the core that polls it */
+        ret = posix_memalign(&srq->addr, 4096, size * srq->count);
+        if (ret)
+                GOTO(err_srq, ret);
+
+        memset(srq->addr, 0x0, size * srq->count);
+
+        srq->mr = rdma_register_mr(dev->pd, srq->addr, size * srq->count);
+        if (srq->mr == NULL) {
+                ret = ENOMEM;
+                GOTO(err_addr, ret);
+        }
+
+        srq->qp_tab = htab_create(__corenet_rdma_srq_cmp,
+                                  __corenet_rdma_srq_key, "rdma_srq");
+        if (srq->qp_tab == NULL) {
+                ret = ENOMEM;
+                GOTO(err_mr, ret);
+        }
+
+        static_assert(sizeof(rdma_req_t) <= RDMA_INFO_SIZE, "rdma_req_t");
+
+        for (i = 0; i < srq->count; i++) {
+                __corenet_rdma_srq_slot(srq, srq->addr + i * size + RDMA_MESSAGE_SIZE);
+        }
+
+        ret = __corenet_rdma_srq_post(srq);
+        if (ret)
+                GOTO(err_tab, ret);
+
+        DINFO("srq %p slot %u mem %ju\n", srq->srq, srq->count,
+              (uint64_t)size * srq->count);
+
+        dev->srq = srq;
+
+        return 0;
+err_tab:
+        htab_destroy(srq->qp_tab, NULL, NULL);
+err_mr:
+        ibv_dereg_mr(srq->mr);
+err_addr:
+        free(srq->addr);
+err_srq:
+        ibv_destroy_srq(srq->srq);
+err_free:
+        ltg_free((void **)&srq);
+err_ret:
+        return ret;
+}
+
 int corenet_rdma_post_recv(void *ptr)
 {
         int ret;
@@ -448,6 +724,12 @@ int corenet_rdma_post_recv(void *ptr)
 
         rdma_handler = req->rdma_handler;
 
+        if (req->srq) {
+                __corenet_rdma_srq_slot(req->srq, req);
+                corenet_rdma_put(rdma_handler, __FUNCTION__, 1);
+                return 0;
+        }
+
         if (likely(rdma_handler->is_closing == 0)){
 
                 if (req->mode == RDMA_READ)
@@ -458,6 +740,8 @@ int corenet_rdma_post_recv(void *ptr)
                 ret = ibv_post_recv(req->rdma_handler->qp, &req->wr.rr, &bad_wr);
                 if (unlikely(ret))
                         GOTO(err_ret, ret);
+
+                rdma_handler->nr_recv_wr++;
         } else {
                 corenet_rdma_put(rdma_handler, __FUNCTION__, 1);
         }
@@ -469,16 +753,14 @@ err_ret:
 }
 
 inline rdma_req_t INLINE *build_post_send_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf,
-                                              void **addr, uint32_t rkey, uint32_t size)
+                                              const data_prop_t *prop)
 {
         struct ibv_send_wr *sr = NULL;
         rdma_req_t *req = NULL;
         void *ptr = ltgbuf_head1(buf, sizeof(ltg_net_head_t));
         ltg_net_head_t *net_head = ptr;
 
-        (void)addr;
-        (void)rkey;
-        (void)size;
+        (void)prop;
 
         LTG_ASSERT(net_head->magic == LTG_MSG_MAGIC);
 
@@ -490,7 +772,9 @@ inline rdma_req_t INLINE *build_post_send_req(rdma_conn_t *rdma_handler, ltgbuf_
         req->ref = ltgbuf_trans_sge(req->sge, buf, &req->msg_buf, rdma_handler->mr->lkey);
         LTG_ASSERT(req->ref == 1);
 
+        req->nr_sge = 1;
         req->mode = RDMA_SEND_MSG;
+        req->n = 0;
         req->rdma_handler = rdma_handler;
         sr = &req->wr.sr[0];
 
@@ -501,24 +785,44 @@ inline rdma_req_t INLINE *build_post_send_req(rdma_conn_t *rdma_handler, ltgbuf_
         sr->num_sge = 1;
         sr->opcode = IBV_WR_SEND;
         sr->send_flags = IBV_SEND_SIGNALED;
+        if (req->sge[0].length <= rdma_handler->max_inline)
+                sr->send_flags |= IBV_SEND_INLINE;
 
         RDMA_REQ_DUMP_L(DBUG, req);
         return req;
 }
 
+static void __corenet_rdma_wr_init(rdma_req_t *req, struct ibv_send_wr *sr,
+                                   enum ibv_wr_opcode opcode, uintptr_t addr,
+                                   uint32_t rkey)
+{
+        memset(sr, 0x00, sizeof(struct ibv_send_wr));
+        sr->wr_id = (uint64_t)req;
+        sr->opcode = opcode;
+        sr->send_flags = IBV_SEND_SIGNALED;
+        sr->wr.rdma.remote_addr = (uint64_t)addr;
+        sr->wr.rdma.rkey = rkey;
+}
+
+/*
+ * the peer's payload may be scattered over up to MAX_DATA_SGE segments.
+ * a read takes one wr per remote segment, each into its part of one local
+ * buffer.
+ */
 inline rdma_req_t INLINE *build_rdma_read_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf,
-                                              void **addr, uint32_t rkey, uint32_t size)
+                                              const data_prop_t *prop)
 {
         struct ibv_send_wr *sr, *tail, head;
         rdma_req_t *req ;
         void *ptr = ltgbuf_head1(buf, sizeof(ltg_net_head_t));
-        uint32_t index;
+        uint32_t index, off;
+        uintptr_t base;
         ltgbuf_t _buf;
 
         ltg_net_head_t *net_head = ptr;
         LTG_ASSERT(net_head->magic == LTG_MSG_MAGIC);
 
-        LTG_ASSERT(rkey > 0);
+        LTG_ASSERT(prop->rkey > 0);
         LTG_ASSERT(buf->len <= RDMA_MESSAGE_SIZE);
         LTG_ASSERT(sizeof(rdma_req_t) <= RDMA_INFO_SIZE);
 
@@ -531,44 +835,193 @@ inline rdma_req_t INLINE *build_rdma_read_req(rdma_conn_t *rdma_handler, ltgbuf_
         ltgbuf_init(&req->msg_buf, 0);
         ltgbuf_merge(&req->msg_buf, buf);
 
-        ltgbuf_init(&_buf, size);
+        ltgbuf_init(&_buf, prop->size);
         LTG_ASSERT(ltgbuf_segcount(&_buf) == 1);
         
-        req->ref = ltgbuf_trans_sge(req->sge, NULL, &_buf, rdma_handler->mr->lkey);
+        ltgbuf_trans_sge(req->sge, NULL, &_buf, rdma_handler->mr->lkey);
         ltgbuf_merge(&req->msg_buf, &_buf);
 
-        LTG_ASSERT(req->ref == 1);
-
+        base = req->sge[0].addr;
+        off = 0;
         tail = &head;
         tail->next = NULL;
-        for (index = 0; index < req->ref; index++) {
+        for (index = 0; index < MAX_DATA_SGE && prop->remote_len[index]; index++) {
+                req->sge[index].addr = base + off;
+                req->sge[index].length = prop->remote_len[index];
+                req->sge[index].lkey = rdma_handler->mr->lkey;
+                off += prop->remote_len[index];
+
                 sr = &req->wr.sr[index];
-                memset(sr, 0x00, sizeof(struct ibv_send_wr));
-                sr->wr_id = (uint64_t)req;
+                __corenet_rdma_wr_init(req, sr, IBV_WR_RDMA_READ,
+                                       prop->remote_addr[index], prop->rkey);
                 sr->sg_list = &req->sge[index];
                 sr->num_sge = 1;
-                sr->opcode = IBV_WR_RDMA_READ;
-                sr->send_flags = IBV_SEND_SIGNALED;
-                sr->wr.rdma.remote_addr = (uint64_t)addr[index];
-                sr->wr.rdma.rkey = rkey;
 
                 tail->next = sr;
                 tail = sr;
                 tail->next = NULL;
         }
 
+        LTG_ASSERT(index > 0 && off == prop->size);
+        req->ref = index;
+        req->nr_sge = index;
+
         RDMA_REQ_DUMP_L(DBUG, req);
         return req;
 }
 
+/*
+ * reply data handed over by the application may live outside the hugepage
+ * mr, such segments get their lkey from the registration cache. ENOMEM if
+ * a segment is not in an allowed range or a registration fails, nothing
+ * is held then and the caller copies.
+ */
+static int __corenet_rdma_write_mr(rdma_conn_t *rdma_handler, rdma_req_t *req)
+{
+        int ret;
+        uint32_t i;
+        struct ibv_mr *mr;
+        struct ibv_sge *sge;
+
+        memset(req->mr, 0x0, sizeof(req->mr));
+
+        if (likely(rdma_handler->dev->mr_cache == NULL))
+                return 0;
+
+        for (i = 1; i < req->nr_sge; i++) {
+                sge = &req->sge[i];
+                if (likely(rdma_mr_registered((void *)sge->addr, sge->length)))
+                        continue;
+
+                if (!rdma_mr_allowed((void *)sge->addr, sge->length)) {
+                        ret = ENOMEM;
+                        goto err_put;
+                }
+
+                req->mr[i] = rdma_mr_get(rdma_handler->dev, (void *)sge->addr,
+                                         sge->length, &mr);
+                if (unlikely(req->mr[i] == NULL)) {
+                        ret = ENOMEM;
+                        DWARN("register %p len %u fail\n", (void *)sge->addr,
+                              sge->length);
+                        GOTO(err_put, ret);
+                }
+
+                sge->lkey = mr->lkey;
+        }
+
+        return 0;
+err_put:
+        for (i = 1; i < req->nr_sge; i++) {
+                if (req->mr[i]) {
+                        rdma_mr_put(req->mr[i]);
+                        req->mr[i] = NULL;
+                }
+        }
+
+        return ret;
+}
+
+/*
+ * lay the local data segments over the remote ones: one rdma write per
+ * remote segment, gathering the local pieces that fall into it. a local
+ * segment across a remote boundary is split. returns the writes built or
+ * -1 if it takes more sges than the req or the qp has.
+ */
+static int __corenet_rdma_write_sg(rdma_conn_t *rdma_handler, rdma_req_t *req,
+                                   const struct ibv_sge *data, int count,
+                                   const data_prop_t *prop)
+{
+        int i, j = 0;
+        uint32_t off = 0, left, len, nr_sge = 1;
+        struct ibv_send_wr *sr;
+        struct ibv_sge *sge;
+
+        for (i = 0; i < MAX_DATA_SGE && prop->remote_len[i] && j < count; i++) {
+                sr = &req->wr.sr[i];
+                __corenet_rdma_wr_init(req, sr, IBV_WR_RDMA_WRITE,
+                                       prop->remote_addr[i], prop->rkey);
+                sr->sg_list = &req->sge[nr_sge];
+
+                for (left = prop->remote_len[i]; left && j < count; left -= len) {
+                        if (nr_sge == MAX_SGE
+                            || sr->num_sge == (int)rdma_handler->max_sge)
+                                return -1;
+
+                        len = _min(left, data[j].length - off);
+                        sge = &req->sge[nr_sge++];
+                        sge->addr = data[j].addr + off;
+                        sge->length = len;
+                        sge->lkey = data[j].lkey;
+                        sr->num_sge++;
+
+                        off += len;
+                        if (off == data[j].length) {
+                                off = 0;
+                                j++;
+                        }
+                }
+
+                if (i)
+                        req->wr.sr[i - 1].next = sr;
+        }
+
+        /* the requester sized its buffer for the reply */
+        LTG_ASSERT(j == count);
+        req->nr_sge = nr_sge;
+
+        return i;
+}
+
+/* data that does not fit the remote layout is copied into one segment */
+static void __corenet_rdma_write_flat(ltgbuf_t *buf)
+{
+        int ret, count = 1;
+        struct iovec iov;
+        ltgbuf_t msg;
+
+        ltgbuf_trans(&iov, &count, buf);
+        ltgbuf_init(&msg, 0);
+        ret = ltgbuf_pop(buf, &msg, iov.iov_len);
+        if (unlikely(ret))
+                UNIMPLEMENTED(__DUMP__);
+
+        ret = ltgbuf_compress(buf);
+        if (unlikely(ret))
+                UNIMPLEMENTED(__DUMP__);
+
+        ltgbuf_merge(&msg, buf);
+        ltgbuf_merge(buf, &msg);
+}
+
+static int __corenet_rdma_write_fit(rdma_conn_t *rdma_handler, rdma_req_t *req,
+                                    const ltgbuf_t *buf, const data_prop_t *prop)
+{
+        int i, count = MAX_SGE;
+        struct iovec iov[MAX_SGE];
+        struct ibv_sge data[MAX_SGE];
+
+        if (ltgbuf_segcount(buf) > MAX_SGE)
+                return 0;
+
+        ltgbuf_trans(iov, &count, buf);
+        for (i = 1; i < count; i++) {
+                data[i - 1].addr = (uintptr_t)iov[i].iov_base;
+                data[i - 1].length = iov[i].iov_len;
+                data[i - 1].lkey = 0;
+        }
+
+        return __corenet_rdma_write_sg(rdma_handler, req, data, count - 1, prop) >= 0;
+}
+
 inline rdma_req_t INLINE *build_rdma_write_req(rdma_conn_t *rdma_handler, ltgbuf_t *buf,
-                                               void **addr, uint32_t rkey, uint32_t size)
+                                               const data_prop_t *prop)
 {
-        struct ibv_send_wr *sr, head, *tail, *msg_sr;
+        int count;
+        struct ibv_send_wr *msg_sr;
+        struct ibv_sge data[MAX_SGE];
         rdma_req_t *req = NULL;
         void *ptr = ltgbuf_head1(buf, sizeof(ltg_net_head_t));
-        uint32_t index;
-        (void)size;
         ltg_net_head_t *net_head = ptr;
         LTG_ASSERT(net_head->magic == LTG_MSG_MAGIC);
         req = (rdma_req_t *)(ptr + RDMA_MESSAGE_SIZE);
@@ -577,47 +1030,119 @@ inline rdma_req_t INLINE *build_rdma_write_req(rdma_conn_t *rdma_handler, ltgbuf
         req->n = 0;
         req->rdma_handler = rdma_handler;
 
+        if (ltgbuf_segcount(buf) > 1
+            && unlikely(!__corenet_rdma_write_fit(rdma_handler, req, buf, prop))) {
+                DBUG("reply %u in %d segments copied\n", buf->len,
+                     ltgbuf_segcount(buf) - 1);
+                __corenet_rdma_write_flat(buf);
+        }
+
         ltgbuf_init(&req->msg_buf, 0);
 
-        req->ref = ltgbuf_trans_sge(req->sge, buf, &req->msg_buf, rdma_handler->mr->lkey);
-        LTG_ASSERT(req->ref <= MAX_SGE);
+        req->nr_sge = ltgbuf_trans_sge(req->sge, buf, &req->msg_buf, rdma_handler->mr->lkey);
+        LTG_ASSERT(req->nr_sge <= MAX_SGE);
+        if (unlikely(__corenet_rdma_write_mr(rdma_handler, req))) {
+                /* the copy is hugepage memory, covered by the mr */
+                __corenet_rdma_write_flat(&req->msg_buf);
+                req->nr_sge = ltgbuf_trans_sge(req->sge, NULL, &req->msg_buf,
+                                               rdma_handler->mr->lkey);
+                LTG_ASSERT(req->nr_sge <= MAX_SGE);
+                if (unlikely(__corenet_rdma_write_mr(rdma_handler, req)))
+                        UNIMPLEMENTED(__DUMP__);
+        }
 
-        msg_sr = &req->wr.sr[req->ref - 1];
+        count = 0;
+        if (req->nr_sge > 1) {
+                LTG_ASSERT(prop->rkey > 0);
+                memcpy(data, &req->sge[1], sizeof(*data) * (req->nr_sge - 1));
+                count = __corenet_rdma_write_sg(rdma_handler, req, data,
+                                                req->nr_sge - 1, prop);
+                LTG_ASSERT(count > 0);
+        }
+
+        req->ref = count + 1;
+        msg_sr = &req->wr.sr[count];
+        memset(msg_sr, 0x00, sizeof(*msg_sr));
         msg_sr->wr_id = (uint64_t)req;
         msg_sr->sg_list = &req->sge[0];
         msg_sr->num_sge = 1;
         msg_sr->opcode = IBV_WR_SEND;
         msg_sr->send_flags = IBV_SEND_SIGNALED;
+        if (req->sge[0].length <= rdma_handler->max_inline)
+                msg_sr->send_flags |= IBV_SEND_INLINE;
         msg_sr->next = NULL;
 
-        if (req->ref == 1) {
-                return req;
+        /*send message after RDMA_WRITE*/
+        if (count)
+                req->wr.sr[count - 1].next = msg_sr;
+
+        RDMA_REQ_DUMP_L(DBUG, req);
+        return req;
+}
+
+/*
+ * rdma_signal: only one send wr in rdma_signal asks for a completion. a qp
+ * completes its send queue in order, so when a signaled wr is done every
+ * wr posted before it is done too, and the reqs left unsignaled are
+ * released from unsignaled_list by seq. a flushed unsignaled wr still
+ * completes with an error and is released the same way. rdma writes
+ * complete with the send behind them, an unsignaled inline send owns
+ * nothing once posted and is freed by the commit.
+ */
+static void __corenet_rdma_sweep(corenet_node_t *node, uint32_t seq)
+{
+        rdma_req_t *req;
+
+        while (!list_empty(&node->unsignaled_list)) {
+                req = list_entry(node->unsignaled_list.next, rdma_req_t, hook);
+                if ((int32_t)(req->seq - seq) > 0)
+                        break;
+
+                list_del_init(&req->hook);
+                __corenet_rdma_req_free(req);
+                corenet_rdma_put(&node->handler, __FUNCTION__, 0);
         }
+}
 
-        LTG_ASSERT(rkey > 0);
-        head.next = NULL;
-        tail = &head;
-        for (index = 0; index < req->ref - 1; index++) {
-                sr = &req->wr.sr[index];
-                memset(sr, 0x00, sizeof(struct ibv_send_wr));
-                sr->wr_id = (uint64_t)req;
-                sr->sg_list = &req->sge[index + 1];
-                //DINFO("rdma write addr %p %d\n", req->sge[index + 1].addr, req->sge[index + 1].length);
-                sr->num_sge = 1;
-                sr->opcode = IBV_WR_RDMA_WRITE;
-                sr->send_flags = IBV_SEND_SIGNALED;
-                sr->wr.rdma.remote_addr = (uint64_t)addr[index];
-                sr->wr.rdma.rkey = rkey;
+/* returns the conn refs the req holds once posted */
+static int __corenet_rdma_signal(corenet_node_t *node, rdma_req_t *req)
+{
+        uint32_t i;
+        struct ibv_send_wr *sr = &req->wr.sr[req->ref - 1];
 
-                tail->next = sr;
-                tail = sr;
+        node->send_seq += req->ref;
+        req->seq = node->send_seq;
+        req->n = 1;
+        INIT_LIST_HEAD(&req->hook);
+
+        /* exec1 runs from the read completion */
+        if (req->mode == RDMA_READ) {
+                node->unsignaled = 0;
+                return req->ref;
         }
 
-        /*send message after RDMA_WRITE*/
-        tail->next = msg_sr;
+        for (i = 0; i < req->ref - 1; i++) {
+                req->wr.sr[i].wr_id = 0;
+                req->wr.sr[i].send_flags = 0;
+        }
 
-        RDMA_REQ_DUMP_L(DBUG, req);
-        return req;
+        node->unsignaled += req->ref;
+        if (node->unsignaled >= (uint32_t)_min(ltgconf_global.rdma_signal,
+                                               DEFAULT_MH_NUM / 2)) {
+                node->unsignaled = 0;
+                return 1;
+        }
+
+        sr->send_flags &= ~IBV_SEND_SIGNALED;
+        if (req->mode == RDMA_SEND_MSG && (sr->send_flags & IBV_SEND_INLINE)) {
+                sr->wr_id = 0;
+                node->send_inline++;
+                return 0;
+        }
+
+        list_add_tail(&req->hook, &node->unsignaled_list);
+
+        return 1;
 }
 
 /**
@@ -628,6 +1153,8 @@ inline rdma_req_t INLINE *build_rdma_write_req(rdma_conn_t *rdma_handler, ltgbuf
  * @see corerpc_rdma_recv_msg
  * @see __corenet_rdma_add
  */
+static void __corenet_rdma_stripe_done(corenet_rdma_t *corenet, rdma_req_t *chunk);
+
 static int S_LTG __corenet_rdma_handle_wc(struct ibv_wc *wc, __corenet_t *corenet)
 {
         rdma_conn_t *rdma_handler;
@@ -637,13 +1164,30 @@ static int S_LTG __corenet_rdma_handle_wc(struct ibv_wc *wc, __corenet_t *corene
         int count = 0;
 
         req = (rdma_req_t *)wc->wr_id;
-        rdma_handler = req->rdma_handler;
+        if (req->mode == RDMA_RECV_MSG && req->srq) {
+                rdma_handler = __corenet_rdma_srq_bind(req, wc->qp_num);
+                if (unlikely(rdma_handler == NULL))
+                        return 0;
+        } else {
+                rdma_handler = req->rdma_handler;
+        }
+
         node = &__corenet_rdma__->array[rdma_handler->node_loc];
 
         rdma_handler->nr_success++;
+        if (req->mode != RDMA_RECV_MSG)
+                rdma_handler->nr_send_cqe++;
 
         RDMA_REQ_DUMP_L(DBUG, req);
 
+        if (req->n && req->mode != RDMA_RECV_MSG) {
+                __corenet_rdma_sweep(node, req->seq);
+
+                /* one completion for the whole write */
+                if (req->mode == RDMA_WRITE)
+                        req->ref = 1;
+        }
+
         switch (req->mode) {
         case RDMA_RECV_MSG:
                 count = wc->byte_len;
@@ -666,10 +1210,14 @@ static int S_LTG __corenet_rdma_handle_wc(struct ibv_wc *wc, __corenet_t *corene
         case RDMA_WRITE:
                 req->ref--;
                 if (req->ref == 0) {
-                        ltgbuf_free(&req->msg_buf);
+                        __corenet_rdma_req_free(req);
                 }
                 corenet_rdma_put(rdma_handler, __FUNCTION__, 0);
                 break; /*do nothing*/
+        case RDMA_STRIPE:
+                __corenet_rdma_stripe_done(__corenet_rdma__, req);
+                corenet_rdma_put(rdma_handler, __FUNCTION__, 0);
+                break;
         default:
                 DERROR("bad mode:%d\n", req->mode);
                 LTG_ASSERT(0);
@@ -688,11 +1236,27 @@ STATIC int __corenet_rdma_handle_wc_error(struct ibv_wc *wc, __corenet_t *corene
 
         //   void *ptr;
         req = (rdma_req_t *)wc->wr_id;
-        rdma_handler = req->rdma_handler;
+        if (req == NULL) {
+                /* an unsignaled wr that owns nothing */
+                return 0;
+        }
+
+        if (req->mode == RDMA_RECV_MSG && req->srq) {
+                /* the put below drops the ref taken by the bind */
+                rdma_handler = __corenet_rdma_srq_bind(req, wc->qp_num);
+                if (rdma_handler == NULL)
+                        return 0;
+
+                __corenet_rdma_srq_slot(req->srq, req);
+        } else {
+                rdma_handler = req->rdma_handler;
+        }
+
         cm_id = rdma_handler->cm_id;
 
         corenet_rdma_t *__corenet_rdma__ = corenet->rdma_net;
         corenet_node_t *node = &__corenet_rdma__->array[rdma_handler->node_loc];
+        int unsignaled;
 
         DBUG("rdma_conn %p %ju/%ju/%ju cmid %p qp %p mode %d status %d opcode %d\n",
               rdma_handler,
@@ -706,53 +1270,279 @@ STATIC int __corenet_rdma_handle_wc_error(struct ibv_wc *wc, __corenet_t *corene
                 CORENET_RDMA_NODE_DUMP_L(DERROR, node);
                 RDMA_REQ_DUMP_L(DERROR, req);
 
-                RDMA_CONN_DUMP_L(DERROR, rdma_handler);
+                RDMA_CONN_DUMP_L(DERROR, rdma_handler);
+
+                if (rdma_handler->core) {
+                        CORE_DUMP_L(DERROR, rdma_handler->core);
+                }
+
+                CMID_DUMP_L(DERROR, cm_id);
+                IBV_QP_DUMP_L(DERROR, cm_id->qp);
+
+                IBV_MR_DUMP_L(DERROR, rdma_handler->mr);
+                if (rdma_handler->iov_mr) {
+                        IBV_MR_DUMP_L(DERROR, rdma_handler->iov_mr);
+                }
+
+                LTG_ASSERT(0);
+        } else if (wc->status == IBV_WC_WR_FLUSH_ERR){
+                rdma_handler->nr_flush++;
+        } else {
+                DWARN("poll error!!!!!! wc status:%s(%d), CQ:%p\n",
+                      ibv_wc_status_str(wc->status), (int)wc->status, rdma_handler);
+                rdma_handler->nr_other++;
+        }
+
+        if (req->mode != RDMA_RECV_MSG)
+                rdma_handler->nr_send_cqe++;
+
+        if (req->mode == RDMA_STRIPE) {
+                corenet_rdma_close(rdma_handler, __FUNCTION__);
+                __corenet_rdma_stripe_fail(__corenet_rdma__, req);
+                corenet_rdma_put(rdma_handler, __FUNCTION__, 1);
+                return 0;
+        }
+
+        if (req->n && req->mode != RDMA_RECV_MSG) {
+                unsignaled = !list_empty(&req->hook);
+                if (unsignaled) {
+                        corenet_rdma_close(rdma_handler, __FUNCTION__);
+                        __corenet_rdma_sweep(node, req->seq);
+                        return 0;
+                }
+
+                __corenet_rdma_sweep(node, req->seq);
+        }
+
+        switch (req->mode) {
+        case RDMA_RECV_MSG:
+                break;
+        case RDMA_SEND_MSG:
+                ltgbuf_free(&req->msg_buf);
+                break;
+        case RDMA_READ:
+                ltgbuf_free(&req->msg_buf);
+                break;
+        case RDMA_WRITE:
+                __corenet_rdma_req_free(req);
+                break;
+        default:
+                DERROR("bad mode:%d\n", req->mode);
+                LTG_ASSERT(0);
+        }
+
+        corenet_rdma_close(rdma_handler, __FUNCTION__);
+
+        //DINFO("rdma_handler (%p %p) ref %d\n", req, rdma_handler, rdma_handler->ref);
+        corenet_rdma_put(rdma_handler, __FUNCTION__, 1);
+
+        return 0;
+}
+
+#define MAX_POLLING 32
+
+/*
+ * rdma_event: after rdma_event empty polls in a row the core arms its cqs
+ * and sleeps on their completion channels together with the interrupt
+ * eventfd, so ring requests and task posts still wake it. a wakeup drains
+ * the cq in bigger batches. a core that is woken up again right away
+ * spins longer before the next sleep, one that sleeps long goes back to
+ * rdma_event.
+ */
+#define RDMA_EVENT_BATCH (MAX_POLLING * 8)
+#define RDMA_EVENT_SPIN_MAX 64          /* times rdma_event */
+#define RDMA_EVENT_SHORT 50             /* usec */
+#define RDMA_EVENT_SLEEP 1000           /* msec */
+
+static __thread uint32_t __rdma_idle__;
+static __thread uint32_t __rdma_idle_max__;
+static __thread uint32_t __rdma_posted__[2];  /* sche posts seen by the last two polls */
+
+static void S_LTG __corenet_rdma_handle(struct ibv_wc *wc, int count, __corenet_t *corenet)
+{
+        int i;
+
+        for (i = 0; i < count; i++) {
+                DBUG("status %d opcode %d len %d\n",
+                      wc[i].status, wc[i].opcode, wc[i].byte_len);
+
+                if (likely(wc[i].status == IBV_WC_SUCCESS)) {
+                        __corenet_rdma_handle_wc(&wc[i], corenet);
+                } else {
+                        __corenet_rdma_handle_wc_error(&wc[i], corenet);
+                }
+        }
+}
+
+static int __corenet_rdma_drain(__corenet_t *corenet, rdma_info_t *rinfo, int max)
+{
+        int ret, count = 0;
+        struct ibv_wc wc[MAX_POLLING];
+
+        while (count < max) {
+                ret = ibv_poll_cq(rinfo->cq, MAX_POLLING, wc);
+                if (unlikely(ret < 0)) {
+                        LTG_ASSERT(0);
+                }
+
+                __corenet_rdma_handle(wc, ret, corenet);
+                count += ret;
+
+                if (ret < MAX_POLLING)
+                        break;
+        }
+
+        return count;
+}
+
+static int __corenet_rdma_arm(__corenet_t *corenet)
+{
+        int ret, i, count = 0;
+        rdma_info_t *rinfo;
+
+        for (i = 0; i < corenet->dev_count; i++) {
+                rinfo = &corenet->dev_list[i];
+                if (rinfo->channel == NULL)
+                        return EINVAL;
+
+                if (rinfo->armed)
+                        continue;
+
+                ret = ibv_req_notify_cq(rinfo->cq, 0);
+                if (unlikely(ret))
+                        GOTO(err_ret, ret);
+
+                rinfo->armed = 1;
+        }
+
+        /* completions that came before the cq was armed raise no event */
+        for (i = 0; i < corenet->dev_count; i++) {
+                count += __corenet_rdma_drain(corenet, &corenet->dev_list[i],
+                                              RDMA_EVENT_BATCH);
+        }
+
+        return count ? EAGAIN : 0;
+err_ret:
+        return ret;
+}
+
+/*
+ * sche_post writes the eventfd only while sleeping is set. a post since
+ * the poll before the last one may not have been run yet, the core stays
+ * up then. private timers run from a core routine, the sleep ends before
+ * the first one is due.
+ */
+static void __corenet_rdma_sleep(__corenet_t *corenet)
+{
+        int ret, i, n = 0, event = 0, ready, tmo;
+        struct pollfd pfd[MAX_RDMA_DEV + 1];
+        core_t *core = core_self();
+        sche_t *sche = core->sche;
+        rdma_info_t *rinfo;
+        struct ibv_cq *cq;
+        void *ctx;
+        uint64_t left;
+        suseconds_t next;
+        ltg_time_t t;
+
+        next = timer_next();
+        if (next == 0)
+                return;
+
+        tmo = next < 0 ? RDMA_EVENT_SLEEP
+                : (int)_min((next + 999) / 1000, RDMA_EVENT_SLEEP);
 
-                if (rdma_handler->core) {
-                        CORE_DUMP_L(DERROR, rdma_handler->core);
+        ret = __corenet_rdma_arm(corenet);
+        if (ret) {
+                if (ret != EAGAIN) {
+                        DWARN("arm cq ret %d, busy polling\n", ret);
+                        __rdma_idle_max__ = UINT32_MAX;
                 }
 
-                CMID_DUMP_L(DERROR, cm_id);
-                IBV_QP_DUMP_L(DERROR, cm_id->qp);
+                return;
+        }
 
-                IBV_MR_DUMP_L(DERROR, rdma_handler->mr);
-                IBV_MR_DUMP_L(DERROR, rdma_handler->iov_mr);
+        for (i = 0; i < corenet->dev_count; i++) {
+                pfd[n].fd = corenet->dev_list[i].channel->fd;
+                pfd[n].events = POLLIN;
+                pfd[n].revents = 0;
+                n++;
+        }
 
-                LTG_ASSERT(0);
-        } else if (wc->status == IBV_WC_WR_FLUSH_ERR){
-                rdma_handler->nr_flush++;
-        } else {
-                DWARN("poll error!!!!!! wc status:%s(%d), CQ:%p\n",
-                      ibv_wc_status_str(wc->status), (int)wc->status, rdma_handler);
-                rdma_handler->nr_other++;
+        pfd[n].fd = core->interrupt_eventfd;
+        pfd[n].events = POLLIN;
+        pfd[n].revents = 0;
+        n++;
+
+        __atomic_store_n(&sche->sleeping, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&sche->posted, __ATOMIC_SEQ_CST) != __rdma_posted__[0]) {
+                __atomic_store_n(&sche->sleeping, 0, __ATOMIC_RELAXED);
+                return;
         }
 
-        switch (req->mode) {
-        case RDMA_RECV_MSG:
-                break;
-        case RDMA_SEND_MSG:
-                ltgbuf_free(&req->msg_buf);
-                break;
-        case RDMA_READ:
-                ltgbuf_free(&req->msg_buf);
-                break;
-        case RDMA_WRITE:
-                ltgbuf_free(&req->msg_buf);
-                break;
-        default:
-                DERROR("bad mode:%d\n", req->mode);
-                LTG_ASSERT(0);
+        _microsec_update_now(&t);
+
+        ready = poll(pfd, n, tmo);
+        __atomic_store_n(&sche->sleeping, 0, __ATOMIC_RELAXED);
+        if (unlikely(ready < 0)) {
+                ret = errno;
+                LTG_ASSERT(ret == EINTR);
+                return;
         }
 
-        corenet_rdma_close(rdma_handler, __FUNCTION__);
+        for (i = 0; i < corenet->dev_count; i++) {
+                rinfo = &corenet->dev_list[i];
+                if (!pfd[i].revents)
+                        continue;
 
-        //DINFO("rdma_handler (%p %p) ref %d\n", req, rdma_handler, rdma_handler->ref);
-        corenet_rdma_put(rdma_handler, __FUNCTION__, 1);
+                ret = ibv_get_cq_event(rinfo->channel, &cq, &ctx);
+                if (unlikely(ret))
+                        continue;
 
-        return 0;
+                ibv_ack_cq_events(cq, 1);
+                rinfo->armed = 0;
+                event++;
+
+                __corenet_rdma_drain(corenet, rinfo, RDMA_EVENT_BATCH);
+        }
+
+        if (pfd[n - 1].revents) {
+                ret = read(core->interrupt_eventfd, &left, sizeof(left));
+                (void) ret;
+        }
+
+        if (event && _microsec_time_used_from_now(&t) < RDMA_EVENT_SHORT) {
+                __rdma_idle_max__ = _min(__rdma_idle_max__ * 2,
+                                         (uint32_t)ltgconf_global.rdma_event
+                                         * RDMA_EVENT_SPIN_MAX);
+        } else if (ready == 0 && tmo == RDMA_EVENT_SLEEP) {
+                __rdma_idle_max__ = _max(__rdma_idle_max__ / 2,
+                                         (uint32_t)ltgconf_global.rdma_event);
+        }
 }
 
-#define MAX_POLLING 32
+static inline int __corenet_rdma_idle(__corenet_t *corenet)
+{
+        corenet_rdma_t *rdma_net = corenet->rdma_net;
+
+        if (likely(!ltgconf_global.rdma_event))
+                return 0;
+
+        if (unlikely(__rdma_idle_max__ == 0))
+                __rdma_idle_max__ = ltgconf_global.rdma_event;
+
+        if (++__rdma_idle__ < __rdma_idle_max__)
+                return 0;
+
+        /* sends queued by this loop go out with the commit first */
+        if (!list_empty(&rdma_net->corenet.forward_list)
+            || core_self()->interrupt_eventfd == -1)
+                return 0;
+
+        __rdma_idle__ = 0;
+
+        return 1;
+}
 
 inline int INLINE corenet_rdma_poll(__corenet_t *corenet)
 {
@@ -764,6 +1554,12 @@ inline int INLINE corenet_rdma_poll(__corenet_t *corenet)
                 return 0;
         }
 
+        if (unlikely(ltgconf_global.rdma_event)) {
+                __rdma_posted__[0] = __rdma_posted__[1];
+                __rdma_posted__[1] = __atomic_load_n(&core_self()->sche->posted,
+                                                     __ATOMIC_ACQUIRE);
+        }
+
 	for (i = 0; i < corenet->dev_count; i++) {
                 rinfo = &corenet->dev_list[i];
 
@@ -776,15 +1572,18 @@ inline int INLINE corenet_rdma_poll(__corenet_t *corenet)
                 polling_count += ret;
 	}
 
-        for (i = 0; i < polling_count; i++) {
-                DBUG("status %d opcode %d len %d\n",
-                      wc[i].status, wc[i].opcode, wc[i].byte_len);
+        __corenet_rdma_handle(wc, polling_count, corenet);
 
-                if (likely(wc[i].status == IBV_WC_SUCCESS)) {
-                        __corenet_rdma_handle_wc(&wc[i], corenet);
-                } else {
-                        __corenet_rdma_handle_wc_error(&wc[i], corenet);
-                }
+	for (i = 0; i < corenet->dev_count; i++) {
+                rinfo = &corenet->dev_list[i];
+                if (rinfo->srq)
+                        __corenet_rdma_srq_refill(rinfo->srq);
+        }
+
+        if (polling_count) {
+                __rdma_idle__ = 0;
+        } else if (unlikely(__corenet_rdma_idle(corenet))) {
+                __corenet_rdma_sleep(corenet);
         }
 
         return 0;
@@ -799,11 +1598,230 @@ inline static void INLINE __corenet_rdma_queue(corenet_rdma_t *corenet, corenet_
         return ;
 }
 
+static inline void __corenet_rdma_post(corenet_rdma_t *corenet, corenet_node_t *node,
+                                       rdma_req_t *req)
+{
+        if (ltgconf_global.rdma_signal > 1) {
+                node->send_ref += __corenet_rdma_signal(node, req);
+        } else {
+                node->send_ref += req->ref;
+        }
+
+        node->last_sr->next = &req->wr.sr[0];
+        node->last_sr = &req->wr.sr[req->ref - 1];
+        node->send_count += req->ref;
+
+	__corenet_rdma_queue(corenet, node);
+}
+
+/* sge range of the data a read or write moves */
+static inline int __corenet_rdma_data(const rdma_req_t *req, int *first)
+{
+        if (req->mode == RDMA_READ) {
+                *first = 0;
+                return req->nr_sge;
+        } else if (req->mode == RDMA_WRITE) {
+                *first = 1;
+                return req->nr_sge - 1;
+        }
+
+        *first = 0;
+        return 0;
+}
+
+/*
+ * multi-rail: a connection may own a qp on each device, its rails. rail 0
+ * is the connection itself and carries every message, the others only
+ * carry chunks of rdma reads and writes from rdma_stripe bytes. the rkey
+ * of the peer's hugepage mr differs per device and comes with the connect
+ * of each rail, so only hugepage memory on both ends is striped. a chunk
+ * that fails on another rail is posted again on rail 0, the striped req
+ * completes as usual once all of its chunks did.
+ */
+static void __corenet_rdma_stripe_post(corenet_rdma_t *corenet, corenet_node_t *rail,
+                                       rdma_req_t *chunk)
+{
+        struct ibv_send_wr *sr = &chunk->wr.sr[0];
+
+        chunk->rdma_handler = &rail->handler;
+        chunk->sge[0].lkey = rail->handler.mr->lkey;
+        sr->wr.rdma.rkey = rail->rail_rkey;
+        sr->next = NULL;
+
+        rail->last_sr->next = sr;
+        rail->last_sr = sr;
+        rail->send_count++;
+        rail->send_ref++;
+        rail->rail_bytes += chunk->sge[0].length;
+
+        __corenet_rdma_queue(corenet, rail);
+}
+
+static rdma_req_t *__corenet_rdma_chunk(rdma_req_t *req, const struct ibv_sge *sge,
+                                        const struct ibv_send_wr *sr, uint32_t off,
+                                        uint32_t len)
+{
+        rdma_req_t *chunk;
+        struct ibv_send_wr *csr;
+
+        chunk = slab_stream_alloc(sizeof(*chunk));
+        if (unlikely(chunk == NULL))
+                return NULL;
+
+        chunk->mode = RDMA_STRIPE;
+        chunk->ref = 1;
+        chunk->n = 0;
+        chunk->srq = NULL;
+        chunk->parent = req;
+        INIT_LIST_HEAD(&chunk->hook);
+        ltgbuf_init(&chunk->msg_buf, 0);
+
+        chunk->sge[0].addr = sge->addr + off;
+        chunk->sge[0].length = len;
+
+        csr = &chunk->wr.sr[0];
+        memset(csr, 0x00, sizeof(*csr));
+        csr->wr_id = (uint64_t)chunk;
+        csr->sg_list = &chunk->sge[0];
+        csr->num_sge = 1;
+        csr->opcode = sr->opcode;
+        csr->send_flags = IBV_SEND_SIGNALED;
+        csr->wr.rdma.remote_addr = sr->wr.rdma.remote_addr + off;
+
+        return chunk;
+}
+
+static int __corenet_rdma_stripe(corenet_rdma_t *corenet, corenet_node_t *node,
+                                 rdma_req_t *req, const data_prop_t *prop)
+{
+        int ret, i, j, n, nr = 0, first, count;
+        uint32_t off, len, piece;
+        uint64_t bytes = 0;
+        corenet_node_t *rail[MAX_RDMA_DEV], *where[MAX_SGE * MAX_RDMA_DEV], *tmp;
+        rdma_req_t *chunk[MAX_SGE * MAX_RDMA_DEV];
+        const struct ibv_sge *sge;
+
+        count = __corenet_rdma_data(req, &first);
+        if (count == 0 || prop == NULL || prop->rkey != node->rail_rkey)
+                return EPERM;
+
+        /* chunks are cut from wrs with a single sge */
+        if (count != (int)req->ref - first)
+                return EPERM;
+
+        for (i = first; i < first + count; i++) {
+                sge = &req->sge[i];
+                if (!rdma_mr_registered((void *)sge->addr, sge->length))
+                        return EPERM;
+
+                bytes += sge->length;
+        }
+
+        if (bytes < (uint64_t)ltgconf_global.rdma_stripe)
+                return EPERM;
+
+        n = 0;
+        rail[n++] = node;
+        for (i = 0; i < node->rail_count; i++) {
+                tmp = &corenet->array[node->rail[i]];
+                if (tmp->handler.is_closing || tmp->rail_rkey == 0)
+                        continue;
+
+                rail[n++] = tmp;
+        }
+
+        if (n == 1)
+                return ENOENT;
+
+        for (i = first; i < first + count; i++) {
+                sge = &req->sge[i];
+                piece = _align_up((sge->length + n - 1) / n, PAGE_SIZE);
+                for (off = 0, j = 0; off < sge->length; off += len, j++) {
+                        len = _min(piece, sge->length - off);
+                        chunk[nr] = __corenet_rdma_chunk(req, sge,
+                                                         &req->wr.sr[i - first],
+                                                         off, len);
+                        if (unlikely(chunk[nr] == NULL)) {
+                                ret = ENOMEM;
+                                GOTO(err_free, ret);
+                        }
+
+                        where[nr++] = rail[j];
+                }
+        }
+
+        req->stripe = nr;
+        req->stripe_err = 0;
+
+        /* held for the req as if it was posted itself */
+        corenet_rdma_get(&node->handler, 1, __FUNCTION__, 0);
+
+        for (i = 0; i < nr; i++) {
+                __corenet_rdma_stripe_post(corenet, where[i], chunk[i]);
+        }
+
+        return 0;
+err_free:
+        for (i = 0; i < nr; i++) {
+                slab_stream_free(chunk[i]);
+        }
+        return ret;
+}
+
+static void __corenet_rdma_stripe_done(corenet_rdma_t *corenet, rdma_req_t *chunk)
+{
+        rdma_req_t *req = chunk->parent;
+        corenet_node_t *node = &corenet->array[req->rdma_handler->node_loc];
+        rdma_conn_t *handler = &node->handler;
+
+        slab_stream_free(chunk);
+
+        req->stripe--;
+        if (req->stripe)
+                return;
+
+        if (unlikely(req->stripe_err || handler->is_closing)) {
+                __corenet_rdma_req_free(req);
+                corenet_rdma_close(handler, __FUNCTION__);
+                corenet_rdma_put(handler, __FUNCTION__, 1);
+                return;
+        }
+
+        if (req->mode == RDMA_READ) {
+                /* the ref stays with the read, see __corenet_rdma_handle_wc */
+                node->exec1(node->ctx, &req->msg_buf);
+                LTG_ASSERT(req->msg_buf.len == 0);
+        } else {
+                /* the reply message goes out once the data is there */
+                req->wr.sr[0] = req->wr.sr[req->ref - 1];
+                req->ref = 1;
+                __corenet_rdma_post(corenet, node, req);
+                corenet_rdma_put(handler, __FUNCTION__, 0);
+        }
+}
+
+static void __corenet_rdma_stripe_fail(corenet_rdma_t *corenet, rdma_req_t *chunk)
+{
+        rdma_req_t *req = chunk->parent;
+        corenet_node_t *node = &corenet->array[req->rdma_handler->node_loc];
+
+        container_of(chunk->rdma_handler, corenet_node_t, handler)->rail_errors++;
+
+        if (chunk->rdma_handler != &node->handler && !node->handler.is_closing) {
+                DBUG("chunk %p len %u back to rail 0\n", chunk, chunk->sge[0].length);
+                __corenet_rdma_stripe_post(corenet, node, chunk);
+                return;
+        }
+
+        req->stripe_err = 1;
+        __corenet_rdma_stripe_done(corenet, chunk);
+}
+
 inline int INLINE corenet_rdma_send(const sockid_t *sockid, ltgbuf_t *buf,
-                                    void **addr, uint32_t rkey, uint32_t size,
+                                    const data_prop_t *prop,
                                     req_build_func build_req)
 {
-        int ret;
+        int ret, i, first, count;
         corenet_node_t *node;
         corenet_rdma_t *__corenet_rdma__ = __corenet_get();
         rdma_req_t *req;
@@ -819,13 +1837,19 @@ inline int INLINE corenet_rdma_send(const sockid_t *sockid, ltgbuf_t *buf,
         }
 
         handler = &node->handler;
-        req = build_req(handler, buf, addr, rkey, size);
+        req = build_req(handler, buf, prop);
 
-        node->last_sr->next = &req->wr.sr[0];
-        node->last_sr = &req->wr.sr[req->ref - 1];
-        node->send_count += req->ref;
+        if (unlikely(node->rail_count)) {
+                if (__corenet_rdma_stripe(__corenet_rdma__, node, req, prop) == 0)
+                        return 0;
+        }
 
-	__corenet_rdma_queue(__corenet_rdma__, node);
+        count = __corenet_rdma_data(req, &first);
+        for (i = first; i < first + count; i++) {
+                node->rail_bytes += req->sge[i].length;
+        }
+
+        __corenet_rdma_post(__corenet_rdma__, node, req);
 
 #if 0
         corenet_rdma_commit(__corenet_rdma__);
@@ -836,6 +1860,20 @@ err_lock:
         return ret;
 }
 
+/* the payload of an inline wr was copied by ibv_post_send */
+static void __corenet_rdma_inline_free(struct ibv_send_wr *sr)
+{
+        rdma_req_t *req;
+
+        while (sr) {
+                req = sr->wr_id ? NULL : __corenet_rdma_sr_req(sr);
+                sr = sr->next;
+                if (req) {
+                        __corenet_rdma_req_free(req);
+                }
+        }
+}
+
 static inline int S_LTG __corenet_rdma_commit(corenet_node_t *node)
 {
         int ret;
@@ -854,12 +1892,22 @@ static inline int S_LTG __corenet_rdma_commit(corenet_node_t *node)
                 return -1;
         }
 
-        corenet_rdma_get(handler, node->send_count, __FUNCTION__, 0);
+        corenet_rdma_get(handler, node->send_ref, __FUNCTION__, 0);
         // IBV_QP_DUMP_L(DINFO, handler->qp);
 
+        handler->nr_post++;
+        handler->nr_send_wr += node->send_count;
+        handler->nr_inline += node->send_inline;
+
+        if (node->send_inline) {
+                __corenet_rdma_inline_free(node->head_sr.next);
+        }
+
         node->head_sr.next = NULL;
         node->last_sr = &node->head_sr;
         node->send_count = 0;
+        node->send_ref = 0;
+        node->send_inline = 0;
 
         return 0;
 }
@@ -952,6 +2000,8 @@ int corenet_rdma_init(int max, corenet_rdma_t **_corenet)
 
                 ltg_spin_init(&node->lock);
                 INIT_LIST_HEAD(&node->send_list);
+                INIT_LIST_HEAD(&node->unsignaled_list);
+                node->rail_primary = -1;
         }
 
         INIT_LIST_HEAD(&corenet->corenet.forward_list);
@@ -1042,6 +2092,7 @@ int __rdma_create_cq(rdma_info_t **_dev, struct rdma_cm_id *cm_id, int ib_port,
         dev->ibv_verbs = cm_id->verbs;
 
         dev->nr_conn = 0;
+        dev->srq = NULL;
 
         dev->nr_success = 0;
         dev->nr_flush = 0;
@@ -1064,11 +2115,23 @@ int __rdma_create_cq(rdma_info_t **_dev, struct rdma_cm_id *cm_id, int ib_port,
 
         /*a bug fix, 512k may be too large*/
         cq_size = min_t(uint32_t, device_attr.max_cqe, MAX_POLL_CQ_SIZE);
+        dev->max_sge = min_t(int, device_attr.max_sge, MAX_SGE);
 
         /* each side will send only one WR, so Completion
          * Queue with 1 entry is enough
          */
-        dev->cq = ibv_create_cq(cm_id->verbs, cq_size, NULL, NULL, 0);
+        dev->channel = NULL;
+        dev->armed = 0;
+        if (ltgconf_global.rdma_event) {
+                dev->channel = ibv_create_comp_channel(cm_id->verbs);
+                if (dev->channel == NULL) {
+                        DWARN("create comp channel errno %d, busy polling\n", errno);
+                } else {
+                        sock_setnonblock(dev->channel->fd);
+                }
+        }
+
+        dev->cq = ibv_create_cq(cm_id->verbs, cq_size, NULL, dev->channel, 0);
         if (!dev->cq) {
                 DERROR("failed to create CQ with %u entries, errno:%d, errmsg:%s\n",
                        cq_size, errno, strerror(errno));
@@ -1096,6 +2159,21 @@ int __rdma_create_cq(rdma_info_t **_dev, struct rdma_cm_id *cm_id, int ib_port,
                 LTG_ASSERT(0);
 #endif
 
+        if (ltgconf_global.rdma_srq) {
+                ret = __corenet_rdma_srq_create(dev, &device_attr);
+                if (ret) {
+                        DWARN("srq off, recv slots per qp, ret %d\n", ret);
+                }
+        }
+
+        dev->mr_cache = NULL;
+        if (ltgconf_global.rdma_mr_cache) {
+                ret = rdma_mr_cache_init(dev);
+                if (ret) {
+                        DWARN("mr cache off, ret %d\n", ret);
+                }
+        }
+
         corenet->dev_count++;
 
         //gmr = dev->mr;
@@ -1178,12 +2256,19 @@ static int __corenet_rdma_create_qp__(struct rdma_cm_id *cm_id, core_t *core, rd
         qp_init_attr.recv_cq = dev->cq;
         qp_init_attr.cap.max_send_wr = 1024;
         qp_init_attr.cap.max_recv_wr = 1024;
-        qp_init_attr.cap.max_send_sge = MAX_SEG_COUNT; /* scatter/gather entries */
+        qp_init_attr.cap.max_send_sge = dev->max_sge; /* scatter/gather entries */
         qp_init_attr.cap.max_recv_sge = MAX_SEG_COUNT;
+        qp_init_attr.cap.max_inline_data = ltgconf_global.rdma_inline;
         qp_init_attr.qp_type = IBV_QPT_RC;
         /* only generate completion queue entries if requested */
         qp_init_attr.sq_sig_all = 0;
 
+        if (dev->srq) {
+                qp_init_attr.srq = dev->srq->srq;
+                qp_init_attr.cap.max_recv_wr = 0;
+                qp_init_attr.cap.max_recv_sge = 0;
+        }
+
         DINFO("cap max_wr %d/%d max_sge %d/%d\n",
               1024, 1024,
               qp_init_attr.cap.max_send_sge, qp_init_attr.cap.max_recv_sge);
@@ -1194,6 +2279,13 @@ static int __corenet_rdma_create_qp__(struct rdma_cm_id *cm_id, core_t *core, rd
         }
 
         ret = rdma_create_qp(cm_id, dev->pd, &qp_init_attr);
+        if (ret && qp_init_attr.cap.max_inline_data) {
+                DWARN("max_inline_data %u refused, errno:%d\n",
+                      qp_init_attr.cap.max_inline_data, errno);
+                qp_init_attr.cap.max_inline_data = 0;
+                ret = rdma_create_qp(cm_id, dev->pd, &qp_init_attr);
+        }
+
         if (ret) {
                 DERROR("cm_id:%p, ret %d, errno:%d\n", cm_id, ret, errno);
                 ret = errno;
@@ -1208,6 +2300,8 @@ static int __corenet_rdma_create_qp__(struct rdma_cm_id *cm_id, core_t *core, rd
         handler->qp = cm_id->qp;
         handler->dev = dev;
         handler->core = core;
+        handler->max_inline = qp_init_attr.cap.max_inline_data;
+        handler->max_sge = _min(qp_init_attr.cap.max_send_sge, (uint32_t)dev->max_sge);
 
         dev->nr_conn++;
 
@@ -1224,6 +2318,16 @@ static int __corenet_rdma_post_mem_handler(rdma_conn_t *handler, core_t *core)
         void *ptr, *tmp = NULL;
         uint32_t size = RDMA_INFO_SIZE + RDMA_MESSAGE_SIZE;
 
+        if (handler->dev->srq) {
+                ret = htab_insert(handler->dev->srq->qp_tab, handler,
+                                  &handler->qp->qp_num, 0);
+                if (ret)
+                        GOTO(err_ret, ret);
+
+                handler->is_connected = 1;
+                return 0;
+        }
+
         ret = posix_memalign(&tmp, 4096, size * DEFAULT_MH_NUM);
         if (ret) {
                 LTG_ASSERT(0);
@@ -1263,6 +2367,8 @@ static int __corenet_rdma_post_mem_handler(rdma_conn_t *handler, core_t *core)
                 ret = ibv_post_recv(handler->qp, &req->wr.rr, &bad_wr);
                 if (ret)
                         LTG_ASSERT(0);
+
+                handler->nr_recv_wr++;
         }
 
         handler->is_connected = 1;
@@ -1271,6 +2377,8 @@ static int __corenet_rdma_post_mem_handler(rdma_conn_t *handler, core_t *core)
         corenet_rdma_get(handler, DEFAULT_MH_NUM, __FUNCTION__, 1);
 
         return 0;
+err_ret:
+        return ret;
 }
 
 static int __corenet_rdma_create_qp_real(core_t *core, struct rdma_cm_id *cm_id, rdma_conn_t *rdma_handler)
@@ -1545,10 +2653,13 @@ err_free:
         return ret;
 }
 
-static int __corenet_rdma_connect(struct rdma_cm_id *cm_id)
+static int __corenet_rdma_connect(struct rdma_cm_id *cm_id,
+                                  const rdma_rail_msg_t *rail)
 {
         int ret;
         struct rdma_conn_param cm_params;
+        rdma_conn_t *handler = cm_id->context;
+        rdma_rail_msg_t msg;
 
         memset(&cm_params, 0, sizeof(cm_params));
 
@@ -1556,6 +2667,13 @@ static int __corenet_rdma_connect(struct rdma_cm_id *cm_id)
         cm_params.initiator_depth = 16;
         cm_params.retry_count = 5;
 
+        if (rail) {
+                msg = *rail;
+                msg.rkey = handler->mr->rkey;
+                cm_params.private_data = &msg;
+                cm_params.private_data_len = sizeof(msg);
+        }
+
         DINFO("cm_id:%p route resolved.\n", cm_id);
 
         ret = rdma_connect(cm_id, &cm_params);
@@ -1573,6 +2691,7 @@ err_ret:
 }
 
 static int __corenet_rdma_on_active_event(struct rdma_event_channel *evt_channel,
+                                          const rdma_rail_msg_t *rail,
                                           core_t *core, sockid_t *sockid)
 {
         int ret;
@@ -1625,7 +2744,7 @@ static int __corenet_rdma_on_active_event(struct rdma_event_channel *evt_channel
                         }
                         break;
                 case RDMA_CM_EVENT_ROUTE_RESOLVED:
-                        ret = __corenet_rdma_connect(ev->id);
+                        ret = __corenet_rdma_connect(ev->id, rail);
                         if (ret) {
                                 GOTO(err_ack, ret);
                         }
@@ -1715,7 +2834,8 @@ err_ret:
 #endif /*CORENET_RDMA_ON_ACTIVE_WAIT*/
 
 int corenet_rdma_connect_by_channel(const uint32_t addr, const uint32_t port,
-                                    core_t *core, sockid_t *sockid)
+                                    const rdma_rail_msg_t *rail, core_t *core,
+                                    sockid_t *sockid)
 {
         int ret = 0;
         int flags;
@@ -1754,7 +2874,7 @@ int corenet_rdma_connect_by_channel(const uint32_t addr, const uint32_t port,
                 GOTO(err_ret, ret);
         }
 
-        ret = __corenet_rdma_on_active_event(evt_channel, core, sockid);
+        ret = __corenet_rdma_on_active_event(evt_channel, rail, core, sockid);
         if (ret)
                 GOTO(err_ret, ret);
 
@@ -1873,16 +2993,166 @@ err_ret:
         return ret;
 }
 
+static int __corenet_rdma_rail_add(corenet_rdma_t *rdma_net, corenet_node_t *primary,
+                                   corenet_node_t *node)
+{
+        int i;
+
+        if (primary->rail_count == MAX_RDMA_DEV - 1)
+                return ENOSPC;
+
+        /* a second qp on one device adds nothing */
+        if (node->handler.dev == primary->handler.dev)
+                return EEXIST;
+
+        for (i = 0; i < primary->rail_count; i++) {
+                if (rdma_net->array[primary->rail[i]].handler.dev == node->handler.dev)
+                        return EEXIST;
+        }
+
+        primary->rail[primary->rail_count++] = node - rdma_net->array;
+        node->rail_primary = primary - rdma_net->array;
+
+        DINFO("rail %d of %s, dev %p, %d rails\n", node->handler.node_loc,
+              _inet_ntoa(primary->sockid.addr), node->handler.dev,
+              primary->rail_count + 1);
+
+        return 0;
+}
+
+/* passive side, the connection of a rail is known by its group */
+static int __corenet_rdma_rail_find(rdma_conn_t *handler)
+{
+        int i;
+        corenet_rdma_t *rdma_net = ((__corenet_t *)handler->core->corenet)->rdma_net;
+        corenet_node_t *node = container_of(handler, corenet_node_t, handler);
+        corenet_node_t *primary;
+
+        for (i = 0; i < rdma_net->corenet.count; i++) {
+                primary = &rdma_net->array[i];
+                if (primary->in_use && primary != node
+                    && primary->rail_group == node->rail_group
+                    && primary->rail_idx == 0
+                    && !primary->handler.is_closing) {
+                        return __corenet_rdma_rail_add(rdma_net, primary, node);
+                }
+        }
+
+        return ENOENT;
+}
+
+/* active side, called on the core once the rail is connected */
+int corenet_rdma_rail_link(const sockid_t *sockid, const sockid_t *rail)
+{
+        corenet_rdma_t *rdma_net = __corenet_get();
+        corenet_node_t *primary, *node;
+
+        primary = &rdma_net->array[sockid->sd];
+        node = &rdma_net->array[rail->sd];
+        if (primary->sockid.seq != sockid->seq || primary->handler.is_closing
+            || node->sockid.seq != rail->seq || node->handler.is_closing)
+                return ECONNRESET;
+
+        return __corenet_rdma_rail_add(rdma_net, primary, node);
+}
+
+static void __corenet_rdma_rail_stat(const corenet_node_t *node,
+                                     corenet_rail_stat_t *stat)
+{
+        __corenet_t *corenet = node->handler.core->corenet;
+
+        stat->addr = node->sockid.addr;
+        stat->dev = node->handler.dev - corenet->dev_list;
+        stat->closing = node->handler.is_closing;
+        stat->bytes = node->rail_bytes;
+        stat->errors = node->rail_errors;
+}
+
+/* rail 0 first, stat holds MAX_RDMA_DEV entries */
+int corenet_rdma_rail_stat(const sockid_t *sockid, corenet_rail_stat_t *stat,
+                           int *count)
+{
+        int i;
+        corenet_rdma_t *rdma_net = __corenet_get();
+        corenet_node_t *node;
+
+        node = &rdma_net->array[sockid->sd];
+        if (node->sockid.sd == -1 || node->sockid.seq != sockid->seq)
+                return ENOENT;
+
+        __corenet_rdma_rail_stat(node, &stat[0]);
+        for (i = 0; i < node->rail_count; i++) {
+                __corenet_rdma_rail_stat(&rdma_net->array[node->rail[i]],
+                                         &stat[i + 1]);
+        }
+
+        *count = node->rail_count + 1;
+
+        return 0;
+}
+
+/* wrs and completions of a connection, called on its core */
+int corenet_rdma_stat(const sockid_t *sockid, corenet_rdma_stat_t *stat)
+{
+        corenet_rdma_t *rdma_net = __corenet_get();
+        corenet_node_t *node;
+        const rdma_conn_t *handler;
+
+        node = &rdma_net->array[sockid->sd];
+        if (node->sockid.sd == -1 || node->sockid.seq != sockid->seq)
+                return ENOENT;
+
+        handler = &node->handler;
+        stat->post = handler->nr_post;
+        stat->send_wr = handler->nr_send_wr;
+        stat->inline_wr = handler->nr_inline;
+        stat->recv_wr = handler->nr_recv_wr;
+        stat->send_cqe = handler->nr_send_cqe;
+        stat->cqe = handler->nr_success + handler->nr_flush + handler->nr_other;
+
+        return 0;
+}
+
+static int __corenet_rdma_rail_accept(va_list ap)
+{
+        rdma_conn_t *handler = va_arg(ap, rdma_conn_t *);
+        int ret;
+
+        va_end(ap);
+
+        ret = __corenet_rdma_rail_find(handler);
+        if (unlikely(ret)) {
+                DWARN("rail of %s unused, ret %d\n",
+                      _inet_ntoa(container_of(handler, corenet_node_t,
+                                              handler)->sockid.addr), ret);
+        }
+
+        return 0;
+}
+
 void corenet_rdma_established(struct rdma_cm_event *ev, void *_core)
 {
+        int ret;
         struct rdma_cm_id *cm_id = ev->id;
         char peer_addr[MAX_NAME_LEN] = "";
         struct sockaddr *addr;
         core_t *core = _core;
+        rdma_conn_t *handler = cm_id->context;
         LTG_ASSERT(core->corenet != NULL);
 
         CMID_DUMP_L(DINFO, cm_id);
 
+        /* a rail joins its connection once it can carry chunks */
+        if (handler && container_of(handler, corenet_node_t, handler)->rail_idx) {
+                ret = core_request(core->hash, -1, "rdma_rail",
+                                   __corenet_rdma_rail_accept, handler);
+                if (unlikely(ret)) {
+                        DWARN("rail of %s unused, ret %d\n",
+                              _inet_ntoa(container_of(handler, corenet_node_t,
+                                                      handler)->sockid.addr), ret);
+                }
+        }
+
         addr = rdma_get_peer_addr(cm_id);
         if (addr == NULL) {
                 DERROR("get peer addr fail, maybe disconnect\n");
@@ -1920,6 +3190,8 @@ void corenet_rdma_connect_request(struct rdma_cm_event *ev, void *_core)
         rdma_conn_t *rdma_handler;
         sockid_t *sockid;
         corerpc_ctx_t *ctx;
+        corenet_node_t *node;
+        const rdma_rail_msg_t *rail;
 
         struct rdma_conn_param conn_param = {
                 .responder_resources = 16,
@@ -1952,6 +3224,15 @@ void corenet_rdma_connect_request(struct rdma_cm_event *ev, void *_core)
 
         cm_id->context = (void *)rdma_handler;
 
+        rail = ev->param.conn.private_data;
+        if (ev->param.conn.private_data_len >= sizeof(*rail)
+            && rail->magic == RDMA_RAIL_MAGIC) {
+                node = container_of(rdma_handler, corenet_node_t, handler);
+                node->rail_group = rail->group;
+                node->rail_idx = rail->idx;
+                node->rail_rkey = rail->rkey;
+        }
+
         ctx->sockid.rdma_handler = (void *)rdma_handler;
         //rdma_handler->private_mem = core_tls_get(core, VARIABLE_HUGEPAGE);
 
@@ -0,0 +1,934 @@
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#define DBG_SUBSYS S_LTG_NET
+
+#include "ltg_net.h"
+#include "ltg_utils.h"
+#include "ltg_rpc.h"
+#include "ltg_core.h"
+
+/*
+ * tcp_shm: corerpc between processes on the same host. every core listens
+ * on an abstract unix socket named after its coreid, a connect that finds
+ * it sends a memfd holding one single producer queue and data region per
+ * direction. the sender copies a message into its region once, the
+ * receiver hands it to corerpc by reference and the block goes back to the
+ * sender when the last buffer pointing into it is freed.
+ *
+ * the peer can write anything into the map, so only offsets, lengths and
+ * done flags are read from it. refcounts and block sizes stay private, and
+ * both ends check the other runs as the same user.
+ */
+
+#define CORENET_SHM_MAGIC 0x5a3e8447
+#define CORENET_SHM_MAX 256             /* peers per core */
+#define CORENET_SHM_SLOT 1024           /* messages in flight per direction */
+#define CORENET_SHM_DATA (IO_MAX * 2)   /* bytes in flight per direction */
+
+typedef struct {
+        uint32_t off;
+        uint32_t len;
+} shm_slot_t;
+
+typedef struct {
+        uint32_t head __attribute__((__aligned__(CACHE_LINE_SIZE)));
+        uint32_t kick;                  /* the receiver sleeps in epoll */
+        shm_slot_t slot[CORENET_SHM_SLOT] __attribute__((__aligned__(CACHE_LINE_SIZE)));
+        /* set by the receiver when the slot's block is free again */
+        uint32_t done[CORENET_SHM_SLOT] __attribute__((__aligned__(CACHE_LINE_SIZE)));
+} shm_queue_t;
+
+#define SHM_QUEUE_SIZE _align_up(sizeof(shm_queue_t) * 2, HUGEPAGE_SIZE)
+#define SHM_MAP_SIZE (SHM_QUEUE_SIZE + (size_t)CORENET_SHM_DATA * 2)
+#define SHM_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+struct shm_map;
+
+/* one per receive slot, outside the map */
+typedef struct {
+        mem_ref_t ref;
+        struct shm_map *map;
+        uint32_t *done;
+} shm_ref_t;
+
+typedef struct shm_map {
+        int ref;                        /* the node and every block out */
+        void *addr;
+        uint32_t size[CORENET_SHM_SLOT]; /* tx blocks, padding included */
+        shm_ref_t rx[CORENET_SHM_SLOT];
+} shm_map_t;
+
+typedef struct {
+        uint32_t magic;
+        coreid_t from;
+        coreid_t to;
+} shm_msg_t;
+
+typedef struct {
+        struct list_head hook;
+        ltgbuf_t buf;
+} shm_pending_t;
+
+static __thread corenet_shm_t *__corenet_shm__;
+
+static void __corenet_shm_addr(const coreid_t *coreid, struct sockaddr_un *sun,
+                               socklen_t *len)
+{
+        int n;
+
+        memset(sun, 0x0, sizeof(*sun));
+        sun->sun_family = AF_UNIX;
+
+        /* abstract, goes away with the process */
+        n = snprintf(sun->sun_path + 1, sizeof(sun->sun_path) - 1, "ltg/%s/%u/%u",
+                     ltgconf_global.system_name, coreid->nid.id, coreid->idx);
+
+        *len = offsetof(struct sockaddr_un, sun_path) + 1 + n;
+}
+
+static int __corenet_shm_memfd(int huge, int *_fd, void **_addr)
+{
+        int ret, fd;
+        void *addr;
+
+        fd = memfd_create("corenet_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING
+                          | (huge ? MFD_HUGETLB : 0));
+        if (fd < 0) {
+                ret = errno;
+                GOTO(err_ret, ret);
+        }
+
+        ret = ftruncate(fd, SHM_MAP_SIZE);
+        if (ret < 0) {
+                ret = errno;
+                GOTO(err_close, ret);
+        }
+
+        /* the peer can not shrink it under our feet */
+        ret = fcntl(fd, F_ADD_SEALS, SHM_SEALS);
+        if (ret < 0) {
+                ret = errno;
+                GOTO(err_close, ret);
+        }
+
+        addr = mmap(NULL, SHM_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+                ret = errno;
+                GOTO(err_close, ret);
+        }
+
+        *_fd = fd;
+        *_addr = addr;
+
+        return 0;
+err_close:
+        close(fd);
+err_ret:
+        return ret;
+}
+
+static shm_map_t *__corenet_shm_map_new(void *addr)
+{
+        int ret;
+        shm_map_t *map;
+
+        ret = ltg_malloc((void **)&map, sizeof(*map));
+        if (unlikely(ret)) {
+                munmap(addr, SHM_MAP_SIZE);
+                return NULL;
+        }
+
+        memset(map, 0x0, sizeof(*map));
+        map->ref = 1;
+        map->addr = addr;
+
+#if ENABLE_RDMA
+        /* blocks may go out over rdma in place, __corenet_shm_map_put invalidates */
+        ret = rdma_mr_allow(addr, SHM_MAP_SIZE);
+        if (unlikely(ret)) {
+                DBUG("shm map %p not allowed, ret %d\n", addr, ret);
+        }
+#endif
+
+        return map;
+}
+
+/* the last receive buffer may be freed on any core */
+static void __corenet_shm_map_put(shm_map_t *map)
+{
+        if (__atomic_sub_fetch(&map->ref, 1, __ATOMIC_ACQ_REL))
+                return;
+
+#if ENABLE_RDMA
+        /* a block may have gone out over rdma in place */
+        rdma_mr_invalidate(map->addr, SHM_MAP_SIZE);
+#endif
+        munmap(map->addr, SHM_MAP_SIZE);
+        ltg_free((void **)&map);
+}
+
+static void __corenet_shm_ref_put(mem_ref_t *_ref)
+{
+        shm_ref_t *ref = container_of(_ref, shm_ref_t, ref);
+        shm_map_t *map = ref->map;
+
+        /* the sender owns the block from here */
+        __atomic_store_n(ref->done, 1, __ATOMIC_RELEASE);
+        __corenet_shm_map_put(map);
+}
+
+/* both ends of the unix socket run as the same user */
+static int __corenet_shm_peer(int sd)
+{
+        int ret;
+        struct ucred cred;
+        socklen_t len = sizeof(cred);
+
+        ret = getsockopt(sd, SOL_SOCKET, SO_PEERCRED, &cred, &len);
+        if (ret < 0) {
+                ret = errno;
+                GOTO(err_ret, ret);
+        }
+
+        if (cred.uid != geteuid()) {
+                ret = EPERM;
+                DWARN("shm peer pid %d uid %d refused\n", cred.pid, cred.uid);
+                GOTO(err_ret, ret);
+        }
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static corenet_shm_node_t *__corenet_shm_node_new(corenet_shm_t *shm)
+{
+        for (int i = 0; i < shm->size; i++) {
+                if (shm->array[i].uds.sd == -1)
+                        return &shm->array[i];
+        }
+
+        return NULL;
+}
+
+static corenet_shm_node_t *__corenet_shm_node(const sockid_t *sockid)
+{
+        corenet_shm_t *shm = __corenet_shm__;
+        corenet_shm_node_t *node;
+
+        if (unlikely(shm == NULL || sockid->sd < 0 || sockid->sd >= shm->size))
+                return NULL;
+
+        node = &shm->array[sockid->sd];
+        if (node->map == NULL || node->sockid.seq != sockid->seq)
+                return NULL;
+
+        return node;
+}
+
+/* the connector produces on queue 0, the acceptor on queue 1 */
+static void __corenet_shm_attach(corenet_shm_t *shm, corenet_shm_node_t *node,
+                                 shm_map_t *map, int side, corerpc_ctx_t *ctx)
+{
+        shm_queue_t *queue = map->addr;
+        char *data = map->addr + SHM_QUEUE_SIZE;
+
+        for (int i = 0; i < CORENET_SHM_SLOT; i++) {
+                map->rx[i].map = map;
+                map->rx[i].ref.put = __corenet_shm_ref_put;
+                map->rx[i].done = &queue[!side].done[i];
+        }
+
+        node->map = map;
+        node->tx = &queue[side];
+        node->rx = &queue[!side];
+        node->tx_data = data + (size_t)CORENET_SHM_DATA * side;
+        node->rx_data = data + (size_t)CORENET_SHM_DATA * !side;
+        node->tx_head = 0;
+        node->tx_done = 0;
+        node->rx_tail = 0;
+        node->data_head = 0;
+        node->data_tail = 0;
+        node->data_used = 0;
+
+        node->sockid.sd = node - shm->array;
+        node->sockid.seq = _random();
+        node->sockid.type = SOCKID_SHM;
+        node->sockid.addr = htonl(INADDR_LOOPBACK);
+        node->sockid.rdma_handler = NULL;
+        node->sockid.request = corerpc_shm_request;
+        node->sockid.reply = corerpc_reply_shm;
+
+        ctx->running = 0;
+        ctx->sockid = node->sockid;
+        ctx->local = shm->coreid;
+        node->ctx = ctx;
+        node->exec = corerpc_shm_recv;
+        node->reset = corerpc_close;
+        corerpc_credit_init(&node->credit);
+
+        list_add_tail(&node->hook, &shm->poll_list);
+}
+
+/* the unix socket is gone, from a hangup or from corenet_shm_close */
+static void __corenet_shm_reset(void *arg)
+{
+        corenet_shm_node_t *node = arg;
+        shm_pending_t *pending;
+
+        if (node->map) {
+                DINFO("shm close %s/%u sd %d send %ju recv %ju full %ju\n",
+                      netable_rname(&((corerpc_ctx_t *)node->ctx)->coreid.nid),
+                      ((corerpc_ctx_t *)node->ctx)->coreid.idx, node->sockid.sd,
+                      node->nr_send, node->nr_recv, node->nr_full);
+
+                list_del_init(&node->hook);
+                if (!list_empty(&node->send_hook))
+                        list_del_init(&node->send_hook);
+
+                while (!list_empty(&node->pending)) {
+                        pending = list_entry(node->pending.next, shm_pending_t, hook);
+                        list_del(&pending->hook);
+                        ltgbuf_free(&pending->buf);
+                        slab_stream_free(pending);
+                }
+
+                corerpc_credit_reset(&node->credit);
+                node->reset(node->ctx);
+                __corenet_shm_map_put(node->map);
+        }
+
+        node->map = NULL;
+        node->tx = NULL;
+        node->rx = NULL;
+        node->ctx = NULL;
+        node->exec = NULL;
+        node->reset = NULL;
+        node->sockid.sd = -1;
+        node->uds.sd = -1;
+        node->nr_send = 0;
+        node->nr_recv = 0;
+        node->nr_full = 0;
+}
+
+static int __corenet_shm_handshake(corenet_shm_node_t *node)
+{
+        int ret, fd = -1;
+        shm_msg_t msg;
+        struct iovec iov;
+        struct msghdr mh;
+        struct cmsghdr *cm;
+        struct stat st;
+        char control[CMSG_SPACE(sizeof(int))];
+        void *addr;
+        shm_map_t *map;
+        corerpc_ctx_t *ctx;
+        corenet_shm_t *shm = __corenet_shm__;
+
+        msg.magic = 0;
+        iov.iov_base = &msg;
+        iov.iov_len = sizeof(msg);
+        memset(&mh, 0x0, sizeof(mh));
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        mh.msg_control = control;
+        mh.msg_controllen = sizeof(control);
+
+        ret = recvmsg(node->uds.sd, &mh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (ret < 0) {
+                ret = errno;
+                goto err_ret;
+        }
+
+        cm = CMSG_FIRSTHDR(&mh);
+        if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+                memcpy(&fd, CMSG_DATA(cm), sizeof(fd));
+        }
+
+        if (ret != sizeof(msg) || fd == -1 || msg.magic != CORENET_SHM_MAGIC) {
+                DERROR("bad shm handshake, len %d magic %x\n", ret, msg.magic);
+                ret = EINVAL;
+                GOTO(err_fd, ret);
+        }
+
+        if (coreid_cmp(&msg.to, &shm->coreid)) {
+                ret = EINVAL;
+                DERROR("shm handshake for %s/%u\n", netable_rname(&msg.to.nid),
+                       msg.to.idx);
+                GOTO(err_fd, ret);
+        }
+
+        ret = fcntl(fd, F_GET_SEALS);
+        if (ret < 0 || (ret & SHM_SEALS) != SHM_SEALS) {
+                ret = EINVAL;
+                DERROR("shm map not sealed\n");
+                GOTO(err_fd, ret);
+        }
+
+        ret = fstat(fd, &st);
+        if (ret < 0) {
+                ret = errno;
+                GOTO(err_fd, ret);
+        }
+
+        if (st.st_size != (off_t)SHM_MAP_SIZE) {
+                ret = EINVAL;
+                DERROR("bad shm size %ju\n", (uint64_t)st.st_size);
+                GOTO(err_fd, ret);
+        }
+
+        addr = mmap(NULL, SHM_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+                ret = errno;
+                GOTO(err_fd, ret);
+        }
+
+        close(fd);
+
+        map = __corenet_shm_map_new(addr);
+        if (unlikely(map == NULL)) {
+                ret = ENOMEM;
+                GOTO(err_ret, ret);
+        }
+
+        ret = slab_static_alloc1((void **)&ctx, sizeof(*ctx));
+        if (unlikely(ret))
+                UNIMPLEMENTED(__DUMP__);
+
+        ctx->coreid = msg.from;
+        __corenet_shm_attach(shm, node, map, 1, ctx);
+
+        DINFO("shm accept %s/%u sd %d\n", netable_rname(&msg.from.nid),
+              msg.from.idx, node->sockid.sd);
+
+        return 0;
+err_fd:
+        if (fd != -1)
+                close(fd);
+err_ret:
+        return ret;
+}
+
+/* EPOLLIN on the unix socket: the handshake first, kicks after that */
+static void __corenet_shm_event(void *arg)
+{
+        int ret;
+        char buf[MAX_BUF_LEN];
+        corenet_shm_node_t *node = arg;
+        sockid_t uds = node->uds;
+
+        if (unlikely(node->map == NULL)) {
+                ret = __corenet_shm_handshake(node);
+                if (unlikely(ret)) {
+                        if (ret == EAGAIN)
+                                return;
+
+                        GOTO(err_ret, ret);
+                }
+
+                return;
+        }
+
+        /* the poller picks the messages up */
+        ret = recv(uds.sd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (ret == 0) {
+                ret = ECONNRESET;
+                GOTO(err_ret, ret);
+        }
+
+        return;
+err_ret:
+        corenet_tcp_close(&uds);
+}
+
+static void __corenet_shm_accept(void *arg)
+{
+        int ret, sd;
+        corenet_shm_t *shm = arg;
+        corenet_shm_node_t *node;
+
+        while (1) {
+                sd = accept4(shm->sd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (sd < 0) {
+                        ret = errno;
+                        if (ret != EAGAIN) {
+                                DWARN("accept fail %s\n", strerror(ret));
+                        }
+
+                        break;
+                }
+
+                ret = __corenet_shm_peer(sd);
+                if (unlikely(ret)) {
+                        close(sd);
+                        continue;
+                }
+
+                node = __corenet_shm_node_new(shm);
+                if (unlikely(node == NULL)) {
+                        DWARN("shm peer max %u\n", shm->size);
+                        close(sd);
+                        continue;
+                }
+
+                node->uds.sd = sd;
+                node->uds.seq = _random();
+                node->uds.type = SOCKID_CORENET;
+                node->uds.addr = 0;
+                ret = corenet_tcp_add(NULL, &node->uds, node, NULL,
+                                      __corenet_shm_reset, NULL,
+                                      __corenet_shm_event, "corenet_shm");
+                if (unlikely(ret)) {
+                        close(sd);
+                        node->uds.sd = -1;
+                }
+        }
+}
+
+/*
+ * ENOENT or ECONNREFUSED: the core is not on this host, or runs without
+ * tcp_shm. the caller goes on with tcp.
+ */
+int corenet_shm_connect(const coreid_t *coreid, sockid_t *sockid)
+{
+        int ret, sd, fd;
+        void *addr;
+        socklen_t len;
+        struct sockaddr_un sun;
+        struct iovec iov;
+        struct msghdr mh;
+        struct cmsghdr *cm;
+        char control[CMSG_SPACE(sizeof(int))];
+        shm_msg_t msg;
+        shm_map_t *map;
+        corerpc_ctx_t *ctx;
+        corenet_shm_node_t *node;
+        corenet_shm_t *shm = __corenet_shm__;
+
+        if (shm == NULL) {
+                ret = ENOSYS;
+                goto err_ret;
+        }
+
+        sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sd < 0) {
+                ret = errno;
+                GOTO(err_ret, ret);
+        }
+
+        __corenet_shm_addr(coreid, &sun, &len);
+        ret = connect(sd, (struct sockaddr *)&sun, len);
+        if (ret < 0) {
+                ret = errno;
+                goto err_sd;
+        }
+
+        /* someone else may hold the name */
+        ret = __corenet_shm_peer(sd);
+        if (unlikely(ret)) {
+                ret = ECONNREFUSED;
+                goto err_sd;
+        }
+
+        node = __corenet_shm_node_new(shm);
+        if (unlikely(node == NULL)) {
+                ret = EMFILE;
+                GOTO(err_sd, ret);
+        }
+
+        /* hugetlb if there are free pages, the data regions are large */
+        ret = __corenet_shm_memfd(1, &fd, &addr);
+        if (unlikely(ret)) {
+                ret = __corenet_shm_memfd(0, &fd, &addr);
+                if (unlikely(ret))
+                        GOTO(err_sd, ret);
+        }
+
+        msg.magic = CORENET_SHM_MAGIC;
+        msg.from = shm->coreid;
+        msg.to = *coreid;
+
+        iov.iov_base = &msg;
+        iov.iov_len = sizeof(msg);
+        memset(&mh, 0x0, sizeof(mh));
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        mh.msg_control = control;
+        mh.msg_controllen = sizeof(control);
+        cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cm), &fd, sizeof(fd));
+
+        ret = sendmsg(sd, &mh, MSG_NOSIGNAL);
+        close(fd);
+        if (ret != sizeof(msg)) {
+                ret = ret < 0 ? errno : EIO;
+                munmap(addr, SHM_MAP_SIZE);
+                GOTO(err_sd, ret);
+        }
+
+        map = __corenet_shm_map_new(addr);
+        if (unlikely(map == NULL)) {
+                ret = ENOMEM;
+                GOTO(err_sd, ret);
+        }
+
+        ret = slab_static_alloc1((void **)&ctx, sizeof(*ctx));
+        if (unlikely(ret))
+                UNIMPLEMENTED(__DUMP__);
+
+        /* no ack, messages wait in the queue until the peer attaches */
+        ctx->coreid = *coreid;
+        __corenet_shm_attach(shm, node, map, 0, ctx);
+
+        node->uds.sd = sd;
+        node->uds.seq = _random();
+        node->uds.type = SOCKID_CORENET;
+        node->uds.addr = 0;
+        ret = corenet_tcp_add(NULL, &node->uds, node, NULL, __corenet_shm_reset,
+                              NULL, __corenet_shm_event,
+                              netable_rname(&coreid->nid));
+        if (unlikely(ret))
+                UNIMPLEMENTED(__DUMP__);
+
+        DINFO("shm connect %s/%u sd %d\n", netable_rname(&coreid->nid),
+              coreid->idx, node->sockid.sd);
+
+        *sockid = node->sockid;
+
+        return 0;
+err_sd:
+        close(sd);
+err_ret:
+        return ret;
+}
+
+int corenet_shm_connected(const sockid_t *sockid)
+{
+        return __corenet_shm_node(sockid) != NULL;
+}
+
+corenet_credit_t *corenet_shm_credit(const sockid_t *sockid)
+{
+        corenet_shm_node_t *node;
+
+        node = __corenet_shm_node(sockid);
+        if (node == NULL)
+                return NULL;
+
+        return &node->credit;
+}
+
+void corenet_shm_close(const sockid_t *sockid)
+{
+        sockid_t uds;
+        corenet_shm_node_t *node;
+
+        node = __corenet_shm_node(sockid);
+        if (node == NULL)
+                return;
+
+        uds = node->uds;
+        corenet_tcp_close(&uds);
+}
+
+/* blocks go back in the order they were handed out */
+static void __corenet_shm_reclaim(corenet_shm_node_t *node)
+{
+        uint32_t idx;
+        shm_queue_t *tx = node->tx;
+        shm_map_t *map = node->map;
+
+        while (node->tx_done != node->tx_head) {
+                idx = node->tx_done % CORENET_SHM_SLOT;
+                if (!__atomic_load_n(&tx->done[idx], __ATOMIC_ACQUIRE))
+                        break;
+
+                node->data_tail = (node->data_tail + map->size[idx]) % CORENET_SHM_DATA;
+                node->data_used -= map->size[idx];
+                node->tx_done++;
+        }
+
+        if (node->data_used == 0) {
+                node->data_head = 0;
+                node->data_tail = 0;
+        }
+}
+
+/* copy one message into the region, ENOSPC until the receiver frees some */
+static int __corenet_shm_put(corenet_shm_node_t *node, ltgbuf_t *buf)
+{
+        uint32_t size, pad = 0, off, idx;
+        shm_queue_t *tx = node->tx;
+        shm_map_t *map = node->map;
+        shm_slot_t *slot;
+
+        __corenet_shm_reclaim(node);
+
+        if (node->tx_head - node->tx_done >= CORENET_SHM_SLOT)
+                return ENOSPC;
+
+        size = _align_up(buf->len, CACHE_LINE_SIZE);
+        off = node->data_head;
+        if (off + size > CORENET_SHM_DATA)
+                pad = CORENET_SHM_DATA - off;
+
+        if (node->data_used + pad + size > CORENET_SHM_DATA)
+                return ENOSPC;
+
+        if (pad)
+                off = 0;
+
+        ltgbuf_get(buf, node->tx_data + off, buf->len);
+
+        idx = node->tx_head % CORENET_SHM_SLOT;
+        map->size[idx] = pad + size;
+        tx->done[idx] = 0;
+        slot = &tx->slot[idx];
+        slot->off = off;
+        slot->len = buf->len;
+
+        node->tx_head++;
+        node->data_head = (off + size) % CORENET_SHM_DATA;
+        node->data_used += pad + size;
+        node->nr_send++;
+
+        ltgbuf_free(buf);
+
+        return 0;
+}
+
+int corenet_shm_send(void *ctx, const sockid_t *sockid, ltgbuf_t *buf)
+{
+        int ret;
+        corenet_shm_node_t *node;
+        shm_pending_t *pending;
+
+        (void) ctx;
+
+        node = __corenet_shm_node(sockid);
+        if (unlikely(node == NULL)) {
+                ret = ECONNRESET;
+                GOTO(err_ret, ret);
+        }
+
+        if (unlikely(buf->len > CORENET_SHM_DATA)) {
+                ret = EMSGSIZE;
+                GOTO(err_ret, ret);
+        }
+
+        if (list_empty(&node->pending)) {
+                ret = __corenet_shm_put(node, buf);
+                if (likely(ret == 0))
+                        goto out;
+        }
+
+        pending = slab_stream_alloc(sizeof(*pending));
+        if (unlikely(pending == NULL)) {
+                ret = ENOMEM;
+                GOTO(err_ret, ret);
+        }
+
+        ltgbuf_init(&pending->buf, 0);
+        ltgbuf_merge(&pending->buf, buf);
+        list_add_tail(&pending->hook, &node->pending);
+        node->nr_full++;
+out:
+        if (list_empty(&node->send_hook))
+                list_add_tail(&node->send_hook, &__corenet_shm__->send_list);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static void __corenet_shm_publish(corenet_shm_node_t *node)
+{
+        char kick = 0;
+        shm_queue_t *tx = node->tx;
+
+        if (tx->head == node->tx_head)
+                return;
+
+        __atomic_store_n(&tx->head, node->tx_head, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&tx->kick, __ATOMIC_RELAXED)) {
+                send(node->uds.sd, &kick, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+        }
+}
+
+void corenet_shm_commit(void *_shm)
+{
+        corenet_shm_t *shm = _shm;
+        corenet_shm_node_t *node;
+        shm_pending_t *pending;
+        struct list_head *pos, *n;
+
+        list_for_each_safe(pos, n, &shm->send_list) {
+                node = list_entry(pos, corenet_shm_node_t, send_hook);
+
+                while (!list_empty(&node->pending)) {
+                        pending = list_entry(node->pending.next, shm_pending_t, hook);
+                        if (__corenet_shm_put(node, &pending->buf))
+                                break;
+
+                        list_del(&pending->hook);
+                        slab_stream_free(pending);
+                }
+
+                __corenet_shm_publish(node);
+
+                if (list_empty(&node->pending))
+                        list_del_init(&node->send_hook);
+        }
+}
+
+static int __corenet_shm_recv(corenet_shm_node_t *node, int polling)
+{
+        int count = 0, _count;
+        uint32_t head, idx, off, len;
+        ltgbuf_t buf;
+        sockid_t uds;
+        shm_queue_t *rx = node->rx;
+        shm_map_t *map = node->map;
+        shm_ref_t *ref;
+
+        /* a sleeping core wants a byte on the socket with the next message */
+        __atomic_store_n(&rx->kick, !polling, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        head = __atomic_load_n(&rx->head, __ATOMIC_ACQUIRE);
+        while (node->rx_tail != head) {
+                idx = node->rx_tail % CORENET_SHM_SLOT;
+                off = rx->slot[idx].off;
+                len = rx->slot[idx].len;
+                ref = &map->rx[idx];
+
+                /* out of the region, or a slot the peer did not get back */
+                if (unlikely(head - node->rx_tail > CORENET_SHM_SLOT
+                             || off > CORENET_SHM_DATA || len > CORENET_SHM_DATA - off
+                             || __atomic_load_n(&ref->ref.ref, __ATOMIC_ACQUIRE))) {
+                        DERROR("bad shm slot %u off %u len %u from %s/%u\n",
+                               node->rx_tail, off, len,
+                               netable_rname(&((corerpc_ctx_t *)node->ctx)->coreid.nid),
+                               ((corerpc_ctx_t *)node->ctx)->coreid.idx);
+                        uds = node->uds;
+                        corenet_tcp_close(&uds);
+                        return count;
+                }
+
+                __atomic_add_fetch(&map->ref, 1, __ATOMIC_RELAXED);
+                ltgbuf_initref(&buf, node->rx_data + off, len, &ref->ref);
+                node->rx_tail++;
+                node->nr_recv++;
+                count++;
+
+                node->exec(node->ctx, &buf, &_count);
+
+                /* closed by the handler */
+                if (unlikely(node->map != map))
+                        return count;
+        }
+
+        return count;
+}
+
+int corenet_shm_poll(void *_shm, int polling)
+{
+        int count = 0;
+        corenet_shm_t *shm = _shm;
+        corenet_shm_node_t *node;
+        struct list_head *pos, *n;
+
+        list_for_each_safe(pos, n, &shm->poll_list) {
+                node = list_entry(pos, corenet_shm_node_t, hook);
+                count += __corenet_shm_recv(node, polling);
+        }
+
+        return count;
+}
+
+int corenet_shm_init(const coreid_t *coreid, corenet_shm_t **_shm)
+{
+        int ret, sd;
+        socklen_t len;
+        struct sockaddr_un sun;
+        sockid_t sockid;
+        corenet_shm_t *shm;
+        corenet_shm_node_t *node;
+
+        ret = ltg_malloc((void **)&shm, sizeof(*shm)
+                         + sizeof(corenet_shm_node_t) * CORENET_SHM_MAX);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        shm->coreid = *coreid;
+        shm->size = CORENET_SHM_MAX;
+        INIT_LIST_HEAD(&shm->poll_list);
+        INIT_LIST_HEAD(&shm->send_list);
+
+        for (int i = 0; i < shm->size; i++) {
+                node = &shm->array[i];
+                memset(node, 0x0, sizeof(*node));
+                INIT_LIST_HEAD(&node->hook);
+                INIT_LIST_HEAD(&node->send_hook);
+                INIT_LIST_HEAD(&node->pending);
+                node->sockid.sd = -1;
+                node->uds.sd = -1;
+        }
+
+        sd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sd < 0) {
+                ret = errno;
+                GOTO(err_free, ret);
+        }
+
+        __corenet_shm_addr(coreid, &sun, &len);
+        ret = bind(sd, (struct sockaddr *)&sun, len);
+        if (ret < 0) {
+                ret = errno;
+                DWARN("bind %s fail %s\n", sun.sun_path + 1, strerror(ret));
+                GOTO(err_sd, ret);
+        }
+
+        ret = listen(sd, 256);
+        if (ret < 0) {
+                ret = errno;
+                GOTO(err_sd, ret);
+        }
+
+        shm->sd = sd;
+        __corenet_shm__ = shm;
+
+        sockid.sd = sd;
+        sockid.seq = _random();
+        sockid.type = SOCKID_CORENET;
+        sockid.addr = 0;
+        ret = corenet_tcp_add(NULL, &sockid, shm, NULL, NULL, NULL,
+                              __corenet_shm_accept, "corenet_shm_passive");
+        if (unlikely(ret))
+                GOTO(err_unset, ret);
+
+        *_shm = shm;
+
+        return 0;
+err_unset:
+        __corenet_shm__ = NULL;
+err_sd:
+        close(sd);
+err_free:
+        ltg_free((void **)&shm);
+err_ret:
+        return ret;
+}
@@ -6,6 +6,7 @@
 #include <pthread.h>
 #include <signal.h>
 #include <netinet/tcp.h>
+#include <linux/errqueue.h>
 #include <errno.h>
 
 #define DBG_SUBSYS S_LTG_NET
@@ -30,8 +31,17 @@ static int __corenet_tcp_rwlock_init(corenet_node_t *node);
 static void __corenet_tcp_unlock(corenet_node_t *node);
 static int __corenet_tcp_remote(int fd, ltgbuf_t *buf, int op);
 
+#else
+
+static void __corenet_tcp_zc_enable(corenet_node_t *node);
+static void __corenet_tcp_zc_free(corenet_node_t *node);
+static int __corenet_tcp_zc_reap(int sd, struct list_head *list);
+
 #endif
 
+/* per core, for the stats read from other threads */
+static corenet_tcp_t *__corenet_tcp_core__[CORE_MAX];
+
 static void S_LTG *__corenet_get()
 {
         return core_tls_get(NULL, VARIABLE_CORENET_TCP);
@@ -42,6 +52,97 @@ static void S_LTG *__corenet_get_byctx(void *ctx)
         return core_tls_get(ctx, VARIABLE_CORENET_TCP);
 }
 
+#if ENABLE_TCP_URING
+
+#define URING_OP_RECV 0
+#define URING_OP_SEND 1
+#define URING_OP_EPOLL 2
+#define URING_OP_CANCEL 3
+
+#define URING_DATA(seq, sd, op) (((uint64_t)(seq) << 32) | ((uint64_t)(sd) << 2) | (op))
+#define URING_DATA_SEQ(data) ((uint32_t)((data) >> 32))
+#define URING_DATA_SD(data) ((int)(((data) >> 2) & 0x3fffffff))
+#define URING_DATA_OP(data) ((int)((data) & 0x3))
+/* a send is found by its context, it may outlive the node */
+#define URING_DATA_SEND(send) ((uint64_t)(uintptr_t)(send) | URING_OP_SEND)
+#define URING_DATA_PTR(data) ((void *)(uintptr_t)((data) & ~0x3ULL))
+
+typedef struct {
+        int inflight;
+        int closed;                     /* freed by the send's cqe */
+        corenet_node_t *node;
+        ltgbuf_t buf;                   /* what the closed node had in flight */
+        struct msghdr msg;
+        struct iovec iov[CORENET_URING_IOV_MAX];
+} corenet_uring_send_t;
+
+static int __corenet_uring_add(corenet_tcp_t *corenet, corenet_node_t *node)
+{
+        int ret;
+        corenet_uring_send_t *send;
+
+        ret = ltg_malloc_tag((void **)&send, sizeof(*send), MEM_TAG_CORENET);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        memset(send, 0x0, sizeof(*send));
+        send->node = node;
+        send->msg.msg_iov = send->iov;
+
+        ret = corenet_uring_recv(corenet->uring, node->sockid.sd,
+                                 URING_DATA(node->sockid.seq, node->sockid.sd,
+                                            URING_OP_RECV));
+        if (unlikely(ret))
+                GOTO(err_free, ret);
+
+        node->uring_send = send;
+        node->uring = 1;
+        INIT_LIST_HEAD(&node->uring_hook);
+
+        return 0;
+err_free:
+        ltg_free_tag((void **)&send, MEM_TAG_CORENET);
+err_ret:
+        return ret;
+}
+
+static void __corenet_uring_close(corenet_tcp_t *corenet, corenet_node_t *node)
+{
+        int ret, sd = node->sockid.sd;
+        corenet_uring_send_t *send = node->uring_send;
+
+        /* pending sends fail, then drop the kernel's file refs before close */
+        shutdown(sd, SHUT_RDWR);
+
+        ret = corenet_uring_cancel(corenet->uring, sd,
+                                   URING_DATA(0, 0, URING_OP_CANCEL));
+        if (likely(ret == 0)) {
+                ret = corenet_uring_submit(corenet->uring, 0, 0);
+        }
+
+        if (unlikely(ret)) {
+                DWARN("cancel sd %d fail %s\n", sd, strerror(ret));
+        }
+
+        if (!list_empty(&node->uring_hook)) {
+                list_del_init(&node->uring_hook);
+        }
+
+        /* the sqe still points at msghdr and the data, the cqe frees them */
+        if (send->inflight) {
+                send->closed = 1;
+                ltgbuf_init(&send->buf, 0);
+                ltgbuf_merge(&send->buf, &node->send_buf);
+                node->uring_send = NULL;
+        } else {
+                ltg_free_tag((void **)&node->uring_send, MEM_TAG_CORENET);
+        }
+
+        node->uring = 0;
+}
+
+#endif
+
 static void __corenet_set_out(corenet_node_t *node)
 {
         int ret, event;
@@ -191,6 +292,7 @@ static int __corenet_add(corenet_tcp_t *corenet, const sockid_t *sockid, void *c
         node->recv = recv;
         node->check = check;
         node->sockid = *sockid;
+        corerpc_credit_init(&node->credit);
 
         LTG_ASSERT(node->name == NULL);
         ret = ltg_malloc((void **)&node->name, strlen(name) + 1);
@@ -199,6 +301,26 @@ static int __corenet_add(corenet_tcp_t *corenet, const sockid_t *sockid, void *c
         
         strcpy(node->name, name);
 
+#if ENABLE_TCP_URING
+        /* fds with their own recv handler stay on epoll */
+        if (corenet->uring && recv == NULL) {
+                ret = __corenet_uring_add(corenet, node);
+                if (unlikely(ret))
+                        UNIMPLEMENTED(__DUMP__);
+
+                DBUG("corenet_tcp connect %s[%u] %s sd %d uring\n", sche->name,
+                     sche->id, node->name, sd);
+
+                return 0;
+        }
+#endif
+
+#if !ENABLE_TCP_THREAD
+        if (recv == NULL) {
+                __corenet_tcp_zc_enable(node);
+        }
+#endif
+
         ev.data.fd = sd;
         ev.events = event;
         ret = epoll_ctl(corenet->corenet.epoll_fd, EPOLL_CTL_ADD, sd, &ev);
@@ -305,6 +427,11 @@ static void __corenet_close__(const sockid_t *sockid)
               sche->id, node->name, sd, node->ev);
         LTG_ASSERT(node->ev);
 
+#if ENABLE_TCP_URING
+        if (node->uring) {
+                __corenet_uring_close(__corenet__, node);
+        } else
+#endif
         if (node->ev) {
                 ev.data.fd = sd;
                 ev.events = node->ev;
@@ -315,6 +442,8 @@ static void __corenet_close__(const sockid_t *sockid)
                 }
         }
 
+        corerpc_credit_reset(&node->credit);
+
         if (node->reset)
                 node->reset(node->ctx);
 
@@ -322,9 +451,18 @@ static void __corenet_close__(const sockid_t *sockid)
         corerpc_reset(&node->sockid);
 #endif
 
+#if !ENABLE_TCP_THREAD
+        __corenet_tcp_zc_free(node);
+#endif
         close(node->sockid.sd);
         ltgbuf_free(&node->recv_buf);
         ltgbuf_free(&node->send_buf);
+#if !ENABLE_TCP_THREAD
+        mem_chunk_rx_free(&node->rx);
+        if (!list_empty(&node->send_list)) {
+                list_del_init(&node->send_list);
+        }
+#endif
 
         if (!list_empty(&node->hook)) {
                 __corenet_checklist_del(__corenet__, node);
@@ -413,9 +551,13 @@ static int __corenet_tcp_local(int fd, ltgbuf_t *buf, int op)
                 LTG_ASSERT(0);
         }
 
+        __corenet__->nr_syscall++;
+
         if (ret < 0) {
                 ret = -ret;
-                DWARN("sd %u %u %s\n", fd, ret, strerror(ret));
+                if (ret != EAGAIN) {
+                        DWARN("sd %u %u %s\n", fd, ret, strerror(ret));
+                }
                 LTG_ASSERT(ret != EMSGSIZE);
                 LTG_ASSERT(ret != EFAULT);
                 GOTO(err_ret, ret);
@@ -466,14 +608,14 @@ err_ret:
         return ret;
 }
 
-static int __corenet_tcp_recv(corenet_node_t *node, int *count)
+static int __corenet_tcp_recv_fionread(corenet_node_t *node)
 {
         int ret, toread;
         uint64_t left, cp;
-
-        ANALYSIS_BEGIN(0);
+        corenet_tcp_t *__corenet__ = __corenet_get();
 
         ret = ioctl(node->sockid.sd, FIONREAD, &toread);
+        __corenet__->nr_syscall++;
         if (ret < 0) {
                 ret = errno;
                 GOTO(err_ret, ret);
@@ -502,6 +644,41 @@ static int __corenet_tcp_recv(corenet_node_t *node, int *count)
                 left -= cp;
         }
 
+        return 0;
+err_ret:
+        return ret;
+}
+
+static int __corenet_tcp_recv(corenet_node_t *node, int *count)
+{
+        int ret;
+
+        ANALYSIS_BEGIN(0);
+
+#if ENABLE_TCP_THREAD
+        ret = __corenet_tcp_recv_fionread(node);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+#else
+        uint32_t len = 0;
+        uint64_t nr_recv = node->rx.nr_recv;
+        corenet_tcp_t *__corenet__ = __corenet_get();
+
+        /* straight into the chunk ring, sized reads only without chunks */
+        ret = mem_chunk_recv(&node->rx, node->sockid.sd, &node->recv_buf, &len);
+        __corenet__->nr_syscall += node->rx.nr_recv - nr_recv;
+        if (unlikely(ret)) {
+                if (ret != ENOBUFS)
+                        GOTO(err_ret, ret);
+
+                ret = __corenet_tcp_recv_fionread(node);
+                if (unlikely(ret))
+                        GOTO(err_ret, ret);
+        }
+
+        DBUG("recv %u, left %u\n", len, node->recv_buf.len);
+#endif
+
         // __iscsi_newtask_core
         // corerpc_recv
         ret = node->exec(node->ctx, &node->recv_buf, count);
@@ -515,6 +692,388 @@ err_ret:
         return ret;
 }
 
+#if !ENABLE_TCP_THREAD
+
+typedef struct {
+        struct list_head hook;
+        uint32_t id;
+        int done;
+        ltgbuf_t buf;
+} corenet_zc_t;
+
+/* sends of a closed socket, held until the kernel is done with them */
+typedef struct {
+        struct list_head hook;
+        int sd;                         /* dup of the closed socket */
+        time_t expire;
+        struct list_head zc_list;
+} corenet_zc_orphan_t;
+
+static void __corenet_tcp_zc_enable(corenet_node_t *node)
+{
+        int ret, one = 1;
+
+        if (ltgconf_global.tcp_zerocopy == 0)
+                return;
+
+        ret = setsockopt(node->sockid.sd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+        if (unlikely(ret < 0)) {
+                DWARN("%s sd %d zerocopy %s\n", node->name, node->sockid.sd,
+                      strerror(errno));
+                return;
+        }
+
+        node->zc = 1;
+}
+
+/* completions may be reported out of order, release in send order */
+static void __corenet_tcp_zc_release(struct list_head *list)
+{
+        corenet_zc_t *zc;
+
+        while (!list_empty(list)) {
+                zc = (void *)list->next;
+                if (!zc->done)
+                        break;
+
+                list_del(&zc->hook);
+                ltgbuf_free(&zc->buf);
+                slab_stream_free(zc);
+        }
+}
+
+static void __corenet_tcp_zc_done(struct list_head *list, uint32_t lo, uint32_t hi)
+{
+        struct list_head *pos;
+        corenet_zc_t *zc;
+
+        list_for_each(pos, list) {
+                zc = (void *)pos;
+
+                if (zc->id - lo <= hi - lo)
+                        zc->done = 1;
+        }
+}
+
+/* only once the kernel dropped its references */
+static void __corenet_tcp_zc_drop(struct list_head *list)
+{
+        struct list_head *pos;
+
+        list_for_each(pos, list) {
+                ((corenet_zc_t *)pos)->done = 1;
+        }
+
+        __corenet_tcp_zc_release(list);
+}
+
+/* a linger of 0 makes close purge the write queue, and the pages with it */
+static void __corenet_tcp_zc_abort(int sd)
+{
+        int ret;
+        struct linger linger = {1, 0};
+
+        ret = setsockopt(sd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+        if (unlikely(ret < 0)) {
+                DWARN("sd %d linger %s\n", sd, strerror(errno));
+        }
+}
+
+/*
+ * called before the socket is closed. the kernel may still hold pages
+ * of sends not reported yet, so they move to an orphan that keeps a dup
+ * of the socket, and are released as the completions come in.
+ */
+static void __corenet_tcp_zc_free(corenet_node_t *node)
+{
+        int sd;
+        corenet_zc_orphan_t *orphan;
+        corenet_tcp_t *__corenet__ = __corenet_get();
+
+        if (!list_empty(&node->zc_list)) {
+                __corenet_tcp_zc_reap(node->sockid.sd, &node->zc_list);
+        }
+
+        if (list_empty(&node->zc_list))
+                goto out;
+
+        sd = dup(node->sockid.sd);
+        if (unlikely(sd < 0)) {
+                /* the caller closes it right after, nothing reuses them before */
+                DWARN("%s dup %s, abort\n", node->name, strerror(errno));
+                __corenet_tcp_zc_abort(node->sockid.sd);
+                __corenet_tcp_zc_drop(&node->zc_list);
+                goto out;
+        }
+
+        /* what close would do, data already queued is still sent */
+        shutdown(sd, SHUT_RDWR);
+
+        orphan = slab_stream_alloc(sizeof(*orphan));
+        LTG_ASSERT(orphan);
+        orphan->sd = sd;
+        orphan->expire = gettime() + ltgconf_global.rpc_timeout;
+        INIT_LIST_HEAD(&orphan->zc_list);
+        list_splice_init(&node->zc_list, &orphan->zc_list);
+        list_add_tail(&orphan->hook, &__corenet__->zc_orphan);
+
+        DINFO("%s sd %d zerocopy in flight, hold it on %d\n", node->name,
+              node->sockid.sd, sd);
+out:
+        node->zc = 0;
+        node->zc_partial = 0;
+        node->zc_seq = 0;
+}
+
+/* once a second from poll, the orphans past their time are aborted */
+static void __corenet_tcp_zc_orphan(corenet_tcp_t *__corenet__)
+{
+        time_t now;
+        struct list_head *pos, *n;
+        corenet_zc_orphan_t *orphan;
+
+        now = gettime();
+        if (now == __corenet__->zc_scan)
+                return;
+
+        __corenet__->zc_scan = now;
+
+        list_for_each_safe(pos, n, &__corenet__->zc_orphan) {
+                orphan = (void *)pos;
+
+                __corenet_tcp_zc_reap(orphan->sd, &orphan->zc_list);
+                if (list_empty(&orphan->zc_list)) {
+                        close(orphan->sd);
+                } else if (now > orphan->expire) {
+                        DWARN("sd %d zerocopy not completed, abort\n", orphan->sd);
+                        __corenet_tcp_zc_abort(orphan->sd);
+                        close(orphan->sd);
+                        __corenet_tcp_zc_drop(&orphan->zc_list);
+                } else {
+                        continue;
+                }
+
+                list_del(&orphan->hook);
+                slab_stream_free(orphan);
+        }
+}
+
+/*
+ * read the completions off the error queue, returns how many were
+ * found. anything else on the queue is a real socket error.
+ */
+static int __corenet_tcp_zc_reap(int sd, struct list_head *list)
+{
+        int ret, count = 0;
+        char control[128];
+        struct msghdr msg;
+        struct cmsghdr *cm;
+        struct sock_extended_err *serr;
+        corenet_tcp_t *__corenet__ = __corenet_get();
+
+        while (1) {
+                memset(&msg, 0x0, sizeof(msg));
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+
+                ret = recvmsg(sd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+                __corenet__->nr_syscall++;
+                if (ret < 0) {
+                        ret = errno;
+                        if (ret == EAGAIN)
+                                break;
+                        else if (ret == EINTR)
+                                continue;
+
+                        GOTO(err_ret, ret);
+                }
+
+                cm = CMSG_FIRSTHDR(&msg);
+                if (unlikely(cm == NULL)) {
+                        ret = EIO;
+                        GOTO(err_ret, ret);
+                }
+
+                serr = (void *)CMSG_DATA(cm);
+                if (unlikely(serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY
+                             || serr->ee_errno)) {
+                        ret = serr->ee_errno ? (int)serr->ee_errno : EIO;
+                        GOTO(err_ret, ret);
+                }
+
+                __corenet_tcp_zc_done(list, serr->ee_info, serr->ee_data);
+
+                __corenet__->nr_zc_complete += serr->ee_data - serr->ee_info + 1;
+                if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                        __corenet__->nr_zc_copied += serr->ee_data - serr->ee_info + 1;
+                }
+
+                count++;
+        }
+
+        __corenet_tcp_zc_release(list);
+
+        return count;
+err_ret:
+        return -ret;
+}
+
+/*
+ * send the owned head of send_buf with MSG_ZEROCOPY. sent segments stay
+ * pinned on zc_list until the kernel reports completion. a segment cut
+ * by a short send stays at the head of send_buf and must go out the same
+ * way, so that it is only released after the earlier send. returns
+ * ENOTSUP when a plain send should be used.
+ */
+static int __corenet_tcp_zc_send(corenet_node_t *node)
+{
+        int ret, iov_count;
+        uint32_t len, whole;
+        struct msghdr msg;
+        ltgbuf_t *buf = &node->send_buf, tmp;
+        corenet_zc_t *zc;
+        corenet_tcp_t *__corenet__ = __corenet_get();
+
+        /* shared segments may be freed by their owner at any time */
+        len = ltgbuf_owned(buf);
+        if (!node->zc_partial && len < (uint32_t)ltgconf_global.tcp_zerocopy) {
+                __corenet__->nr_zc_fallback++;
+                return ENOTSUP;
+        }
+
+        LTG_ASSERT(len);
+
+        iov_count = CORE_IOV_MAX;
+        ltgbuf_trans2(__corenet__->iov, &iov_count, 0, len, buf);
+
+        memset(&msg, 0x0, sizeof(msg));
+        msg.msg_iov = __corenet__->iov;
+        msg.msg_iovlen = iov_count;
+
+        ret = _sendmsg(node->sockid.sd, &msg, MSG_DONTWAIT | MSG_ZEROCOPY);
+        __corenet__->nr_syscall++;
+        if (ret < 0) {
+                ret = -ret;
+                /* out of optmem, wait for completions if the head is pinned */
+                if (ret == ENOBUFS) {
+                        if (node->zc_partial)
+                                return 0;
+
+                        __corenet__->nr_zc_fallback++;
+                        return ENOTSUP;
+                }
+
+                /* stays queued, EPOLLOUT resumes it */
+                if (ret == EAGAIN)
+                        return 0;
+
+                GOTO(err_ret, ret);
+        }
+
+        zc = slab_stream_alloc(sizeof(*zc));
+        LTG_ASSERT(zc);
+        zc->id = node->zc_seq++;
+        zc->done = 0;
+        ltgbuf_init(&zc->buf, 0);
+
+        whole = ltgbuf_segfloor(buf, ret);
+        if (whole) {
+                ltgbuf_init(&tmp, 0);
+                ltgbuf_pop(buf, &tmp, whole);
+                ltgbuf_merge(&zc->buf, &tmp);
+        }
+
+        /* only moves the split segment forward */
+        if ((uint32_t)ret > whole) {
+                ltgbuf_pop(buf, NULL, ret - whole);
+        }
+
+        node->zc_partial = (uint32_t)ret > whole;
+        list_add_tail(&zc->hook, &node->zc_list);
+
+        __corenet__->nr_zc_send++;
+        __corenet__->nr_zc_bytes += ret;
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+int corenet_tcp_zc_stat(int hash, corenet_zc_stat_t *stat)
+{
+        corenet_tcp_t *corenet;
+
+        if (hash < 0 || hash >= CORE_MAX)
+                return EINVAL;
+
+        corenet = __corenet_tcp_core__[hash];
+        if (corenet == NULL)
+                return ENOENT;
+
+        stat->send = __atomic_load_n(&corenet->nr_zc_send, __ATOMIC_RELAXED);
+        stat->bytes = __atomic_load_n(&corenet->nr_zc_bytes, __ATOMIC_RELAXED);
+        stat->complete = __atomic_load_n(&corenet->nr_zc_complete, __ATOMIC_RELAXED);
+        stat->copied = __atomic_load_n(&corenet->nr_zc_copied, __ATOMIC_RELAXED);
+        stat->fallback = __atomic_load_n(&corenet->nr_zc_fallback, __ATOMIC_RELAXED);
+
+        return 0;
+}
+
+#else
+
+int corenet_tcp_zc_stat(int hash, corenet_zc_stat_t *stat)
+{
+        (void) hash;
+        (void) stat;
+
+        return ENOSYS;
+}
+
+#endif
+
+/* syscalls of a core's corenet_tcp, io_uring_enter counted apart */
+int corenet_tcp_sys_stat(int hash, corenet_sys_stat_t *stat)
+{
+        corenet_tcp_t *corenet;
+
+        if (hash < 0 || hash >= CORE_MAX)
+                return EINVAL;
+
+        corenet = __corenet_tcp_core__[hash];
+        if (corenet == NULL)
+                return ENOENT;
+
+        stat->syscall = __atomic_load_n(&corenet->nr_syscall, __ATOMIC_RELAXED);
+        stat->enter = 0;
+        stat->sqe = 0;
+
+#if ENABLE_TCP_URING
+        if (corenet->uring) {
+                corenet_uring_t *uring = corenet->uring;
+
+                stat->enter = __atomic_load_n(&uring->nr_enter, __ATOMIC_RELAXED);
+                stat->sqe = __atomic_load_n(&uring->nr_sqe, __ATOMIC_RELAXED);
+        }
+#endif
+
+        return 0;
+}
+
+corenet_credit_t *corenet_tcp_credit(const sockid_t *sockid)
+{
+        corenet_node_t *node;
+        corenet_tcp_t *__corenet__ = __corenet_get();
+
+        if (unlikely(__corenet__ == NULL))
+                return NULL;
+
+        node = &__corenet__->array[sockid->sd];
+        if (node->sockid.seq != sockid->seq || node->sockid.sd == -1)
+                return NULL;
+
+        return &node->credit;
+}
+
 static int __corenet_tcp_send(corenet_node_t *node)
 {
         int ret;
@@ -528,7 +1087,20 @@ static int __corenet_tcp_send(corenet_node_t *node)
 #if ENABLE_TCP_THREAD
                 ret = __corenet_tcp_remote(node->sockid.sd, buf, __OP_SEND__);
 #else
+                if (node->zc && (node->zc_partial
+                                 || buf->len >= (uint32_t)ltgconf_global.tcp_zerocopy)) {
+                        ret = __corenet_tcp_zc_send(node);
+                        if (ret != ENOTSUP) {
+                                if (unlikely(ret))
+                                        GOTO(err_ret, ret);
+
+                                goto out;
+                        }
+                }
+
                 ret = __corenet_tcp_local(node->sockid.sd, buf, __OP_SEND__);
+                if (ret == -EAGAIN)
+                        goto out;
 #endif
                 if (ret < 0) {
                         ret = -ret;
@@ -547,6 +1119,9 @@ static int __corenet_tcp_send(corenet_node_t *node)
 #endif
         }
 
+#if !ENABLE_TCP_THREAD
+out:
+#endif
         ANALYSIS_QUEUE(0, IO_WARN, NULL);
 
         return 0;
@@ -782,7 +1357,7 @@ static void *__corenet_tcp_thread(void *args)
 
         INIT_LIST_HEAD(&list);
 
-        ret = ltg_malloc((void **)&iov, sizeof(*iov) * CORE_IOV_MAX);
+        ret = ltg_malloc_tag((void **)&iov, sizeof(*iov) * CORE_IOV_MAX, MEM_TAG_CORENET);
         if (ret)
                 UNIMPLEMENTED(__DUMP__);
 
@@ -1104,6 +1679,14 @@ static int __corenet_tcp_exec(void *ctx, corenet_node_t *node, event_t *ev)
 
         DBUG("ev %x\n", ev->events);
 
+        /* zerocopy completions raise EPOLLERR too */
+        if (unlikely(ev->events & EPOLLERR) && node->zc) {
+                ret = __corenet_tcp_zc_reap(node->sockid.sd, &node->zc_list);
+                if (ret > 0) {
+                        ev->events &= ~EPOLLERR;
+                }
+        }
+
         if (unlikely((ev->events & EPOLLRDHUP) || (ev->events & EPOLLERR))
             || (ev->events & EPOLLHUP))  {
                 ret = ECONNRESET;
@@ -1129,16 +1712,14 @@ err_ret:
 #endif
 #endif
 
-int corenet_tcp_poll(void *ctx, int tmo)
+static int __corenet_tcp_epoll(void *ctx, corenet_tcp_t *__corenet__, int tmo)
 {
         int nfds, i;
         event_t events[512], *ev;
         corenet_node_t *node;
-        corenet_tcp_t *__corenet__ = __corenet_get_byctx(ctx);
 
-        DBUG("polling %d begin\n", tmo);
-        LTG_ASSERT(tmo >= 0 && tmo < ltgconf_global.rpc_timeout * 2);
         nfds = _epoll_wait(__corenet__->corenet.epoll_fd, events, 512, (tmo ? 1 : 0) * 1000);
+        __corenet__->nr_syscall++;
         if (unlikely(nfds < 0)) {
                 UNIMPLEMENTED(__DUMP__);
         }
@@ -1157,6 +1738,205 @@ int corenet_tcp_poll(void *ctx, int tmo)
         return 0;
 }
 
+#if ENABLE_TCP_URING
+
+static void __corenet_uring_send(corenet_tcp_t *corenet, corenet_node_t *node)
+{
+        int ret, iov_count;
+        corenet_uring_send_t *send = node->uring_send;
+        sockid_t sockid = node->sockid;
+
+        if (send->inflight || node->send_buf.len == 0)
+                return;
+
+        /* one send in flight per node keeps the stream in order */
+        iov_count = CORENET_URING_IOV_MAX;
+        ltgbuf_trans(send->iov, &iov_count, &node->send_buf);
+        send->msg.msg_iovlen = iov_count;
+
+        ret = corenet_uring_sendmsg(corenet->uring, sockid.sd, &send->msg,
+                                    URING_DATA_SEND(send));
+        if (unlikely(ret)) {
+                DWARN("send to %s @ %u fail %s\n", _inet_ntoa(sockid.addr),
+                      sockid.sd, strerror(ret));
+                corenet_tcp_close(&sockid);
+                return;
+        }
+
+        send->inflight = 1;
+}
+
+static void __corenet_uring_rearm(corenet_tcp_t *corenet, corenet_node_t *node)
+{
+        int ret;
+        sockid_t sockid = node->sockid;
+
+        ret = corenet_uring_recv(corenet->uring, sockid.sd,
+                                 URING_DATA(sockid.seq, sockid.sd, URING_OP_RECV));
+        if (unlikely(ret)) {
+                DWARN("recv from %s @ %u fail %s\n", _inet_ntoa(sockid.addr),
+                      sockid.sd, strerror(ret));
+                corenet_tcp_close(&sockid);
+        }
+}
+
+static void __corenet_uring_cqe(void *_corenet, uint64_t data, int res,
+                                uint32_t flags, void *buf)
+{
+        int ret, op = URING_DATA_OP(data);
+        corenet_tcp_t *corenet = _corenet;
+        corenet_node_t *node;
+        corenet_uring_send_t *send;
+        sockid_t sockid;
+
+        if (op == URING_OP_CANCEL) {
+                return;
+        } else if (op == URING_OP_EPOLL) {
+                corenet->uring_epoll = 1;
+                if (!(flags & IORING_CQE_F_MORE)) {
+                        ret = corenet_uring_poll(corenet->uring, corenet->corenet.epoll_fd,
+                                                 URING_DATA(0, 0, URING_OP_EPOLL));
+                        if (unlikely(ret))
+                                UNIMPLEMENTED(__DUMP__);
+                }
+
+                return;
+        } else if (op == URING_OP_SEND) {
+                send = URING_DATA_PTR(data);
+                send->inflight = 0;
+
+                if (unlikely(send->closed)) {
+                        DBUG("closed send res %d\n", res);
+                        ltgbuf_free(&send->buf);
+                        ltg_free_tag((void **)&send, MEM_TAG_CORENET);
+                        return;
+                }
+
+                node = send->node;
+                sockid = node->sockid;
+
+                if (unlikely(res < 0)) {
+                        DWARN("forward to %s @ %u len %d fail ret %d\n",
+                              _inet_ntoa(sockid.addr), sockid.sd,
+                              node->send_buf.len, -res);
+                        corenet_tcp_close(&sockid);
+                        return;
+                }
+
+                ltgbuf_pop(&node->send_buf, NULL, res);
+                __corenet_uring_send(corenet, node);
+                return;
+        }
+
+        node = &corenet->array[URING_DATA_SD(data)];
+        if (unlikely(!node->uring || node->sockid.seq != URING_DATA_SEQ(data))) {
+                DBUG("stale op %d sd %d res %d\n", op, URING_DATA_SD(data), res);
+                return;
+        }
+
+        sockid = node->sockid;
+
+        if (op == URING_OP_RECV) {
+                if (likely(res > 0)) {
+                        ret = ltgbuf_appendmem(&node->recv_buf, buf, res);
+                        if (unlikely(ret))
+                                UNIMPLEMENTED(__DUMP__);
+
+                        if (list_empty(&node->uring_hook)) {
+                                list_add_tail(&node->uring_hook, &corenet->uring_ready);
+                        }
+
+                        if (!(flags & IORING_CQE_F_MORE)) {
+                                __corenet_uring_rearm(corenet, node);
+                        }
+                } else if (res == -ENOBUFS) {
+                        __corenet_uring_rearm(corenet, node);
+                } else {
+                        DBUG("recv from %s @ %u ret %d\n", _inet_ntoa(sockid.addr),
+                             sockid.sd, res);
+                        corenet_tcp_close(&sockid);
+                }
+        }
+}
+
+static void __corenet_uring_exec_recv(void *_node)
+{
+        int ret, recv_msg;
+        corenet_node_t *node = _node;
+        sockid_t sockid = node->sockid;
+
+        if (unlikely(sockid.sd == -1 || node->recv_buf.len == 0))
+                return;
+
+        // corerpc_recv
+        ret = node->exec(node->ctx, &node->recv_buf, &recv_msg);
+        if (unlikely(ret)) {
+                corenet_tcp_close(&sockid);
+        }
+}
+
+static int __corenet_uring_poll(void *ctx, corenet_tcp_t *corenet, int tmo)
+{
+        int ret, count;
+        corenet_node_t *node;
+        struct list_head *pos, *n;
+
+        count = corenet_uring_reap(corenet->uring, __corenet_uring_cqe, corenet);
+        if (count == 0) {
+                /* no syscall unless task work is flagged or the core may sleep */
+                ret = corenet_uring_submit(corenet->uring, tmo, tmo);
+                if (unlikely(ret))
+                        UNIMPLEMENTED(__DUMP__);
+
+                corenet_uring_reap(corenet->uring, __corenet_uring_cqe, corenet);
+        }
+
+        list_for_each_safe(pos, n, &corenet->uring_ready) {
+                node = list_entry(pos, corenet_node_t, uring_hook);
+                list_del_init(pos);
+
+                sche_task_new("corenet_tcp_recv", __corenet_uring_exec_recv, node, -1);
+        }
+
+        if (corenet->uring_epoll) {
+                corenet->uring_epoll = 0;
+                __corenet_tcp_epoll(ctx, corenet, 0);
+        }
+
+        sche_run(core_tls_get(ctx, VARIABLE_SCHEDULE));
+
+        return 0;
+}
+
+#endif
+
+int corenet_tcp_poll(void *ctx, int tmo)
+{
+        corenet_tcp_t *__corenet__ = __corenet_get_byctx(ctx);
+
+        DBUG("polling %d begin\n", tmo);
+        LTG_ASSERT(tmo >= 0 && tmo < ltgconf_global.rpc_timeout * 2);
+
+#if !ENABLE_TCP_THREAD
+        /* corked sends are waiting for the commit */
+        if (unlikely(!list_empty(&__corenet__->corenet.forward_list)))
+                tmo = 0;
+
+        if (unlikely(!list_empty(&__corenet__->zc_orphan)))
+                __corenet_tcp_zc_orphan(__corenet__);
+#endif
+
+#if ENABLE_TCP_URING
+        if (__corenet__->uring) {
+                return __corenet_uring_poll(ctx, __corenet__, tmo);
+        }
+#endif
+
+        return __corenet_tcp_epoll(ctx, __corenet__, tmo);
+}
+
+#if ENABLE_TCP_THREAD
+
 typedef struct {
         struct list_head hook;
         sockid_t sockid;
@@ -1190,7 +1970,8 @@ static void __corenet_tcp_queue(corenet_tcp_t *__corenet__, const sockid_t *sock
                 DBUG("new forward to %s @ %u\n",
                       _inet_ntoa(sockid->addr), sockid->sd);
 
-                corenet_fwd = slab_stream_alloc(sizeof(*corenet_fwd));
+                corenet_fwd = obj_pool_alloc(OBJ_POOL_CORENET_FWD,
+                                             sizeof(*corenet_fwd));
                 LTG_ASSERT(corenet_fwd);
                 corenet_fwd->sockid = *sockid;
                 ltgbuf_init(&corenet_fwd->buf, 0);
@@ -1201,6 +1982,24 @@ static void __corenet_tcp_queue(corenet_tcp_t *__corenet__, const sockid_t *sock
         }
 }
 
+#else
+
+/* send_buf is flushed by the next commit, one sendmsg per node */
+inline static void __corenet_tcp_queue(corenet_tcp_t *__corenet__, corenet_node_t *node,
+                                       ltgbuf_t *buf)
+{
+        ltgbuf_merge(&node->send_buf, buf);
+
+        if (list_empty(&node->send_list)) {
+                if (ltgconf_global.tcp_cork)
+                        _microsec_update_now(&node->send_time);
+
+                list_add_tail(&node->send_list, &__corenet__->corenet.forward_list);
+        }
+}
+
+#endif
+
 int corenet_tcp_send(void *ctx, const sockid_t *sockid, ltgbuf_t *buf)
 {
         int ret;
@@ -1219,7 +2018,11 @@ int corenet_tcp_send(void *ctx, const sockid_t *sockid, ltgbuf_t *buf)
                 GOTO(err_ret, ret);
         }
 
+#if ENABLE_TCP_THREAD
         __corenet_tcp_queue(__corenet__, sockid, buf);
+#else
+        __corenet_tcp_queue(__corenet__, node, buf);
+#endif
 
         ANALYSIS_QUEUE(0, 10 * 1000, NULL);
 
@@ -1295,7 +2098,7 @@ static void __corenet_tcp_commit_task(void *ctx)
 
                 __corenet_tcp_commit(&corenet_fwd->sockid, &corenet_fwd->buf);
 
-                slab_stream_free(corenet_fwd);
+                obj_pool_free(corenet_fwd);
         }
 }
 
@@ -1312,83 +2115,72 @@ void corenet_tcp_commit(void *ctx)
 
 #else
 
-inline static void __corenet_tcp_exec_send_nowait(void *_node)
-{
-        int ret;
-        corenet_node_t *node = _node;
-        sockid_t sockid = node->sockid;
-
-        ret =  __corenet_tcp_send(node);
-        if (unlikely(ret)) {
-                DWARN("send to %d fail\n", sockid.sd);
-        }
+/* small sends wait up to tcp_cork usec for more data to share the syscall */
+#define CORENET_TCP_CORK_MAX (64 * 1024)
 
-        if (!list_empty(&node->send_buf.list)) {
-                __corenet_set_out(node);
-        }
+static int __corenet_tcp_corked(corenet_node_t *node)
+{
+        if (likely(ltgconf_global.tcp_cork == 0)
+            || node->send_buf.len >= CORENET_TCP_CORK_MAX)
+                return 0;
 
-        return;
+        return _microsec_time_used_from_now(&node->send_time)
+                < ltgconf_global.tcp_cork;
 }
 
-static int __corenet_tcp_commit(void *ctx, const sockid_t *sockid, ltgbuf_t *buf)
+static void __corenet_tcp_flush(corenet_node_t *node)
 {
         int ret;
-        corenet_node_t *node;
-        corenet_tcp_t *__corenet__ = __corenet_get_byctx(ctx);
-
-        LTG_ASSERT(sockid->type == SOCKID_CORENET);
-        //LTG_ASSERT(sockid->addr);
-
-        node = &__corenet__->array[sockid->sd];
-        if (node->sockid.seq != sockid->seq || node->sockid.sd == -1) {
-                ret = ECONNRESET;
-                ltgbuf_free(buf);
-                GOTO(err_ret, ret);
-        }
 
-        ltgbuf_merge(&node->send_buf, buf);
+        /* the socket is full, EPOLLOUT sends the rest */
+        if (node->ev & EPOLLOUT)
+                return;
 
-#if 1
-        sche_task_new("corenet_tcp_send", __corenet_tcp_exec_send_nowait, node, -1);
-        sche_run(core_tls_get(ctx, VARIABLE_SCHEDULE));
-#else
-#if 0
-        ret =  __corenet_tcp_send(node);
+        ret = __corenet_tcp_send(node);
         if (unlikely(ret)) {
-                DWARN("send to %d fail\n", sockid->sd);
+                DWARN("send to %d fail\n", node->sockid.sd);
         }
-#endif
 
         if (!list_empty(&node->send_buf.list)) {
                 __corenet_set_out(node);
         }
-#endif
-
-        return 0;
-err_ret:
-        return ret;
 }
 
 void corenet_tcp_commit(void *ctx)
 {
         struct list_head *pos, *n;
-        corenet_fwd_t *corenet_fwd;
+        corenet_node_t *node;
         corenet_tcp_t *__corenet__ = __corenet_get_byctx(ctx);
 
         list_for_each_safe(pos, n, &__corenet__->corenet.forward_list) {
-                corenet_fwd = (void *)pos;
-                list_del(pos);
+                node = container_of(pos, corenet_node_t, send_list);
+                if (__corenet_tcp_corked(node))
+                        continue;
+
+                list_del_init(&node->send_list);
 
                 DBUG("forward to %s @ %u, buf %u\n",
-                      _inet_ntoa(corenet_fwd->sockid.addr), corenet_fwd->sockid.sd,
-                      corenet_fwd->buf.len);
+                      _inet_ntoa(node->sockid.addr), node->sockid.sd,
+                      node->send_buf.len);
 
-                __corenet_tcp_commit(ctx, &corenet_fwd->sockid, &corenet_fwd->buf);
+#if ENABLE_TCP_URING
+                if (node->uring) {
+                        __corenet_uring_send(__corenet__, node);
+                        continue;
+                }
+#endif
 
-                slab_stream_free(corenet_fwd);
+                __corenet_tcp_flush(node);
         }
 
-        sche_run(core_tls_get(ctx, VARIABLE_SCHEDULE));
+#if ENABLE_TCP_URING
+        /* every send of this iteration goes out with a single io_uring_enter */
+        if (__corenet__->uring) {
+                int ret = corenet_uring_submit(__corenet__->uring, 0, 0);
+                if (unlikely(ret))
+                        UNIMPLEMENTED(__DUMP__);
+        }
+#endif
 }
 
 #endif
@@ -1426,7 +2218,7 @@ int corenet_tcp_init(int count, corenet_tcp_t **_corenet)
 
         DINFO("count %d size %d\n", count, len);
 
-        ret = ltg_malloc((void **)&corenet, len);
+        ret = ltg_malloc_tag((void **)&corenet, len, MEM_TAG_CORENET);
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
@@ -1444,6 +2236,10 @@ int corenet_tcp_init(int count, corenet_tcp_t **_corenet)
 
                 ltgbuf_init(&node->recv_buf, 0);
                 ltgbuf_init(&node->send_buf, 0);
+#if !ENABLE_TCP_THREAD
+                INIT_LIST_HEAD(&node->zc_list);
+                INIT_LIST_HEAD(&node->send_list);
+#endif
                 node->sockid.sd = -1;
         }
 
@@ -1455,13 +2251,45 @@ int corenet_tcp_init(int count, corenet_tcp_t **_corenet)
 
         INIT_LIST_HEAD(&corenet->corenet.forward_list);
         INIT_LIST_HEAD(&corenet->corenet.check_list);
+#if !ENABLE_TCP_THREAD
+        INIT_LIST_HEAD(&corenet->zc_orphan);
+#endif
+
+#if ENABLE_TCP_URING
+        INIT_LIST_HEAD(&corenet->uring_ready);
+        if (ltgconf_global.tcp_uring) {
+                ret = corenet_uring_create((corenet_uring_t **)&corenet->uring);
+                if (unlikely(ret)) {
+                        DWARN("io_uring unavailable %s, use epoll\n", strerror(ret));
+                        corenet->uring = NULL;
+                } else {
+                        /* the fds left on epoll wake the ring through it */
+                        ret = corenet_uring_poll(corenet->uring, corenet->corenet.epoll_fd,
+                                                 URING_DATA(0, 0, URING_OP_EPOLL));
+                        if (unlikely(ret))
+                                GOTO(err_free, ret);
+                }
+        }
+#else
+        if (ltgconf_global.tcp_uring) {
+                DWARN("built without io_uring, use epoll\n");
+        }
+#endif
 
         ret = ltg_spin_init(&corenet->corenet.lock);
         if (unlikely(ret))
                 GOTO(err_free, ret);
 
+#if ENABLE_TCP_THREAD
+        ret = obj_pool_private_init(core_self()->hash, OBJ_POOL_CORENET_FWD,
+                                    "corenet_fwd", sizeof(corenet_fwd_t),
+                                    ltgconf_global.obj_pool_count);
+        if (unlikely(ret))
+                GOTO(err_free, ret);
+#endif
 
         core_tls_set(VARIABLE_CORENET_TCP, corenet);
+        __corenet_tcp_core__[core_self()->hash] = corenet;
         if (_corenet)
                 *_corenet = corenet;
 
@@ -1475,7 +2303,7 @@ int corenet_tcp_init(int count, corenet_tcp_t **_corenet)
 
 	return 0;
 err_free:
-        ltg_free((void **)&corenet);
+        ltg_free_tag((void **)&corenet, MEM_TAG_CORENET);
 err_ret:
         return ret;
 }
@@ -0,0 +1,439 @@
+#include <limits.h>
+#include <time.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+
+#define DBG_SUBSYS S_LTG_NET
+
+#include "ltg_utils.h"
+#include "ltg_core.h"
+#include "core/corenet_uring.h"
+
+#if ENABLE_TCP_URING
+
+#define URING_BGID 0
+
+static int __uring_setup(uint32_t entries, struct io_uring_params *p)
+{
+        return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int __uring_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+                         uint32_t flags, void *arg, size_t argsz)
+{
+        return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                       flags, arg, argsz);
+}
+
+static int __uring_register(int fd, uint32_t op, void *arg, uint32_t nr)
+{
+        return syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+static int __corenet_uring_map(corenet_uring_t *uring, const struct io_uring_params *p)
+{
+        int ret;
+
+        uring->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(uint32_t);
+        uring->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+        uring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+
+        if (p->features & IORING_FEAT_SINGLE_MMAP) {
+                uring->sq_ring_size = _max(uring->sq_ring_size, uring->cq_ring_size);
+                uring->cq_ring_size = uring->sq_ring_size;
+        }
+
+        uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, uring->fd,
+                              IORING_OFF_SQ_RING);
+        if (uring->sq_ring == MAP_FAILED) {
+                ret = errno;
+                GOTO(err_ret, ret);
+        }
+
+        if (p->features & IORING_FEAT_SINGLE_MMAP) {
+                uring->cq_ring = uring->sq_ring;
+        } else {
+                uring->cq_ring = mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, uring->fd,
+                                      IORING_OFF_CQ_RING);
+                if (uring->cq_ring == MAP_FAILED) {
+                        ret = errno;
+                        GOTO(err_sq, ret);
+                }
+        }
+
+        uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+        if (uring->sqes == MAP_FAILED) {
+                ret = errno;
+                GOTO(err_cq, ret);
+        }
+
+        uring->sq_entries = p->sq_entries;
+        uring->sq_mask = *(uint32_t *)(uring->sq_ring + p->sq_off.ring_mask);
+        uring->sq_khead = uring->sq_ring + p->sq_off.head;
+        uring->sq_ktail = uring->sq_ring + p->sq_off.tail;
+        uring->sq_kflags = uring->sq_ring + p->sq_off.flags;
+        uring->sq_tail = *uring->sq_ktail;
+
+        /* sqe i always sits in slot i */
+        uint32_t *array = uring->sq_ring + p->sq_off.array;
+        for (uint32_t i = 0; i < p->sq_entries; i++) {
+                array[i] = i;
+        }
+
+        uring->cq_mask = *(uint32_t *)(uring->cq_ring + p->cq_off.ring_mask);
+        uring->cq_khead = uring->cq_ring + p->cq_off.head;
+        uring->cq_ktail = uring->cq_ring + p->cq_off.tail;
+        uring->cqes = uring->cq_ring + p->cq_off.cqes;
+
+        return 0;
+err_cq:
+        if (uring->cq_ring != uring->sq_ring)
+                munmap(uring->cq_ring, uring->cq_ring_size);
+err_sq:
+        munmap(uring->sq_ring, uring->sq_ring_size);
+err_ret:
+        return ret;
+}
+
+static void __corenet_uring_buf_put(corenet_uring_t *uring, uint16_t bid)
+{
+        struct io_uring_buf *buf;
+
+        buf = &uring->buf_ring->bufs[uring->buf_tail & (CORENET_URING_BUF_COUNT - 1)];
+        buf->addr = (uint64_t)(uring->buf + (size_t)bid * CORENET_URING_BUF_SIZE);
+        buf->len = CORENET_URING_BUF_SIZE;
+        buf->bid = bid;
+
+        uring->buf_tail++;
+}
+
+static void __corenet_uring_buf_commit(corenet_uring_t *uring)
+{
+        __atomic_store_n(&uring->buf_ring->tail, uring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static int __corenet_uring_buf_init(corenet_uring_t *uring)
+{
+        int ret;
+        struct io_uring_buf_reg reg;
+
+        ret = ltg_malign((void **)&uring->buf_ring, PAGE_SIZE,
+                         sizeof(struct io_uring_buf) * CORENET_URING_BUF_COUNT);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        ret = ltg_malign(&uring->buf, PAGE_SIZE,
+                         (size_t)CORENET_URING_BUF_SIZE * CORENET_URING_BUF_COUNT);
+        if (unlikely(ret))
+                GOTO(err_ring, ret);
+
+        memset(uring->buf_ring, 0x0,
+               sizeof(struct io_uring_buf) * CORENET_URING_BUF_COUNT);
+
+        memset(&reg, 0x0, sizeof(reg));
+        reg.ring_addr = (uint64_t)uring->buf_ring;
+        reg.ring_entries = CORENET_URING_BUF_COUNT;
+        reg.bgid = URING_BGID;
+
+        ret = __uring_register(uring->fd, IORING_REGISTER_PBUF_RING, &reg, 1);
+        if (ret < 0) {
+                ret = errno;
+                GOTO(err_buf, ret);
+        }
+
+        uring->bgid = URING_BGID;
+        uring->buf_tail = 0;
+        for (int i = 0; i < CORENET_URING_BUF_COUNT; i++) {
+                __corenet_uring_buf_put(uring, i);
+        }
+
+        __corenet_uring_buf_commit(uring);
+
+        return 0;
+err_buf:
+        ltg_free(&uring->buf);
+err_ring:
+        ltg_free((void **)&uring->buf_ring);
+err_ret:
+        return ret;
+}
+
+int corenet_uring_create(corenet_uring_t **_uring)
+{
+        int ret;
+        corenet_uring_t *uring;
+        struct io_uring_params p;
+
+        ret = ltg_malloc_tag((void **)&uring, sizeof(*uring), MEM_TAG_CORENET);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        memset(uring, 0x0, sizeof(*uring));
+
+        /*
+         * task work is run when the core enters the kernel, the kernel only
+         * flags it in the sq ring instead of interrupting a polling core.
+         */
+        memset(&p, 0x0, sizeof(p));
+        p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN
+                | IORING_SETUP_TASKRUN_FLAG | IORING_SETUP_CQSIZE;
+        p.cq_entries = CORENET_URING_ENTRIES * 4;
+
+        uring->fd = __uring_setup(CORENET_URING_ENTRIES, &p);
+        if (uring->fd < 0 && errno == EINVAL) {
+                memset(&p, 0x0, sizeof(p));
+                p.flags = IORING_SETUP_CQSIZE;
+                p.cq_entries = CORENET_URING_ENTRIES * 4;
+                uring->fd = __uring_setup(CORENET_URING_ENTRIES, &p);
+        }
+
+        if (uring->fd < 0) {
+                ret = errno;
+                GOTO(err_free, ret);
+        }
+
+        if (!(p.features & IORING_FEAT_EXT_ARG)) {
+                ret = ENOTSUP;
+                GOTO(err_close, ret);
+        }
+
+        ret = __corenet_uring_map(uring, &p);
+        if (unlikely(ret))
+                GOTO(err_close, ret);
+
+        ret = __corenet_uring_buf_init(uring);
+        if (unlikely(ret))
+                GOTO(err_unmap, ret);
+
+        CORENET_URING_DUMP_L(DINFO, uring, "sq %u cq %u buf %u*%u\n",
+                             p.sq_entries, p.cq_entries,
+                             CORENET_URING_BUF_COUNT, CORENET_URING_BUF_SIZE);
+
+        *_uring = uring;
+
+        return 0;
+err_unmap:
+        munmap(uring->sqes, uring->sqes_size);
+        if (uring->cq_ring != uring->sq_ring)
+                munmap(uring->cq_ring, uring->cq_ring_size);
+        munmap(uring->sq_ring, uring->sq_ring_size);
+err_close:
+        close(uring->fd);
+err_free:
+        ltg_free_tag((void **)&uring, MEM_TAG_CORENET);
+err_ret:
+        return ret;
+}
+
+void corenet_uring_destroy(corenet_uring_t *uring)
+{
+        munmap(uring->sqes, uring->sqes_size);
+        if (uring->cq_ring != uring->sq_ring)
+                munmap(uring->cq_ring, uring->cq_ring_size);
+        munmap(uring->sq_ring, uring->sq_ring_size);
+        close(uring->fd);
+
+        ltg_free(&uring->buf);
+        ltg_free((void **)&uring->buf_ring);
+        ltg_free_tag((void **)&uring, MEM_TAG_CORENET);
+}
+
+int S_LTG corenet_uring_submit(corenet_uring_t *uring, int wait, int tmo)
+{
+        int ret;
+        uint32_t flags = 0;
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+
+        if (uring->to_submit == 0 && !wait
+            && !(__atomic_load_n(uring->sq_kflags, __ATOMIC_RELAXED)
+                 & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW))) {
+                return 0;
+        }
+
+        __atomic_store_n(uring->sq_ktail, uring->sq_tail, __ATOMIC_RELEASE);
+
+        if (wait || uring->to_submit == 0) {
+                flags |= IORING_ENTER_GETEVENTS;
+        }
+
+        memset(&arg, 0x0, sizeof(arg));
+        if (wait && tmo) {
+                ts.tv_sec = tmo;
+                ts.tv_nsec = 0;
+                arg.ts = (uint64_t)&ts;
+        }
+
+        flags |= IORING_ENTER_EXT_ARG;
+        uring->nr_enter++;
+
+        ret = __uring_enter(uring->fd, uring->to_submit, wait ? 1 : 0, flags,
+                            &arg, sizeof(arg));
+        if (ret < 0) {
+                ret = errno;
+                if (ret == ETIME || ret == EINTR || ret == EBUSY || ret == EAGAIN)
+                        return 0;
+
+                GOTO(err_ret, ret);
+        }
+
+        uring->to_submit -= ret;
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static struct io_uring_sqe S_LTG *__corenet_uring_sqe(corenet_uring_t *uring)
+{
+        int ret;
+        uint32_t head;
+        struct io_uring_sqe *sqe;
+
+        head = __atomic_load_n(uring->sq_khead, __ATOMIC_ACQUIRE);
+        if (unlikely(uring->sq_tail - head >= uring->sq_entries)) {
+                ret = corenet_uring_submit(uring, 0, 0);
+                if (unlikely(ret))
+                        return NULL;
+
+                head = __atomic_load_n(uring->sq_khead, __ATOMIC_ACQUIRE);
+                if (uring->sq_tail - head >= uring->sq_entries)
+                        return NULL;
+        }
+
+        sqe = &uring->sqes[uring->sq_tail & uring->sq_mask];
+        memset(sqe, 0x0, sizeof(*sqe));
+
+        uring->sq_tail++;
+        uring->to_submit++;
+        uring->nr_sqe++;
+
+        return sqe;
+}
+
+int corenet_uring_recv(corenet_uring_t *uring, int fd, uint64_t user_data)
+{
+        struct io_uring_sqe *sqe;
+
+        sqe = __corenet_uring_sqe(uring);
+        if (unlikely(sqe == NULL))
+                return EBUSY;
+
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = uring->bgid;
+        sqe->user_data = user_data;
+
+        return 0;
+}
+
+int corenet_uring_sendmsg(corenet_uring_t *uring, int fd, const struct msghdr *msg,
+                          uint64_t user_data)
+{
+        struct io_uring_sqe *sqe;
+
+        sqe = __corenet_uring_sqe(uring);
+        if (unlikely(sqe == NULL))
+                return EBUSY;
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)msg;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = user_data;
+
+        return 0;
+}
+
+int corenet_uring_poll(corenet_uring_t *uring, int fd, uint64_t user_data)
+{
+        struct io_uring_sqe *sqe;
+
+        sqe = __corenet_uring_sqe(uring);
+        if (unlikely(sqe == NULL))
+                return EBUSY;
+
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = POLLIN;
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->user_data = user_data;
+
+        return 0;
+}
+
+/* cancel everything still queued on fd */
+int corenet_uring_cancel(corenet_uring_t *uring, int fd, uint64_t user_data)
+{
+        struct io_uring_sqe *sqe;
+
+        sqe = __corenet_uring_sqe(uring);
+        if (unlikely(sqe == NULL))
+                return EBUSY;
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = user_data;
+
+        return 0;
+}
+
+/*
+ * the buffer handed to func is recycled when it returns. a multishot recv
+ * that ran out of buffers ends with -ENOBUFS and must be armed again.
+ */
+int S_LTG corenet_uring_reap(corenet_uring_t *uring, corenet_uring_func func, void *ctx)
+{
+        int count = 0, recycle = 0;
+        uint32_t head, tail;
+        uint16_t bid;
+        struct io_uring_cqe *cqe;
+        void *buf;
+
+        head = *uring->cq_khead;
+        tail = __atomic_load_n(uring->cq_ktail, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+                cqe = &uring->cqes[head & uring->cq_mask];
+
+                if (cqe->flags & IORING_CQE_F_BUFFER) {
+                        bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                        buf = uring->buf + (size_t)bid * CORENET_URING_BUF_SIZE;
+                } else {
+                        buf = NULL;
+                }
+
+                if (unlikely(cqe->res == -ENOBUFS))
+                        uring->nr_nobufs++;
+
+                func(ctx, cqe->user_data, cqe->res, cqe->flags, buf);
+
+                if (buf) {
+                        __corenet_uring_buf_put(uring, bid);
+                        recycle++;
+                }
+
+                head++;
+                count++;
+        }
+
+        if (recycle)
+                __corenet_uring_buf_commit(uring);
+
+        __atomic_store_n(uring->cq_khead, head, __ATOMIC_RELEASE);
+        uring->nr_cqe += count;
+
+        return count;
+}
+
+#endif
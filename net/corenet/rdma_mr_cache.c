@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <rdma/rdma_cma.h>
+
+#define DBG_SUBSYS S_LTG_NET
+
+#include "ltg_utils.h"
+#include "ltg_net.h"
+#include "ltg_core.h"
+
+/*
+ * registration cache for memory outside the hugepage mr, one per device
+ * of a core. entries are page aligned ranges that never overlap, kept in
+ * an array sorted by start for lookup and on a lru list for eviction. a
+ * registration that overlaps cached ones replaces them with their union.
+ * an entry in use by a request is only retired, it is deregistered by
+ * the last put. rdma_mr_invalidate may be called from any thread, each
+ * cache applies the ranges before its next lookup.
+ *
+ * only ranges the owner declared with rdma_mr_allow are registered, the
+ * owner promises to invalidate them before they are unmapped or freed.
+ * anything else, ltgbuf_initwith memory from malloc included, is refused
+ * and the caller copies it, a freed and remapped address can not reach
+ * a stale registration that way.
+ */
+
+#define RDMA_MR_INVAL_MAX 64
+#define RDMA_MR_ALLOW_MAX 128
+
+typedef struct {
+        uintptr_t start;
+        uintptr_t end;
+} rdma_mr_range_t;
+
+struct rdma_mr_ent {
+        struct list_head hook;          /* on lru while cached */
+        uintptr_t start;
+        uintptr_t end;
+        struct ibv_mr *mr;
+        int ref;
+        int retired;
+};
+
+typedef struct {
+        struct ibv_pd *pd;
+        int count;
+        int max;
+        rdma_mr_ent_t **index;          /* sorted by start */
+        struct list_head lru;
+        uint64_t inval_seq;
+
+        uint64_t nr_hit;
+        uint64_t nr_miss;
+        uint64_t nr_evict;
+        uint64_t nr_refuse;
+} rdma_mr_cache_t;
+
+static pthread_mutex_t __inval_lock__ = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t __inval_seq__ = 0;
+static rdma_mr_range_t __inval__[RDMA_MR_INVAL_MAX];
+
+/* allowed ranges, each thread looks them up in its own copy */
+static uint64_t __allow_seq__ = 0;
+static int __allow_count__ = 0;
+static rdma_mr_range_t __allow__[RDMA_MR_ALLOW_MAX];
+
+static __thread uint64_t __allow_seq_private__ = 0;
+static __thread int __allow_count_private__ = 0;
+static __thread rdma_mr_range_t __allow_private__[RDMA_MR_ALLOW_MAX];
+
+int rdma_mr_cache_init(rdma_info_t *dev)
+{
+        int ret;
+        rdma_mr_cache_t *cache;
+
+        ret = ltg_malloc((void **)&cache, sizeof(*cache));
+        if (ret)
+                GOTO(err_ret, ret);
+
+        memset(cache, 0x0, sizeof(*cache));
+        cache->pd = dev->pd;
+        cache->max = ltgconf_global.rdma_mr_cache;
+        INIT_LIST_HEAD(&cache->lru);
+        cache->inval_seq = __atomic_load_n(&__inval_seq__, __ATOMIC_ACQUIRE);
+
+        /* room for one registration over budget, see __rdma_mr_evict */
+        ret = ltg_malloc((void **)&cache->index,
+                         sizeof(*cache->index) * (cache->max + 1));
+        if (ret)
+                GOTO(err_free, ret);
+
+        dev->mr_cache = cache;
+
+        return 0;
+err_free:
+        ltg_free((void **)&cache);
+err_ret:
+        return ret;
+}
+
+int rdma_mr_registered(const void *addr, size_t len)
+{
+        void *private_mem = NULL;
+        uint64_t private_mem_size = 0;
+
+        get_global_private_mem(&private_mem, &private_mem_size);
+
+        return (uintptr_t)addr >= (uintptr_t)private_mem
+                && (uintptr_t)addr + len <= (uintptr_t)private_mem + private_mem_size;
+}
+
+static void __rdma_mr_allow_load()
+{
+        pthread_mutex_lock(&__inval_lock__);
+
+        memcpy(__allow_private__, __allow__, sizeof(*__allow__) * __allow_count__);
+        __allow_count_private__ = __allow_count__;
+        __allow_seq_private__ = __allow_seq__;
+
+        pthread_mutex_unlock(&__inval_lock__);
+}
+
+/* whether [addr, addr + len) lies in one range given to rdma_mr_allow */
+int S_LTG rdma_mr_allowed(const void *addr, size_t len)
+{
+        int i;
+        uintptr_t start = (uintptr_t)addr, end = start + len;
+
+        if (unlikely(__allow_seq_private__
+                     != __atomic_load_n(&__allow_seq__, __ATOMIC_ACQUIRE))) {
+                __rdma_mr_allow_load();
+        }
+
+        for (i = 0; i < __allow_count_private__; i++) {
+                if (start >= __allow_private__[i].start
+                    && end <= __allow_private__[i].end)
+                        return 1;
+        }
+
+        return 0;
+}
+
+/*
+ * the owner keeps the range mapped until it calls rdma_mr_invalidate on
+ * it, which also withdraws the permission.
+ */
+int rdma_mr_allow(const void *addr, size_t len)
+{
+        int ret;
+
+        pthread_mutex_lock(&__inval_lock__);
+
+        if (__allow_count__ == RDMA_MR_ALLOW_MAX) {
+                ret = ENOSPC;
+                GOTO(err_lock, ret);
+        }
+
+        __allow__[__allow_count__].start = _align_down((uintptr_t)addr, PAGE_SIZE);
+        __allow__[__allow_count__].end = _align_up((uintptr_t)addr + len, PAGE_SIZE);
+        __allow_count__++;
+        __atomic_store_n(&__allow_seq__, __allow_seq__ + 1, __ATOMIC_RELEASE);
+
+        pthread_mutex_unlock(&__inval_lock__);
+
+        return 0;
+err_lock:
+        pthread_mutex_unlock(&__inval_lock__);
+        return ret;
+}
+
+static void __rdma_mr_free(rdma_mr_ent_t *ent)
+{
+        int ret;
+
+        ret = ibv_dereg_mr(ent->mr);
+        if (unlikely(ret)) {
+                DWARN("dereg %p ret %d\n", (void *)ent->start, ret);
+        }
+
+        ltg_free((void **)&ent);
+}
+
+/* last entry with start <= addr, -1 if none */
+static int __rdma_mr_search(rdma_mr_cache_t *cache, uintptr_t addr)
+{
+        int l = 0, r = cache->count - 1, m, found = -1;
+
+        while (l <= r) {
+                m = (l + r) / 2;
+                if (cache->index[m]->start <= addr) {
+                        found = m;
+                        l = m + 1;
+                } else {
+                        r = m - 1;
+                }
+        }
+
+        return found;
+}
+
+static void __rdma_mr_remove(rdma_mr_cache_t *cache, int idx)
+{
+        rdma_mr_ent_t *ent = cache->index[idx];
+
+        memmove(&cache->index[idx], &cache->index[idx + 1],
+                sizeof(*cache->index) * (cache->count - idx - 1));
+        cache->count--;
+        list_del_init(&ent->hook);
+
+        if (ent->ref) {
+                ent->retired = 1;
+        } else {
+                __rdma_mr_free(ent);
+        }
+}
+
+static void __rdma_mr_drop(rdma_mr_cache_t *cache, uintptr_t start, uintptr_t end)
+{
+        int idx;
+
+        idx = __rdma_mr_search(cache, start);
+        if (idx < 0 || cache->index[idx]->end <= start)
+                idx++;
+
+        while (idx < cache->count && cache->index[idx]->start < end) {
+                __rdma_mr_remove(cache, idx);
+        }
+}
+
+static void __rdma_mr_inval(rdma_mr_cache_t *cache)
+{
+        uint64_t seq, i;
+
+        pthread_mutex_lock(&__inval_lock__);
+
+        seq = __inval_seq__;
+        if (seq - cache->inval_seq > RDMA_MR_INVAL_MAX) {
+                DINFO("mr cache flush %d\n", cache->count);
+                while (cache->count) {
+                        __rdma_mr_remove(cache, cache->count - 1);
+                }
+        } else {
+                for (i = cache->inval_seq; i < seq; i++) {
+                        __rdma_mr_drop(cache, __inval__[i % RDMA_MR_INVAL_MAX].start,
+                                       __inval__[i % RDMA_MR_INVAL_MAX].end);
+                }
+        }
+
+        cache->inval_seq = seq;
+
+        pthread_mutex_unlock(&__inval_lock__);
+}
+
+static void __rdma_mr_evict(rdma_mr_cache_t *cache)
+{
+        struct list_head *pos, *n;
+        rdma_mr_ent_t *ent;
+
+        list_for_each_safe(pos, n, &cache->lru) {
+                if (cache->count < cache->max)
+                        break;
+
+                ent = list_entry(pos, rdma_mr_ent_t, hook);
+                if (ent->ref)
+                        continue;
+
+                __rdma_mr_remove(cache, __rdma_mr_search(cache, ent->start));
+                cache->nr_evict++;
+        }
+}
+
+static rdma_mr_ent_t *__rdma_mr_new(rdma_mr_cache_t *cache, uintptr_t start,
+                                    uintptr_t end)
+{
+        int ret, idx;
+        rdma_mr_ent_t *ent;
+
+        /* a union with the ranges it overlaps keeps the index disjoint */
+        idx = __rdma_mr_search(cache, start);
+        if (idx >= 0 && cache->index[idx]->end > start)
+                start = cache->index[idx]->start;
+
+        idx = __rdma_mr_search(cache, end - 1);
+        if (idx >= 0 && cache->index[idx]->end > end)
+                end = cache->index[idx]->end;
+
+        __rdma_mr_drop(cache, start, end);
+        __rdma_mr_evict(cache);
+
+        ret = ltg_malloc((void **)&ent, sizeof(*ent));
+        if (ret)
+                GOTO(err_ret, ret);
+
+        ent->start = start;
+        ent->end = end;
+        ent->ref = 0;
+        ent->retired = 0;
+        ent->mr = rdma_register_mr(cache->pd, (void *)start, end - start);
+        if (ent->mr == NULL) {
+                ret = errno;
+                GOTO(err_free, ret);
+        }
+
+        idx = __rdma_mr_search(cache, start) + 1;
+        memmove(&cache->index[idx + 1], &cache->index[idx],
+                sizeof(*cache->index) * (cache->count - idx));
+        cache->index[idx] = ent;
+        cache->count++;
+        list_add_tail(&ent->hook, &cache->lru);
+
+        if (unlikely(cache->count > cache->max)) {
+                DWARN("mr cache over budget %d/%d\n", cache->count, cache->max);
+        }
+
+        return ent;
+err_free:
+        ltg_free((void **)&ent);
+err_ret:
+        return NULL;
+}
+
+/*
+ * the entry covering [addr, addr + len), registered on a miss. the caller
+ * holds it until the rdma op using the range is done, see rdma_mr_put.
+ */
+rdma_mr_ent_t S_LTG *rdma_mr_get(rdma_info_t *dev, const void *addr, size_t len,
+                                 struct ibv_mr **mr)
+{
+        int idx;
+        rdma_mr_cache_t *cache = dev->mr_cache;
+        rdma_mr_ent_t *ent;
+        uintptr_t start = (uintptr_t)addr, end = start + len;
+
+        if (unlikely(cache == NULL || len == 0))
+                return NULL;
+
+        if (unlikely(cache->inval_seq
+                     != __atomic_load_n(&__inval_seq__, __ATOMIC_ACQUIRE))) {
+                __rdma_mr_inval(cache);
+        }
+
+        idx = __rdma_mr_search(cache, start);
+        if (likely(idx >= 0 && cache->index[idx]->end >= end)) {
+                ent = cache->index[idx];
+                list_move_tail(&ent->hook, &cache->lru);
+                cache->nr_hit++;
+        } else {
+                if (unlikely(!rdma_mr_allowed(addr, len))) {
+                        cache->nr_refuse++;
+                        return NULL;
+                }
+
+                ent = __rdma_mr_new(cache, _align_down(start, PAGE_SIZE),
+                                    _align_up(end, PAGE_SIZE));
+                if (unlikely(ent == NULL))
+                        return NULL;
+
+                cache->nr_miss++;
+                DBUG("mr cache miss %p len %ju, %d cached hit %ju miss %ju"
+                     " evict %ju refuse %ju\n", addr, len, cache->count,
+                     cache->nr_hit, cache->nr_miss, cache->nr_evict,
+                     cache->nr_refuse);
+        }
+
+        ent->ref++;
+        *mr = ent->mr;
+
+        return ent;
+}
+
+void S_LTG rdma_mr_put(rdma_mr_ent_t *ent)
+{
+        LTG_ASSERT(ent->ref > 0);
+
+        ent->ref--;
+        if (unlikely(ent->ref == 0 && ent->retired)) {
+                __rdma_mr_free(ent);
+        }
+}
+
+/*
+ * the range is about to be unmapped or reused, cached registrations over
+ * it are dropped and allowed ranges it overlaps are withdrawn. rdma ops
+ * on the range must be done by now.
+ */
+void rdma_mr_invalidate(const void *addr, size_t len)
+{
+        int i, count;
+        uint64_t seq;
+        uintptr_t start = _align_down((uintptr_t)addr, PAGE_SIZE);
+        uintptr_t end = _align_up((uintptr_t)addr + len, PAGE_SIZE);
+
+        pthread_mutex_lock(&__inval_lock__);
+
+        seq = __inval_seq__;
+        __inval__[seq % RDMA_MR_INVAL_MAX].start = start;
+        __inval__[seq % RDMA_MR_INVAL_MAX].end = end;
+        __atomic_store_n(&__inval_seq__, seq + 1, __ATOMIC_RELEASE);
+
+        count = 0;
+        for (i = 0; i < __allow_count__; i++) {
+                if (__allow__[i].start < end && __allow__[i].end > start)
+                        continue;
+
+                __allow__[count++] = __allow__[i];
+        }
+
+        if (count != __allow_count__) {
+                __allow_count__ = count;
+                __atomic_store_n(&__allow_seq__, __allow_seq__ + 1,
+                                 __ATOMIC_RELEASE);
+        }
+
+        pthread_mutex_unlock(&__inval_lock__);
+}
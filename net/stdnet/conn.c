@@ -16,14 +16,17 @@
 
 static int __conn_add(const nid_t *nid)
 {
-        int ret;
+        int ret, connected = 0;
         char key[MAX_NAME_LEN], buf[MAX_BUF_LEN], tmp[MAX_BUF_LEN];
         ltg_net_info_t *info;
         net_handle_t nh;
         size_t len;
 
         if (netable_connected(nid)) {
-                goto out;
+                if (!ltgconf_global.maping_warmup)
+                        goto out;
+
+                connected = 1;
         }
 
         snprintf(key, MAX_NAME_LEN, "%u.info", nid->id);
@@ -40,12 +43,16 @@ static int __conn_add(const nid_t *nid)
 
         DBUG("connect to %u %s\n", nid->id, info->name);
 
-        ret = netable_connect(&nh, info);
-        if (ret) {
-                DBUG("connect to %u %s fail\n", nid->id, info->name);
-                GOTO(err_ret, ret);
+        if (!connected) {
+                ret = netable_connect(&nh, info);
+                if (ret) {
+                        DBUG("connect to %u %s fail\n", nid->id, info->name);
+                        GOTO(err_ret, ret);
+                }
         }
 
+        corenet_maping_check(info);
+
 out:
 
         return 0;
@@ -55,19 +62,26 @@ err_ret:
 
 int conn_scan()
 {
-        int ret, i;
+        int ret, i, count = 0;
         etcd_node_t *list = NULL, *node;
-        nid_t nid;
+        nid_t nid, *nids;
 
         ret = etcd_list(ETCD_MANAGE, &list);
         if (unlikely(ret)) {
                 if (ret == ENOKEY) {
                         DINFO("conn table empty\n");
+                        corenet_maping_prune(NULL, 0);
                         goto out;
                 } else
                         GOTO(err_ret, ret);
         }
 
+        ret = ltg_malloc((void **)&nids, sizeof(*nids) * list->num_node);
+        if (unlikely(ret)) {
+                free_etcd_node(list);
+                GOTO(err_ret, ret);
+        }
+
         for(i = 0; i < list->num_node; i++) {
                 node = list->nodes[i];
  
@@ -77,9 +91,13 @@ int conn_scan()
                 }
 
                 str2nid(&nid, node->key);
+                nids[count++] = nid;
                 ret = __conn_add(&nid);
         }
 
+        corenet_maping_prune(nids, count);
+
+        ltg_free((void **)&nids);
         free_etcd_node(list);
 
 out:
@@ -343,6 +343,8 @@ void netable_close(const nid_t *nid, const char *why, const time_t *ltime)
 
         netable_unlock(nid);
 
+        corenet_maping_uncheck(nid);
+
         sdevent_close(&sock);
 
         return;
@@ -0,0 +1,192 @@
+#include <string.h>
+#include <errno.h>
+
+#define DBG_SUBSYS S_LTG_RPC
+
+#include "ltg_utils.h"
+#include "ltg_net.h"
+#include "ltg_rpc.h"
+#include "ltg_core.h"
+
+/*
+ * credit flow control per corenet connection. a request takes its bytes
+ * and one message from the window of the connection and gives them back
+ * when its slot is posted: reply, timeout or reset. a caller that does
+ * not fit sleeps on the connection until enough comes back. the window
+ * starts from the local rpc_credit_* conf and is replaced by whatever the
+ * peer advertises in its replies.
+ */
+
+typedef struct {
+        struct list_head hook;
+        task_t task;
+        uint32_t bytes;
+} credit_wait_t;
+
+static inline int __corerpc_credit_fit(const corenet_credit_t *credit,
+                                       uint32_t bytes)
+{
+        if (credit->max_msgs && credit->msgs >= credit->max_msgs)
+                return 0;
+
+        /* a request larger than the window still goes out alone */
+        if (credit->max_bytes && credit->bytes
+            && credit->bytes + bytes > credit->max_bytes)
+                return 0;
+
+        return 1;
+}
+
+static void __corerpc_credit_wakeup(corenet_credit_t *credit)
+{
+        credit_wait_t *wait;
+
+        while (!list_empty(&credit->wait_list)) {
+                wait = list_entry(credit->wait_list.next, credit_wait_t, hook);
+                if (!__corerpc_credit_fit(credit, wait->bytes))
+                        break;
+
+                credit->bytes += wait->bytes;
+                credit->msgs++;
+                credit->nr_wait--;
+                list_del_init(&wait->hook);
+                sche_task_post(&wait->task, 0, NULL);
+        }
+}
+
+void corerpc_credit_init(corenet_credit_t *credit)
+{
+        credit->max_bytes = ltgconf_global.rpc_credit_bytes;
+        credit->max_msgs = ltgconf_global.rpc_credit_msgs;
+        credit->bytes = 0;
+        credit->msgs = 0;
+        credit->nr_wait = 0;
+        credit->nr_block = 0;
+        INIT_LIST_HEAD(&credit->wait_list);
+}
+
+/* the connection is gone, nobody will give credit back */
+void corerpc_credit_reset(corenet_credit_t *credit)
+{
+        credit_wait_t *wait;
+
+        while (!list_empty(&credit->wait_list)) {
+                wait = list_entry(credit->wait_list.next, credit_wait_t, hook);
+                list_del_init(&wait->hook);
+                sche_task_post(&wait->task, ECONNRESET, NULL);
+        }
+
+        credit->bytes = 0;
+        credit->msgs = 0;
+        credit->nr_wait = 0;
+}
+
+/*
+ * callers outside a task, the ring queue ones, can not sleep. they are
+ * counted but never held back.
+ */
+int S_LTG corerpc_credit_get(const sockid_t *sockid, uint32_t bytes, int wait)
+{
+        int ret;
+        corenet_credit_t *credit;
+        credit_wait_t ctx;
+
+        credit = corenet_credit(sockid);
+        if (unlikely(credit == NULL))
+                return 0;
+
+        if (likely((__corerpc_credit_fit(credit, bytes)
+                    && list_empty(&credit->wait_list)) || !wait)) {
+                credit->bytes += bytes;
+                credit->msgs++;
+                return 0;
+        }
+
+        DBUG("wait credit %u, used %u/%u msg %u/%u\n", bytes, credit->bytes,
+             credit->max_bytes, credit->msgs, credit->max_msgs);
+
+        ctx.bytes = bytes;
+        ctx.task = sche_task_get();
+        list_add_tail(&ctx.hook, &credit->wait_list);
+        credit->nr_wait++;
+        credit->nr_block++;
+
+        ret = sche_yield("credit_wait", NULL, NULL);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+void S_LTG corerpc_credit_put(const sockid_t *sockid, uint32_t bytes)
+{
+        corenet_credit_t *credit;
+
+        credit = corenet_credit(sockid);
+        if (unlikely(credit == NULL))
+                return;
+
+        LTG_ASSERT(credit->msgs && credit->bytes >= bytes);
+        credit->bytes -= bytes;
+        credit->msgs--;
+
+        __corerpc_credit_wakeup(credit);
+}
+
+/* window advertised by the peer in a reply */
+void S_LTG corerpc_credit_update(const sockid_t *sockid, const ltg_net_head_t *head)
+{
+        corenet_credit_t *credit;
+
+        if (likely(!(head->prog & LTG_REPLY_CREDIT)))
+                return;
+
+        credit = corenet_credit(sockid);
+        if (unlikely(credit == NULL))
+                return;
+
+        if (unlikely(credit->max_bytes != head->replen
+                     || credit->max_msgs != head->group)) {
+                DBUG("credit %u/%u -> %u/%u\n", credit->max_bytes,
+                     credit->max_msgs, head->replen, head->group);
+
+                credit->max_bytes = head->replen;
+                credit->max_msgs = head->group;
+                __corerpc_credit_wakeup(credit);
+        }
+}
+
+/* replies carry the window this node grants, see corerpc_credit_update */
+void S_LTG corerpc_credit_advertise(ltgbuf_t *buf)
+{
+        ltg_net_head_t *head;
+
+        if (likely(!ltgconf_global.rpc_credit_bytes
+                   && !ltgconf_global.rpc_credit_msgs))
+                return;
+
+        head = ltgbuf_head1(buf, sizeof(*head));
+        head->prog |= LTG_REPLY_CREDIT;
+        head->replen = ltgconf_global.rpc_credit_bytes;
+        head->group = ltgconf_global.rpc_credit_msgs;
+}
+
+int corerpc_credit_stat(const sockid_t *sockid, corerpc_credit_stat_t *stat)
+{
+        corenet_credit_t *credit;
+
+        credit = corenet_credit(sockid);
+        if (credit == NULL)
+                return ENOENT;
+
+        stat->bytes = credit->bytes;
+        stat->msgs = credit->msgs;
+        stat->max_bytes = credit->max_bytes;
+        stat->max_msgs = credit->max_msgs;
+        stat->wait = credit->nr_wait;
+        stat->block = credit->nr_block;
+
+        return 0;
+}
@@ -91,6 +91,15 @@ inline static void __corerpc_scan(void *_core, void *var, void *_corerpc)
         return;
 }
 
+/* timeouts are due within a wheel tick, not at the next scan */
+inline static void S_LTG __corerpc_expire(void *_core, void *var, void *_rpc_table)
+{
+        (void) _core;
+        (void) var;
+
+        rpc_table_expire(_rpc_table);
+}
+
 inline static void __corerpc_destroy(void *_core, void *var, void *_corerpc)
 {
         core_t *core = _core;
@@ -117,10 +126,22 @@ static int __corerpc_init(va_list ap)
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
+        ret = corerpc_proto_private_init(core->hash);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        ret = corerpc_request_private_init(core->hash);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
         ret = core_register_scan("corerpc_scan", __corerpc_scan, rpc_table);
         if (unlikely(ret))
                 GOTO(err_destroy, ret);
 
+        ret = core_register_routine("corerpc_expire", __corerpc_expire, rpc_table);
+        if (unlikely(ret))
+                GOTO(err_destroy, ret);
+
         DINFO("%s[%u] rpc inited\n", core->name, core->hash);
 
         return 0;
@@ -185,14 +185,14 @@ static void S_LTG __corerpc_request_queue_reply(void *_ctx)
         ltgbuf_free(&ctx->in);
         ltgbuf_free(&ctx->out);
 
-        slab_stream_free(ctx);
+        obj_pool_free(ctx);
         
         return ;
 err_ret:
         ltgbuf_free(&ctx->out);
         ltgbuf_free(&ctx->in);
         corerpc_reply_error(&ctx->sockid, &ctx->msgid, ret);
-        slab_stream_free(ctx);
+        obj_pool_free(ctx);
         return;
 }
 
@@ -201,7 +201,7 @@ static void S_LTG __corerpc_request_queue(rpc_request_t *rpc_request)
         int ret;
         const char *name;
         coreid_t coreid;
-        corerpc_ring_t *ctx = slab_stream_alloc(sizeof(*ctx));
+        corerpc_ring_t *ctx = obj_pool_alloc(OBJ_POOL_CORERPC_RING, sizeof(*ctx));
 
         request_trans(rpc_request, &coreid, &ctx->sockid, &ctx->msgid, &ctx->in,
                       &ctx->replen, NULL);
@@ -254,7 +254,7 @@ static void S_LTG __corerpc_request_queue(rpc_request_t *rpc_request)
 err_ret:
         ltgbuf_free(&ctx->in);
         corerpc_reply_error(&ctx->sockid, &ctx->msgid, ret);
-        slab_stream_free(ctx);
+        obj_pool_free(ctx);
         return;
 }
 
@@ -278,7 +278,7 @@ static int S_LTG __corerpc_request_handler(corerpc_ctx_t *ctx,
         LTG_ASSERT(head->prog < LTG_MSG_MAX_KEEP);
         prog = &__corerpc_prog__[head->prog];
 
-        rpc_request = slab_stream_alloc(sizeof(*rpc_request));
+        rpc_request = obj_pool_alloc(OBJ_POOL_RPC_REQUEST, sizeof(*rpc_request));
         if (!rpc_request) {
                 ret = ENOMEM;
                 GOTO(err_ret, ret);
@@ -321,13 +321,16 @@ err_ret:
 
 extern rpc_table_t *corerpc_self();
 
-static void S_LTG __corerpc_reply_handler(const ltg_net_head_t *head, ltgbuf_t *buf)
+static void S_LTG __corerpc_reply_handler(corerpc_ctx_t *ctx,
+                                          const ltg_net_head_t *head, ltgbuf_t *buf)
 {
         int ret, retval;
         rpc_table_t *__rpc_table_private__ = corerpc_self();
 
         NET_HEAD_DUMP(head);
 
+        corerpc_credit_update(&ctx->sockid, head);
+
         retval = ltg_pack_err(buf);
         if (unlikely(retval))
                 ltgbuf_free(buf);
@@ -362,7 +365,7 @@ static int __corerpc_handler(corerpc_ctx_t *ctx, ltgbuf_t *buf)
                 __corerpc_request_handler(ctx, &head, buf);
                 break;
         case LTG_MSG_REP:
-                __corerpc_reply_handler(&head, buf);
+                __corerpc_reply_handler(ctx, &head, buf);
                 break;
         default:
                 DERROR("bad msgtype\n");
@@ -401,7 +404,7 @@ static int S_LTG __corerpc_rdma_handler(corerpc_ctx_t *ctx, ltgbuf_t *msg_buf)
                         __corerpc_request_handler(ctx, &head, msg_buf);
                         break;
                 case LTG_MSG_REP:
-                        __corerpc_reply_handler(&head, msg_buf);
+                        __corerpc_reply_handler(ctx, &head, msg_buf);
                         ltgbuf_free(msg_buf);
                         break;
                 default:
@@ -449,10 +452,8 @@ int S_LTG corerpc_rdma_recv_msg(void *_ctx, void *iov, int *_count)
         ltgbuf_initwith(&_buf, msg, net_head->len, iov, corenet_rdma_post_recv);
 
         if (net_head->blocks) {
-                void **addr = (void **)net_head->msgid.data_prop.remote_addr;
-                uint32_t rkey = net_head->msgid.data_prop.rkey;
-
-                corenet_rdma_send(sockid, &_buf, addr, rkey, net_head->blocks,
+                LTG_ASSERT(net_head->msgid.data_prop.size == net_head->blocks);
+                corenet_rdma_send(sockid, &_buf, &net_head->msgid.data_prop,
                                   build_rdma_read_req);
         } else {
                 __corerpc_rdma_handler(ctx,  &_buf);
@@ -504,6 +505,196 @@ int corerpc_tcp_recv(void *_ctx, void *buf, int *_count)
         return 0;
 }
 
+/* corenet_shm hands over one whole message at a time */
+int corerpc_shm_recv(void *_ctx, void *buf, int *_count)
+{
+        corerpc_ctx_t *ctx = _ctx;
+
+        __corerpc_handler(ctx, buf);
+        *_count = 1;
+
+        return 0;
+}
+
+#define LOCAL_IOV_MAX 16
+
+typedef struct {
+        rpc_prog_t *prog;
+        int in_cnt;
+        int out_cnt;
+        int outlen;
+        int replen;
+        struct iovec in_iov[LOCAL_IOV_MAX];
+        struct iovec out_iov[LOCAL_IOV_MAX];
+} corerpc_local_t;
+
+static uint64_t __corerpc_local_count__[CORE_MAX];
+
+int S_LTG corerpc_islocal(const coreid_t *coreid, const ltgbuf_t *wbuf,
+                          const ltgbuf_t *rbuf, int msg_type)
+{
+        core_t *core = core_self();
+
+        if (!ltgconf_global.rpc_local || !net_islocal(&coreid->nid))
+                return 0;
+
+        if (unlikely(core == NULL || coreid->idx >= CORE_MAX
+                     || !core_used(coreid->idx)))
+                return 0;
+
+        if (unlikely(msg_type >= LTG_MSG_MAX_KEEP
+                     || __corerpc_prog__[msg_type].handler == NULL))
+                return 0;
+
+        if (unlikely((wbuf && ltgbuf_segcount(wbuf) >= LOCAL_IOV_MAX)
+                     || (rbuf && ltgbuf_segcount(rbuf) > LOCAL_IOV_MAX)))
+                return 0;
+
+        return 1;
+}
+
+static void __corerpc_local_copy(corerpc_local_t *ctx, const ltgbuf_t *out)
+{
+        uint32_t off = 0, len;
+
+        for (int i = 0; i < ctx->out_cnt && off < out->len; i++) {
+                len = _min(ctx->out_iov[i].iov_len, out->len - off);
+                ltgbuf_get1(out, ctx->out_iov[i].iov_base, off, len);
+                off += len;
+        }
+}
+
+static int S_LTG __corerpc_local_exec(corerpc_local_t *ctx)
+{
+        int ret;
+        ltgbuf_t in, out;
+        request_handler_func handler = NULL;
+        const char *name;
+
+        ltgbuf_initwith2(&in, ctx->in_iov, ctx->in_cnt, NULL, NULL);
+        ltgbuf_initwith2(&out, ctx->out_iov, ctx->out_cnt, NULL, NULL);
+
+        ctx->prog->handler(&in, &handler, &name);
+        if (unlikely(handler == NULL)) {
+                ret = ENOSYS;
+                GOTO(err_free, ret);
+        }
+
+        DBUG("local %s\n", name);
+
+        ret = handler(&in, &out, &ctx->outlen);
+        if (unlikely(ret))
+                GOTO(err_free, ret);
+
+        LTG_ASSERT(ctx->outlen <= ctx->replen);
+
+        /* the handler may have put its own segments in the reply */
+        if (unlikely(out.len && ltgbuf_head(&out) != ctx->out_iov[0].iov_base)) {
+                __corerpc_local_copy(ctx, &out);
+        }
+
+        ltgbuf_free(&in);
+        ltgbuf_free(&out);
+
+        return 0;
+err_free:
+        ltgbuf_free(&in);
+        ltgbuf_free(&out);
+        return ret;
+}
+
+static int S_LTG __corerpc_local_task(va_list ap)
+{
+        corerpc_local_t *ctx = va_arg(ap, corerpc_local_t *);
+
+        va_end(ap);
+
+        return __corerpc_local_exec(ctx);
+}
+
+/*
+ * the target core is in this process, hand the handler the caller's
+ * buffers directly, no head, crc or socket. the caller waits, so the
+ * buffers stay valid while the target core uses them.
+ */
+int S_LTG corerpc_local(const char *name, const coreid_t *coreid,
+                        const void *request, int reqlen, const ltgbuf_t *wbuf,
+                        ltgbuf_t *rbuf, int msg_type)
+{
+        int ret, count;
+        core_t *core = core_self();
+        corerpc_local_t ctx;
+
+        ctx.prog = &__corerpc_prog__[msg_type];
+        ctx.outlen = 0;
+
+        ctx.in_cnt = 0;
+        if (likely(reqlen)) {
+                ctx.in_iov[0].iov_base = (void *)request;
+                ctx.in_iov[0].iov_len = reqlen;
+                ctx.in_cnt++;
+        }
+
+        if (wbuf) {
+                count = LOCAL_IOV_MAX - ctx.in_cnt;
+                ltgbuf_trans(&ctx.in_iov[ctx.in_cnt], &count, wbuf);
+                ctx.in_cnt += count;
+        }
+
+        ctx.out_cnt = 0;
+        ctx.replen = rbuf ? (int)rbuf->len : 0;
+        if (rbuf) {
+                ctx.out_cnt = LOCAL_IOV_MAX;
+                ltgbuf_trans(ctx.out_iov, &ctx.out_cnt, rbuf);
+        }
+
+        __corerpc_local_count__[core->hash]++;
+
+        if (core->hash == (int)coreid->idx) {
+                ret = __corerpc_local_exec(&ctx);
+        } else {
+                ret = core_ring_wait(coreid->idx, RING_TASK, name,
+                                     __corerpc_local_task, &ctx);
+        }
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+int corerpc_local_stat(int hash, uint64_t *count)
+{
+        if (hash < 0 || hash >= CORE_MAX)
+                return EINVAL;
+
+        *count = __atomic_load_n(&__corerpc_local_count__[hash], __ATOMIC_RELAXED);
+
+        return 0;
+}
+
+int corerpc_proto_private_init(int hash)
+{
+        int ret;
+
+        ret = obj_pool_private_init(hash, OBJ_POOL_RPC_REQUEST, "rpc_request",
+                                    sizeof(rpc_request_t),
+                                    ltgconf_global.obj_pool_count);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        ret = obj_pool_private_init(hash, OBJ_POOL_CORERPC_RING, "corerpc_ring",
+                                    sizeof(corerpc_ring_t),
+                                    ltgconf_global.obj_pool_count);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        return 0;
+err_ret:
+        return ret;
+}
+
 void corerpc_register(int type, request_get_handler handler, void *context)
 {
         rpc_prog_t *prog;
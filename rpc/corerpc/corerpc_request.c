@@ -10,6 +10,7 @@
 
 #define SEND_TASK 2
 #define SEND_QUEUE 3
+#define SEND_ASYNC 4
 
 #define CORE_CHECK 0
 
@@ -24,12 +25,16 @@ typedef struct corerpc_op {
 
         void *wbuf;
         void *rbuf;
+        const ltgbuf_t *wsg;            /* wbuf in place, see __corerpc_trans_sg */
+        ltgbuf_t *rsg;
 
         int msg_type;
         int timeout;
         uint32_t group;
         sockid_t sockid;
         msgid_t msgid;
+        uint32_t credit;                /* bytes taken from the connection */
+        void *mr;                       /* cached registration of wbuf or rbuf */
 } corerpc_op_t;
 
 typedef struct {
@@ -53,10 +58,56 @@ typedef struct {
 } rpc_ctx_t;
 
 static void __corerpc_close(void *arg1, void *arg2, void *arg3);
+
+/* contexts of the calls a netctl core sends for other cores */
+int corerpc_request_private_init(int hash)
+{
+        return obj_pool_private_init(hash, OBJ_POOL_RPC_CTX, "rpc_ctx",
+                                     sizeof(rpc_ctx_t),
+                                     ltgconf_global.obj_pool_count);
+}
 extern rpc_table_t *corerpc_self_byctx(void *);
 extern rpc_table_t *corerpc_self();
 extern int corerpc_inited;
 
+static void S_LTG __corerpc_mr_put(corerpc_op_t *op)
+{
+#if ENABLE_RDMA
+        if (unlikely(op->mr)) {
+                rdma_mr_put(op->mr);
+                op->mr = NULL;
+        }
+#else
+        (void) op;
+#endif
+}
+
+/* reply data that came with the message, over tcp or shm */
+static void S_LTG __corerpc_reply_get(const corerpc_op_t *op, ltgbuf_t *buf)
+{
+        int i, count = MAX_DATA_SGE;
+        uint32_t off = 0, len;
+        struct iovec iov[MAX_DATA_SGE];
+
+        if (likely(buf == NULL || buf->len == 0))
+                return;
+
+        LTG_ASSERT(op->rbuflen >= (int)buf->len);
+        if (op->rsg) {
+                ltgbuf_trans(iov, &count, op->rsg);
+                for (i = 0; i < count && off < buf->len; i++) {
+                        len = _min(iov[i].iov_len, buf->len - off);
+                        ltgbuf_get1(buf, iov[i].iov_base, off, len);
+                        off += len;
+                }
+        } else {
+                LTG_ASSERT(op->rbuf);
+                ltgbuf_get(buf, op->rbuf, buf->len);
+        }
+
+        ltgbuf_free(buf);
+}
+
 static void S_LTG __corerpc_post_task(void *arg1, void *arg2, void *arg3, void *arg4)
 {
         rpc_ctx_t *ctx = arg1;
@@ -67,13 +118,9 @@ static void S_LTG __corerpc_post_task(void *arg1, void *arg2, void *arg3, void *
         (void) arg4;
 
         ctx->latency = 0;
-
-        if (buf && buf->len) {
-                LTG_ASSERT(op->rbuf);
-                LTG_ASSERT(op->rbuflen >= (int)buf->len);
-                ltgbuf_get(buf, op->rbuf, buf->len);
-                ltgbuf_free(buf);
-        }
+        corerpc_credit_put(&op->sockid, op->credit);
+        __corerpc_mr_put(op);
+        __corerpc_reply_get(op, buf);
 
         sche_task_post(&ctx->task, retval, NULL);
 }
@@ -84,7 +131,6 @@ static void __corerpc_request_reset(const msgid_t *msgid, int retval)
 
         DBUG("reset (%d, %d)\n", msgid->idx, msgid->figerprint);
         rpc_table_t *__rpc_table_private__ = corerpc_self();
-        sche_task_reset();
         rpc_table_free(__rpc_table_private__, msgid);
 }
 
@@ -152,30 +198,92 @@ inline void INLINE __ltgbuf_trans_addr(void **addr, void *buf)
 #endif
 
 
-static void __corerpc_msgid_prep(msgid_t *msgid, const void *wbuf, int wlen,
-                                 void *rbuf, int rlen, const rdma_conn_t *handler)
+/*
+ * the peer reads or writes the buffer with the rkey sent here. buffers
+ * outside the hugepage mr take one from the registration cache, held in
+ * the op until its slot is posted.
+ */
+static int __corerpc_rkey(const rdma_conn_t *handler, const void *buf,
+                          int len, void **_mr, uint32_t *rkey)
+{
+        struct ibv_mr *mr;
+        rdma_mr_ent_t *ent;
+
+        if (likely(handler->dev->mr_cache == NULL
+                   || rdma_mr_registered(buf, len))) {
+                *rkey = handler->mr->rkey;
+                return 0;
+        }
+
+        ent = rdma_mr_get(handler->dev, buf, len, &mr);
+        if (unlikely(ent == NULL))
+                return ENOMEM;
+
+        *_mr = ent;
+        *rkey = mr->rkey;
+
+        return 0;
+}
+
+/* every segment is in the hugepage mr, see __corerpc_trans_sg */
+static void __corerpc_msgid_sg(data_prop_t *prop, const ltgbuf_t *buf,
+                               const rdma_conn_t *handler)
+{
+        int i, count = MAX_DATA_SGE;
+        struct iovec iov[MAX_DATA_SGE];
+
+        prop->size = ltgbuf_trans(iov, &count, buf);
+        LTG_ASSERT(prop->size == buf->len);
+
+        for (i = 0; i < count; i++) {
+                prop->remote_addr[i] = (uintptr_t)iov[i].iov_base;
+                prop->remote_len[i] = iov[i].iov_len;
+        }
+
+        prop->rkey = handler->mr->rkey;
+}
+
+static int __corerpc_msgid_prep(msgid_t *msgid, const void *wbuf, int wlen,
+                                void *rbuf, int rlen, const ltgbuf_t *sg,
+                                const rdma_conn_t *handler, void **mr)
 {
+        int ret;
 
         if (rlen == 0 && wlen == 0)
-                return;
+                return 0;
 
         memset(&msgid->data_prop, 0x00, sizeof(data_prop_t));
-	if (wbuf != NULL) {
-		msgid->data_prop.rkey = handler->mr->rkey;
+        if (sg != NULL) {
+                __corerpc_msgid_sg(&msgid->data_prop, sg, handler);
+        } else if (wbuf != NULL) {
+                ret = __corerpc_rkey(handler, wbuf, wlen, mr,
+                                     &msgid->data_prop.rkey);
+                if (unlikely(ret))
+                        GOTO(err_ret, ret);
+
 		//ltgbuf_trans_addr((void **)msgid->data_prop.remote_addr, (void *)wbuf);
                 msgid->data_prop.remote_addr[0] = (uintptr_t)wbuf;
-                
+                msgid->data_prop.remote_len[0] = wlen;
 		msgid->data_prop.size = wlen;
 	} else if (rbuf != NULL){
                 //LTG_ASSERT((int)rbuf->len == msg_size);
 
-		msgid->data_prop.rkey = handler->mr->rkey;
+                ret = __corerpc_rkey(handler, rbuf, rlen, mr,
+                                     &msgid->data_prop.rkey);
+                if (unlikely(ret))
+                        GOTO(err_ret, ret);
+
 		//__ltgbuf_trans_addr((void **)msgid->data_prop.remote_addr, rbuf);
                 msgid->data_prop.remote_addr[0] = (uintptr_t)rbuf;
+                msgid->data_prop.remote_len[0] = rlen;
 		msgid->data_prop.size = rlen;
 	}
 
         MSGID_DUMP(msgid);
+
+        return 0;
+err_ret:
+        return ret;
 }
 
 #endif
@@ -189,8 +297,11 @@ int S_LTG corerpc_rdma_request(void *ctx, void *_op)
 
         (void) ctx;
         
-        __corerpc_msgid_prep(&op->msgid, op->wbuf, op->wbuflen, op->rbuf,
-                             op->rbuflen, handler);
+        ret = __corerpc_msgid_prep(&op->msgid, op->wbuf, op->wbuflen, op->rbuf,
+                                   op->rbuflen, op->wsg ? op->wsg : op->rsg,
+                                   handler, &op->mr);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
 
         ret = rpc_request_prep(&buf, &op->msgid, op->request, op->msglen,
                                op->rbuflen, op->wbuflen, op->msg_type, op->group,
@@ -198,7 +309,7 @@ int S_LTG corerpc_rdma_request(void *ctx, void *_op)
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
-        ret = corenet_rdma_send(&op->sockid, &buf, NULL, 0, 0, build_post_send_req);
+        ret = corenet_rdma_send(&op->sockid, &buf, NULL, build_post_send_req);
         if (unlikely(ret)) {
                 GOTO(err_free, ret);
         }
@@ -210,6 +321,27 @@ err_ret:
         return ret;
 }
 
+/* the caller holds wbuf until the reply, it is sent without a copy */
+static void __corerpc_wbuf_attach(ltgbuf_t *buf, const corerpc_op_t *op)
+{
+        int i, count = MAX_DATA_SGE;
+        struct iovec iov[MAX_DATA_SGE];
+        ltgbuf_t tmp;
+
+        if (op->wsg == NULL) {
+                LTG_ASSERT(op->wbuf);
+                ltgbuf_initwith(&tmp, op->wbuf, op->wbuflen, NULL, NULL);
+                ltgbuf_merge(buf, &tmp);
+                return;
+        }
+
+        ltgbuf_trans(iov, &count, op->wsg);
+        for (i = 0; i < count; i++) {
+                ltgbuf_initwith(&tmp, iov[i].iov_base, iov[i].iov_len, NULL, NULL);
+                ltgbuf_merge(buf, &tmp);
+        }
+}
+
 int corerpc_tcp_request(void *ctx, void *_op)
 {
         int ret;
@@ -223,10 +355,7 @@ int corerpc_tcp_request(void *ctx, void *_op)
                 GOTO(err_ret, ret);
 
         if (op->wbuflen) {
-                ltgbuf_t tmp;
-                LTG_ASSERT(op->wbuf);
-                ltgbuf_initwith(&tmp, op->wbuf, op->wbuflen, NULL, NULL);
-                ltgbuf_merge(&buf, &tmp);
+                __corerpc_wbuf_attach(&buf, op);
         }
 
         ret = corenet_tcp_send(ctx, &op->sockid, &buf);
@@ -241,6 +370,34 @@ err_ret:
         return ret;
 }
 
+int corerpc_shm_request(void *ctx, void *_op)
+{
+        int ret;
+        ltgbuf_t buf;
+        corerpc_op_t *op = _op;
+
+        ret = rpc_request_prep(&buf, &op->msgid, op->request, op->msglen,
+                               op->rbuflen, op->wbuflen, op->msg_type, op->group,
+                               op->coreid.idx);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        if (op->wbuflen) {
+                __corerpc_wbuf_attach(&buf, op);
+        }
+
+        ret = corenet_shm_send(ctx, &op->sockid, &buf);
+        if (unlikely(ret)) {
+                GOTO(err_free, ret);
+        }
+        
+        return 0;
+err_free:
+        ltgbuf_free(&buf);
+err_ret:
+        return ret;
+}
+
 static int S_LTG __corerpc_send_sock(void *core, const char *name,
                                      rpc_ctx_t *ctx, func3_t func3, int type)
 {
@@ -251,27 +408,33 @@ static int S_LTG __corerpc_send_sock(void *core, const char *name,
 
         DBUG("%s\n", name);
 
-        ret = __corerpc_getslot(core, name, ctx, func3, type);
+        op->credit = sizeof(ltg_net_head_t) + op->msglen + op->wbuflen;
+        op->mr = NULL;
+        ret = corerpc_credit_get(&op->sockid, op->credit, type == SEND_TASK);
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
+        ret = __corerpc_getslot(core, name, ctx, func3, type);
+        if (unlikely(ret))
+                GOTO(err_credit, ret);
+
         ret = op->sockid.request(core, op);
         if (unlikely(ret)) { 
                 __corerpc_request_reset(&op->msgid, ret);
-                if (sche_running()) {
+                corerpc_credit_put(&op->sockid, op->credit);
+                __corerpc_mr_put(op);
+                if (type == SEND_TASK) {
                         sche_task_reset();
 #if 0
                         corenet_maping_close(&op->netctl.nid, &op->sockid);
 #endif
                 }
 
-                if (type == SEND_QUEUE) {
-                        goto out;
-                } else {
-                        ret = _errno_net(ret);
-                        LTG_ASSERT(ret == ENONET || ret == ESHUTDOWN);
-                        GOTO(err_ret, ret);
-                }
+                /* queued and async callers get the error in their reply */
+                ret = _errno_net(ret);
+                /* ENOMEM: the buffer could not be registered */
+                LTG_ASSERT(ret == ENONET || ret == ESHUTDOWN || ret == ENOMEM);
+                GOTO(err_ret, ret);
 	}
 
         DBUG("%s msgid (%u, %x) to %s\n", name, &op->msgid.idx,
@@ -280,10 +443,11 @@ static int S_LTG __corerpc_send_sock(void *core, const char *name,
         SOCKID_DUMP(&op->sockid);
         MSGID_DUMP(&op->msgid);
 
-out:
         ANALYSIS_QUEUE(0, IO_INFO, NULL);
         
         return 0;
+err_credit:
+        corerpc_credit_put(&op->sockid, op->credit);
 err_ret:
         return ret;
 }
@@ -302,7 +466,8 @@ static int S_LTG __corerpc_send(const char *name, rpc_ctx_t *ctx, func3_t func,
                 GOTO(err_ret, ret);
         }
         
-        ret = corenet_maping(core, &op->netctl, &op->sockid);
+        ret = corenet_maping1(core, &op->netctl,
+                              op->msglen + op->wbuflen + op->rbuflen, &op->sockid);
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
@@ -361,6 +526,8 @@ int corerpc_postwait_sock(const char *name, const coreid_t *coreid,
         
         op->wbuf = NULL;
         op->rbuf = NULL;
+        op->wsg = NULL;
+        op->rsg = NULL;
         op->wbuflen = 0;
         op->rbuflen = 0;
 
@@ -400,24 +567,21 @@ static void S_LTG __corerpc_post_queue(void *arg1, void *arg2, void *arg3,
 
         LTG_ASSERT(ctx->coreid == coreid.idx);
 #endif
-        
+
+        corerpc_credit_put(&op->sockid, op->credit);
+        __corerpc_mr_put(op);
         ring->retval = retval;
-        if (buf && buf->len) {
-                LTG_ASSERT(op->rbuf);
-                LTG_ASSERT(op->rbuflen >= (int)buf->len);
-                ltgbuf_get(buf, op->rbuf, buf->len);
-                ltgbuf_free(buf);
-        }
+        __corerpc_reply_get(op, buf);
 
         core_ring_reply(&ring->ring_ctx);
-        slab_stream_free(ctx);
+        obj_pool_free(ctx);
 }
 
 inline static void INLINE __corerpc_queue_exec(void *_ring)
 {
         int ret;
         corerpc_ring_ctx_t *ring = _ring;
-        rpc_ctx_t *ctx = slab_stream_alloc(sizeof(*ctx));
+        rpc_ctx_t *ctx = obj_pool_alloc(OBJ_POOL_RPC_CTX, sizeof(*ctx));
 
         ctx->op = *ring->op;
         ctx->ctx = ring;
@@ -441,7 +605,7 @@ err_ret:
 #if 1
         ring->retval = ret;
         core_ring_reply(&ring->ring_ctx);
-        slab_stream_free(ctx);
+        obj_pool_free(ctx);
 #endif
         return;
 }
@@ -533,6 +697,59 @@ err_ret:
 
 #define MEM_MALLOC 0
 
+/*
+ * a small buffer outside the hugepage mr is cheaper to copy into the ring
+ * than to register, larger ones go out in place if their owner allowed
+ * it, see __corerpc_rkey and rdma_mr_allow.
+ */
+inline static int INLINE __corerpc_trans_copy(const ltgbuf_t *buf)
+{
+#if ENABLE_RDMA
+        if (likely(!ltgconf_global.rdma || !ltgconf_global.rdma_mr_cache))
+                return 0;
+
+        if (rdma_mr_registered(ltgbuf_head(buf), buf->len))
+                return 0;
+
+        return (int)buf->len < ltgconf_global.rdma_mr_min
+                || !rdma_mr_allowed(ltgbuf_head(buf), buf->len);
+#else
+        (void) buf;
+        return 0;
+#endif
+}
+
+/*
+ * a buffer of a few segments, all in the hugepage mr, is read or written
+ * by the peer in place with one remote segment each. tcp and shm take the
+ * segments as they are.
+ */
+inline static int INLINE __corerpc_trans_sg(const ltgbuf_t *buf)
+{
+#if ENABLE_RDMA
+        int i, count;
+        struct iovec iov[MAX_DATA_SGE];
+
+        if (buf == NULL || likely(!ltgconf_global.rdma))
+                return 0;
+
+        count = ltgbuf_segcount(buf);
+        if (likely(count == 1) || count > MAX_DATA_SGE)
+                return 0;
+
+        ltgbuf_trans(iov, &count, buf);
+        for (i = 0; i < count; i++) {
+                if (!rdma_mr_registered(iov[i].iov_base, iov[i].iov_len))
+                        return 0;
+        }
+
+        return 1;
+#else
+        (void) buf;
+        return 0;
+#endif
+}
+
 inline static void INLINE __corerpc_trans_addr(const ltgbuf_t *buf,
                                                mem_handler_t *handler, void **addr)
 {
@@ -543,7 +760,7 @@ inline static void INLINE __corerpc_trans_addr(const ltgbuf_t *buf,
                 return;
         }
 
-        if (likely(ltgbuf_segcount(buf) == 1)) {
+        if (likely(ltgbuf_segcount(buf) == 1 && !__corerpc_trans_copy(buf))) {
                 *addr = ltgbuf_head(buf);
         } else {
 #if MEM_MALLOC
@@ -570,7 +787,7 @@ inline static void INLINE __corerpc_trans_addr(const ltgbuf_t *buf,
 inline static void INLINE __corerpc_trans_free(const ltgbuf_t *buf,
                                                mem_handler_t *handler, void *addr)
 {
-        if (buf == NULL) {
+        if (buf == NULL || addr == NULL) {
                 return;
         }
 
@@ -606,6 +823,12 @@ inline int INLINE corerpc_postwait(const char *name, const coreid_t *coreid,
 
         (void) msg_size;
 
+        if (corerpc_islocal(coreid, wbuf, rbuf, msg_type)) {
+                LTG_ASSERT(replen == (rbuf ? (int)rbuf->len : 0));
+                return corerpc_local(name, coreid, request, reqlen, wbuf, rbuf,
+                                     msg_type);
+        }
+
         op.coreid = *coreid;
         op.request = request;
         op.msglen = reqlen;
@@ -618,8 +841,21 @@ inline int INLINE corerpc_postwait(const char *name, const coreid_t *coreid,
 
         LTG_ASSERT(replen == op.rbuflen);
         
-        __corerpc_trans_addr(wbuf, &whandler, &op.wbuf);
-        __corerpc_trans_addr(rbuf, &rhandler, &op.rbuf);
+        op.wsg = NULL;
+        op.rsg = NULL;
+        if (unlikely(__corerpc_trans_sg(wbuf))) {
+                op.wsg = wbuf;
+                op.wbuf = NULL;
+        } else {
+                __corerpc_trans_addr(wbuf, &whandler, &op.wbuf);
+        }
+
+        if (unlikely(__corerpc_trans_sg(rbuf))) {
+                op.rsg = rbuf;
+                op.rbuf = NULL;
+        } else {
+                __corerpc_trans_addr(rbuf, &rhandler, &op.rbuf);
+        }
 
         if (unlikely(op.wbuf && ltgbuf_head(wbuf) != op.wbuf)) {
                 ltgbuf_get(wbuf, op.wbuf, wbuf->len);
@@ -702,6 +938,483 @@ err_ret:
         return ret;
 }
 
+/*
+ * async post, the caller gets func(arg, retval) on its own core once the
+ * reply is in, the slot times out or the send fails after queuing. func
+ * is mostly called from the poller and must not yield, it may post again.
+ * wbuf and rbuf stay with the call until then, the request is copied.
+ */
+typedef struct {
+        rpc_ctx_t ctx;                  /* netctl is this core */
+        corerpc_ring_ctx_t ring;        /* netctl is another core */
+        mem_handler_t whandler;
+        mem_handler_t rhandler;
+        const ltgbuf_t *wbuf;
+        ltgbuf_t *rbuf;
+        int local;
+        int connect;                    /* netctl is this core, not connected */
+        corerpc_post_func func;
+        void *arg;
+        char request[0];
+} corerpc_async_t;
+
+static void S_LTG __corerpc_async_done(corerpc_async_t *async, int retval)
+{
+        corerpc_op_t *op = &async->ctx.op;
+
+        if (unlikely(retval == 0 && op->rbuf
+                     && ltgbuf_head(async->rbuf) != op->rbuf)) {
+                ltgbuf_copy3(async->rbuf, op->rbuf, async->rbuf->len);
+        }
+
+        __corerpc_trans_free(async->wbuf, &async->whandler, op->wbuf);
+        __corerpc_trans_free(async->rbuf, &async->rhandler, op->rbuf);
+
+        async->func(async->arg, retval);
+        slab_stream_free(async);
+}
+
+static void S_LTG __corerpc_post_async(void *arg1, void *arg2, void *arg3,
+                                       void *arg4)
+{
+        corerpc_async_t *async = arg1;
+        int retval = *(int *)arg2;
+        ltgbuf_t *buf = arg3;
+        corerpc_op_t *op = &async->ctx.op;
+
+        (void) arg4;
+
+        corerpc_credit_put(&op->sockid, op->credit);
+        __corerpc_mr_put(op);
+        __corerpc_reply_get(op, buf);
+
+        __corerpc_async_done(async, retval);
+}
+
+/* local calls and connects run the blocking way in a task of their own */
+static void __corerpc_async_task(void *arg)
+{
+        int ret;
+        corerpc_async_t *async = arg;
+        corerpc_op_t *op = &async->ctx.op;
+
+        if (async->local) {
+                ret = corerpc_local(async->ring.name, &op->coreid, op->request,
+                                    op->msglen, async->wbuf, async->rbuf,
+                                    op->msg_type);
+        } else if (async->connect) {
+                ret = __corerpc_postwait(async->ring.name, op);
+        } else {
+                ret = __corerpc_ring_task_wait(op->netctl.idx,
+                                               async->ring.name, op);
+        }
+
+        __corerpc_async_done(async, ret);
+}
+
+static void S_LTG __corerpc_async_reply(void *arg)
+{
+        corerpc_async_t *async = arg;
+
+        if (unlikely(async->ring.retval == ENOSYS)) {
+                DINFO("retry connect\n");
+                sche_task_new(async->ring.name, __corerpc_async_task, async, -1);
+                return;
+        }
+
+        __corerpc_async_done(async, async->ring.retval);
+}
+
+int S_LTG corerpc_post_async(const char *name, const coreid_t *coreid,
+                             const void *request, int reqlen,
+                             const ltgbuf_t *wbuf, ltgbuf_t *rbuf,
+                             int msg_type, int group, int timeout,
+                             corerpc_post_func func, void *arg)
+{
+        int ret;
+        coreid_t netctl;
+        corerpc_async_t *async;
+        corerpc_op_t *op;
+
+        LTG_ASSERT(rbuf == NULL || wbuf == NULL);
+
+        if (unlikely(!ltgconf_global.daemon || !corerpc_inited)) {
+                ret = ENOSYS;
+                GOTO(err_ret, ret);
+        }
+
+        async = slab_stream_alloc(sizeof(*async) + reqlen);
+        if (unlikely(async == NULL)) {
+                ret = ENOMEM;
+                GOTO(err_ret, ret);
+        }
+
+        memcpy(async->request, request, reqlen);
+        async->wbuf = wbuf;
+        async->rbuf = rbuf;
+        async->func = func;
+        async->arg = arg;
+        async->ring.name = name;
+        async->local = 0;
+        async->connect = 0;
+
+        op = &async->ctx.op;
+        op->coreid = *coreid;
+        op->request = async->request;
+        op->msglen = reqlen;
+        op->msg_type = msg_type;
+        op->timeout = timeout;
+        op->group = group;
+        op->wbuflen = wbuf ? wbuf->len : 0;
+        op->rbuflen = rbuf ? rbuf->len : 0;
+        op->wbuf = NULL;
+        op->rbuf = NULL;
+        op->wsg = NULL;
+        op->rsg = NULL;
+
+        if (corerpc_islocal(coreid, wbuf, rbuf, msg_type)) {
+                async->local = 1;
+                sche_task_new(name, __corerpc_async_task, async, -1);
+                return 0;
+        }
+
+        if (unlikely(__corerpc_trans_sg(wbuf))) {
+                op->wsg = wbuf;
+        } else {
+                __corerpc_trans_addr(wbuf, &async->whandler, &op->wbuf);
+        }
+
+        if (unlikely(__corerpc_trans_sg(rbuf))) {
+                op->rsg = rbuf;
+        } else {
+                __corerpc_trans_addr(rbuf, &async->rhandler, &op->rbuf);
+        }
+
+        if (unlikely(op->wbuf && ltgbuf_head(wbuf) != op->wbuf)) {
+                ltgbuf_get(wbuf, op->wbuf, wbuf->len);
+        }
+
+        if (likely(netctl_get(coreid, &netctl))) {
+                op->netctl = netctl;
+                async->ring.op = op;
+                core_ring_queue(netctl.idx, RING_QUEUE, &async->ring.ring_ctx,
+                                __corerpc_queue_exec, &async->ring,
+                                __corerpc_async_reply, async);
+        } else {
+                op->netctl = *coreid;
+
+                /* the connect would yield the caller or spin the poller */
+                if (unlikely(!corenet_maping_ready(core_self(), coreid))) {
+                        DINFO("%s connect in task\n", name);
+                        async->connect = 1;
+                        sche_task_new(name, __corerpc_async_task, async, -1);
+                        return 0;
+                }
+
+                ret = __corerpc_send(name, &async->ctx, __corerpc_post_async,
+                                     SEND_ASYNC);
+                if (unlikely(ret))
+                        GOTO(err_trans, ret);
+        }
+
+        return 0;
+err_trans:
+        __corerpc_trans_free(wbuf, &async->whandler, op->wbuf);
+        __corerpc_trans_free(rbuf, &async->rhandler, op->rbuf);
+        slab_stream_free(async);
+err_ret:
+        return ret;
+}
+
+void corerpc_wait_init(corerpc_wait_t *wait)
+{
+        wait->count = 0;
+        wait->retval = 0;
+        wait->task.taskid = -1;
+}
+
+/* post func of a fan-out, the first error is kept */
+void S_LTG corerpc_wait_done(void *_wait, int retval)
+{
+        corerpc_wait_t *wait = _wait;
+
+        LTG_ASSERT(wait->count > 0);
+
+        if (unlikely(retval && wait->retval == 0))
+                wait->retval = retval;
+
+        wait->count--;
+        if (wait->count == 0 && wait->task.taskid != -1) {
+                sche_task_post(&wait->task, 0, NULL);
+        }
+}
+
+int S_LTG corerpc_wait(const char *name, corerpc_wait_t *wait)
+{
+        int ret;
+
+        if (wait->count) {
+                wait->task = sche_task_get();
+                ret = sche_yield(name, NULL, NULL);
+                if (unlikely(ret))
+                        GOTO(err_ret, ret);
+        }
+
+        return wait->retval;
+err_ret:
+        return ret;
+}
+
+/*
+ * a batch takes one ring hop to a netctl core for all its remote calls.
+ * they are sent from there in one pass, so calls on the same connection
+ * go out with one commit: one sendmsg for tcp, one wr chain for rdma. the
+ * caller yields once for all the replies. local calls run first, the
+ * caller can not be woken by the batch while one of them waits.
+ */
+struct corerpc_batch_ctx;
+
+typedef struct {
+        rpc_ctx_t ctx;
+        corerpc_batch_t *ent;
+        struct corerpc_batch_ctx *batch;
+        mem_handler_t whandler;
+        mem_handler_t rhandler;
+} batch_op_t;
+
+typedef struct corerpc_batch_ctx {
+        ring_ctx_t ring_ctx;
+        const char *name;
+        int ring;                       /* sent by a netctl core */
+        int count;
+        int wait;                       /* replies still due */
+        task_t task;
+        batch_op_t op[0];
+} corerpc_batch_ctx_t;
+
+static void S_LTG __corerpc_batch_put(corerpc_batch_ctx_t *batch)
+{
+        batch->wait--;
+        if (batch->wait)
+                return;
+
+        if (batch->ring) {
+                core_ring_reply(&batch->ring_ctx);
+        } else {
+                sche_task_post(&batch->task, 0, NULL);
+        }
+}
+
+static void S_LTG __corerpc_batch_post(void *arg1, void *arg2, void *arg3,
+                                       void *arg4)
+{
+        batch_op_t *bop = arg1;
+        int retval = *(int *)arg2;
+        ltgbuf_t *buf = arg3;
+        corerpc_op_t *op = &bop->ctx.op;
+
+        (void) arg4;
+
+        corerpc_credit_put(&op->sockid, op->credit);
+        __corerpc_mr_put(op);
+        __corerpc_reply_get(op, buf);
+
+        bop->ent->retval = retval;
+        __corerpc_batch_put(bop->batch);
+}
+
+/* the batch is held until the pass is done, see __corerpc_batch_put */
+static void S_LTG __corerpc_batch_send(corerpc_batch_ctx_t *batch)
+{
+        int ret, i;
+        batch_op_t *bop;
+
+        batch->wait = batch->count + 1;
+
+        for (i = 0; i < batch->count; i++) {
+                bop = &batch->op[i];
+                ret = __corerpc_send(batch->name, &bop->ctx, __corerpc_batch_post,
+                                     batch->ring ? SEND_QUEUE : SEND_ASYNC);
+                if (unlikely(ret)) {
+                        bop->ent->retval = ret;
+                        batch->wait--;
+                }
+        }
+}
+
+static void S_LTG __corerpc_batch_exec(void *arg)
+{
+        corerpc_batch_ctx_t *batch = arg;
+
+        __corerpc_batch_send(batch);
+        __corerpc_batch_put(batch);
+}
+
+static void S_LTG __corerpc_batch_reply(void *arg)
+{
+        corerpc_batch_ctx_t *batch = arg;
+
+        sche_task_post(&batch->task, 0, NULL);
+}
+
+static void __corerpc_batch_prep(batch_op_t *bop, corerpc_batch_t *ent,
+                                 int group, int timeout)
+{
+        corerpc_op_t *op = &bop->ctx.op;
+        const ltgbuf_t *wbuf = ent->wbuf;
+        ltgbuf_t *rbuf = ent->rbuf;
+
+        LTG_ASSERT(rbuf == NULL || wbuf == NULL);
+
+        bop->ent = ent;
+        op->coreid = ent->coreid;
+        op->netctl = ent->coreid;
+        op->request = ent->request;
+        op->msglen = ent->reqlen;
+        op->msg_type = ent->msg_type;
+        op->timeout = timeout;
+        op->group = group;
+        op->wbuflen = wbuf ? wbuf->len : 0;
+        op->rbuflen = rbuf ? rbuf->len : 0;
+        op->wbuf = NULL;
+        op->rbuf = NULL;
+        op->wsg = NULL;
+        op->rsg = NULL;
+
+        if (unlikely(__corerpc_trans_sg(wbuf))) {
+                op->wsg = wbuf;
+        } else {
+                __corerpc_trans_addr(wbuf, &bop->whandler, &op->wbuf);
+        }
+
+        if (unlikely(__corerpc_trans_sg(rbuf))) {
+                op->rsg = rbuf;
+        } else {
+                __corerpc_trans_addr(rbuf, &bop->rhandler, &op->rbuf);
+        }
+
+        if (unlikely(op->wbuf && ltgbuf_head(wbuf) != op->wbuf)) {
+                ltgbuf_get(wbuf, op->wbuf, wbuf->len);
+        }
+}
+
+static void __corerpc_batch_finish(batch_op_t *bop)
+{
+        corerpc_op_t *op = &bop->ctx.op;
+        corerpc_batch_t *ent = bop->ent;
+
+        if (unlikely(ent->retval == 0 && op->rbuf
+                     && ltgbuf_head(ent->rbuf) != op->rbuf)) {
+                ltgbuf_copy3(ent->rbuf, op->rbuf, ent->rbuf->len);
+        }
+
+        __corerpc_trans_free(ent->wbuf, &bop->whandler, op->wbuf);
+        __corerpc_trans_free(ent->rbuf, &bop->rhandler, op->rbuf);
+}
+
+/* every call gets its retval, the first error is returned */
+int S_LTG corerpc_postwait_batch(const char *name, corerpc_batch_t *batch,
+                                 int count, int group, int timeout)
+{
+        int ret, i, remote = 0;
+        coreid_t netctl;
+        corerpc_batch_ctx_t *ctx;
+        corerpc_batch_t *ent;
+        batch_op_t *bop;
+
+        if (unlikely(!ltgconf_global.daemon || !corerpc_inited)) {
+                for (i = 0; i < count; i++) {
+                        ent = &batch[i];
+                        ent->retval = corerpc_postwait(name, &ent->coreid,
+                                                       ent->request, ent->reqlen,
+                                                       ent->rbuf ? ent->rbuf->len : 0,
+                                                       ent->wbuf, ent->rbuf,
+                                                       ent->msg_type, -1, group,
+                                                       timeout);
+                }
+
+                goto out;
+        }
+
+        for (i = 0; i < count; i++) {
+                ent = &batch[i];
+                if (corerpc_islocal(&ent->coreid, ent->wbuf, ent->rbuf,
+                                    ent->msg_type)) {
+                        ent->retval = corerpc_local(name, &ent->coreid,
+                                                    ent->request, ent->reqlen,
+                                                    ent->wbuf, ent->rbuf,
+                                                    ent->msg_type);
+                } else {
+                        ent->retval = EINPROGRESS;
+                        remote++;
+                }
+        }
+
+        if (remote == 0)
+                goto out;
+
+        ret = ltg_malloc((void **)&ctx, sizeof(*ctx) + sizeof(*bop) * remote);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        ctx->name = name;
+        ctx->count = 0;
+        for (i = 0; i < count; i++) {
+                if (batch[i].retval != EINPROGRESS)
+                        continue;
+
+                bop = &ctx->op[ctx->count++];
+                bop->batch = ctx;
+                __corerpc_batch_prep(bop, &batch[i], group, timeout);
+        }
+
+        ctx->ring = netctl_get(&batch[0].coreid, &netctl);
+        if (likely(ctx->ring)) {
+                for (i = 0; i < ctx->count; i++) {
+                        ctx->op[i].ctx.op.netctl.idx = netctl.idx;
+                }
+
+                ctx->task = sche_task_get();
+                core_ring_queue(netctl.idx, RING_QUEUE, &ctx->ring_ctx,
+                                __corerpc_batch_exec, ctx,
+                                __corerpc_batch_reply, ctx);
+        } else {
+                /* a connect may yield while sending, take the task after */
+                __corerpc_batch_send(ctx);
+                ctx->task = sche_task_get();
+                __corerpc_batch_put(ctx);
+        }
+
+        ret = sche_yield(name, NULL, NULL);
+        LTG_ASSERT(ret == 0);
+
+        for (i = 0; i < ctx->count; i++) {
+                bop = &ctx->op[i];
+                if (unlikely(ctx->ring && bop->ent->retval == ENOSYS)) {
+                        DINFO("retry connect\n");
+                        bop->ent->retval = __corerpc_ring_task_wait(netctl.idx,
+                                                                   name,
+                                                                   &bop->ctx.op);
+                }
+
+                __corerpc_batch_finish(bop);
+        }
+
+        ltg_free((void **)&ctx);
+
+out:
+        for (i = 0; i < count; i++) {
+                if (unlikely(batch[i].retval)) {
+                        ret = batch[i].retval;
+                        GOTO(err_ret, ret);
+                }
+        }
+
+        return 0;
+err_ret:
+        return ret;
+}
+
 inline static void INLINE __corerpc_request_free(void *ctx)
 {
         ltgbuf_t *buf = ctx;
@@ -15,6 +15,112 @@
 
 rpc_table_t *__rpc_table__;
 
+/*
+ * unused slots are kept on a free list by idx, getslot and free are O(1)
+ * however many calls are outstanding. a table that runs out of slots grows
+ * by RPC_TABLE_CHUNK up to rpc_table_max. slots never move, a msgid keeps
+ * pointing at its slot and the figerprint tells a stale one.
+ */
+#define RPC_TABLE_NULL ((uint32_t)-1)
+
+static inline slot_t S_LTG *__rpc_table_slot(const rpc_table_t *rpc_table,
+                                             uint32_t idx)
+{
+        return rpc_table->chunk[idx / RPC_TABLE_CHUNK][idx % RPC_TABLE_CHUNK];
+}
+
+/*
+ * slots with a call in flight also sit on a timeout wheel, hashed by
+ * deadline into RPC_WHEEL_SIZE buckets of RPC_WHEEL_TICK ms. expiry walks
+ * only the buckets whose tick has passed. a deadline more than one turn
+ * away stays in its bucket until its own turn comes.
+ */
+#define RPC_WHEEL_DUE 32
+
+typedef struct {
+        uint32_t idx;
+        uint32_t figerprint;
+} wheel_due_t;
+
+static inline uint64_t S_LTG __rpc_table_now()
+{
+        struct timeval tv;
+
+        _gettimeofday(&tv, NULL);
+
+        return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static inline struct list_head S_LTG *__rpc_wheel_bucket(rpc_table_t *rpc_table,
+                                                         uint64_t ms)
+{
+        return &rpc_table->wheel[(ms / RPC_WHEEL_TICK) % RPC_WHEEL_SIZE];
+}
+
+static void S_LTG __rpc_wheel_add(rpc_table_t *rpc_table, slot_t *slot)
+{
+        if (unlikely(!rpc_table->private))
+                ltg_spin_lock(&rpc_table->wheel_lock);
+
+        /* a tick already expired is not walked again until the next turn */
+        list_add_tail(&slot->wheel_hook, __rpc_wheel_bucket(rpc_table,
+                        _max(slot->deadline, rpc_table->wheel_now)));
+        rpc_table->wheel_count++;
+
+        if (unlikely(!rpc_table->private))
+                ltg_spin_unlock(&rpc_table->wheel_lock);
+}
+
+static void S_LTG __rpc_wheel_del(rpc_table_t *rpc_table, slot_t *slot)
+{
+        if (unlikely(!rpc_table->private))
+                ltg_spin_lock(&rpc_table->wheel_lock);
+
+        if (!list_empty(&slot->wheel_hook)) {
+                list_del_init(&slot->wheel_hook);
+                rpc_table->wheel_count--;
+        }
+
+        if (unlikely(!rpc_table->private))
+                ltg_spin_unlock(&rpc_table->wheel_lock);
+}
+
+/* takes due slots off the wheel, called with wheel_lock held */
+static int __rpc_wheel_due(rpc_table_t *rpc_table, uint64_t now,
+                           wheel_due_t *due, int max)
+{
+        int count = 0;
+        struct list_head *pos, *n, *head;
+        slot_t *slot;
+
+        /* after a long stall every bucket is walked once */
+        if (now - rpc_table->wheel_now >= RPC_WHEEL_TICK * RPC_WHEEL_SIZE) {
+                rpc_table->wheel_now = now - now % RPC_WHEEL_TICK
+                        - RPC_WHEEL_TICK * (RPC_WHEEL_SIZE - 1);
+        }
+
+        while (rpc_table->wheel_now + RPC_WHEEL_TICK <= now) {
+                head = __rpc_wheel_bucket(rpc_table, rpc_table->wheel_now);
+                list_for_each_safe(pos, n, head) {
+                        slot = list_entry(pos, slot_t, wheel_hook);
+                        if (slot->deadline > now)
+                                continue;
+
+                        list_del_init(&slot->wheel_hook);
+                        rpc_table->wheel_count--;
+                        due[count].idx = slot->msgid.idx;
+                        due[count].figerprint = slot->msgid.figerprint;
+                        count++;
+                        if (count == max)
+                                return count;
+                }
+
+                rpc_table->wheel_now += RPC_WHEEL_TICK;
+        }
+
+        return count;
+}
+
 static int S_LTG __rpc_table_used(rpc_table_t *rpc_table, slot_t *slot)
 {
         int ret;
@@ -34,17 +140,37 @@ static int S_LTG __rpc_table_used(rpc_table_t *rpc_table, slot_t *slot)
         }
 }
 
-static int S_LTG __rpc_table_use(rpc_table_t *rpc_table, slot_t *slot)
+/* a slot off the free list is unused, a scan may peek at a shared one */
+static void S_LTG __rpc_table_use(rpc_table_t *rpc_table, slot_t *slot)
 {
+        int ret;
+
         if (likely(rpc_table->private)) {
-                return pspin_trylock(&slot->used_pspin);
+                ret = pspin_trylock(&slot->used_pspin);
+                LTG_ASSERT(ret == 0);
         } else {
-                return ltg_spin_trylock(&slot->used_spin);
+                ret = ltg_spin_lock(&slot->used_spin);
+                if (unlikely(ret))
+                        UNIMPLEMENTED(__DUMP__);
         }
 }
 
+static void S_LTG __rpc_table_push(rpc_table_t *rpc_table, slot_t *slot)
+{
+        if (unlikely(!rpc_table->private))
+                ltg_spin_lock(&rpc_table->free_lock);
+
+        slot->free_next = rpc_table->free_head;
+        rpc_table->free_head = slot->msgid.idx;
+
+        if (unlikely(!rpc_table->private))
+                ltg_spin_unlock(&rpc_table->free_lock);
+}
+
 static void __rpc_table_free(rpc_table_t *rpc_table, slot_t *slot)
 {
+        __rpc_wheel_del(rpc_table, slot);
+
         slot->post = NULL;
         slot->post_arg = NULL;
         slot->timeout = 0;
@@ -57,7 +183,7 @@ static void __rpc_table_free(rpc_table_t *rpc_table, slot_t *slot)
                 ltg_spin_unlock(&slot->used_spin);
         }
 
-        //__rpc_table()->cur = slot->msgid.idx;
+        __rpc_table_push(rpc_table, slot);
 }
 
 static int S_LTG __rpc_table_lock(rpc_table_t *rpc_table, slot_t *slot)
@@ -84,22 +210,53 @@ static int __rpc_table_unlock(rpc_table_t *rpc_table, slot_t *slot)
                 return ltg_spin_unlock(&slot->lock);
 }
 
-static int __rpc_table_check(rpc_table_t *rpc_table, slot_t *slot, uint32_t now)
+static slot_t S_LTG *__rpc_table_lock_slot(rpc_table_t *rpc_table, const msgid_t *msgid)
 {
-        int ret, retval = ETIMEDOUT;
-        const char *conn;
+        int ret;
+        slot_t *slot;
 
-        ret = __rpc_table_trylock(rpc_table, slot);
-        if (unlikely(ret)) {
-                if (ret == EBUSY) {
-                        DINFO("%s @ %s/%u check, id (%u, %x) busy\n", slot->name,
-                              _inet_ntoa(slot->sockid.addr), slot->sockid.sd, slot->msgid.idx,
-                              slot->msgid.figerprint);
-                        return 0;
-                } else
-                        GOTO(err_ret, ret);
+        if (unlikely(msgid->idx >= rpc_table->count)) {
+                DWARN("slot[%u] out of %u\n", msgid->idx, rpc_table->count);
+                return NULL;
         }
 
+        slot = __rpc_table_slot(rpc_table, msgid->idx);
+        if (unlikely(msgid->figerprint != slot->msgid.figerprint)) {
+                DBUG("slot[%u] already closed\n", msgid->idx);
+                return NULL;
+        }
+
+        ret = __rpc_table_lock(rpc_table, slot);
+        if (unlikely(ret))
+                UNIMPLEMENTED(__DUMP__);
+
+        if (likely(__rpc_table_used(rpc_table, slot)))
+                return slot;
+        else {
+                DWARN("slot[%u] unused\n", msgid->idx);
+                __rpc_table_unlock(rpc_table, slot);
+                return NULL;
+        }
+
+        return slot;
+}
+
+static void __rpc_table_timeout(rpc_table_t *rpc_table, const wheel_due_t *due,
+                                uint64_t now)
+{
+        int retval = ETIMEDOUT;
+        const char *conn;
+        msgid_t msgid;
+        slot_t *slot;
+
+        msgid.idx = due->idx;
+        msgid.figerprint = due->figerprint;
+
+        /* replied or reset since it was taken off the wheel */
+        slot = __rpc_table_lock_slot(rpc_table, &msgid);
+        if (unlikely(slot == NULL))
+                return;
+
         if (slot->nid.id) {
                 if (netable_connected(&slot->nid)) {
                         conn = "connected";
@@ -110,83 +267,63 @@ static int __rpc_table_check(rpc_table_t *rpc_table, slot_t *slot, uint32_t now)
                 conn = "unknow";
         }
 
-        if (slot->timeout && now > slot->timeout
-            && (now - slot->timeout > (uint32_t)ltgconf_global.rpc_timeout / 2)) {
-                DINFO("%s @ %s/%u(%s) check, id (%u, %x), used %u timeout %d\n", slot->name,
-                      _inet_ntoa(slot->sockid.addr), slot->sockid.sd, conn, slot->msgid.idx,
-                      slot->msgid.figerprint, (int)(now - slot->begin), slot->timeout);
-        } else {
-                DBUG("%s @ %s/%u(%s) check, id (%u, %x), used %u\n", slot->name,
-                     _inet_ntoa(slot->sockid.addr), slot->sockid.sd, conn, slot->msgid.idx,
-                     slot->msgid.figerprint, (int)(now - slot->begin));
-        }
-
-        if (slot->timeout && now > slot->timeout) {
-                DWARN("%s @ %s/%u(%s) timeout, id (%u, %x), rpc %u "
-                      "used %u timeout %d\n", slot->name,
-                      _inet_ntoa(slot->sockid.addr), slot->sockid.sd,
-                      conn, slot->msgid.idx,
-                      slot->msgid.figerprint,
-                      ltgconf_global.rpc_timeout,
-                      (int)(now - slot->begin), slot->timeout);
-
-#if 1
-                slot->timeout = 0;
-                slot->close(&slot->nid, &slot->sockid, NULL);
-                slot->post(slot->post_arg, &retval, NULL, NULL);
-                __rpc_table_free(rpc_table, slot);
-#else
-                sockid_t sockid = slot->sockid; 
-                nid_t nid = slot->nid;
-                func2_t _close = slot->close;
-                
-                slot->timeout = 0;
-                slot->post(slot->post_arg, &retval, NULL, NULL);
-                __rpc_table_free(rpc_table, slot);
+        DWARN("%s @ %s/%u(%s) timeout, id (%u, %x), rpc %u "
+              "used %u timeout %d late %ums\n", slot->name,
+              _inet_ntoa(slot->sockid.addr), slot->sockid.sd,
+              conn, slot->msgid.idx,
+              slot->msgid.figerprint,
+              ltgconf_global.rpc_timeout,
+              (int)(gettime() - slot->begin), slot->timeout,
+              (uint32_t)(now - slot->deadline));
 
-                _close(&nid, &sockid, NULL);
-#endif
-        }
+        slot->timeout = 0;
+        slot->close(&slot->nid, &slot->sockid, NULL);
+        slot->post(slot->post_arg, &retval, NULL, NULL);
+        __rpc_table_free(rpc_table, slot);
 
         __rpc_table_unlock(rpc_table, slot);
-
-        return 0;
-err_ret:
-        return ret;
 }
 
-static void __rpc_table_scan(rpc_table_t *rpc_table)
+/*
+ * cheap when nothing is due, the core loop calls it every round. due
+ * slots are posted outside wheel_lock, close and post may reset the table.
+ */
+void S_LTG rpc_table_expire(rpc_table_t *rpc_table)
 {
-        slot_t *slot;
-        uint32_t i, used = 0, checked = 0;
-        time_t now = gettime();
-        
-        ANALYSIS_BEGIN(0);
-                
-        for (i = 0; i < rpc_table->count; i++) {
-                slot = rpc_table->slot[i];
+        int i, count;
+        uint64_t now = __rpc_table_now();
+        wheel_due_t due[RPC_WHEEL_DUE];
 
-                if (!__rpc_table_used(rpc_table, slot)) {
-                        continue;
-                }
+        if (likely(now < rpc_table->wheel_now + RPC_WHEEL_TICK))
+                return;
 
-                used++;
+        do {
+                if (unlikely(!rpc_table->private))
+                        ltg_spin_lock(&rpc_table->wheel_lock);
 
-                __rpc_table_check(rpc_table, slot, now);
+                count = __rpc_wheel_due(rpc_table, now, due, RPC_WHEEL_DUE);
 
-                checked++;
-        }
+                if (unlikely(!rpc_table->private))
+                        ltg_spin_unlock(&rpc_table->wheel_lock);
 
-        ANALYSIS_END(0, IO_WARN, NULL);
+                for (i = 0; i < count; i++) {
+                        __rpc_table_timeout(rpc_table, &due[i], now);
+                }
+        } while (count == RPC_WHEEL_DUE);
+}
+
+static void __rpc_table_scan(rpc_table_t *rpc_table)
+{
+        rpc_table_expire(rpc_table);
 
         rpc_table->last_scan = gettime();
 
-        if (used && (rpc_table->cycle % 2 == 0)) {
+        if (rpc_table->wheel_count && (rpc_table->cycle % 2 == 0)) {
                 rpc_table->cycle++;
-                DINFO("%s used %u/%u\n", rpc_table->name, used, checked);
+                DINFO("%s used %u/%u\n", rpc_table->name,
+                      rpc_table->wheel_count, rpc_table->count);
         }
 }
-
 #if 0
 static void __rpc_table_scan_task(void *args)
 {
@@ -240,11 +377,9 @@ static void  *__rpc_table_scan_worker(void *arg)
                         continue;
                 }
 
-                if (ltgconf_global.daemon) {
-                        sleep(2);
-                } else {
-                        sleep(1);
-                }
+                usleep(RPC_WHEEL_TICK * 1000);
+
+                rpc_table_expire(rpc_table);
 
                 interval = _min(ltgconf_global.rpc_timeout, 1);
                 rpc_table_scan(rpc_table, interval, 0);
@@ -254,33 +389,120 @@ static void  *__rpc_table_scan_worker(void *arg)
 }
 
 
-static slot_t S_LTG *__rpc_table_getslot_sequence(rpc_table_t *rpc_table)
+static int __rpc_table_slot_new(rpc_table_t *rpc_table, slot_t **_slot, uint32_t idx)
 {
-        int ret, retry = 0;
+        int ret;
         slot_t *slot;
-        uint32_t i, cur;
 
-        cur = rpc_table->cur;
-        for (i = 0; i < rpc_table->count; i++) {
-                slot = rpc_table->slot[(i + cur) %  rpc_table->count];
-                ret = __rpc_table_use(rpc_table, slot);
-                if (unlikely(ret == EBUSY)) {
-                        retry++;
-                        if (retry > 1000) {
-                                DWARN("retry %u\n", retry);
-                        }
+        if (rpc_table->private) {
+                ret = slab_static_alloc1((void **)&slot, sizeof(*slot));
+        } else {
+                ret = ltg_malloc_tag((void **)&slot, sizeof(*slot), MEM_TAG_RPC);
+        }
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
 
-                        continue;
-                }
+        ret = ltg_spin_init(&slot->lock);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        if (rpc_table->private) {
+                ret = pspin_init(&slot->used_pspin);
+        } else {
+                ret = ltg_spin_init(&slot->used_spin);
+        }
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        slot->msgid.idx = idx;
+        slot->msgid.tabid = rpc_table->tabid;
+        slot->msgid.figerprint = 0;
+        slot->figerprint_prev = 0;
+        slot->timeout = 0;
+        slot->name[0] = '\0';
+        slot->post_arg = NULL;
+        slot->post = NULL;
+        INIT_LIST_HEAD(&slot->wheel_hook);
 
-                rpc_table->cur = (i + cur + 1) % rpc_table->count;
+        *_slot = slot;
 
-                //DINFO("cur %d\n", rpc_table->cur);
+        return 0;
+err_ret:
+        return ret;
+}
 
-                return slot;
+/* called with free_lock held, the new slots go on the free list */
+static int __rpc_table_grow(rpc_table_t *rpc_table)
+{
+        int ret, i;
+        uint32_t count = rpc_table->count;
+        slot_t **chunk;
+
+        if (count + RPC_TABLE_CHUNK > rpc_table->max) {
+                ret = ENOSPC;
+                GOTO(err_ret, ret);
         }
 
-        return NULL;
+        if (rpc_table->private) {
+                ret = slab_static_alloc1((void **)&chunk,
+                                         sizeof(*chunk) * RPC_TABLE_CHUNK);
+        } else {
+                ret = ltg_malloc_tag((void **)&chunk, sizeof(*chunk) * RPC_TABLE_CHUNK,
+                                     MEM_TAG_RPC);
+        }
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        for (i = 0; i < RPC_TABLE_CHUNK; i++) {
+                ret = __rpc_table_slot_new(rpc_table, &chunk[i], count + i);
+                if (unlikely(ret))
+                        UNIMPLEMENTED(__DUMP__);
+        }
+
+        /* lowest idx on top */
+        for (i = RPC_TABLE_CHUNK - 1; i >= 0; i--) {
+                chunk[i]->free_next = rpc_table->free_head;
+                rpc_table->free_head = count + i;
+        }
+
+        rpc_table->chunk[count / RPC_TABLE_CHUNK] = chunk;
+        __atomic_store_n(&rpc_table->count, count + RPC_TABLE_CHUNK, __ATOMIC_RELEASE);
+
+        if (count >= RPC_TABLE_MAX) {
+                DINFO("%s grow to %u/%u\n", rpc_table->name,
+                      count + RPC_TABLE_CHUNK, rpc_table->max);
+        }
+
+        return 0;
+err_ret:
+        return ret;
+}
+
+static slot_t S_LTG *__rpc_table_pop(rpc_table_t *rpc_table)
+{
+        int ret;
+        slot_t *slot = NULL;
+
+        if (unlikely(!rpc_table->private))
+                ltg_spin_lock(&rpc_table->free_lock);
+
+        if (unlikely(rpc_table->free_head == RPC_TABLE_NULL)) {
+                ret = __rpc_table_grow(rpc_table);
+                if (unlikely(ret)) {
+                        DWARN("%s full, %u slots\n", rpc_table->name,
+                              rpc_table->count);
+                        goto out;
+                }
+        }
+
+        slot = __rpc_table_slot(rpc_table, rpc_table->free_head);
+        rpc_table->free_head = slot->free_next;
+
+out:
+        if (unlikely(!rpc_table->private))
+                ltg_spin_unlock(&rpc_table->free_lock);
+
+        return slot;
 }
 
 static void S_LTG __rpc_table_new(rpc_table_t *rpc_table, slot_t *slot)
@@ -304,12 +526,13 @@ int S_LTG rpc_table_getslot(rpc_table_t *rpc_table, msgid_t *msgid, const char *
         int ret;
         slot_t *slot;
 
-        slot = __rpc_table_getslot_sequence(rpc_table);
+        slot = __rpc_table_pop(rpc_table);
         if (unlikely(slot == NULL)) {
                 ret = ENOSPC;
                 GOTO(err_ret, ret);
         }
 
+        __rpc_table_use(rpc_table, slot);
         __rpc_table_new(rpc_table, slot);
 
         *msgid = slot->msgid;
@@ -320,32 +543,6 @@ err_ret:
         return ret;
 }
 
-static slot_t S_LTG *__rpc_table_lock_slot(rpc_table_t *rpc_table, const msgid_t *msgid)
-{
-        int ret;
-        slot_t *slot;
-
-        slot = rpc_table->slot[msgid->idx];
-        if (unlikely(msgid->figerprint != slot->msgid.figerprint)) {
-                DBUG("slot[%u] already closed\n", msgid->idx);
-                return NULL;
-        }
-
-        ret = __rpc_table_lock(rpc_table, slot);
-        if (unlikely(ret))
-                UNIMPLEMENTED(__DUMP__);
-
-        if (likely(__rpc_table_used(rpc_table, slot)))
-                return slot;
-        else {
-                DWARN("slot[%u] unused\n", msgid->idx);
-                __rpc_table_unlock(rpc_table, slot);
-                return NULL;
-        }
-
-        return slot;
-}
-
 int S_LTG rpc_table_setslot(rpc_table_t *rpc_table, const msgid_t *msgid, func3_t func, void *arg,
                       func2_t _close, const nid_t *nid, const sockid_t *sockid, int timeout)
 {
@@ -365,6 +562,7 @@ int S_LTG rpc_table_setslot(rpc_table_t *rpc_table, const msgid_t *msgid, func3_
         slot->close = _close;
         slot->begin = gettime();
         slot->timeout = slot->begin + timeout;
+        slot->deadline = __rpc_table_now() + timeout * 1000;
 
         if (sockid) 
                 slot->sockid = *sockid;
@@ -378,6 +576,8 @@ int S_LTG rpc_table_setslot(rpc_table_t *rpc_table, const msgid_t *msgid, func3_
                 memset(&slot->nid, 0x0, sizeof(*nid));
         }
         
+        __rpc_wheel_add(rpc_table, slot);
+
         __rpc_table_unlock(rpc_table, slot);
 
         return 0;
@@ -471,7 +671,7 @@ err_ret:
 
 void rpc_table_reset(rpc_table_t *rpc_table, const sockid_t *sockid, const nid_t *nid)
 {
-        uint32_t i;
+        uint32_t i, count;
         slot_t *slot;
 
         if (rpc_table == NULL) {
@@ -479,8 +679,9 @@ void rpc_table_reset(rpc_table_t *rpc_table, const sockid_t *sockid, const nid_t
                 return;
         }
 
-        for (i = 0; i < rpc_table->count; i++) {
-                slot = rpc_table->slot[i];
+        count = __atomic_load_n(&rpc_table->count, __ATOMIC_ACQUIRE);
+        for (i = 0; i < count; i++) {
+                slot = __rpc_table_slot(rpc_table, i);
                 __rpc_table_reset(rpc_table, slot, sockid, nid);
         }
 }
@@ -489,57 +690,49 @@ static int __rpc_table_create(const char *name, int count, int tabid,
                               int private, rpc_table_t **_rpc_table)
 {
         int ret, i;
-        slot_t *slot;
         rpc_table_t *rpc_table;
 
-        uint32_t size = sizeof(rpc_table_t) + sizeof(slot_t *) * count;
+        uint32_t size = sizeof(rpc_table_t);
         if (private) {
                 ret = slab_static_alloc1((void **)&rpc_table, size);
         } else {
-                ret = ltg_malloc((void **)&rpc_table, size);
+                ret = ltg_malloc_tag((void **)&rpc_table, size, MEM_TAG_RPC);
         }
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
-        for (i = 0; i < count; i++) {
-                if (private) {
-                        ret = slab_static_alloc1((void **)&slot, sizeof(*slot));
-                } else {
-                        ret = ltg_malloc((void **)&slot, sizeof(*slot));
-                }
-                if (unlikely(ret))
-                        UNIMPLEMENTED(__DUMP__);
-                
-                ret = ltg_spin_init(&slot->lock);
-                if (unlikely(ret))
-                        GOTO(err_ret, ret);
-
-                if (private) {
-                        ret = pspin_init(&slot->used_pspin);
-                } else {
-                        ret = ltg_spin_init(&slot->used_spin);
-                }
-                if (unlikely(ret))
-                        GOTO(err_ret, ret);
-
-                slot->msgid.idx = i;
-                slot->msgid.tabid = tabid;
-                slot->msgid.figerprint = 0;
-                slot->figerprint_prev = 0;
-                slot->timeout = 0;
-                slot->name[0] = '\0';
-                slot->post_arg = NULL;
-                slot->post = NULL;
-
-                rpc_table->slot[i] = slot;
-        }
-
+        memset(rpc_table, 0x0, size);
         strcpy(rpc_table->name, name);
         rpc_table->sequence = _random();
-        rpc_table->count = count;
+        rpc_table->count = 0;
+        rpc_table->max = _min(_max(ltgconf_global.rpc_table_max, count),
+                              RPC_TABLE_CHUNK * RPC_TABLE_CHUNK_MAX);
         rpc_table->tabid = tabid;
         rpc_table->last_scan = 0;
         rpc_table->private = private;
+        rpc_table->free_head = RPC_TABLE_NULL;
+
+        ret = ltg_spin_init(&rpc_table->free_lock);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        ret = ltg_spin_init(&rpc_table->wheel_lock);
+        if (unlikely(ret))
+                GOTO(err_ret, ret);
+
+        for (i = 0; i < RPC_WHEEL_SIZE; i++) {
+                INIT_LIST_HEAD(&rpc_table->wheel[i]);
+        }
+
+        rpc_table->wheel_now = __rpc_table_now();
+        rpc_table->wheel_now -= rpc_table->wheel_now % RPC_WHEEL_TICK;
+
+        for (i = 0; i < count / RPC_TABLE_CHUNK; i++) {
+                ret = __rpc_table_grow(rpc_table);
+                if (unlikely(ret))
+                        GOTO(err_ret, ret);
+        }
+
         *_rpc_table = rpc_table;
 
         return 0;
@@ -584,7 +777,7 @@ void rpc_table_destroy(rpc_table_t **_rpc_table)
         int retval = ECONNRESET;
 
         for (int i = 0; i < (int)rpc_table->count; i++) {
-                slot = rpc_table->slot[i];
+                slot = __rpc_table_slot(rpc_table, i);
 
                 if (!__rpc_table_used(rpc_table, slot)) {
                         continue;
@@ -598,6 +791,6 @@ void rpc_table_destroy(rpc_table_t **_rpc_table)
         if (rpc_table->private) {
                 slab_static_free1((void **)&rpc_table);
         } else {
-                ltg_free((void **)&rpc_table);
+                ltg_free_tag((void **)&rpc_table, MEM_TAG_RPC);
         }
 }
@@ -171,7 +171,7 @@ STATIC int __rpc_request_handler(const nid_t *nid, const sockid_t *sockid,
         static_assert(sizeof(*rpc_request)  < sizeof(mem_cache128_t),
                       "rpc_request_t");
 #endif
-        rpc_request = slab_stream_alloc(sizeof(rpc_request_t));
+        rpc_request = obj_pool_alloc(OBJ_POOL_RPC_REQUEST, sizeof(rpc_request_t));
         if (!rpc_request) {
                 ret = ENOMEM;
                 GOTO(err_ret, ret);
@@ -359,13 +359,15 @@ int analysis_create(analysis_t **_ana, const char *_name, int private)
                 GOTO(err_ret, ret);
         }
 
-        ret = ltg_malloc((void **)&ana->queue, sizeof(analysis_queue_t));
+        ret = ltg_malloc_tag((void **)&ana->queue, sizeof(analysis_queue_t),
+                             MEM_TAG_ANALYSIS);
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
         ana->queue->count = 0;
 
-        ret = ltg_malloc((void **)&ana->new_queue, sizeof(analysis_queue_t));
+        ret = ltg_malloc_tag((void **)&ana->new_queue, sizeof(analysis_queue_t),
+                             MEM_TAG_ANALYSIS);
         if (unlikely(ret))
                 GOTO(err_ret, ret);
 
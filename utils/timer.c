@@ -380,6 +380,27 @@ err_ret:
         return ret;
 }
 
+/* usec until the first timer of this core is due, -1 without one */
+suseconds_t timer_next()
+{
+        int ret;
+        void *first;
+        ltimer_t *timer;
+        __time_t now;
+
+        timer = core_tls_get(NULL, VARIABLE_TIMER);
+        if (timer == NULL)
+                return -1;
+
+        ret = skiplist_get1st(timer->group.list, &first);
+        if (ret)
+                return -1;
+
+        now = __timer_gettime();
+
+        return now >= ((entry_t *)first)->time ? 0 : ((entry_t *)first)->time - now;
+}
+
 inline static void INLINE __timer_routine(void *_core, void *var, void *_timer)
 {
         (void) var;